@@ -0,0 +1,56 @@
+//
+//  AllocationCounter.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "AllocationCounter.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<long> allocationCount(0);
+static std::atomic<long> allocationBytes(0);
+
+AllocationCount currentAllocationCount() {
+    AllocationCount result;
+    result.count = allocationCount.load(std::memory_order_relaxed);
+    result.bytes = allocationBytes.load(std::memory_order_relaxed);
+    return result;
+}
+
+static void* countedAllocate(const std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocationBytes.fetch_add((long)size, std::memory_order_relaxed);
+    void* memory = malloc(size > 0 ? size : 1);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new(std::size_t size) {
+    return countedAllocate(size);
+}
+
+void* operator new[](std::size_t size) {
+    return countedAllocate(size);
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    free(memory);
+}
@@ -0,0 +1,22 @@
+//
+//  AllocationCounter.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef AllocationCounter_hpp
+#define AllocationCounter_hpp
+
+struct AllocationCount {
+    long count = 0;
+    long bytes = 0;
+};
+
+/**
+ Counts every global operator new in the process. The benchmark binary replaces the global allocation operators
+ (see AllocationCounter.cpp), so only code linked into it is counted; the solver itself is unchanged.
+ */
+AllocationCount currentAllocationCount();
+
+#endif /* AllocationCounter_hpp */
@@ -0,0 +1,503 @@
+//
+//  BenchmarkMain.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "BenchmarkSuite.hpp"
+#include "EngineCalibration.hpp"
+#include "KernelBenchmark.hpp"
+#include "RegressionGate.hpp"
+#include "ThreadPool.hpp"
+
+#ifndef SUDOKU_INPUT_DIRECTORY
+#define SUDOKU_INPUT_DIRECTORY "Input"
+#endif
+
+static std::vector<std::string> splitNames(const std::string& list) {
+    std::vector<std::string> names;
+    std::stringstream stream(list);
+    std::string name;
+    while (getline(stream, name, ',')) {
+        if (!name.empty()) {
+            names.push_back(name);
+        }
+    }
+    return names;
+}
+
+// corpus and configuration selection plus the options every suite command accepts
+struct SuiteSelection {
+    BenchmarkOptions options;
+    std::vector<std::string> corpusNames = BenchmarkSuite::corpusNames();
+    std::vector<std::string> configurationNames;
+    int threadCount = 0;
+};
+
+// false when the option isn't one of the suite's
+static bool parseSuiteOption(const std::string& argument, const std::string& value, SuiteSelection& selection) {
+    if (argument == "--corpus") {
+        selection.corpusNames = splitNames(value);
+    } else if (argument == "--config") {
+        selection.configurationNames = splitNames(value);
+    } else if (argument == "--count") {
+        selection.options.generatedCount = atoi(value.c_str());
+    } else if (argument == "--warmup") {
+        selection.options.warmupRuns = atoi(value.c_str());
+    } else if (argument == "--reps") {
+        selection.options.repetitions = atoi(value.c_str());
+    } else if (argument == "--timeout") {
+        selection.options.timeoutSeconds = atof(value.c_str());
+    } else if (argument == "--seed") {
+        selection.options.seed = strtoull(value.c_str(), nullptr, 10);
+    } else if (argument == "--threads") {
+        selection.threadCount = atoi(value.c_str());
+    } else if (argument == "--input") {
+        selection.options.inputDirectory = value;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// false for unknown names
+static bool buildCorpora(const BenchmarkSuite& suite, const std::vector<std::string>& names, BenchmarkCorpusVector& corpora) {
+    for (auto name = names.begin(); name != names.end(); ++name) {
+        auto start = std::chrono::steady_clock::now();
+        BenchmarkCorpus corpus;
+        if (!suite.buildCorpus(*name, corpus)) {
+            std::cerr << "unknown corpus: " << *name << std::endl;
+            return false;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cerr << "corpus " << corpus.name << ": " << corpus.grids.size() << " puzzles (" << corpus.description << ") in " << elapsed.count() << " s" << std::endl;
+        corpora.push_back(corpus);
+    }
+    return true;
+}
+
+/**
+ Builds the selected corpora and runs the selected configurations on them, printing the table as it goes. With
+ withCounters, also steps through the logic on every corpus small enough for it. False for unknown names.
+ */
+static bool runSelection(const SuiteSelection& selection, const bool withCounters, BenchmarkBaseline& run) {
+    BenchmarkConfigurationVector configurations;
+    const BenchmarkConfigurationVector knownConfigurations = BenchmarkSuite::defaultConfigurations();
+    for (auto name = selection.configurationNames.begin(); name != selection.configurationNames.end(); ++name) {
+        auto found = std::find_if(knownConfigurations.begin(), knownConfigurations.end(), [&](const BenchmarkConfiguration& configuration) {
+            return configuration.name == *name;
+        });
+        if (found == knownConfigurations.end()) {
+            std::cerr << "unknown configuration: " << *name << std::endl;
+            return false;
+        }
+        configurations.push_back(*found);
+    }
+    if (selection.configurationNames.empty()) {
+        configurations = knownConfigurations;
+    }
+
+    ThreadPool pool(selection.threadCount);
+    BenchmarkSuite suite(selection.options, pool);
+    BenchmarkCorpusVector corpora;
+    if (!buildCorpora(suite, selection.corpusNames, corpora)) {
+        return false;
+    }
+    const BenchmarkOptions& options = selection.options;
+    std::cerr << options.warmupRuns << " warmup runs, " << options.repetitions << " measured runs, timeout " << options.timeoutSeconds << " s per puzzle" << std::endl;
+
+    run = BenchmarkBaseline();
+    run.options = options;
+    BenchmarkSuite::printTableHeader(std::cout);
+    for (auto corpus = corpora.begin(); corpus != corpora.end(); ++corpus) {
+        for (auto configuration = configurations.begin(); configuration != configurations.end(); ++configuration) {
+            BenchmarkResult result;
+            if (!suite.run(*corpus, *configuration, result)) {
+                continue;
+            }
+            BenchmarkSuite::printTableRow(std::cout, result);
+            run.results.push_back(result);
+        }
+        TechniqueCounters counters;
+        if (withCounters && suite.countTechniques(*corpus, counters)) {
+            run.counters.push_back(counters);
+        }
+    }
+    return true;
+}
+
+static const BenchmarkResult* findBaselineResult(const BenchmarkBaseline& baseline, const std::string& corpus, const std::string& configuration) {
+    for (auto result = baseline.results.begin(); result != baseline.results.end(); ++result) {
+        if (result->corpus == corpus && result->configuration == configuration) {
+            return &*result;
+        }
+    }
+    return nullptr;
+}
+
+static long wrongSolutionCount(const BenchmarkBaseline& run) {
+    long count = 0;
+    for (auto result = run.results.begin(); result != run.results.end(); ++result) {
+        count += result->wrongCount;
+    }
+    return count;
+}
+
+/**
+ sudoku_bench [--corpus name,...] [--config name,...] [--count n] [--warmup n] [--reps n] [--timeout seconds]
+              [--seed n] [--threads n] [--input directory] [--json file]
+
+ Runs every selected configuration on every selected corpus and prints one table row per pair; --json also writes
+ the rows to a file for scripts. --threads only affects corpus generation, solves are timed one at a time.
+ Exits with 1 when any configuration returned a wrong solution.
+ */
+static int runSuite(const int argc, const char * argv[]) {
+    SuiteSelection selection;
+    selection.options.inputDirectory = SUDOKU_INPUT_DIRECTORY;
+    std::string jsonFilename = "";
+    for (int i = 0; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "missing value for " << argument << std::endl;
+            return 1;
+        }
+        const std::string value = argv[++i];
+        if (argument == "--json") {
+            jsonFilename = value;
+        } else if (!parseSuiteOption(argument, value, selection)) {
+            std::cerr << "unknown option: " << argument << std::endl;
+            return 1;
+        }
+    }
+
+    BenchmarkBaseline run;
+    if (!runSelection(selection, false, run)) {
+        return 1;
+    }
+    if (!jsonFilename.empty()) {
+        std::ofstream file(jsonFilename);
+        if (!file.is_open()) {
+            std::cerr << "unable to write " << jsonFilename << std::endl;
+            return 1;
+        }
+        BenchmarkSuite::writeJson(file, run.options, run.results);
+    }
+    return wrongSolutionCount(run) > 0 ? 1 : 0;
+}
+
+/**
+ sudoku_bench record --baseline file [suite options]
+
+ Runs the suite like the default command and stores per-puzzle timings, statuses, DFS nodes and the technique
+ counters as a baseline for compare.
+ */
+static int runRecord(const int argc, const char * argv[]) {
+    SuiteSelection selection;
+    selection.options.inputDirectory = SUDOKU_INPUT_DIRECTORY;
+    std::string baselineFilename = "";
+    for (int i = 0; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "missing value for " << argument << std::endl;
+            return 1;
+        }
+        const std::string value = argv[++i];
+        if (argument == "--baseline") {
+            baselineFilename = value;
+        } else if (!parseSuiteOption(argument, value, selection)) {
+            std::cerr << "unknown option: " << argument << std::endl;
+            return 1;
+        }
+    }
+    if (baselineFilename.empty()) {
+        std::cerr << "record needs --baseline file" << std::endl;
+        return 1;
+    }
+
+    BenchmarkBaseline run;
+    if (!runSelection(selection, true, run)) {
+        return 1;
+    }
+    if (wrongSolutionCount(run) > 0) {
+        std::cerr << "not recording a baseline with wrong solutions" << std::endl;
+        return 1;
+    }
+    if (!RegressionGate::writeBaseline(baselineFilename, run)) {
+        std::cerr << "unable to write " << baselineFilename << std::endl;
+        return 1;
+    }
+    std::cerr << "Baseline written to " << baselineFilename << std::endl;
+    return 0;
+}
+
+/**
+ sudoku_bench compare --baseline file [--threshold fraction] [--tail-threshold fraction] [--alpha p] [--retries n]
+                      [--corpus name,...] [--config name,...] [--threads n] [--input directory]
+
+ Reruns the baseline's corpora and configurations (or the selected subset) with the baseline's count, seed,
+ repetitions and timeout, then prints the RegressionGate report. Pairs that only regressed in their timings are
+ run again up to --retries times (2 by default). Exits with 1 when the gate fails.
+ */
+static int runCompare(const int argc, const char * argv[]) {
+    SuiteSelection selection;
+    selection.options.inputDirectory = SUDOKU_INPUT_DIRECTORY;
+    GateOptions gateOptions;
+    int retryCount = 2;
+    std::string baselineFilename = "";
+    bool corporaSelected = false;
+    bool configurationsSelected = false;
+    for (int i = 0; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "missing value for " << argument << std::endl;
+            return 1;
+        }
+        const std::string value = argv[++i];
+        if (argument == "--baseline") {
+            baselineFilename = value;
+        } else if (argument == "--threshold") {
+            gateOptions.throughputThreshold = atof(value.c_str());
+        } else if (argument == "--tail-threshold") {
+            gateOptions.tailThreshold = atof(value.c_str());
+        } else if (argument == "--alpha") {
+            gateOptions.significance = atof(value.c_str());
+        } else if (argument == "--retries") {
+            retryCount = std::max(0, atoi(value.c_str()));
+        } else if (argument == "--corpus" || argument == "--config" || argument == "--threads" || argument == "--input") {
+            parseSuiteOption(argument, value, selection);
+            corporaSelected |= argument == "--corpus";
+            configurationsSelected |= argument == "--config";
+        } else {
+            std::cerr << "unknown option: " << argument << std::endl;
+            return 1;
+        }
+    }
+
+    BenchmarkBaseline baseline;
+    std::string error;
+    if (baselineFilename.empty() || !RegressionGate::readBaseline(baselineFilename, baseline, error)) {
+        std::cerr << (baselineFilename.empty() ? "compare needs --baseline file" : error) << std::endl;
+        return 1;
+    }
+    const std::string inputDirectory = selection.options.inputDirectory;
+    selection.options = baseline.options;
+    selection.options.inputDirectory = inputDirectory;
+
+    // only the baseline's pairs that were selected are compared
+    const auto isSelected = [](const std::vector<std::string>& names, const std::string& name) {
+        return std::find(names.begin(), names.end(), name) != names.end();
+    };
+    BenchmarkResultVector selectedResults;
+    std::vector<std::string> corpusNames;
+    std::vector<std::string> configurationNames;
+    for (auto result = baseline.results.begin(); result != baseline.results.end(); ++result) {
+        if ((corporaSelected && !isSelected(selection.corpusNames, result->corpus)) || (configurationsSelected && !isSelected(selection.configurationNames, result->configuration))) {
+            continue;
+        }
+        selectedResults.push_back(*result);
+        if (!isSelected(corpusNames, result->corpus)) {
+            corpusNames.push_back(result->corpus);
+        }
+        if (!isSelected(configurationNames, result->configuration)) {
+            configurationNames.push_back(result->configuration);
+        }
+    }
+    TechniqueCountersVector selectedCounters;
+    for (auto counters = baseline.counters.begin(); counters != baseline.counters.end(); ++counters) {
+        if (isSelected(corpusNames, counters->corpus)) {
+            selectedCounters.push_back(*counters);
+        }
+    }
+    baseline.results = selectedResults;
+    baseline.counters = selectedCounters;
+    if (baseline.results.empty()) {
+        std::cerr << "nothing to compare" << std::endl;
+        return 1;
+    }
+    selection.corpusNames = corpusNames;
+    selection.configurationNames = configurationNames;
+
+    BenchmarkBaseline run;
+    if (!runSelection(selection, true, run)) {
+        return 1;
+    }
+    GateReport report = RegressionGate::compare(baseline, run, gateOptions);
+
+    for (int retry = 0; retry < retryCount && !report.timingRegressions().empty(); retry++) {
+        const std::vector<GateRow> regressions = report.timingRegressions();
+        BenchmarkBaseline retryBaseline = baseline;
+        retryBaseline.results.clear();
+        retryBaseline.counters.clear();
+        SuiteSelection retrySelection = selection;
+        retrySelection.corpusNames.clear();
+        retrySelection.configurationNames.clear();
+        for (auto row = regressions.begin(); row != regressions.end(); ++row) {
+            retryBaseline.results.push_back(*findBaselineResult(baseline, row->corpus, row->configuration));
+            if (!isSelected(retrySelection.corpusNames, row->corpus)) {
+                retrySelection.corpusNames.push_back(row->corpus);
+            }
+            if (!isSelected(retrySelection.configurationNames, row->configuration)) {
+                retrySelection.configurationNames.push_back(row->configuration);
+            }
+        }
+        std::cerr << "Running " << regressions.size() << " slower pairs again (" << retry + 1 << "/" << retryCount << ")" << std::endl;
+        BenchmarkBaseline retryRun;
+        if (!runSelection(retrySelection, false, retryRun)) {
+            return 1;
+        }
+        RegressionGate::mergeRetry(report, RegressionGate::compare(retryBaseline, retryRun, gateOptions));
+    }
+
+    std::cout << std::endl;
+    RegressionGate::printReport(std::cout, report, gateOptions);
+    return report.failed || wrongSolutionCount(run) > 0 ? 1 : 0;
+}
+
+/**
+ sudoku_bench kernels [--sizes n,...] [--states n] [--min-time seconds] [--seed n] [--json file]
+
+ Times the propagation kernels, GridEditor operations and combination lists on mid-solve states of each grid size
+ (9, 16 and 25 by default) and prints ns and allocations per call.
+ */
+static int runKernels(const int argc, const char * argv[]) {
+    KernelOptions options;
+    std::vector<int> sizes = {9, 16, 25};
+    std::string jsonFilename = "";
+    for (int i = 0; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "missing value for " << argument << std::endl;
+            return 1;
+        }
+        const std::string value = argv[++i];
+        if (argument == "--sizes") {
+            sizes.clear();
+            const std::vector<std::string> names = splitNames(value);
+            for (auto name = names.begin(); name != names.end(); ++name) {
+                sizes.push_back(atoi(name->c_str()));
+            }
+        } else if (argument == "--states") {
+            options.stateCount = atoi(value.c_str());
+        } else if (argument == "--min-time") {
+            options.minimumSeconds = atof(value.c_str());
+        } else if (argument == "--seed") {
+            options.seed = strtoull(value.c_str(), nullptr, 10);
+        } else if (argument == "--json") {
+            jsonFilename = value;
+        } else {
+            std::cerr << "unknown option: " << argument << std::endl;
+            return 1;
+        }
+    }
+    for (auto size = sizes.begin(); size != sizes.end(); ++size) {
+        if (!BitmaskSolver::supportsSize(*size)) {
+            std::cerr << "unsupported size: " << *size << std::endl;
+            return 1;
+        }
+    }
+
+    KernelBenchmark benchmark(options);
+    KernelResultVector results;
+    KernelBenchmark::printTableHeader(std::cout);
+    for (auto size = sizes.begin(); size != sizes.end(); ++size) {
+        const KernelResultVector sizeResults = benchmark.run(*size);
+        for (auto result = sizeResults.begin(); result != sizeResults.end(); ++result) {
+            KernelBenchmark::printTableRow(std::cout, *result);
+        }
+        results.insert(results.end(), sizeResults.begin(), sizeResults.end());
+    }
+
+    if (!jsonFilename.empty()) {
+        std::ofstream file(jsonFilename);
+        if (!file.is_open()) {
+            std::cerr << "unable to write " << jsonFilename << std::endl;
+            return 1;
+        }
+        KernelBenchmark::writeJson(file, options, results);
+    }
+    return 0;
+}
+
+/**
+ sudoku_bench calibrate --model file [--corpus name,...] [--count n] [--reps n] [--timeout seconds] [--seed n]
+                        [--threads n] [--input directory]
+
+ Times every EngineCostModel strategy on every puzzle of the selected corpora, prints how a model fitted on half
+ of them picks for the other half, and writes the model fitted on all of them. The output is what
+ EngineCostModel::builtIn holds, or a file for "sudoku_solver --model".
+ */
+static int runCalibrate(const int argc, const char * argv[]) {
+    SuiteSelection selection;
+    selection.options.inputDirectory = SUDOKU_INPUT_DIRECTORY;
+    CalibrationOptions calibrationOptions;
+    std::string modelFilename = "";
+    for (int i = 0; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "missing value for " << argument << std::endl;
+            return 1;
+        }
+        const std::string value = argv[++i];
+        if (argument == "--model") {
+            modelFilename = value;
+        } else if (argument == "--reps") {
+            calibrationOptions.repetitions = atoi(value.c_str());
+        } else if (argument == "--timeout") {
+            calibrationOptions.timeoutSeconds = atof(value.c_str());
+        } else if (argument == "--config" || argument == "--warmup" || !parseSuiteOption(argument, value, selection)) {
+            std::cerr << "unknown option: " << argument << std::endl;
+            return 1;
+        }
+    }
+    if (modelFilename.empty()) {
+        std::cerr << "calibrate needs --model file" << std::endl;
+        return 1;
+    }
+
+    ThreadPool pool(selection.threadCount);
+    BenchmarkSuite suite(selection.options, pool);
+    BenchmarkCorpusVector corpora;
+    if (!buildCorpora(suite, selection.corpusNames, corpora)) {
+        return 1;
+    }
+    const CalibrationSampleVector samples = EngineCalibration::measure(corpora, calibrationOptions);
+    EngineCalibration::printEvaluation(std::cout, samples, calibrationOptions);
+
+    EngineCostModel model;
+    if (!EngineCalibration::fit(samples, calibrationOptions, model)) {
+        std::cerr << "too few puzzles to fit a model" << std::endl;
+        return 1;
+    }
+    if (!model.write(modelFilename)) {
+        std::cerr << "unable to write " << modelFilename << std::endl;
+        return 1;
+    }
+    std::cerr << "Model written to " << modelFilename << std::endl;
+    return 0;
+}
+
+int main(int argc, const char * argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "record") {
+        return runRecord(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::string(argv[1]) == "compare") {
+        return runCompare(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::string(argv[1]) == "kernels") {
+        return runKernels(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::string(argv[1]) == "calibrate") {
+        return runCalibrate(argc - 2, argv + 2);
+    }
+    return runSuite(argc - 1, argv + 1);
+}
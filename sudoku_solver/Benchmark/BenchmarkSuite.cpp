@@ -0,0 +1,493 @@
+//
+//  BenchmarkSuite.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "BenchmarkSuite.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <dirent.h>
+#include <fstream>
+#include <iomanip>
+#include <sys/resource.h>
+
+#include "AllocationCounter.hpp"
+#include "LaneSolver.hpp"
+
+// generated puzzles are graded in rounds of this many per wanted hard puzzle, for at most kMaxHardRounds rounds
+static const int kHardCandidatesPerPuzzle = 4;
+static const int kMaxHardRounds = 16;
+
+// clue counts for the generated corpora that aren't minimal; low enough to need work, high enough that every
+// configuration finishes them well within the default timeout
+static const int kEasyClueCount = 36;
+static const int kSixteenClueCount = 150;
+static const int kTwentyFiveClueCount = 420;
+
+// largest grids countTechniques steps through
+static const int kMaxCountedSize = 9;
+
+BenchmarkSuite::BenchmarkSuite(const BenchmarkOptions options, ThreadPool& pool) : _options(options), _pool(pool) {
+    _options.warmupRuns = std::max(0, _options.warmupRuns);
+    _options.repetitions = std::max(1, _options.repetitions);
+    _options.generatedCount = std::max(1, _options.generatedCount);
+}
+
+#pragma mark - Corpora
+
+std::vector<std::string> BenchmarkSuite::corpusNames() {
+    return {"input", "easy", "hard", "minimal", "sixteen", "twentyfive"};
+}
+
+bool BenchmarkSuite::buildCorpus(const std::string name, BenchmarkCorpus& corpus) const {
+    GeneratorOptions options;
+    options.seed = _options.seed;
+    if (name == "input") {
+        corpus = _loadInputCorpus();
+    } else if (name == "easy") {
+        options.targetClueCount = kEasyClueCount;
+        corpus = _generateCorpus(name, "9x9, " + std::to_string(kEasyClueCount) + " clues", options, _options.generatedCount);
+    } else if (name == "hard") {
+        corpus = _generateHardCorpus(_options.generatedCount);
+    } else if (name == "minimal") {
+        options.seed += 1000;
+        corpus = _generateCorpus(name, "9x9, no clue can be removed", options, _options.generatedCount);
+    } else if (name == "sixteen") {
+        options.size = 16;
+        options.targetClueCount = kSixteenClueCount;
+        options.seed += 3000;
+        corpus = _generateCorpus(name, "16x16, " + std::to_string(kSixteenClueCount) + " clues", options, _options.generatedCount);
+    } else if (name == "twentyfive") {
+        options.size = 25;
+        options.targetClueCount = kTwentyFiveClueCount;
+        options.seed += 4000;
+        corpus = _generateCorpus(name, "25x25, " + std::to_string(kTwentyFiveClueCount) + " clues", options, std::max(1, _options.generatedCount / 4));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+BenchmarkCorpus BenchmarkSuite::_loadInputCorpus() const {
+    BenchmarkCorpus corpus;
+    corpus.name = "input";
+    corpus.description = _options.inputDirectory + "/*.txt";
+
+    std::vector<std::string> filenames;
+    DIR* directory = opendir(_options.inputDirectory.c_str());
+    if (directory != nullptr) {
+        while (dirent* entry = readdir(directory)) {
+            const std::string filename = entry->d_name;
+            if (filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".txt") == 0) {
+                filenames.push_back(filename);
+            }
+        }
+        closedir(directory);
+    }
+    // readdir order depends on the file system
+    std::sort(filenames.begin(), filenames.end());
+    for (auto filename = filenames.begin(); filename != filenames.end(); ++filename) {
+        Grid grid(_options.inputDirectory + "/" + *filename);
+        if (grid.getSize() > 0) {
+            corpus.grids.push_back(grid);
+        }
+    }
+    return corpus;
+}
+
+BenchmarkCorpus BenchmarkSuite::_generateCorpus(const std::string name, const std::string description, const GeneratorOptions options, const int count) const {
+    BenchmarkCorpus corpus;
+    corpus.name = name;
+    corpus.description = description;
+    PuzzleGenerator generator(options);
+    GeneratedPuzzleVector puzzles = generator.generate(count, _pool);
+    for (auto puzzle = puzzles.begin(); puzzle != puzzles.end(); ++puzzle) {
+        corpus.grids.push_back(puzzle->puzzleGrid());
+    }
+    return corpus;
+}
+
+/**
+ Random minimal puzzles are mostly solvable with simple techniques, so the hard corpus keeps only the ones the
+ grader rates Expert or Extreme, generating more rounds until there are enough (or the round limit is hit).
+ */
+BenchmarkCorpus BenchmarkSuite::_generateHardCorpus(const int count) const {
+    BenchmarkCorpus corpus;
+    corpus.name = "hard";
+    corpus.description = "9x9 minimal, graded expert or extreme";
+    for (int round = 0; round < kMaxHardRounds && (int)corpus.grids.size() < count; round++) {
+        GeneratorOptions options;
+        options.seed = _options.seed + 2000 + round;
+        PuzzleGenerator generator(options);
+        GeneratedPuzzleVector puzzles = generator.generate(count * kHardCandidatesPerPuzzle, _pool);
+
+        GridVector graded;
+        for (auto puzzle = puzzles.begin(); puzzle != puzzles.end(); ++puzzle) {
+            graded.push_back(puzzle->puzzleGrid());
+        }
+        GradeReportVector reports = DifficultyGrader::gradeAll(graded, _pool);
+        for (size_t i = 0; i < puzzles.size() && (int)corpus.grids.size() < count; i++) {
+            if (reports[i].difficulty == Difficulty::Expert || reports[i].difficulty == Difficulty::Extreme) {
+                corpus.grids.push_back(puzzles[i].puzzleGrid());
+            }
+        }
+    }
+    return corpus;
+}
+
+#pragma mark - Configurations
+
+BenchmarkConfigurationVector BenchmarkSuite::defaultConfigurations() {
+    BenchmarkConfigurationVector configurations;
+
+    BenchmarkConfiguration automatic;
+    automatic.name = "auto";
+    configurations.push_back(automatic);
+
+    BenchmarkConfiguration lookahead;
+    lookahead.name = "lookahead";
+    lookahead.engine = SolveEngine::Search;
+    lookahead.searchOptions.lookahead = true;
+    configurations.push_back(lookahead);
+
+    BenchmarkConfiguration backjump;
+    backjump.name = "backjump";
+    backjump.engine = SolveEngine::Search;
+    backjump.searchOptions.conflictDirectedBackjumping = true;
+    configurations.push_back(backjump);
+
+    BenchmarkConfiguration sat;
+    sat.name = "sat";
+    sat.engine = SolveEngine::Sat;
+    configurations.push_back(sat);
+
+    BenchmarkConfiguration portfolio;
+    portfolio.name = "portfolio";
+    portfolio.engine = SolveEngine::Portfolio;
+    configurations.push_back(portfolio);
+
+    BenchmarkConfiguration lanes;
+    lanes.name = "lanes";
+    lanes.useLanes = true;
+    configurations.push_back(lanes);
+
+    return configurations;
+}
+
+#pragma mark - Measuring
+
+// the kernel's peak RSS in kilobytes; VmHWM can be reset, ru_maxrss can't
+static long peakRssKilobytes() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return atol(line.c_str() + 6);
+        }
+    }
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static void resetPeakRss() {
+    // "5" resets VmHWM to the current RSS (Linux 4.0 and later); elsewhere the write just fails
+    FILE* file = fopen("/proc/self/clear_refs", "w");
+    if (file != nullptr) {
+        fputs("5", file);
+        fclose(file);
+    }
+}
+
+// solved grids must keep the puzzle's givens as well as follow the rules
+static bool isCorrectSolution(const Grid& puzzle, const Grid& grid) {
+    if (!grid.isSolved()) {
+        return false;
+    }
+    const int cellCount = puzzle.getSize() * puzzle.getSize();
+    for (int i = 0; i < cellCount; i++) {
+        const int given = puzzle.cellAtIndex(i).getValue();
+        if (given != -1 && given != grid.cellAtIndex(i).getValue()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void countStatus(const Grid& puzzle, const Grid& grid, const SolveStatus status, BenchmarkResult& result) {
+    switch (status) {
+        case SolveStatus::Solved:
+            result.solvedCount += 1;
+            result.wrongCount += !isCorrectSolution(puzzle, grid);
+            break;
+        case SolveStatus::NoSolution:
+            result.noSolutionCount += 1;
+            break;
+        case SolveStatus::BudgetExhausted:
+        case SolveStatus::Cancelled:
+        case SolveStatus::MemoryExhausted:
+            result.timeoutCount += 1;
+            break;
+    }
+}
+
+void BenchmarkSuite::_runScalar(const BenchmarkCorpus& corpus, const BenchmarkConfiguration& configuration, const bool measure, MeasuredRun& run, BenchmarkResult& result) const {
+    for (auto puzzle = corpus.grids.begin(); puzzle != corpus.grids.end(); ++puzzle) {
+        Grid grid = *puzzle;
+        const AllocationCount allocationsBefore = currentAllocationCount();
+        auto start = std::chrono::steady_clock::now();
+        SolveLimits limits;
+        limits.setTimeout(_options.timeoutSeconds);
+        Solver solver(grid, limits);
+        solver.setEngine(configuration.engine);
+        solver.setSearchOptions(configuration.searchOptions);
+        solver.setVerbose(false);
+        SolveResult solveResult = solver.solve();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        const AllocationCount allocationsAfter = currentAllocationCount();
+        if (measure) {
+            run.allocationCount += allocationsAfter.count - allocationsBefore.count;
+            run.latencies.push_back(elapsed.count());
+            run.nodeCounts.push_back(solveResult.searchStatistics.nodeCount);
+            run.statuses.push_back(solveResult.status);
+            result.totalSeconds += elapsed.count();
+            result.peakSolveMegabytes = std::max(result.peakSolveMegabytes, solveResult.memoryStatistics.peakTotalBytes / (1024.0 * 1024.0));
+            if (!solveResult.portfolioWinner.empty()) {
+                result.portfolioWins[solveResult.portfolioWinner] += 1;
+            }
+            countStatus(*puzzle, grid, solveResult.status, result);
+        }
+    }
+}
+
+void BenchmarkSuite::_runLanes(const BenchmarkCorpus& corpus, const bool measure, MeasuredRun& run, BenchmarkResult& result) const {
+    GridVector grids = corpus.grids;
+    LaneStatistics statistics;
+    SolveStatus statuses[LaneSolver::kLaneCount];
+    for (int first = 0; first < (int)grids.size(); first += LaneSolver::kLaneCount) {
+        const int count = std::min(LaneSolver::kLaneCount, (int)grids.size() - first);
+        const AllocationCount allocationsBefore = currentAllocationCount();
+        auto start = std::chrono::steady_clock::now();
+        LaneSolver::solveBatch(&grids[first], count, statuses, statistics);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        const AllocationCount allocationsAfter = currentAllocationCount();
+        if (!measure) {
+            continue;
+        }
+        run.allocationCount += allocationsAfter.count - allocationsBefore.count;
+        result.totalSeconds += elapsed.count();
+        for (int i = 0; i < count; i++) {
+            run.latencies.push_back(elapsed.count());
+            run.statuses.push_back(statuses[i]);
+            countStatus(corpus.grids[first + i], grids[first + i], statuses[i], result);
+        }
+    }
+}
+
+bool BenchmarkSuite::run(const BenchmarkCorpus& corpus, const BenchmarkConfiguration& configuration, BenchmarkResult& result) const {
+    if (configuration.useLanes) {
+        for (auto grid = corpus.grids.begin(); grid != corpus.grids.end(); ++grid) {
+            if (!LaneSolver::supportsSize(grid->getSize())) {
+                return false;
+            }
+        }
+    }
+    result = BenchmarkResult();
+    result.corpus = corpus.name;
+    result.configuration = configuration.name;
+    result.puzzleCount = (int)corpus.grids.size();
+    result.repetitions = _options.repetitions;
+    if (corpus.grids.empty()) {
+        return true;
+    }
+
+    resetPeakRss();
+    std::vector<MeasuredRun> runs;
+    for (int run = 0; run < _options.warmupRuns + _options.repetitions; run++) {
+        const bool measure = run >= _options.warmupRuns;
+        MeasuredRun measuredRun;
+        if (configuration.useLanes) {
+            _runLanes(corpus, measure, measuredRun, result);
+        } else {
+            _runScalar(corpus, configuration, measure, measuredRun, result);
+        }
+        if (measure) {
+            runs.push_back(measuredRun);
+        }
+    }
+    result.peakRssKilobytes = peakRssKilobytes();
+
+    result.solvedCount /= _options.repetitions;
+    result.noSolutionCount /= _options.repetitions;
+    result.timeoutCount /= _options.repetitions;
+    result.wrongCount /= _options.repetitions;
+
+    // per puzzle: the median over the repetitions, and what the first measured run reported
+    std::vector<double> latencies;
+    long allocationCount = 0;
+    for (auto run = runs.begin(); run != runs.end(); ++run) {
+        allocationCount += run->allocationCount;
+    }
+    result.allocationsPerPuzzle = (double)allocationCount / ((long)runs.size() * result.puzzleCount);
+    std::vector<long> nodeCounts = runs.front().nodeCounts;
+    result.puzzleStatuses = runs.front().statuses;
+    for (int puzzle = 0; puzzle < result.puzzleCount; puzzle++) {
+        std::vector<double> samples;
+        for (auto run = runs.begin(); run != runs.end(); ++run) {
+            samples.push_back(run->latencies[puzzle]);
+        }
+        latencies.insert(latencies.end(), samples.begin(), samples.end());
+        std::sort(samples.begin(), samples.end());
+        const size_t middle = samples.size() / 2;
+        result.puzzleSeconds.push_back(samples.size() % 2 == 1 ? samples[middle] : (samples[middle - 1] + samples[middle]) / 2);
+    }
+    result.puzzlesPerSecond = result.totalSeconds > 0 ? latencies.size() / result.totalSeconds : 0;
+
+    double latencySum = 0;
+    for (auto latency = latencies.begin(); latency != latencies.end(); ++latency) {
+        latencySum += *latency;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&](const double fraction) {
+        // nearest rank
+        const size_t rank = (size_t)std::ceil(fraction * latencies.size());
+        return latencies[std::min(latencies.size() - 1, rank > 0 ? rank - 1 : 0)] * 1000;
+    };
+    result.meanMilliseconds = latencySum / latencies.size() * 1000;
+    result.medianMilliseconds = percentile(0.5);
+    result.p99Milliseconds = percentile(0.99);
+    result.maxMilliseconds = latencies.back() * 1000;
+
+    // SAT doesn't search nodes, the lanes don't report the nodes of the puzzles they hand to Solver, and in a
+    // portfolio they depend on which member happens to win
+    if (!nodeCounts.empty() && configuration.engine != SolveEngine::Sat && configuration.engine != SolveEngine::Portfolio) {
+        long nodeSum = 0;
+        result.maxNodes = 0;
+        for (auto nodes = nodeCounts.begin(); nodes != nodeCounts.end(); ++nodes) {
+            nodeSum += *nodes;
+            result.maxNodes = std::max(result.maxNodes, *nodes);
+        }
+        result.meanNodes = (double)nodeSum / nodeCounts.size();
+        result.puzzleNodes = nodeCounts;
+    }
+    return true;
+}
+
+#pragma mark - Technique counters
+
+static long totalCandidateCount(const Grid& grid) {
+    long count = 0;
+    for (int cellIndex = 0; cellIndex < grid.getSize() * grid.getSize(); cellIndex++) {
+        const Cell& cell = grid.cellAtIndex(cellIndex);
+        if (cell.getValue() == -1) {
+            count += cell.getCandidates().size();
+        }
+    }
+    return count;
+}
+
+bool BenchmarkSuite::countTechniques(const BenchmarkCorpus& corpus, TechniqueCounters& counters) const {
+    for (auto grid = corpus.grids.begin(); grid != corpus.grids.end(); ++grid) {
+        if (grid->getSize() > kMaxCountedSize) {
+            return false;
+        }
+    }
+    counters = TechniqueCounters();
+    counters.corpus = corpus.name;
+    for (auto puzzle = corpus.grids.begin(); puzzle != corpus.grids.end(); ++puzzle) {
+        Grid grid = *puzzle;
+        ConstraintSolver solver(grid, nullptr, kAllTechniques);
+        solver.setNaiveCandidates();
+        long candidateCount = totalCandidateCount(grid);
+        TechniqueStep step;
+        while (solver.applyCheapestTechnique(step)) {
+            const long remaining = totalCandidateCount(grid);
+            counters.steps[(int)step.technique] += 1;
+            counters.eliminations[(int)step.technique] += candidateCount - remaining;
+            candidateCount = remaining;
+        }
+        counters.stalledCount += !grid.isSolved();
+    }
+    return true;
+}
+
+#pragma mark - Reports
+
+void BenchmarkSuite::printTableHeader(std::ostream& stream) {
+    stream << std::left << std::setw(11) << "corpus" << std::setw(10) << "config" << std::right;
+    stream << std::setw(6) << "n" << std::setw(7) << "solved" << std::setw(6) << "none" << std::setw(5) << "t/o" << std::setw(6) << "wrong";
+    stream << std::setw(12) << "puzzles/s" << std::setw(10) << "mean ms" << std::setw(10) << "median" << std::setw(10) << "p99" << std::setw(10) << "max";
+    stream << std::setw(12) << "nodes" << std::setw(10) << "allocs" << std::setw(10) << "solve MB" << std::setw(10) << "rss MB" << std::endl;
+}
+
+void BenchmarkSuite::printTableRow(std::ostream& stream, const BenchmarkResult& result) {
+    const std::ios::fmtflags flags = stream.flags();
+    stream << std::left << std::setw(11) << result.corpus << std::setw(10) << result.configuration << std::right;
+    stream << std::setw(6) << result.puzzleCount << std::setw(7) << result.solvedCount << std::setw(6) << result.noSolutionCount;
+    stream << std::setw(5) << result.timeoutCount << std::setw(6) << result.wrongCount;
+    stream << std::fixed << std::setprecision(1) << std::setw(12) << result.puzzlesPerSecond;
+    stream << std::setprecision(3) << std::setw(10) << result.meanMilliseconds << std::setw(10) << result.medianMilliseconds;
+    stream << std::setw(10) << result.p99Milliseconds << std::setw(10) << result.maxMilliseconds;
+    stream << std::setprecision(1) << std::setw(12);
+    if (result.meanNodes < 0) {
+        stream << "-";
+    } else {
+        stream << result.meanNodes;
+    }
+    stream << std::setw(10) << result.allocationsPerPuzzle << std::setw(10) << result.peakSolveMegabytes << std::setw(10) << result.peakRssKilobytes / 1024.0 << std::endl;
+    if (!result.portfolioWins.empty()) {
+        stream << "  wins:";
+        for (auto wins = result.portfolioWins.begin(); wins != result.portfolioWins.end(); ++wins) {
+            stream << " " << wins->first << " " << wins->second;
+        }
+        stream << std::endl;
+    }
+    stream.flags(flags);
+}
+
+static std::string jsonString(const std::string& text) {
+    std::string quoted = "\"";
+    for (auto character = text.begin(); character != text.end(); ++character) {
+        if (*character == '"' || *character == '\\') {
+            quoted += '\\';
+        }
+        quoted += *character;
+    }
+    return quoted + "\"";
+}
+
+void BenchmarkSuite::writeJson(std::ostream& stream, const BenchmarkOptions& options, const BenchmarkResultVector& results) {
+    stream << std::setprecision(9);
+    stream << "{\n";
+    stream << "  \"warmup_runs\": " << options.warmupRuns << ",\n";
+    stream << "  \"repetitions\": " << options.repetitions << ",\n";
+    stream << "  \"timeout_seconds\": " << options.timeoutSeconds << ",\n";
+    stream << "  \"generated_count\": " << options.generatedCount << ",\n";
+    stream << "  \"seed\": " << options.seed << ",\n";
+    stream << "  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult& result = results[i];
+        stream << (i == 0 ? "\n" : ",\n");
+        stream << "    {\"corpus\": " << jsonString(result.corpus) << ", \"configuration\": " << jsonString(result.configuration);
+        stream << ", \"puzzles\": " << result.puzzleCount << ", \"repetitions\": " << result.repetitions;
+        stream << ", \"solved\": " << result.solvedCount << ", \"no_solution\": " << result.noSolutionCount;
+        stream << ", \"timeouts\": " << result.timeoutCount << ", \"wrong\": " << result.wrongCount;
+        stream << ", \"total_seconds\": " << result.totalSeconds << ", \"puzzles_per_second\": " << result.puzzlesPerSecond;
+        stream << ", \"mean_ms\": " << result.meanMilliseconds << ", \"median_ms\": " << result.medianMilliseconds;
+        stream << ", \"p99_ms\": " << result.p99Milliseconds << ", \"max_ms\": " << result.maxMilliseconds;
+        stream << ", \"mean_nodes\": ";
+        if (result.meanNodes < 0) {
+            stream << "null, \"max_nodes\": null";
+        } else {
+            stream << result.meanNodes << ", \"max_nodes\": " << result.maxNodes;
+        }
+        stream << ", \"allocations_per_puzzle\": " << result.allocationsPerPuzzle << ", \"peak_solve_mb\": " << result.peakSolveMegabytes;
+        stream << ", \"peak_rss_kb\": " << result.peakRssKilobytes << "}";
+    }
+    stream << "\n  ]\n}\n";
+}
@@ -0,0 +1,147 @@
+//
+//  BenchmarkSuite.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef BenchmarkSuite_hpp
+#define BenchmarkSuite_hpp
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "DifficultyGrader.hpp"
+#include "Grid.hpp"
+#include "PuzzleGenerator.hpp"
+#include "Solver.hpp"
+#include "ThreadPool.hpp"
+
+struct BenchmarkCorpus {
+    std::string name;
+    std::string description;
+    GridVector grids;
+};
+
+typedef std::vector<BenchmarkCorpus> BenchmarkCorpusVector;
+
+struct BenchmarkConfiguration {
+    std::string name;
+    SolveEngine engine = SolveEngine::Automatic;
+    SearchOptions searchOptions;
+    // LaneSolver batches instead of one Solver per puzzle; 9x9 corpora only
+    bool useLanes = false;
+};
+
+typedef std::vector<BenchmarkConfiguration> BenchmarkConfigurationVector;
+
+struct BenchmarkOptions {
+    int warmupRuns = 1;
+    int repetitions = 3;
+    // per puzzle; a solve that runs out counts as a timeout, not as a failure
+    double timeoutSeconds = 5;
+    // puzzles per generated corpus (the 25x25 corpus uses a quarter of it)
+    int generatedCount = 40;
+    unsigned long long seed = 1;
+    std::string inputDirectory;
+};
+
+struct BenchmarkResult {
+    std::string corpus;
+    std::string configuration;
+    int puzzleCount = 0;
+    int repetitions = 0;
+
+    // per repetition, so they don't grow with the repetition count
+    long solvedCount = 0;
+    long noSolutionCount = 0;
+    long timeoutCount = 0;
+    long wrongCount = 0;        // reported as solved but breaking a rule or a given
+
+    double totalSeconds = 0;    // measured runs only
+    double puzzlesPerSecond = 0;
+    double meanMilliseconds = 0;
+    double medianMilliseconds = 0;
+    double p99Milliseconds = 0;
+    double maxMilliseconds = 0;
+
+    // DFS nodes per puzzle; negative when the engine doesn't count them
+    double meanNodes = -1;
+    long maxNodes = -1;
+    long peakRssKilobytes = 0;
+    // heap allocations per solve over the measured runs (AllocationCounter), the puzzle's copy not included
+    double allocationsPerPuzzle = 0;
+    // the largest memory peak a solve accounted for (MemoryStatistics::peakTotalBytes); 0 for lanes, which don't
+    double peakSolveMegabytes = 0;
+
+    // per puzzle in corpus order: the median latency over the repetitions, and the status and DFS nodes of the
+    // first measured run (no nodes when the engine doesn't count them)
+    std::vector<double> puzzleSeconds;
+    std::vector<SolveStatus> puzzleStatuses;
+    std::vector<long> puzzleNodes;
+
+    // portfolio only: answers per member over the measured runs
+    std::map<std::string, long> portfolioWins;
+};
+
+typedef std::vector<BenchmarkResult> BenchmarkResultVector;
+
+// what step-by-step logic (every technique, cheapest first) does on a corpus; deterministic, unlike the timings
+struct TechniqueCounters {
+    std::string corpus;
+    long steps[kTechniqueCount] = {};
+    // candidates removed by the steps of each technique, including those of the values it placed
+    long eliminations[kTechniqueCount] = {};
+    long stalledCount = 0;      // puzzles the logic couldn't finish
+};
+
+typedef std::vector<TechniqueCounters> TechniqueCountersVector;
+
+/**
+ End-to-end benchmark: every selected configuration solves every selected corpus, first warmupRuns times without
+ measuring and then repetitions times with a clock around each solve. Latencies are taken per puzzle (for lanes,
+ per batch, since every puzzle of a batch is done when the batch is), throughput over the measured runs.
+
+ The generated corpora come from PuzzleGenerator with fixed seeds, so the same options give the same puzzles on
+ every machine and results stay comparable between builds. Peak RSS is the kernel's high-water mark, reset before
+ each corpus/configuration pair where Linux allows it (otherwise it's the peak of the whole process so far).
+ */
+class BenchmarkSuite {
+    struct MeasuredRun {
+        std::vector<double> latencies;
+        std::vector<long> nodeCounts;
+        std::vector<SolveStatus> statuses;
+        long allocationCount = 0;
+    };
+
+    BenchmarkOptions _options;
+    ThreadPool& _pool;
+
+    BenchmarkCorpus _loadInputCorpus() const;
+    BenchmarkCorpus _generateCorpus(const std::string name, const std::string description, const GeneratorOptions options, const int count) const;
+    BenchmarkCorpus _generateHardCorpus(const int count) const;
+
+    void _runScalar(const BenchmarkCorpus& corpus, const BenchmarkConfiguration& configuration, const bool measure, MeasuredRun& run, BenchmarkResult& result) const;
+    void _runLanes(const BenchmarkCorpus& corpus, const bool measure, MeasuredRun& run, BenchmarkResult& result) const;
+
+public:
+    BenchmarkSuite(const BenchmarkOptions options, ThreadPool& pool);
+
+    static std::vector<std::string> corpusNames();
+    static BenchmarkConfigurationVector defaultConfigurations();
+
+    // the named corpus, loaded or generated; false for an unknown name
+    bool buildCorpus(const std::string name, BenchmarkCorpus& corpus) const;
+    // false when the configuration can't run on the corpus (lanes on other sizes than 9x9)
+    bool run(const BenchmarkCorpus& corpus, const BenchmarkConfiguration& configuration, BenchmarkResult& result) const;
+    // false for corpora with grids larger than 9x9, where the slower techniques would take minutes
+    bool countTechniques(const BenchmarkCorpus& corpus, TechniqueCounters& counters) const;
+
+    static void printTableHeader(std::ostream& stream);
+    static void printTableRow(std::ostream& stream, const BenchmarkResult& result);
+    static void writeJson(std::ostream& stream, const BenchmarkOptions& options, const BenchmarkResultVector& results);
+};
+
+#endif /* BenchmarkSuite_hpp */
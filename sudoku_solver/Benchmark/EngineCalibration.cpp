@@ -0,0 +1,225 @@
+//
+//  EngineCalibration.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "EngineCalibration.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+#include "Solver.hpp"
+
+// a timeout only says the strategy is slower than the limit, so it is charged more than the limit
+const double EngineCalibration::kTimeoutPenalty = 2;
+
+// keeps ln(seconds) finite for solves below the clock's resolution
+static const double kMinimumSeconds = 1e-6;
+
+#pragma mark - Measuring
+
+CalibrationSampleVector EngineCalibration::measure(const BenchmarkCorpusVector& corpora, const CalibrationOptions& options) {
+    const SolveStrategyVector& strategies = EngineCostModel::strategies();
+    CalibrationSampleVector samples;
+    for (auto corpus = corpora.begin(); corpus != corpora.end(); ++corpus) {
+        auto corpusStart = std::chrono::steady_clock::now();
+        for (auto puzzle = corpus->grids.begin(); puzzle != corpus->grids.end(); ++puzzle) {
+            CalibrationSample sample;
+            sample.corpus = corpus->name;
+            sample.features = PuzzleFeatures::extract(*puzzle);
+            for (auto strategy = strategies.begin(); strategy != strategies.end(); ++strategy) {
+                double best = -1;
+                bool timedOut = false;
+                for (int repetition = 0; repetition < std::max(1, options.repetitions) && !timedOut; repetition++) {
+                    Grid grid = *puzzle;
+                    SolveLimits limits;
+                    limits.setTimeout(options.timeoutSeconds);
+                    Solver solver(grid, limits);
+                    solver.setEngine(strategy->useSat ? SolveEngine::Sat : SolveEngine::Search);
+                    solver.setSearchOptions(strategy->searchOptions(SearchOptions()));
+                    solver.setVerbose(false);
+                    auto start = std::chrono::steady_clock::now();
+                    const SolveResult result = solver.solve();
+                    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                    if (result.status == SolveStatus::BudgetExhausted) {
+                        timedOut = true;
+                        best = options.timeoutSeconds * kTimeoutPenalty;
+                    } else if (best < 0 || elapsed.count() < best) {
+                        best = elapsed.count();
+                    }
+                }
+                sample.seconds.push_back(best);
+                sample.timedOut.push_back(timedOut);
+            }
+            samples.push_back(sample);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - corpusStart;
+        std::cerr << "calibrated " << corpus->name << ": " << corpus->grids.size() << " puzzles in " << elapsed.count() << " s" << std::endl;
+    }
+    return samples;
+}
+
+#pragma mark - Fitting
+
+// solves the system in place with partial pivoting; false when it is singular
+static bool solveLinearSystem(std::vector<std::vector<double>>& matrix, std::vector<double>& vector, std::vector<double>& solution) {
+    const int n = (int)vector.size();
+    for (int column = 0; column < n; column++) {
+        int pivot = column;
+        for (int row = column + 1; row < n; row++) {
+            if (std::fabs(matrix[row][column]) > std::fabs(matrix[pivot][column])) {
+                pivot = row;
+            }
+        }
+        if (std::fabs(matrix[pivot][column]) < 1e-12) {
+            return false;
+        }
+        std::swap(matrix[column], matrix[pivot]);
+        std::swap(vector[column], vector[pivot]);
+        for (int row = column + 1; row < n; row++) {
+            const double factor = matrix[row][column] / matrix[column][column];
+            for (int k = column; k < n; k++) {
+                matrix[row][k] -= factor * matrix[column][k];
+            }
+            vector[row] -= factor * vector[column];
+        }
+    }
+    solution.assign(n, 0);
+    for (int row = n - 1; row >= 0; row--) {
+        double sum = vector[row];
+        for (int k = row + 1; k < n; k++) {
+            sum -= matrix[row][k] * solution[k];
+        }
+        solution[row] = sum / matrix[row][row];
+    }
+    return true;
+}
+
+bool EngineCalibration::fit(const CalibrationSampleVector& samples, const CalibrationOptions& options, EngineCostModel& model) {
+    const SolveStrategyVector& strategies = EngineCostModel::strategies();
+    const int inputCount = PuzzleFeatures::kModelInputCount;
+    if ((int)samples.size() < inputCount) {
+        return false;
+    }
+    model = EngineCostModel();
+    for (int strategy = 0; strategy < (int)strategies.size(); strategy++) {
+        // normal equations of the ridge regression; the constant is not penalized
+        std::vector<std::vector<double>> matrix(inputCount, std::vector<double>(inputCount, 0));
+        std::vector<double> vector(inputCount, 0);
+        for (int i = 1; i < inputCount; i++) {
+            matrix[i][i] = options.ridge * samples.size();
+        }
+        for (auto sample = samples.begin(); sample != samples.end(); ++sample) {
+            const PuzzleFeatures::ModelInputs inputs = sample->features.modelInputs();
+            const double target = std::log(std::max(kMinimumSeconds, sample->seconds[strategy]));
+            for (int i = 0; i < inputCount; i++) {
+                for (int j = 0; j < inputCount; j++) {
+                    matrix[i][j] += inputs[i] * inputs[j];
+                }
+                vector[i] += inputs[i] * target;
+            }
+        }
+        DoubleVector weights;
+        if (!solveLinearSystem(matrix, vector, weights)) {
+            return false;
+        }
+        double squaredResiduals = 0;
+        for (auto sample = samples.begin(); sample != samples.end(); ++sample) {
+            const PuzzleFeatures::ModelInputs inputs = sample->features.modelInputs();
+            double residual = std::log(std::max(kMinimumSeconds, sample->seconds[strategy]));
+            for (int i = 0; i < inputCount; i++) {
+                residual -= weights[i] * inputs[i];
+            }
+            squaredResiduals += residual * residual;
+        }
+        model.setWeights(strategies[strategy].name, weights, squaredResiduals / std::max(1, (int)samples.size() - inputCount));
+    }
+    return true;
+}
+
+#pragma mark - Evaluation
+
+void EngineCalibration::printEvaluation(std::ostream& stream, const CalibrationSampleVector& samples, const CalibrationOptions& options) {
+    const SolveStrategyVector& strategies = EngineCostModel::strategies();
+    const int strategyCount = (int)strategies.size();
+    CalibrationSampleVector training;
+    CalibrationSampleVector held;
+    for (int i = 0; i < (int)samples.size(); i++) {
+        (i % 2 == 0 ? training : held).push_back(samples[i]);
+    }
+    EngineCostModel model;
+    if (!fit(training, options, model)) {
+        stream << "too few samples to evaluate the model" << std::endl;
+        return;
+    }
+    const EngineCostModel sizeRule;
+
+    // columns: every strategy, then the size rule, the model's picks and the best strategy in hindsight
+    struct Totals {
+        int count = 0;
+        std::vector<double> seconds;
+        std::vector<int> picks;
+    };
+    std::vector<std::string> corpusOrder;
+    std::map<std::string, Totals> totals;
+    const std::string allName = "all";
+    for (auto sample = held.begin(); sample != held.end(); ++sample) {
+        if (totals.find(sample->corpus) == totals.end()) {
+            corpusOrder.push_back(sample->corpus);
+        }
+        const int modelPick = EngineCostModel::strategyIndex(model.choose(sample->features).name);
+        const int rulePick = EngineCostModel::strategyIndex(sizeRule.choose(sample->features).name);
+        const double oracle = *std::min_element(sample->seconds.begin(), sample->seconds.end());
+        const std::string names[] = {sample->corpus, allName};
+        for (auto name = std::begin(names); name != std::end(names); ++name) {
+            Totals& corpusTotals = totals[*name];
+            if (corpusTotals.count == 0) {
+                corpusTotals.seconds.assign(strategyCount + 3, 0);
+                corpusTotals.picks.assign(strategyCount, 0);
+            }
+            corpusTotals.count += 1;
+            for (int strategy = 0; strategy < strategyCount; strategy++) {
+                corpusTotals.seconds[strategy] += sample->seconds[strategy];
+            }
+            corpusTotals.seconds[strategyCount] += sample->seconds[rulePick];
+            corpusTotals.seconds[strategyCount + 1] += sample->seconds[modelPick];
+            corpusTotals.seconds[strategyCount + 2] += oracle;
+            corpusTotals.picks[modelPick] += 1;
+        }
+    }
+    corpusOrder.push_back(allName);
+
+    stream << "Mean ms per puzzle on the held-out half (model fitted on the other half; timeouts count "
+           << kTimeoutPenalty * options.timeoutSeconds * 1000 << " ms)" << std::endl;
+    stream << std::left << std::setw(12) << "corpus" << std::right << std::setw(6) << "n";
+    for (auto strategy = strategies.begin(); strategy != strategies.end(); ++strategy) {
+        stream << std::setw(11) << strategy->name;
+    }
+    stream << std::setw(11) << "size-rule" << std::setw(11) << "model" << std::setw(11) << "best" << "  model picks" << std::endl;
+    const std::ios::fmtflags flags = stream.flags();
+    for (auto name = corpusOrder.begin(); name != corpusOrder.end(); ++name) {
+        const Totals& corpusTotals = totals[*name];
+        if (corpusTotals.count == 0) {
+            continue;
+        }
+        stream << std::left << std::setw(12) << *name << std::right << std::setw(6) << corpusTotals.count;
+        stream << std::fixed << std::setprecision(3);
+        for (auto seconds = corpusTotals.seconds.begin(); seconds != corpusTotals.seconds.end(); ++seconds) {
+            stream << std::setw(11) << *seconds * 1000 / corpusTotals.count;
+        }
+        stream << " ";
+        for (int strategy = 0; strategy < strategyCount; strategy++) {
+            if (corpusTotals.picks[strategy] > 0) {
+                stream << " " << strategies[strategy].name << "=" << corpusTotals.picks[strategy];
+            }
+        }
+        stream << std::endl;
+        stream.flags(flags);
+    }
+}
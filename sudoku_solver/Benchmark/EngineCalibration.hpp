@@ -0,0 +1,56 @@
+//
+//  EngineCalibration.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef EngineCalibration_hpp
+#define EngineCalibration_hpp
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "BenchmarkSuite.hpp"
+#include "EngineCostModel.hpp"
+#include "PuzzleFeatures.hpp"
+
+struct CalibrationOptions {
+    // best of this many runs per puzzle and strategy, which drops most of a shared machine's noise
+    int repetitions = 2;
+    // per solve; a strategy that runs out is charged kTimeoutPenalty times this
+    double timeoutSeconds = 2;
+    // ridge term that keeps the weights finite when a feature barely varies (e.g. ln(cells) within one size)
+    double ridge = 1e-3;
+};
+
+struct CalibrationSample {
+    std::string corpus;
+    PuzzleFeatures features;
+    // indexed like EngineCostModel::strategies()
+    std::vector<double> seconds;
+    std::vector<bool> timedOut;
+};
+
+typedef std::vector<CalibrationSample> CalibrationSampleVector;
+
+/**
+ Fits EngineCostModel offline: every strategy solves every puzzle of the corpora, and a ridge regression of
+ ln(seconds) on the puzzle's model inputs gives each strategy's weights.
+
+ To show what the model is worth, evaluate fits on the even samples and picks for the odd ones, then compares the
+ mean latency of those picks per corpus with every fixed strategy, the old size rule (SAT from 25x25 on, the
+ standard technique set below) and the fastest strategy in hindsight.
+ */
+class EngineCalibration {
+public:
+    static const double kTimeoutPenalty;
+
+    static CalibrationSampleVector measure(const BenchmarkCorpusVector& corpora, const CalibrationOptions& options);
+    // false when some strategy has fewer samples than weights
+    static bool fit(const CalibrationSampleVector& samples, const CalibrationOptions& options, EngineCostModel& model);
+    static void printEvaluation(std::ostream& stream, const CalibrationSampleVector& samples, const CalibrationOptions& options);
+};
+
+#endif /* EngineCalibration_hpp */
@@ -0,0 +1,253 @@
+//
+//  KernelBenchmark.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "KernelBenchmark.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <random>
+
+#include "AllocationCounter.hpp"
+#include "BitmaskSolver.hpp"
+#include "CombinationListCreator.hpp"
+#include "GridEditor.hpp"
+#include "PuzzleGenerator.hpp"
+
+// copies (and solvers) prepared per timed batch
+static const int kBatchSize = 16;
+
+// keeps the combination lists from being optimized away
+static volatile size_t combinationSink;
+
+KernelBenchmark::KernelBenchmark(const KernelOptions options) : _options(options) {
+    _options.stateCount = std::max(1, _options.stateCount);
+}
+
+#pragma mark - States
+
+// fewer clues give a longer walk; the larger sizes keep enough clues to generate quickly
+int KernelBenchmark::_clueCountForSize(const int size) {
+    switch (size) {
+        case 9:
+            return 0;
+        case 16:
+            return 120;
+        case 25:
+            return 360;
+    }
+    return size * size / 2;
+}
+
+GridVector KernelBenchmark::captureStates(const int size) const {
+    GeneratorOptions options;
+    options.size = size;
+    options.targetClueCount = _clueCountForSize(size);
+    options.seed = _options.seed;
+    PuzzleGenerator generator(options);
+    BitmaskSolver bitmaskSolver(size);
+    std::mt19937_64 rng(_options.seed);
+    const GeneratedPuzzle puzzle = generator.generateOne(bitmaskSolver, rng);
+
+    // walks from the givens to the solution, calling visit with every state on the way
+    const auto walk = [&](const std::function<void(const int step, const Grid& state)>& visit) {
+        Grid grid = puzzle.puzzleGrid();
+        ConstraintSolver solver(grid, nullptr, techniqueBit(Technique::SubgroupExclusion));
+        GridEditor editor(grid);
+        solver.setNaiveCandidates();
+        for (int step = 0; !grid.isSolved(); step++) {
+            visit(step, grid);
+            TechniqueStep applied;
+            if (!solver.applyCheapestTechnique(applied)) {
+                const int cellIndex = grid.getCellIndexWithFewestCandidates();
+                if (cellIndex < 0) {
+                    break;
+                }
+                editor.setCellValueAndUpdateCandidates(puzzle.solution[cellIndex], cellIndex);
+            }
+        }
+    };
+
+    // two passes so that only the sampled states are ever copied
+    int stepCount = 0;
+    walk([&](const int step, const Grid&) {
+        stepCount = step + 1;
+    });
+    const int stateCount = std::min(_options.stateCount, stepCount);
+    GridVector states;
+    walk([&](const int step, const Grid& state) {
+        if ((int)states.size() < stateCount && step == (int)((long)states.size() * stepCount / stateCount)) {
+            states.push_back(state);
+        }
+    });
+    return states;
+}
+
+KernelBenchmark::KernelTarget KernelBenchmark::_targetForState(const Grid& state) {
+    KernelTarget target;
+    target.cellIndex = 0;
+    int mostCandidates = -1;
+    for (int cellIndex = 0; cellIndex < state.getSize() * state.getSize(); cellIndex++) {
+        const Cell& cell = state.cellAtIndex(cellIndex);
+        if (cell.getValue() == -1 && (int)cell.getCandidates().size() > mostCandidates) {
+            mostCandidates = (int)cell.getCandidates().size();
+            target.cellIndex = cellIndex;
+        }
+    }
+    const IntSet& candidates = state.cellAtIndex(target.cellIndex).getCandidates();
+    // the smallest candidate, so the target doesn't depend on the set's iteration order
+    target.candidate = candidates.empty() ? 1 : *std::min_element(candidates.begin(), candidates.end());
+    target.rowIndices = state.commonRowIndicesOfCellAtIndex(target.cellIndex);
+    target.candidatesToKeep = candidates;
+    target.candidatesToKeep.erase(target.candidate);
+    return target;
+}
+
+#pragma mark - Measuring
+
+KernelResult KernelBenchmark::_measure(const int size, const std::string name, const GridVector& states, const std::vector<KernelTarget>& targets, const Kernel& kernel) const {
+    KernelResult result;
+    result.size = size;
+    result.kernel = name;
+
+    double seconds = 0;
+    AllocationCount allocations;
+    int nextState = 0;
+    // at least one call per state, then batches until the time is up
+    while (seconds < _options.minimumSeconds || result.callCount < (long)states.size()) {
+        GridVector grids;
+        std::vector<int> stateIndices;
+        for (int i = 0; i < kBatchSize; i++) {
+            stateIndices.push_back(nextState);
+            grids.push_back(states[nextState]);
+            nextState = (nextState + 1) % (int)states.size();
+        }
+        std::vector<std::unique_ptr<ConstraintSolver>> solvers;
+        for (auto grid = grids.begin(); grid != grids.end(); ++grid) {
+            solvers.push_back(std::unique_ptr<ConstraintSolver>(new ConstraintSolver(*grid)));
+        }
+
+        const AllocationCount before = currentAllocationCount();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kBatchSize; i++) {
+            kernel(*solvers[i], grids[i], targets[stateIndices[i]]);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        const AllocationCount after = currentAllocationCount();
+
+        seconds += elapsed.count();
+        allocations.count += after.count - before.count;
+        allocations.bytes += after.bytes - before.bytes;
+        result.callCount += kBatchSize;
+    }
+    result.nanosecondsPerCall = seconds * 1e9 / result.callCount;
+    result.allocationsPerCall = (double)allocations.count / result.callCount;
+    result.bytesPerCall = (double)allocations.bytes / result.callCount;
+    return result;
+}
+
+KernelResult KernelBenchmark::_measureCombinations(const int n, const int k) const {
+    KernelResult result;
+    result.size = n;
+    result.kernel = "combinations(n," + std::to_string(k) + ")";
+
+    double seconds = 0;
+    AllocationCount allocations;
+    while (seconds < _options.minimumSeconds || result.callCount == 0) {
+        const AllocationCount before = currentAllocationCount();
+        auto start = std::chrono::steady_clock::now();
+        const IntVectorVector combinations = CombinationListCreator::makeCombinationList(n, k);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        const AllocationCount after = currentAllocationCount();
+
+        seconds += elapsed.count();
+        allocations.count += after.count - before.count;
+        allocations.bytes += after.bytes - before.bytes;
+        combinationSink = combinations.size();
+        result.callCount += 1;
+    }
+    result.nanosecondsPerCall = seconds * 1e9 / result.callCount;
+    result.allocationsPerCall = (double)allocations.count / result.callCount;
+    result.bytesPerCall = (double)allocations.bytes / result.callCount;
+    return result;
+}
+
+KernelResultVector KernelBenchmark::run(const int size) const {
+    KernelResultVector results;
+    const GridVector states = captureStates(size);
+    if (states.empty()) {
+        return results;
+    }
+    std::vector<KernelTarget> targets;
+    for (auto state = states.begin(); state != states.end(); ++state) {
+        targets.push_back(_targetForState(*state));
+    }
+
+    results.push_back(_measure(size, "setCandidatesNaive", states, targets, [](ConstraintSolver& solver, Grid&, const KernelTarget&) {
+        solver._setCandidatesNaive();
+    }));
+    results.push_back(_measure(size, "subgroupExclusion", states, targets, [](ConstraintSolver& solver, Grid&, const KernelTarget&) {
+        solver._filterCandidatesUsingSubgroupExclusion();
+    }));
+    results.push_back(_measure(size, "chains", states, targets, [](ConstraintSolver& solver, Grid&, const KernelTarget&) {
+        solver._filterCandidatesUsingChains();
+    }));
+    results.push_back(_measure(size, "boxes", states, targets, [](ConstraintSolver& solver, Grid&, const KernelTarget&) {
+        solver._filterCandidatesUsingBoxes();
+    }));
+    results.push_back(_measure(size, "alternatePairs", states, targets, [](ConstraintSolver& solver, Grid&, const KernelTarget&) {
+        solver._filterUsingAlternatePairs();
+    }));
+    results.push_back(_measure(size, "cellsWithOneCandidate", states, targets, [](ConstraintSolver& solver, Grid&, const KernelTarget&) {
+        solver._updateCellsWithOneCandidate();
+    }));
+    results.push_back(_measure(size, "editor.setValue", states, targets, [](ConstraintSolver&, Grid& grid, const KernelTarget& target) {
+        GridEditor(grid).setCellValueAndUpdateCandidates(target.candidate, target.cellIndex);
+    }));
+    results.push_back(_measure(size, "editor.removeFromRow", states, targets, [](ConstraintSolver&, Grid& grid, const KernelTarget& target) {
+        GridEditor(grid).removeCandidateFromRowOfCellIndexExcluding(target.candidate, IntSet{target.cellIndex}, target.cellIndex);
+    }));
+    results.push_back(_measure(size, "editor.keepOnly", states, targets, [](ConstraintSolver&, Grid& grid, const KernelTarget& target) {
+        GridEditor(grid).removeCandidatesFromIndicesThatAreNotInCandidateSet(target.rowIndices, target.candidatesToKeep);
+    }));
+    results.push_back(_measureCombinations(size, 2));
+    results.push_back(_measureCombinations(size, 3));
+    return results;
+}
+
+#pragma mark - Reports
+
+void KernelBenchmark::printTableHeader(std::ostream& stream) {
+    stream << std::left << std::setw(6) << "size" << std::setw(24) << "kernel" << std::right;
+    stream << std::setw(10) << "calls" << std::setw(14) << "ns/call" << std::setw(14) << "allocs/call" << std::setw(14) << "bytes/call" << std::endl;
+}
+
+void KernelBenchmark::printTableRow(std::ostream& stream, const KernelResult& result) {
+    const std::ios::fmtflags flags = stream.flags();
+    stream << std::left << std::setw(6) << result.size << std::setw(24) << result.kernel << std::right;
+    stream << std::setw(10) << result.callCount << std::fixed << std::setprecision(1) << std::setw(14) << result.nanosecondsPerCall;
+    stream << std::setprecision(2) << std::setw(14) << result.allocationsPerCall << std::setprecision(1) << std::setw(14) << result.bytesPerCall << std::endl;
+    stream.flags(flags);
+}
+
+void KernelBenchmark::writeJson(std::ostream& stream, const KernelOptions& options, const KernelResultVector& results) {
+    stream << std::setprecision(9);
+    stream << "{\n";
+    stream << "  \"states\": " << options.stateCount << ",\n";
+    stream << "  \"minimum_seconds\": " << options.minimumSeconds << ",\n";
+    stream << "  \"seed\": " << options.seed << ",\n";
+    stream << "  \"kernels\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const KernelResult& result = results[i];
+        stream << (i == 0 ? "\n" : ",\n");
+        stream << "    {\"size\": " << result.size << ", \"kernel\": \"" << result.kernel << "\", \"calls\": " << result.callCount;
+        stream << ", \"ns_per_call\": " << result.nanosecondsPerCall << ", \"allocations_per_call\": " << result.allocationsPerCall;
+        stream << ", \"bytes_per_call\": " << result.bytesPerCall << "}";
+    }
+    stream << "\n  ]\n}\n";
+}
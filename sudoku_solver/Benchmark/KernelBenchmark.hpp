@@ -0,0 +1,81 @@
+//
+//  KernelBenchmark.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef KernelBenchmark_hpp
+#define KernelBenchmark_hpp
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "ConstraintSolver.hpp"
+#include "Grid.hpp"
+
+typedef std::vector<Grid> GridVector;
+
+struct KernelOptions {
+    // mid-solve states captured per grid size
+    int stateCount = 32;
+    // each kernel runs in batches until it has been timed for at least this long
+    double minimumSeconds = 0.2;
+    unsigned long long seed = 1;
+};
+
+struct KernelResult {
+    int size = 0;
+    std::string kernel;
+    long callCount = 0;
+    double nanosecondsPerCall = 0;
+    double allocationsPerCall = 0;
+    double bytesPerCall = 0;
+};
+
+typedef std::vector<KernelResult> KernelResultVector;
+
+/**
+ Microbenchmarks for the propagation kernels, so a change to one of them shows up on its own instead of as noise
+ in a whole solve.
+
+ The states come from a generated puzzle of each size, walked to its solution with singles and subgroup exclusion
+ and, whenever those stall, by placing the solution value of the cell with the fewest candidates. States are
+ sampled evenly along that walk, so they range from barely started to almost solved.
+
+ Every call gets a fresh copy of a state (made, together with its ConstraintSolver, outside the timed region), so
+ kernels that change the grid are measured on the same input every time. Allocations are counted by the
+ replacement operator new in AllocationCounter.cpp.
+ */
+class KernelBenchmark {
+    struct KernelTarget {
+        // an unanswered cell with the most candidates, one of its candidates and its row
+        int cellIndex;
+        int candidate;
+        IntSet rowIndices;
+        // the cell's candidates without that one, to strip everything else from the row
+        IntSet candidatesToKeep;
+    };
+    typedef std::function<void(ConstraintSolver&, Grid&, const KernelTarget&)> Kernel;
+
+    KernelOptions _options;
+
+    static int _clueCountForSize(const int size);
+    static KernelTarget _targetForState(const Grid& state);
+    KernelResult _measure(const int size, const std::string name, const GridVector& states, const std::vector<KernelTarget>& targets, const Kernel& kernel) const;
+    KernelResult _measureCombinations(const int n, const int k) const;
+
+public:
+    KernelBenchmark(const KernelOptions options);
+
+    GridVector captureStates(const int size) const;
+    KernelResultVector run(const int size) const;
+
+    static void printTableHeader(std::ostream& stream);
+    static void printTableRow(std::ostream& stream, const KernelResult& result);
+    static void writeJson(std::ostream& stream, const KernelOptions& options, const KernelResultVector& results);
+};
+
+#endif /* KernelBenchmark_hpp */
@@ -0,0 +1,374 @@
+//
+//  RegressionGate.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "RegressionGate.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+static const std::string kBaselineHeader = "sudoku_bench_baseline 1";
+
+#pragma mark - Baseline file
+
+bool RegressionGate::writeBaseline(const std::string& filename, const BenchmarkBaseline& baseline) {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+    file << std::setprecision(9);
+    file << kBaselineHeader << "\n";
+    file << "option warmup_runs " << baseline.options.warmupRuns << "\n";
+    file << "option repetitions " << baseline.options.repetitions << "\n";
+    file << "option timeout_seconds " << baseline.options.timeoutSeconds << "\n";
+    file << "option generated_count " << baseline.options.generatedCount << "\n";
+    file << "option seed " << baseline.options.seed << "\n";
+    for (auto result = baseline.results.begin(); result != baseline.results.end(); ++result) {
+        file << "result " << result->corpus << " " << result->configuration << " " << result->puzzleCount << " " << result->puzzlesPerSecond << "\n";
+        for (int i = 0; i < (int)result->puzzleSeconds.size(); i++) {
+            file << "puzzle " << result->corpus << " " << result->configuration << " " << i << " " << result->puzzleSeconds[i];
+            file << " " << (int)result->puzzleStatuses[i] << " " << (result->puzzleNodes.empty() ? -1 : result->puzzleNodes[i]) << "\n";
+        }
+    }
+    for (auto counters = baseline.counters.begin(); counters != baseline.counters.end(); ++counters) {
+        for (int technique = 0; technique < kTechniqueCount; technique++) {
+            file << "counter " << counters->corpus << " " << DifficultyGrader::techniqueName((Technique)technique);
+            file << " " << counters->steps[technique] << " " << counters->eliminations[technique] << "\n";
+        }
+        file << "stalled " << counters->corpus << " " << counters->stalledCount << "\n";
+    }
+    return file.good();
+}
+
+static BenchmarkResult* findResult(BenchmarkResultVector& results, const std::string& corpus, const std::string& configuration) {
+    for (auto result = results.begin(); result != results.end(); ++result) {
+        if (result->corpus == corpus && result->configuration == configuration) {
+            return &*result;
+        }
+    }
+    return nullptr;
+}
+
+static TechniqueCounters& countersForCorpus(TechniqueCountersVector& counters, const std::string& corpus) {
+    for (auto entry = counters.begin(); entry != counters.end(); ++entry) {
+        if (entry->corpus == corpus) {
+            return *entry;
+        }
+    }
+    counters.push_back(TechniqueCounters());
+    counters.back().corpus = corpus;
+    return counters.back();
+}
+
+bool RegressionGate::readBaseline(const std::string& filename, BenchmarkBaseline& baseline, std::string& error) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        error = "unable to open " + filename;
+        return false;
+    }
+    std::string line;
+    if (!getline(file, line) || line != kBaselineHeader) {
+        error = filename + " is not a baseline file";
+        return false;
+    }
+    baseline = BenchmarkBaseline();
+    int lineNumber = 1;
+    while (getline(file, line)) {
+        lineNumber += 1;
+        if (line.empty()) {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string type;
+        fields >> type;
+        bool valid = true;
+        if (type == "option") {
+            std::string name;
+            fields >> name;
+            if (name == "warmup_runs") {
+                fields >> baseline.options.warmupRuns;
+            } else if (name == "repetitions") {
+                fields >> baseline.options.repetitions;
+            } else if (name == "timeout_seconds") {
+                fields >> baseline.options.timeoutSeconds;
+            } else if (name == "generated_count") {
+                fields >> baseline.options.generatedCount;
+            } else if (name == "seed") {
+                fields >> baseline.options.seed;
+            }
+        } else if (type == "result") {
+            BenchmarkResult result;
+            fields >> result.corpus >> result.configuration >> result.puzzleCount >> result.puzzlesPerSecond;
+            baseline.results.push_back(result);
+        } else if (type == "puzzle") {
+            std::string corpus;
+            std::string configuration;
+            int index;
+            double seconds;
+            int status;
+            long nodes;
+            fields >> corpus >> configuration >> index >> seconds >> status >> nodes;
+            BenchmarkResult* result = findResult(baseline.results, corpus, configuration);
+            valid = !fields.fail() && result != nullptr && index == (int)result->puzzleSeconds.size();
+            if (valid) {
+                result->puzzleSeconds.push_back(seconds);
+                result->puzzleStatuses.push_back((SolveStatus)status);
+                if (nodes >= 0) {
+                    result->puzzleNodes.push_back(nodes);
+                }
+            }
+        } else if (type == "counter") {
+            std::string corpus;
+            std::string name;
+            Technique technique;
+            long steps;
+            long eliminations;
+            fields >> corpus >> name >> steps >> eliminations;
+            valid = !fields.fail() && DifficultyGrader::techniqueFromName(name, technique);
+            if (valid) {
+                TechniqueCounters& counters = countersForCorpus(baseline.counters, corpus);
+                counters.steps[(int)technique] = steps;
+                counters.eliminations[(int)technique] = eliminations;
+            }
+        } else if (type == "stalled") {
+            std::string corpus;
+            long count;
+            fields >> corpus >> count;
+            if (!fields.fail()) {
+                countersForCorpus(baseline.counters, corpus).stalledCount = count;
+            }
+        }
+        if (!valid || fields.fail()) {
+            error = filename + ":" + std::to_string(lineNumber) + ": invalid record";
+            return false;
+        }
+    }
+    return true;
+}
+
+#pragma mark - Statistics
+
+double RegressionGate::wilcoxonSignedRankPValue(const std::vector<double>& differences) {
+    // magnitude and sign of every difference that isn't zero
+    std::vector<std::pair<double, bool>> nonZero;
+    for (auto difference = differences.begin(); difference != differences.end(); ++difference) {
+        if (std::fabs(*difference) > 1e-12) {
+            nonZero.push_back(std::make_pair(std::fabs(*difference), *difference > 0));
+        }
+    }
+    const double n = (double)nonZero.size();
+    if (nonZero.empty()) {
+        return 1;
+    }
+    std::sort(nonZero.begin(), nonZero.end());
+
+    double positiveRankSum = 0;
+    double tieCorrection = 0;
+    for (size_t first = 0; first < nonZero.size();) {
+        size_t last = first;
+        while (last + 1 < nonZero.size() && nonZero[last + 1].first == nonZero[first].first) {
+            last += 1;
+        }
+        // ranks are 1-based; tied magnitudes share the average of their ranks
+        const double rank = (first + last) / 2.0 + 1;
+        for (size_t i = first; i <= last; i++) {
+            positiveRankSum += nonZero[i].second ? rank : 0;
+        }
+        const double tieCount = (double)(last - first + 1);
+        tieCorrection += tieCount * tieCount * tieCount - tieCount;
+        first = last + 1;
+    }
+
+    // normal approximation with continuity correction; conservative for the small counts where it's rough
+    const double mean = n * (n + 1) / 4;
+    const double variance = n * (n + 1) * (2 * n + 1) / 24 - tieCorrection / 48;
+    if (variance <= 0) {
+        return 1;
+    }
+    const double z = (positiveRankSum - mean - 0.5) / std::sqrt(variance);
+    return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+// nearest rank, like the benchmark table
+static double percentile(std::vector<double> values, const double fraction) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    const size_t rank = (size_t)std::ceil(fraction * values.size());
+    return values[std::min(values.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+static bool isTimeout(const SolveStatus status) {
+    return status == SolveStatus::BudgetExhausted || status == SolveStatus::Cancelled || status == SolveStatus::MemoryExhausted;
+}
+
+#pragma mark - Comparison
+
+static bool hasCounterChanges(const GateRow& row) {
+    return row.missing || row.statusChangeCount > 0 || row.nodeChangeCount > 0;
+}
+
+static bool hasRegressed(const GateRow& row) {
+    return hasCounterChanges(row) || row.throughputRegressed || row.tailRegressed;
+}
+
+std::vector<GateRow> GateReport::timingRegressions() const {
+    std::vector<GateRow> result;
+    for (auto row = rows.begin(); row != rows.end(); ++row) {
+        if (!hasCounterChanges(*row) && (row->throughputRegressed || row->tailRegressed)) {
+            result.push_back(*row);
+        }
+    }
+    return result;
+}
+
+static GateRow compareResults(const BenchmarkResult& baseline, const BenchmarkResult& current, const GateOptions& options) {
+    GateRow row;
+    row.corpus = baseline.corpus;
+    row.configuration = baseline.configuration;
+
+    const int count = (int)std::min(baseline.puzzleSeconds.size(), current.puzzleSeconds.size());
+    const bool compareNodes = (int)baseline.puzzleNodes.size() >= count && (int)current.puzzleNodes.size() >= count;
+    std::vector<double> logRatios;
+    double logRatioSum = 0;
+    for (int i = 0; i < count; i++) {
+        const bool baselineTimedOut = isTimeout(baseline.puzzleStatuses[i]);
+        const bool currentTimedOut = isTimeout(current.puzzleStatuses[i]);
+        if (baselineTimedOut && currentTimedOut) {
+            continue;
+        }
+        row.statusChangeCount += baseline.puzzleStatuses[i] != current.puzzleStatuses[i];
+        // a puzzle that now times out (or no longer does) is a status change; its nodes and time say nothing more
+        if (baselineTimedOut || currentTimedOut) {
+            continue;
+        }
+        row.nodeChangeCount += compareNodes && baseline.puzzleNodes[i] != current.puzzleNodes[i];
+        // lanes report the batch time for every puzzle of a batch, which is one sample, not sixteen
+        const bool sameBatch = i > 0 && baseline.puzzleSeconds[i] == baseline.puzzleSeconds[i - 1] && current.puzzleSeconds[i] == current.puzzleSeconds[i - 1];
+        if (!sameBatch && baseline.puzzleSeconds[i] > 0 && current.puzzleSeconds[i] > 0) {
+            const double logRatio = std::log(current.puzzleSeconds[i] / baseline.puzzleSeconds[i]);
+            logRatios.push_back(logRatio);
+            logRatioSum += logRatio;
+        }
+    }
+    row.statusChangeCount += std::abs((long)baseline.puzzleSeconds.size() - (long)current.puzzleSeconds.size());
+
+    row.pairedCount = (int)logRatios.size();
+    if (!logRatios.empty()) {
+        row.timeRatio = std::exp(logRatioSum / logRatios.size());
+        row.pValue = RegressionGate::wilcoxonSignedRankPValue(logRatios);
+    }
+    const double baselineP99 = percentile(baseline.puzzleSeconds, 0.99);
+    if (baselineP99 > 0) {
+        row.p99Ratio = percentile(current.puzzleSeconds, 0.99) / baselineP99;
+    }
+    row.throughputRegressed = row.pValue < options.significance && row.timeRatio > 1 + options.throughputThreshold;
+    row.tailRegressed = row.p99Ratio > 1 + options.tailThreshold;
+    return row;
+}
+
+GateReport RegressionGate::compare(const BenchmarkBaseline& baseline, const BenchmarkBaseline& current, const GateOptions& options) {
+    GateReport report;
+    BenchmarkResultVector currentResults = current.results;
+    for (auto result = baseline.results.begin(); result != baseline.results.end(); ++result) {
+        const BenchmarkResult* currentResult = findResult(currentResults, result->corpus, result->configuration);
+        if (currentResult == nullptr) {
+            GateRow row;
+            row.corpus = result->corpus;
+            row.configuration = result->configuration;
+            row.missing = true;
+            report.rows.push_back(row);
+            report.failed = true;
+            continue;
+        }
+        GateRow row = compareResults(*result, *currentResult, options);
+        report.failed |= hasRegressed(row);
+        report.rows.push_back(row);
+    }
+
+    TechniqueCountersVector currentCounters = current.counters;
+    for (auto counters = baseline.counters.begin(); counters != baseline.counters.end(); ++counters) {
+        const TechniqueCounters& other = countersForCorpus(currentCounters, counters->corpus);
+        for (int technique = 0; technique < kTechniqueCount; technique++) {
+            const std::string name = DifficultyGrader::techniqueName((Technique)technique);
+            if (counters->steps[technique] != other.steps[technique] || counters->eliminations[technique] != other.eliminations[technique]) {
+                std::stringstream change;
+                change << counters->corpus << " " << name << ": " << counters->steps[technique] << " steps/" << counters->eliminations[technique];
+                change << " eliminations -> " << other.steps[technique] << "/" << other.eliminations[technique];
+                report.counterChanges.push_back(change.str());
+            }
+        }
+        if (counters->stalledCount != other.stalledCount) {
+            report.counterChanges.push_back(counters->corpus + " stalled puzzles: " + std::to_string(counters->stalledCount) + " -> " + std::to_string(other.stalledCount));
+        }
+    }
+    report.failed |= !report.counterChanges.empty();
+    return report;
+}
+
+void RegressionGate::mergeRetry(GateReport& report, const GateReport& retry) {
+    for (auto row = report.rows.begin(); row != report.rows.end(); ++row) {
+        for (auto retried = retry.rows.begin(); retried != retry.rows.end(); ++retried) {
+            if (retried->corpus == row->corpus && retried->configuration == row->configuration && !hasRegressed(*retried)) {
+                *row = *retried;
+            }
+        }
+    }
+    report.failed = !report.counterChanges.empty();
+    for (auto row = report.rows.begin(); row != report.rows.end(); ++row) {
+        report.failed |= hasRegressed(*row);
+    }
+}
+
+void RegressionGate::printReport(std::ostream& stream, const GateReport& report, const GateOptions& options) {
+    const std::ios::fmtflags flags = stream.flags();
+    stream << std::fixed << std::setprecision(1) << "Thresholds: time +" << options.throughputThreshold * 100 << "% at p < ";
+    stream << std::setprecision(3) << options.significance << ", p99 +" << std::setprecision(1) << options.tailThreshold * 100 << "%" << std::endl;
+    stream.flags(flags);
+    stream << std::left << std::setw(11) << "corpus" << std::setw(10) << "config" << std::right << std::setw(7) << "paired";
+    stream << std::setw(10) << "time" << std::setw(11) << "p-value" << std::setw(10) << "p99" << std::setw(9) << "status" << std::setw(8) << "nodes";
+    stream << "  verdict" << std::endl;
+    for (auto row = report.rows.begin(); row != report.rows.end(); ++row) {
+        stream << std::left << std::setw(11) << row->corpus << std::setw(10) << row->configuration << std::right;
+        if (row->missing) {
+            stream << "  missing from this run: FAIL" << std::endl;
+            continue;
+        }
+        std::vector<std::string> problems;
+        if (row->throughputRegressed) {
+            problems.push_back("slower");
+        }
+        if (row->tailRegressed) {
+            problems.push_back("tail");
+        }
+        if (row->statusChangeCount > 0) {
+            problems.push_back("status");
+        }
+        if (row->nodeChangeCount > 0) {
+            problems.push_back("nodes");
+        }
+        std::string verdict = problems.empty() ? "ok" : "FAIL (";
+        for (size_t i = 0; i < problems.size(); i++) {
+            verdict += (i > 0 ? ", " : "") + problems[i];
+        }
+        verdict += problems.empty() ? "" : ")";
+
+        stream << std::setw(7) << row->pairedCount << std::fixed << std::setprecision(1);
+        stream << std::setw(9) << (row->timeRatio - 1) * 100 << "%" << std::setprecision(4) << std::setw(11) << row->pValue;
+        stream << std::setprecision(1) << std::setw(9) << (row->p99Ratio - 1) * 100 << "%";
+        stream << std::setw(9) << row->statusChangeCount << std::setw(8) << row->nodeChangeCount << "  " << verdict << std::endl;
+        stream.flags(flags);
+    }
+    for (auto change = report.counterChanges.begin(); change != report.counterChanges.end(); ++change) {
+        stream << "counter changed: " << *change << std::endl;
+    }
+    stream << (report.failed ? "Regression gate FAILED" : "Regression gate passed") << std::endl;
+    stream.flags(flags);
+}
@@ -0,0 +1,95 @@
+//
+//  RegressionGate.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef RegressionGate_hpp
+#define RegressionGate_hpp
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "BenchmarkSuite.hpp"
+
+// everything a later run is compared against
+struct BenchmarkBaseline {
+    BenchmarkOptions options;
+    BenchmarkResultVector results;
+    TechniqueCountersVector counters;
+};
+
+struct GateOptions {
+    // slowdown of the typical puzzle (geometric mean of the per-puzzle ratios) that counts as a regression
+    double throughputThreshold = 0.10;
+    // growth of the p99 latency that counts as a regression; tails are noisier, so the default is looser
+    double tailThreshold = 0.25;
+    // one-sided p-value below which a slowdown is taken to be real
+    double significance = 0.01;
+};
+
+struct GateRow {
+    std::string corpus;
+    std::string configuration;
+    bool missing = false;           // in the baseline but not in this run
+
+    int pairedCount = 0;            // puzzles (or lane batches) timed on both sides
+    double timeRatio = 1;           // current / baseline, geometric mean over the puzzles
+    double pValue = 1;
+    double p99Ratio = 1;
+    bool throughputRegressed = false;
+    bool tailRegressed = false;
+
+    // exact comparisons; puzzles that timed out on both sides are skipped, and one that timed out on one side only
+    // counts as a status change (solved to budget exhausted, cancelled or out of memory is a regression)
+    long statusChangeCount = 0;
+    long nodeChangeCount = 0;
+};
+
+struct GateReport {
+    std::vector<GateRow> rows;
+    std::vector<std::string> counterChanges;
+    bool failed = false;
+
+    // rows whose timings regressed while their counters matched; only these are worth running again
+    std::vector<GateRow> timingRegressions() const;
+};
+
+/**
+ Regression gate for sudoku_bench: a run is recorded as a baseline file and later runs are compared against it
+ puzzle by puzzle. The corpora are regenerated from the baseline's seed and count, so both sides time the same
+ puzzles.
+
+ Timings: each puzzle's median latency over the repetitions is paired with its baseline median, and a one-sided
+ Wilcoxon signed-rank test on the log ratios decides whether the current build is slower. A pair regresses when
+ that test is significant and the geometric mean slowdown is over the threshold, so neither noise nor a tiny but
+ consistent change fails the gate. The p99 of the per-puzzle medians is held to its own threshold.
+
+ Noise on a shared machine comes in bursts that slow every puzzle of a run alike, which a paired test can't tell
+ from a regression, so pairs whose timings regressed can be run again (mergeRetry): a pair only fails if it
+ regresses on every attempt.
+
+ Counters: solve statuses, DFS nodes per puzzle and the technique counters are deterministic, so any difference
+ fails the gate even when the timings are too noisy to tell. Intended algorithm changes need a new baseline.
+
+ The baseline is a plain text file, one record per line: "option name value", "result corpus configuration
+ puzzles puzzles/s", "puzzle corpus configuration index seconds status nodes" and "counter corpus technique steps
+ eliminations" / "stalled corpus count".
+ */
+class RegressionGate {
+public:
+    static bool writeBaseline(const std::string& filename, const BenchmarkBaseline& baseline);
+    static bool readBaseline(const std::string& filename, BenchmarkBaseline& baseline, std::string& error);
+
+    static GateReport compare(const BenchmarkBaseline& baseline, const BenchmarkBaseline& current, const GateOptions& options);
+    // takes the rows of a rerun (compared against the same baseline) that no longer regress
+    static void mergeRetry(GateReport& report, const GateReport& retry);
+    static void printReport(std::ostream& stream, const GateReport& report, const GateOptions& options);
+
+    // one-sided p-value for "the differences are positive"; zero differences are dropped, ties get average ranks
+    static double wilcoxonSignedRankPValue(const std::vector<double>& differences);
+};
+
+#endif /* RegressionGate_hpp */
@@ -0,0 +1,190 @@
+//
+//  PuzzleGenerator.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "PuzzleGenerator.hpp"
+
+#include <algorithm>
+#include <set>
+
+PuzzleGenerator::PuzzleGenerator(const GeneratorOptions options) : _options(options) {
+    _buildCellGroups();
+}
+
+const GeneratorOptions& PuzzleGenerator::getOptions() const {
+    return _options;
+}
+
+#pragma mark - Symmetry
+
+static IntVector symmetricCellIndices(const int cellIndex, const int size, const SymmetryType symmetry) {
+    const int row = cellIndex / size;
+    const int column = cellIndex % size;
+    const int last = size - 1;
+    std::set<int> indices;
+    indices.insert(cellIndex);
+    switch (symmetry) {
+        case SymmetryType::None:
+            break;
+        case SymmetryType::Rotational:
+            indices.insert((last - row) * size + (last - column));
+            break;
+        case SymmetryType::QuarterTurn:
+            indices.insert(column * size + (last - row));
+            indices.insert((last - row) * size + (last - column));
+            indices.insert((last - column) * size + row);
+            break;
+        case SymmetryType::Horizontal:
+            indices.insert((last - row) * size + column);
+            break;
+        case SymmetryType::Vertical:
+            indices.insert(row * size + (last - column));
+            break;
+        case SymmetryType::Diagonal:
+            indices.insert(column * size + row);
+            break;
+    }
+    return IntVector(indices.begin(), indices.end());
+}
+
+// each group is an orbit of the symmetry; a cell belongs to exactly one group
+void PuzzleGenerator::_buildCellGroups() {
+    const int size = _options.size;
+    const int cellCount = size * size;
+    std::vector<bool> grouped(cellCount, false);
+    for (int cellIndex = 0; cellIndex < cellCount; cellIndex++) {
+        if (!grouped[cellIndex]) {
+            IntVector group = symmetricCellIndices(cellIndex, size, _options.symmetry);
+            for (auto index = group.begin(); index != group.end(); ++index) {
+                grouped[*index] = true;
+            }
+            _cellGroups.push_back(group);
+        }
+    }
+}
+
+bool PuzzleGenerator::symmetryTypeFromName(const std::string name, SymmetryType& symmetry) {
+    if (name == "none") {
+        symmetry = SymmetryType::None;
+    } else if (name == "rotational") {
+        symmetry = SymmetryType::Rotational;
+    } else if (name == "quarter") {
+        symmetry = SymmetryType::QuarterTurn;
+    } else if (name == "horizontal") {
+        symmetry = SymmetryType::Horizontal;
+    } else if (name == "vertical") {
+        symmetry = SymmetryType::Vertical;
+    } else if (name == "diagonal") {
+        symmetry = SymmetryType::Diagonal;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+#pragma mark - Generation
+
+bool PuzzleGenerator::_removeClues(BitmaskSolver& solver, const IntVector& solution, std::mt19937_64& rng, IntVectorVector& cellGroups, int& clueCount) const {
+    const int target = _options.targetClueCount;
+    std::shuffle(cellGroups.begin(), cellGroups.end(), rng);
+    for (auto group = cellGroups.begin(); group != cellGroups.end(); ++group) {
+        if (target > 0 && clueCount <= target) {
+            break;
+        }
+        const int groupSize = (int)group->size();
+        if (target > 0 && clueCount - groupSize < target) {
+            continue;
+        }
+
+        IntVector removedValues;
+        for (auto cellIndex = group->begin(); cellIndex != group->end(); ++cellIndex) {
+            removedValues.push_back(solver.getGiven(*cellIndex));
+            solver.clearGiven(*cellIndex);
+        }
+
+        if (!solver.hasSolutionOtherThan(solution, *group, _options.checkNodeLimit)) {
+            clueCount -= groupSize;
+        } else {
+            for (int i = 0; i < groupSize; i++) {
+                solver.setGiven((*group)[i], removedValues[i]);
+            }
+        }
+    }
+    return target == 0 || clueCount <= target;
+}
+
+GeneratedPuzzle PuzzleGenerator::generateOne(BitmaskSolver& solver, std::mt19937_64& rng) const {
+    GeneratedPuzzle result;
+    result.size = _options.size;
+    result.clueCount = -1;
+    result.attempts = 0;
+
+    const int cellCount = solver.getCellCount();
+    IntVectorVector cellGroups = _cellGroups;
+    const int maxAttempts = std::max(1, _options.maxAttempts);
+    for (int attempt = 1; attempt <= maxAttempts; attempt++) {
+        solver.clearGivens();
+        if (!solver.findRandomSolution(rng)) {
+            break;
+        }
+        const IntVector solution = solver.getSolution();
+        for (int cellIndex = 0; cellIndex < cellCount; cellIndex++) {
+            solver.setGiven(cellIndex, solution[cellIndex]);
+        }
+
+        int clueCount = cellCount;
+        const bool reachedTarget = _removeClues(solver, solution, rng, cellGroups, clueCount);
+
+        // keep the sparsest puzzle seen so far in case no attempt reaches the target
+        if (result.clueCount == -1 || clueCount < result.clueCount) {
+            result.clueCount = clueCount;
+            result.solution = solution;
+            result.givens.resize(cellCount);
+            for (int cellIndex = 0; cellIndex < cellCount; cellIndex++) {
+                result.givens[cellIndex] = solver.getGiven(cellIndex);
+            }
+        }
+        result.attempts = attempt;
+        if (reachedTarget) {
+            break;
+        }
+    }
+    return result;
+}
+
+GeneratedPuzzleVector PuzzleGenerator::generate(const int count, ThreadPool& pool) const {
+    GeneratedPuzzleVector result(count);
+    const int threadCount = pool.getThreadCount();
+    pool.runOnEachWorker([&](const int workerIndex) {
+        std::seed_seq seedSequence({(unsigned)(_options.seed & 0xffffffff), (unsigned)(_options.seed >> 32), (unsigned)workerIndex});
+        std::mt19937_64 rng(seedSequence);
+        BitmaskSolver solver(_options.size);
+        for (int puzzleIndex = workerIndex; puzzleIndex < count; puzzleIndex += threadCount) {
+            result[puzzleIndex] = generateOne(solver, rng);
+        }
+    });
+    return result;
+}
+
+#pragma mark - Generated puzzle
+
+static Grid gridFromValues(const int size, const IntVector& values) {
+    Grid result(size);
+    for (int cellIndex = 0; cellIndex < (int)values.size(); cellIndex++) {
+        if (values[cellIndex] != -1) {
+            result.setCellValue(cellIndex, values[cellIndex]);
+        }
+    }
+    return result;
+}
+
+Grid GeneratedPuzzle::puzzleGrid() const {
+    return gridFromValues(size, givens);
+}
+
+Grid GeneratedPuzzle::solutionGrid() const {
+    return gridFromValues(size, solution);
+}
@@ -0,0 +1,87 @@
+//
+//  PuzzleGenerator.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef PuzzleGenerator_hpp
+#define PuzzleGenerator_hpp
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "BitmaskSolver.hpp"
+#include "Grid.hpp"
+#include "ThreadPool.hpp"
+
+typedef std::vector<int> IntVector;
+typedef std::vector<IntVector> IntVectorVector;
+
+// which cells have to be removed together so the clue pattern keeps its symmetry
+enum class SymmetryType {
+    None,
+    Rotational,     // 180 degree turn
+    QuarterTurn,    // 90 degree turn
+    Horizontal,     // mirrored top to bottom
+    Vertical,       // mirrored left to right
+    Diagonal        // mirrored along the main diagonal
+};
+
+struct GeneratorOptions {
+    int size = 9;
+    // 0 removes clues until no more can go; otherwise stops once the count is reached
+    int targetClueCount = 0;
+    SymmetryType symmetry = SymmetryType::None;
+    // full solutions tried per puzzle when the target clue count can't be reached
+    int maxAttempts = 8;
+    // a removal whose uniqueness check needs more search nodes than this keeps its clue, which bounds the time
+    // spent near minimal puzzles on large grids (where a single check can run to millions of nodes); 0 for no limit
+    long checkNodeLimit = 10000;
+    unsigned long long seed = 1;
+};
+
+struct GeneratedPuzzle {
+    int size;
+    IntVector givens;
+    IntVector solution;
+    int clueCount;
+    int attempts;
+
+    Grid puzzleGrid() const;
+    Grid solutionGrid() const;
+};
+
+typedef std::vector<GeneratedPuzzle> GeneratedPuzzleVector;
+
+/**
+ Builds puzzles with exactly one solution:
+ 1. fill an empty grid by randomized search
+ 2. visit the cells (or symmetric groups of cells) in random order and remove their clues, putting them back
+    whenever the puzzle allows a second solution; since it was unique before, only a solution that differs from
+    the filled grid in one of the removed cells is searched for
+
+ The BitmaskSolver keeps the remaining clues as row/column/subgrid masks, so removing or restoring a clue is a
+ few mask updates rather than a reload of the puzzle.
+ */
+class PuzzleGenerator {
+    GeneratorOptions _options;
+    IntVectorVector _cellGroups;
+
+    void _buildCellGroups();
+    bool _removeClues(BitmaskSolver& solver, const IntVector& solution, std::mt19937_64& rng, IntVectorVector& cellGroups, int& clueCount) const;
+
+public:
+    PuzzleGenerator(const GeneratorOptions options);
+
+    const GeneratorOptions& getOptions() const;
+
+    GeneratedPuzzle generateOne(BitmaskSolver& solver, std::mt19937_64& rng) const;
+    // spreads count puzzles over the pool; worker w uses its own RNG stream and makes puzzles w, w + threads, ...
+    GeneratedPuzzleVector generate(const int count, ThreadPool& pool) const;
+
+    static bool symmetryTypeFromName(const std::string name, SymmetryType& symmetry);
+};
+
+#endif /* PuzzleGenerator_hpp */
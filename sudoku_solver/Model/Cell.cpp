@@ -31,7 +31,7 @@ const IntSet& Cell::getCandidates() const {
     return _candidates;
 }
 
-void Cell::setCandidates(const IntSet c) {
+void Cell::setCandidates(const IntSet& c) {
     _candidates = c;
 }
 
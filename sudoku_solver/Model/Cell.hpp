@@ -22,7 +22,7 @@ public:
     void setValue(const int v, const int gridSize);
 
     const IntSet& getCandidates() const;
-    void setCandidates(const IntSet candidates);
+    void setCandidates(const IntSet& candidates);
 
     int eraseCandidate(const int candidate);
 };
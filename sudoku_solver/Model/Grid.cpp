@@ -6,12 +6,19 @@
 
 #include "Grid.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <sstream>
 
 static const int kDefaultSize = 9;
 static const int kDefaultSubSize = 3;
+const int Grid::kMaxSize;
+static_assert(Grid::kMaxSize <= 64, "setCellCandidatesExcluding takes values as bits of a uint64_t");
 
 static bool isPerfectSquare(const int n) {
     if (n < 0) {
@@ -21,25 +28,51 @@ static bool isPerfectSquare(const int n) {
     return n == root * root;
 }
 
+// accepts the characters written by prettyPrint: 1-9, then A-Z for 10-35, a-z for 36-61 and @, #, $ for 62-64.
+// Grids small enough to never need lowercase letters accept either case.
+static int valueOfPrintCharacter(const char c, const int gridSize) {
+    if (c >= '1' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'A' && c <= 'Z') {
+        return c - 'A' + 10;
+    } else if (c >= 'a' && c <= 'z') {
+        return gridSize > 35 ? c - 'a' + 36 : c - 'a' + 10;
+    }
+    switch (c) {
+        case '@': return 62;
+        case '#': return 63;
+        case '$': return 64;
+    }
+    return -1;
+}
+
 Grid::Grid() {
     _cells.resize(kDefaultSize * kDefaultSize);
     _size = kDefaultSize;
     _subSize = kDefaultSubSize;
-    _initializeCommonIndicesMaps();
+    _initializeIndexTables();
+    _initializeCandidateCountIndex();
+    _initializeHash();
+}
+
+bool Grid::supportsSize(const int size) {
+    return size >= 1 && size <= kMaxSize && isPerfectSquare(size);
 }
 
 Grid::Grid(const int s) {
-    if (isPerfectSquare(s)) {
+    if (supportsSize(s)) {
         _cells.resize(s * s);
         _size = s;
         _subSize = round(sqrt(s));
     } else {
-        std::cout << "invalid size: " << s << " is not perfect square" << std::endl;
+        std::cout << "invalid size: " << s << " is not a perfect square up to " << kMaxSize << std::endl;
         _cells.resize(kDefaultSize * kDefaultSize);
         _size = kDefaultSize;
         _subSize = kDefaultSubSize;
     }
-    _initializeCommonIndicesMaps();
+    _initializeIndexTables();
+    _initializeCandidateCountIndex();
+    _initializeHash();
 }
 
 void Grid::_initFromFile(const std::string filename) {
@@ -52,24 +85,25 @@ void Grid::_initFromFile(const std::string filename) {
         while (getline(myfile, line)) {
             if (lineLength < 0) {
                 lineLength = (int)line.length();
-                if (isPerfectSquare(lineLength)) {
+                if (supportsSize(lineLength)) {
                     _size = lineLength;
                     _subSize = round(sqrt(lineLength));
+                } else if (isPerfectSquare(lineLength)) {
+                    std::cout << "unsupported grid size: " << lineLength << " (the largest is " << kMaxSize << ")" << std::endl;
+                    error = true;
+                    break;
                 } else {
                     error = true;
                     break;
                 }
-            } else if (line.length() != lineLength) {
+            } else if ((int)line.length() != lineLength) {
                 std::cout << "invalid input line length: " << line.length() << " but expect " << lineLength << std::endl;
                 error = true;
                 break;
             }
             for (char& c : line) {
-                if (c >= '1' && c <= '9') {
-                    int intValue = c - '0';
-                    _cells.push_back(Cell(intValue));
-                } else if (c >= 'a' && c <= 'g') {
-                    int intValue = c - 'a' + 10;
+                const int intValue = valueOfPrintCharacter(c, _size);
+                if (intValue >= 1 && intValue <= _size) {
                     _cells.push_back(Cell(intValue));
                 } else {
                     _cells.push_back(Cell());
@@ -78,7 +112,7 @@ void Grid::_initFromFile(const std::string filename) {
             totalLines += 1;
         }
         myfile.close();
-        if (totalLines != lineLength) {
+        if (!error && totalLines != lineLength) {
             std::cout << "invalid number of input lines: " << totalLines << " but expect " << lineLength << std::endl;
             error = true;
         }
@@ -96,7 +130,49 @@ void Grid::_initFromFile(const std::string filename) {
 
 Grid::Grid(const std::string filename) {
     _initFromFile(filename);
-    _initializeCommonIndicesMaps();
+    _initializeIndexTables();
+    _initializeCandidateCountIndex();
+    _initializeHash();
+}
+
+Grid Grid::fromCompactString(const std::string line) {
+    const int size = compactStringSize(line);
+    if (size == 0) {
+        std::cerr << "invalid compact grid length: " << line.length() << std::endl;
+        return Grid();
+    }
+    Grid result(size);
+    result.loadCompactString(line);
+    return result;
+}
+
+int Grid::compactStringSize(const std::string& line) {
+    const int length = (int)line.length();
+    const int size = (int)round(sqrt(length));
+    if (size * size != length || !supportsSize(size)) {
+        return 0;
+    }
+    return size;
+}
+
+bool Grid::loadCompactString(const std::string& line) {
+    return loadCompactCharacters(line.data(), (int)line.length());
+}
+
+bool Grid::loadCompactCharacters(const char* cells, const int length) {
+    if (length != _size * _size) {
+        return false;
+    }
+    for (int cellIndex = 0; cellIndex < (int)_cells.size(); cellIndex++) {
+        _cells[cellIndex] = Cell();
+        const int value = valueOfPrintCharacter(cells[cellIndex], _size);
+        if (value >= 1 && value <= _size) {
+            _cells[cellIndex].setValue(value, _size);
+        }
+    }
+    _initializeCandidateCountIndex();
+    _initializeHash();
+    return true;
 }
 
 int Grid::getSize() const {
@@ -107,27 +183,177 @@ int Grid::getSubSize() const {
     return _subSize;
 }
 
-Cell& Grid::cellAtIndex(const int index) {
+const Cell& Grid::cellAtIndex(const int index) const {
     return _cells[index];
 }
 
-const Cell& Grid::cellAtIndex(const int index) const {
-    return _cells[index];
+#pragma mark - Cell setters
+
+void Grid::setCellValue(const int cellIndex, const int value) {
+    _hash ^= _hashOfCell(cellIndex);
+    _cells[cellIndex].setValue(value, _size);
+    _hash ^= _hashOfCell(cellIndex);
+    _updateCandidateCountIndex(cellIndex);
+}
+
+void Grid::setCellCandidates(const int cellIndex, const IntSet& candidates) {
+    _hash ^= _hashOfCell(cellIndex);
+    _cells[cellIndex].setCandidates(candidates);
+    _hash ^= _hashOfCell(cellIndex);
+    _updateCandidateCountIndex(cellIndex);
+}
+
+void Grid::setCellCandidatesExcluding(const int cellIndex, const IntSet& candidates, const uint64_t excludedValues) {
+    _hash ^= _hashOfCell(cellIndex);
+    Cell& cell = _cells[cellIndex];
+    cell.setCandidates(candidates);
+    // erasing leaves the order of the remaining candidates alone, so the order of the erases doesn't matter
+    for (uint64_t values = excludedValues; values != 0; values &= values - 1) {
+        cell.eraseCandidate(__builtin_ctzll(values) + 1);
+    }
+    _hash ^= _hashOfCell(cellIndex);
+    _updateCandidateCountIndex(cellIndex);
+}
+
+int Grid::eraseCellCandidate(const int cellIndex, const int candidate) {
+    const int numberErased = _cells[cellIndex].eraseCandidate(candidate);
+    if (numberErased > 0) {
+        _hash ^= _zobristKeys[2 * (cellIndex * _size + candidate - 1) + 1];
+        _updateCandidateCountIndex(cellIndex);
+    }
+    return numberErased;
+}
+
+#pragma mark - Zobrist hash
+
+// two random keys per (cell, value): one for the value being set, one for it being a candidate
+static std::vector<uint64_t>* buildZobristKeys(const int size) {
+    std::mt19937_64 rng(0x5d0c0ULL + size);
+    std::vector<uint64_t>* keys = new std::vector<uint64_t>(2 * size * size * size);
+    for (auto key = keys->begin(); key != keys->end(); ++key) {
+        *key = rng();
+    }
+    return keys;
+}
+
+static const uint64_t* zobristKeysForSize(const int size) {
+    static std::mutex mutex;
+    static std::map<int, std::unique_ptr<std::vector<uint64_t>>> keysBySize;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<std::vector<uint64_t>>& keys = keysBySize[size];
+    if (!keys) {
+        keys.reset(buildZobristKeys(size));
+    }
+    return keys->data();
+}
+
+void Grid::_initializeHash() {
+    _zobristKeys = zobristKeysForSize(_size);
+    _hash = 0;
+    for (int cellIndex = 0; cellIndex < (int)_cells.size(); cellIndex++) {
+        _hash ^= _hashOfCell(cellIndex);
+    }
+}
+
+uint64_t Grid::_hashOfCell(const int cellIndex) const {
+    const Cell& cell = _cells[cellIndex];
+    if (cell.getValue() != -1) {
+        return _zobristKeys[2 * (cellIndex * _size + cell.getValue() - 1)];
+    }
+    uint64_t result = 0;
+    const IntSet& candidates = cell.getCandidates();
+    for (auto candidate = candidates.begin(); candidate != candidates.end(); ++candidate) {
+        result ^= _zobristKeys[2 * (cellIndex * _size + *candidate - 1) + 1];
+    }
+    return result;
+}
+
+uint64_t Grid::getHash() const {
+    return _hash;
+}
+
+#pragma mark - Candidate count index
+
+void Grid::_initializeCandidateCountIndex() {
+    const int cellCount = (int)_cells.size();
+    _candidateCountOfCell.assign(cellCount, -1);
+    _candidateCountBucketHeads.assign(_size + 1, -1);
+    _nextCellInBucket.assign(cellCount, -1);
+    _previousCellInBucket.assign(cellCount, -1);
+    for (int cellIndex = 0; cellIndex < cellCount; cellIndex++) {
+        _updateCandidateCountIndex(cellIndex);
+    }
+}
+
+void Grid::_updateCandidateCountIndex(const int cellIndex) {
+    const Cell& cell = _cells[cellIndex];
+    const int newCount = cell.getValue() == -1 ? std::min((int)cell.getCandidates().size(), _size) : -1;
+    const int oldCount = _candidateCountOfCell[cellIndex];
+    if (newCount == oldCount) {
+        return;
+    }
+    if (oldCount >= 0) {
+        const int previous = _previousCellInBucket[cellIndex];
+        const int next = _nextCellInBucket[cellIndex];
+        if (previous >= 0) {
+            _nextCellInBucket[previous] = next;
+        } else {
+            _candidateCountBucketHeads[oldCount] = next;
+        }
+        if (next >= 0) {
+            _previousCellInBucket[next] = previous;
+        }
+    }
+    if (newCount >= 0) {
+        const int head = _candidateCountBucketHeads[newCount];
+        _previousCellInBucket[cellIndex] = -1;
+        _nextCellInBucket[cellIndex] = head;
+        if (head >= 0) {
+            _previousCellInBucket[head] = cellIndex;
+        }
+        _candidateCountBucketHeads[newCount] = cellIndex;
+    }
+    _candidateCountOfCell[cellIndex] = newCount;
+}
+
+int Grid::getFewestCandidateCount() const {
+    for (int count = 0; count <= _size; count++) {
+        if (_candidateCountBucketHeads[count] >= 0) {
+            return count;
+        }
+    }
+    return -1;
+}
+
+IntVector Grid::getCellIndicesWithCandidateCount(const int count) const {
+    IntVector result;
+    if (count < 0 || count > _size) {
+        return result;
+    }
+    for (int cellIndex = _candidateCountBucketHeads[count]; cellIndex >= 0; cellIndex = _nextCellInBucket[cellIndex]) {
+        result.push_back(cellIndex);
+    }
+    return result;
 }
 
 #pragma mark - Check if valid
 
+uint64_t Grid::_allValuesMask() const {
+    return _size >= 64 ? ~(uint64_t)0 : (((uint64_t)1) << _size) - 1;
+}
+
 // given a grid row, checks that there are no conflicts in the row (empty cells are allowed)
 bool Grid::_rowIsValid(const int rowIndex) const {
     const int startIndex = rowIndex * _size;
-    IntSet seenValues;
+    uint64_t seenValues = 0;
     for (int currentIndex = startIndex, counter = 0; counter < _size; currentIndex++, counter++) {
         const Cell& cell = _cells[currentIndex];
         if (cell.getValue() != -1) {
-            if (seenValues.find(cell.getValue()) != seenValues.end()) {
+            const uint64_t bit = ((uint64_t)1) << (cell.getValue() - 1);
+            if (seenValues & bit) {
                 return false;
             }
-            seenValues.insert(cell.getValue());
+            seenValues |= bit;
         }
     }
     return true;
@@ -136,14 +362,15 @@ bool Grid::_rowIsValid(const int rowIndex) const {
 // given a grid column, checks that there are no conflicts in the column (empty cells are allowed)
 bool Grid::_columnIsValid(const int columnIndex) const {
     const int startIndex = columnIndex;
-    IntSet seenValues;
+    uint64_t seenValues = 0;
     for (int currentIndex = startIndex, counter = 0; counter < _size; currentIndex += _size, counter++) {
         const Cell& cell = _cells[currentIndex];
         if (cell.getValue() != -1) {
-            if (seenValues.find(cell.getValue()) != seenValues.end()) {
+            const uint64_t bit = ((uint64_t)1) << (cell.getValue() - 1);
+            if (seenValues & bit) {
                 return false;
             }
-            seenValues.insert(cell.getValue());
+            seenValues |= bit;
         }
     }
     return true;
@@ -151,16 +378,17 @@ bool Grid::_columnIsValid(const int columnIndex) const {
 
 // given a grid subgrid, checks that there are no conflicts in the subgrid (empty cells are allowed)
 bool Grid::_subgridIsValid(const int startRow, const int startColumn) const {
-    IntSet seenValues;
+    uint64_t seenValues = 0;
     for (int row = startRow, rowCounter = 0; rowCounter < _subSize; row++, rowCounter++) {
         for (int col = startColumn, colCounter = 0; colCounter < _subSize; col++, colCounter++) {
             int currentIndex = indexAtRowAndColumn(row, col);
             const Cell& cell = _cells[currentIndex];
             if (cell.getValue() != -1) {
-                if (seenValues.find(cell.getValue()) != seenValues.end()) {
+                const uint64_t bit = ((uint64_t)1) << (cell.getValue() - 1);
+                if (seenValues & bit) {
                     return false;
                 }
-                seenValues.insert(cell.getValue());
+                seenValues |= bit;
             }
         }
     }
@@ -202,49 +430,53 @@ bool Grid::isValid() const {
 
 #pragma mark - Check if solved
 
-IntSet Grid::allCandidates() const {
-    static IntSet result;
-    static bool initialized = false;
-    if (!initialized) {
-        for (int i = 1; i <= _size; i++) {
-            result.insert(i);
+// one candidate set per grid size, built once so that grids of different sizes (and threads) can share it
+static std::vector<IntSet> buildAllCandidatesBySize() {
+    std::vector<IntSet> result(Grid::kMaxSize + 1);
+    for (int size = 1; size <= Grid::kMaxSize; size++) {
+        for (int i = 1; i <= size; i++) {
+            result[size].insert(i);
         }
-        initialized = true;
     }
     return result;
 }
 
+const IntSet& Grid::allCandidates() const {
+    static const std::vector<IntSet> allCandidatesBySize = buildAllCandidatesBySize();
+    return allCandidatesBySize[_size];
+}
+
 // given a grid row, checks that each cell has a unique value
 bool Grid::_rowIsSolved(const int rowIndex) const {
     const int startIndex = rowIndex * _size;
-    IntSet remainingValues = allCandidates();
+    uint64_t seenValues = 0;
     for (int currentIndex = startIndex, counter = 0; counter < _size; currentIndex++, counter++) {
         const Cell& cell = _cells[currentIndex];
         if (cell.getValue() == -1) {
             return false;
         }
-        remainingValues.erase(cell.getValue());
+        seenValues |= ((uint64_t)1) << (cell.getValue() - 1);
     }
-    return remainingValues.size() == 0;
+    return seenValues == _allValuesMask();
 }
 
 // given a grid column, checks that each cell has a unique value
 bool Grid::_columnIsSolved(const int columnIndex) const {
     const int startIndex = columnIndex;
-    IntSet remainingValues = allCandidates();
+    uint64_t seenValues = 0;
     for (int currentIndex = startIndex, counter = 0; counter < _size; currentIndex += _size, counter++) {
         const Cell& cell = _cells[currentIndex];
         if (cell.getValue() == -1) {
             return false;
         }
-        remainingValues.erase(cell.getValue());
+        seenValues |= ((uint64_t)1) << (cell.getValue() - 1);
     }
-    return remainingValues.size() == 0;
+    return seenValues == _allValuesMask();
 }
 
 // given a grid subgrid, checks that each cell has a unique value
 bool Grid::_subgridIsSolved(const int startRow, const int startColumn) const {
-    IntSet remainingValues = allCandidates();
+    uint64_t seenValues = 0;
     for (int row = startRow, rowCounter = 0; rowCounter < _subSize; row++, rowCounter++) {
         for (int col = startColumn, colCounter = 0; colCounter < _subSize; col++, colCounter++) {
             int currentIndex = indexAtRowAndColumn(row, col);
@@ -252,10 +484,10 @@ bool Grid::_subgridIsSolved(const int startRow, const int startColumn) const {
             if (cell.getValue() == -1) {
                 return false;
             }
-            remainingValues.erase(cell.getValue());
+            seenValues |= ((uint64_t)1) << (cell.getValue() - 1);
         }
     }
-    return remainingValues.size() == 0;
+    return seenValues == _allValuesMask();
 }
 
 bool Grid::_allRowsSolved() const {
@@ -291,52 +523,6 @@ bool Grid::isSolved() const {
     return _allRowsSolved() && _allColumnsSolved() && _allSubgridsSolved();
 }
 
-#pragma mark - Test if indices are in same group
-
-bool Grid::indicesAreInSameRow(const IntSet& indices) const {
-    int rowIndex = -1;
-    for (auto index = indices.begin(); index != indices.end(); ++index) {
-        const int currentRowIndex = rowOfCellIndex(*index);
-        if (rowIndex == -1) {
-            rowIndex = currentRowIndex;
-        } else if (rowIndex != currentRowIndex) {
-            return false;
-        }
-    }
-    return true;
-}
-
-bool Grid::indicesAreInSameColumn(const IntSet& indices) const {
-    int columnIndex = -1;
-    for (auto index = indices.begin(); index != indices.end(); ++index) {
-        const int currentColumnIndex = columnOfCellIndex(*index);
-        if (columnIndex == -1) {
-            columnIndex = currentColumnIndex;
-        } else if (columnIndex != currentColumnIndex) {
-            return false;
-        }
-    }
-    return true;
-}
-
-bool Grid::indicesAreInSameSubgrid(const IntSet& indices) const {
-    int subgridRowIndex = -1;
-    int subgridColumnIndex = -1;
-    for (auto index = indices.begin(); index != indices.end(); ++index) {
-        const int currentRowIndex = rowOfCellIndex(*index);
-        const int currentColumnIndex = columnOfCellIndex(*index);
-        const int currentSubgridRow = currentRowIndex / _subSize;
-        const int currentSubgridColumn = currentColumnIndex / _subSize;
-        if (subgridRowIndex == -1) {
-            subgridRowIndex = currentSubgridRow;
-            subgridColumnIndex = currentSubgridColumn;
-        } else if (subgridRowIndex != currentSubgridRow || subgridColumnIndex != currentSubgridColumn) {
-            return false;
-        }
-    }
-    return true;
-}
-
 #pragma mark - Common group index getters
 
 static IntSet buildCommonRowIndicesOfCellAtIndex(const int cellIndex, const int gridSize) {
@@ -373,74 +559,105 @@ static IntSet buildCommonSubgridIndicesOfCellAtIndex(const int cellIndex, const
     return indices;
 }
 
-void Grid::_initializeCommonIndicesMaps() {
-    for (int row = 0; row < _size; row++) {
-        _rowIndexToRowIndices[row] = buildCommonRowIndicesOfCellAtIndex(row * _size, _size);
+struct GridIndexTables {
+    std::vector<IntSet> rows;
+    std::vector<IntSet> columns;
+    std::vector<IntSet> subgrids;
+};
+
+static GridIndexTables* buildIndexTables(const int size, const int subSize) {
+    GridIndexTables* tables = new GridIndexTables();
+    for (int row = 0; row < size; row++) {
+        tables->rows.push_back(buildCommonRowIndicesOfCellAtIndex(row * size, size));
     }
-    for (int col = 0; col < _size; col++) {
-        _columnIndexToColumnIndices[col] = buildCommonColumnIndicesOfCellAtIndex(col, _size);
+    for (int col = 0; col < size; col++) {
+        tables->columns.push_back(buildCommonColumnIndicesOfCellAtIndex(col, size));
     }
-    for (int row = 0; row < _size; row += _subSize) {
-        for (int col = 0; col < _size; col += _subSize) {
-            const int subgridRow = row / _subSize;
-            const int subgridColumn = col / _subSize;
-            const int index = subgridRow * _subSize + subgridColumn;
-            const int cellIndex = indexAtRowAndColumn(row, col);
-            _subgridIndexToSubgridIndices[index] = buildCommonSubgridIndicesOfCellAtIndex(cellIndex, _size, _subSize);
+    for (int row = 0; row < size; row += subSize) {
+        for (int col = 0; col < size; col += subSize) {
+            tables->subgrids.push_back(buildCommonSubgridIndicesOfCellAtIndex(row * size + col, size, subSize));
         }
     }
+    return tables;
+}
+
+// built once per size like the Zobrist keys, so copying a grid copies no index sets
+static const GridIndexTables* indexTablesForSize(const int size, const int subSize) {
+    static std::mutex mutex;
+    static std::map<int, std::unique_ptr<GridIndexTables>> tablesBySize;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<GridIndexTables>& tables = tablesBySize[size];
+    if (!tables) {
+        tables.reset(buildIndexTables(size, subSize));
+    }
+    return tables.get();
+}
+
+void Grid::_initializeIndexTables() {
+    _indexTables = indexTablesForSize(_size, _subSize);
 }
 
-IntSet Grid::commonRowIndicesOfCellAtIndex(const int cellIndex) const {
-    return _rowIndexToRowIndices.at(rowOfCellIndex(cellIndex));
+const IntSet& Grid::commonRowIndicesOfCellAtIndex(const int cellIndex) const {
+    return _indexTables->rows[rowOfCellIndex(cellIndex)];
 }
 
-IntSet Grid::commonColumnIndicesOfCellAtIndex(const int cellIndex) const {
-    return _columnIndexToColumnIndices.at(columnOfCellIndex(cellIndex));
+const IntSet& Grid::commonColumnIndicesOfCellAtIndex(const int cellIndex) const {
+    return _indexTables->columns[columnOfCellIndex(cellIndex)];
 }
 
-IntSet Grid::commonSubgridIndicesOfCellAtIndex(const int cellIndex) const {
+const IntSet& Grid::commonSubgridIndicesOfCellAtIndex(const int cellIndex) const {
     const int cellRowIndex = rowOfCellIndex(cellIndex);
     const int cellColumnIndex = columnOfCellIndex(cellIndex);
     const int subgridIndex = subgridIndexAtRowAndColumn(cellRowIndex, cellColumnIndex);
-    return _subgridIndexToSubgridIndices.at(subgridIndex);
+    return _indexTables->subgrids[subgridIndex];
 }
 
-#pragma mark - Row and column indices from cell index set
+#pragma mark - Memory
 
-IntSet Grid::rowSetOfCellIndices(const IntSet& indices) const {
-    IntSet result = IntSet();
-    for (auto cellIndex = indices.begin(); cellIndex != indices.end(); ++cellIndex) {
-        const int currentRow = rowOfCellIndex(*cellIndex);
-        result.insert(currentRow);
+// a hash set node (next pointer and value) with the allocator's header
+static const size_t kHashNodeBytes = 4 * sizeof(void*);
+
+static size_t hashSetBytes(const IntSet& set) {
+    return set.bucket_count() * sizeof(void*) + set.size() * kHashNodeBytes;
+}
+
+size_t Grid::getMemoryFootprint() const {
+    size_t bytes = _cells.capacity() * sizeof(Cell);
+    for (auto cell = _cells.begin(); cell != _cells.end(); ++cell) {
+        bytes += hashSetBytes(cell->getCandidates());
     }
-    return result;
+    bytes += (_candidateCountOfCell.capacity() + _candidateCountBucketHeads.capacity() + _nextCellInBucket.capacity() + _previousCellInBucket.capacity()) * sizeof(int);
+    return bytes;
 }
 
-IntSet Grid::columnSetOfCellIndices(const IntSet& indices) const {
-    IntSet result = IntSet();
-    for (auto cellIndex = indices.begin(); cellIndex != indices.end(); ++cellIndex) {
-        const int currentColumn = columnOfCellIndex(*cellIndex);
-        result.insert(currentColumn);
+size_t Grid::getSharedTableBytes() const {
+    size_t bytes = 2 * (size_t)_size * _size * _size * sizeof(uint64_t);
+    const std::vector<IntSet>* tables[] = {&_indexTables->rows, &_indexTables->columns, &_indexTables->subgrids};
+    for (auto table = std::begin(tables); table != std::end(tables); ++table) {
+        for (auto indices = (*table)->begin(); indices != (*table)->end(); ++indices) {
+            bytes += sizeof(IntSet) + hashSetBytes(*indices);
+        }
     }
-    return result;
+    return bytes;
 }
 
 #pragma mark -
 
-IntToIntSetMap Grid::_initialCandidateListMap() const {
-    static IntToIntSetMap result;
-    static bool initialized = false;
-    if (!initialized) {
-        int gridSize = _size;
-        for (int i = 1; i <= gridSize; i++) {
-            result[i] = IntSet();
+static std::vector<IntToIntSetMap> buildInitialCandidateListMapsBySize() {
+    std::vector<IntToIntSetMap> result(Grid::kMaxSize + 1);
+    for (int size = 1; size <= Grid::kMaxSize; size++) {
+        for (int i = 1; i <= size; i++) {
+            result[size][i] = IntSet();
         }
-        initialized = true;
     }
     return result;
 }
 
+IntToIntSetMap Grid::_initialCandidateListMap() const {
+    static const std::vector<IntToIntSetMap> initialCandidateListMapsBySize = buildInitialCandidateListMapsBySize();
+    return initialCandidateListMapsBySize[_size];
+}
+
 IntToIntSetMap Grid::getCandidateCellIndexListsFromIndices(const IntSet& indices) const {
     IntToIntSetMap result = _initialCandidateListMap();
     for (auto currentIndex = indices.begin(); currentIndex != indices.end(); ++currentIndex) {
@@ -456,38 +673,26 @@ IntToIntSetMap Grid::getCandidateCellIndexListsFromIndices(const IntSet& indices
 
 #pragma mark - Printing
 
-IntToStringMap Grid::_valuetoPrintValue() const {
-    static IntToStringMap result;
-    static bool initialized = false;
-    if (!initialized) {
-        // currently enough for 5x5 grids
-        result[1] = "1";
-        result[2] = "2";
-        result[3] = "3";
-        result[4] = "4";
-        result[5] = "5";
-        result[6] = "6";
-        result[7] = "7";
-        result[8] = "8";
-        result[9] = "9";
-        result[10] = "A";
-        result[11] = "B";
-        result[12] = "C";
-        result[13] = "D";
-        result[14] = "E";
-        result[15] = "F";
-        result[16] = "G";
-        result[17] = "H";
-        result[18] = "I";
-        result[19] = "J";
-        result[20] = "K";
-        result[21] = "L";
-        result[22] = "M";
-        result[23] = "N";
-        result[24] = "O";
-        result[25] = "P";
-        initialized = true;
+static IntToStringMap buildValueToPrintValue() {
+    IntToStringMap result;
+    // enough for 8x8 grids: 1-9, A-Z, a-z, then @, # and $
+    for (int value = 1; value <= 9; value++) {
+        result[value] = std::string(1, '0' + value);
     }
+    for (int value = 10; value <= 35; value++) {
+        result[value] = std::string(1, 'A' + value - 10);
+    }
+    for (int value = 36; value <= 61; value++) {
+        result[value] = std::string(1, 'a' + value - 36);
+    }
+    result[62] = "@";
+    result[63] = "#";
+    result[64] = "$";
+    return result;
+}
+
+IntToStringMap Grid::_valuetoPrintValue() const {
+    static const IntToStringMap result = buildValueToPrintValue();
     return result;
 }
 
@@ -521,6 +726,30 @@ std::string Grid::prettyPrint(const bool printSeparators) const {
     return result;
 }
 
+std::string Grid::compactPrint() const {
+    std::string result(_size * _size, '-');
+    compactPrintTo(&result[0]);
+    return result;
+}
+
+// the alphabet of buildValueToPrintValue
+char Grid::printCharacterOfValue(const int value) {
+    if (value <= 9) {
+        return '0' + value;
+    }
+    if (value <= 35) {
+        return 'A' + value - 10;
+    }
+    return value <= 61 ? 'a' + value - 36 : "@#$"[value - 62];
+}
+
+void Grid::compactPrintTo(char* cells) const {
+    for (int cellIndex = 0; cellIndex < _size * _size; cellIndex++) {
+        const int value = _cells[cellIndex].getValue();
+        cells[cellIndex] = value == -1 ? '-' : printCharacterOfValue(value);
+    }
+}
+
 #pragma mark -
 
 int Grid::getNumberOfUnansweredCellsInIndices(const IntSet& indices) const {
@@ -535,17 +764,22 @@ int Grid::getNumberOfUnansweredCellsInIndices(const IntSet& indices) const {
 }
 
 int Grid::getCellIndexWithFewestCandidates() const {
-    const int cellCount = _size * _size;
-    int minSize = _size;
+    const int minSize = getFewestCandidateCount();
+    return minSize >= 0 ? _candidateCountBucketHeads[minSize] : -1;
+}
+
+int Grid::getCellIndexWithFewestCandidates(std::mt19937_64& rng) const {
+    const int minSize = getFewestCandidateCount();
+    if (minSize < 0) {
+        return -1;
+    }
+    int tieCount = 0;
     int result = -1;
-    for (int i = 0; i < cellCount; i++) {
-        const Cell& cell = _cells[i];
-        if (cell.getValue() == -1) {
-            const int candidatesSize = (int)cell.getCandidates().size();
-            if (candidatesSize < minSize) {
-                minSize = candidatesSize;
-                result = i;
-            }
+    for (int cellIndex = _candidateCountBucketHeads[minSize]; cellIndex >= 0; cellIndex = _nextCellInBucket[cellIndex]) {
+        // reservoir sampling: the k-th tied cell replaces the current pick with probability 1/k
+        tieCount += 1;
+        if (rng() % tieCount == 0) {
+            result = cellIndex;
         }
     }
     return result;
@@ -7,6 +7,8 @@
 #ifndef Grid_hpp
 #define Grid_hpp
 
+#include <cstdint>
+#include <random>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -18,6 +20,9 @@ typedef std::unordered_set<int> IntSet;
 typedef std::unordered_map<int, std::unordered_set<int>> IntToIntSetMap;
 typedef std::unordered_map<int, std::string> IntToStringMap;
 typedef std::vector<Cell> CellVector;
+typedef std::vector<int> IntVector;
+
+struct GridIndexTables;
 
 class Grid {
     int _size;
@@ -41,46 +46,108 @@ class Grid {
     bool _allSubgridsSolved() const;
 
     IntToIntSetMap _initialCandidateListMap() const;
+    // values 1..size as bits 0..size-1 (grids go up to 64x64, see supportsSize)
+    uint64_t _allValuesMask() const;
 
     IntToStringMap _valuetoPrintValue() const;
 
-    void _initializeCommonIndicesMaps();
-    IntToIntSetMap _rowIndexToRowIndices;
-    IntToIntSetMap _columnIndexToColumnIndices;
-    IntToIntSetMap _subgridIndexToSubgridIndices;
-    
+    // the cell indices of every row, column and subgrid, shared by all grids of the same size
+    const GridIndexTables* _indexTables;
+    void _initializeIndexTables();
+
+    // unanswered cells bucketed by candidate count (intrusive doubly linked lists), so the fewest-candidates cell is
+    // found without scanning the grid; kept current by the cell setters below
+    IntVector _candidateCountOfCell;    // -1 for answered cells
+    IntVector _candidateCountBucketHeads;
+    IntVector _nextCellInBucket;
+    IntVector _previousCellInBucket;
+    void _initializeCandidateCountIndex();
+    void _updateCandidateCountIndex(const int cellIndex);
+
+    // Zobrist hash of the values and remaining candidates, updated by the same setters
+    const uint64_t* _zobristKeys;
+    uint64_t _hash;
+    void _initializeHash();
+    uint64_t _hashOfCell(const int cellIndex) const;
+
 public:
+    // the candidate tables stop here, and value bit masks (bit value - 1) fit in a uint64_t
+    static const int kMaxSize = 64;
+
     Grid();
     Grid(const int s);
     Grid(const std::string filename);
+    // perfect squares up to kMaxSize; other sizes give the default grid
+    static bool supportsSize(const int size);
+    // parses compactPrint output; an invalid line gives the default empty grid
+    static Grid fromCompactString(const std::string line);
+    // the size a compactPrint line describes, 0 when its length doesn't fit a supported grid
+    static int compactStringSize(const std::string& line);
+    // replaces every cell from a line of this grid's size without rebuilding the index maps; false when the size differs
+    bool loadCompactString(const std::string& line);
+    // the same on a caller's buffer, such as a shared memory record
+    bool loadCompactCharacters(const char* cells, const int length);
 
     int getSize() const;
     int getSubSize() const;
-    Cell& cellAtIndex(const int index);
     const Cell& cellAtIndex(const int index) const;
 
+    // cells are only changed through these so that the candidate count index stays current
+    void setCellValue(const int cellIndex, const int value);
+    void setCellCandidates(const int cellIndex, const IntSet& candidates);
+    // setCellCandidates with the values whose bits are set in excludedValues (bit value - 1, which kMaxSize keeps
+    // inside the 64 bits) left out, without building the difference first; the set ends up exactly as if those values
+    // had been erased from a copy
+    void setCellCandidatesExcluding(const int cellIndex, const IntSet& candidates, const uint64_t excludedValues);
+    int eraseCellCandidate(const int cellIndex, const int candidate);
+
+    // equal for grids with the same values and candidates (up to 64-bit collisions)
+    uint64_t getHash() const;
+
+    // heap bytes this grid holds, estimated from container capacities; the tables it shares with the other grids of
+    // its size are counted by getSharedTableBytes instead
+    size_t getMemoryFootprint() const;
+    size_t getSharedTableBytes() const;
+
     bool isValid() const;
     bool isSolved() const;
 
-    bool indicesAreInSameRow(const IntSet& indices) const;
-    bool indicesAreInSameColumn(const IntSet& indices) const;
-    bool indicesAreInSameSubgrid(const IntSet& indices) const;
+    // the set-taking helpers are templates so that the solver can pass its scratch sets (see ScratchArena)
+    template <typename IndexSet>
+    bool indicesAreInSameRow(const IndexSet& indices) const;
+    template <typename IndexSet>
+    bool indicesAreInSameColumn(const IndexSet& indices) const;
+    template <typename IndexSet>
+    bool indicesAreInSameSubgrid(const IndexSet& indices) const;
 
-    IntSet commonRowIndicesOfCellAtIndex(const int cellIndex) const;
-    IntSet commonColumnIndicesOfCellAtIndex(const int cellIndex) const;
-    IntSet commonSubgridIndicesOfCellAtIndex(const int cellIndex) const;
+    const IntSet& commonRowIndicesOfCellAtIndex(const int cellIndex) const;
+    const IntSet& commonColumnIndicesOfCellAtIndex(const int cellIndex) const;
+    const IntSet& commonSubgridIndicesOfCellAtIndex(const int cellIndex) const;
 
-    IntSet rowSetOfCellIndices(const IntSet& indices) const;
-    IntSet columnSetOfCellIndices(const IntSet& indices) const;
+    template <typename IndexSet>
+    IndexSet rowSetOfCellIndices(const IndexSet& indices) const;
+    template <typename IndexSet>
+    IndexSet columnSetOfCellIndices(const IndexSet& indices) const;
 
     std::string prettyPrint(const bool printSeparators) const;
-    IntSet allCandidates() const;
+    // single line, one character per cell and '-' for empty cells (same alphabet as the input files)
+    std::string compactPrint() const;
+    // compactPrint into a buffer of size * size characters, without a terminating null
+    void compactPrintTo(char* cells) const;
+    // compactPrint's character for a value from 1 to 64
+    static char printCharacterOfValue(const int value);
+    const IntSet& allCandidates() const;
 
     IntToIntSetMap getCandidateCellIndexListsFromIndices(const IntSet& indices) const;
 
     int getNumberOfUnansweredCellsInIndices(const IntSet& indices) const;
 
+    // -1 when every cell is answered
+    int getFewestCandidateCount() const;
+    IntVector getCellIndicesWithCandidateCount(const int count) const;
     int getCellIndexWithFewestCandidates() const;
+    // picks uniformly among all unanswered cells tied for the fewest candidates
+    int getCellIndexWithFewestCandidates(std::mt19937_64& rng) const;
     
     inline int rowOfCellIndex(const int index) const {
         return index / _size;
@@ -101,4 +168,71 @@ public:
     }
 };
 
+#pragma mark - Set-taking helpers
+
+template <typename IndexSet>
+bool Grid::indicesAreInSameRow(const IndexSet& indices) const {
+    int rowIndex = -1;
+    for (auto index = indices.begin(); index != indices.end(); ++index) {
+        const int currentRowIndex = rowOfCellIndex(*index);
+        if (rowIndex == -1) {
+            rowIndex = currentRowIndex;
+        } else if (rowIndex != currentRowIndex) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename IndexSet>
+bool Grid::indicesAreInSameColumn(const IndexSet& indices) const {
+    int columnIndex = -1;
+    for (auto index = indices.begin(); index != indices.end(); ++index) {
+        const int currentColumnIndex = columnOfCellIndex(*index);
+        if (columnIndex == -1) {
+            columnIndex = currentColumnIndex;
+        } else if (columnIndex != currentColumnIndex) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename IndexSet>
+bool Grid::indicesAreInSameSubgrid(const IndexSet& indices) const {
+    int subgridRowIndex = -1;
+    int subgridColumnIndex = -1;
+    for (auto index = indices.begin(); index != indices.end(); ++index) {
+        const int currentRowIndex = rowOfCellIndex(*index);
+        const int currentColumnIndex = columnOfCellIndex(*index);
+        const int currentSubgridRow = currentRowIndex / _subSize;
+        const int currentSubgridColumn = currentColumnIndex / _subSize;
+        if (subgridRowIndex == -1) {
+            subgridRowIndex = currentSubgridRow;
+            subgridColumnIndex = currentSubgridColumn;
+        } else if (subgridRowIndex != currentSubgridRow || subgridColumnIndex != currentSubgridColumn) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename IndexSet>
+IndexSet Grid::rowSetOfCellIndices(const IndexSet& indices) const {
+    IndexSet result;
+    for (auto cellIndex = indices.begin(); cellIndex != indices.end(); ++cellIndex) {
+        result.insert(rowOfCellIndex(*cellIndex));
+    }
+    return result;
+}
+
+template <typename IndexSet>
+IndexSet Grid::columnSetOfCellIndices(const IndexSet& indices) const {
+    IndexSet result;
+    for (auto cellIndex = indices.begin(); cellIndex != indices.end(); ++cellIndex) {
+        result.insert(columnOfCellIndex(*cellIndex));
+    }
+    return result;
+}
+
 #endif /* Grid_hpp */
@@ -12,23 +12,93 @@
 
 #include "Grid.hpp"
 
+/**
+ Candidate removals over sets of cells. The set-taking methods are templates so that the technique passes can hand
+ in their scratch sets (see ScratchArena) as well as the grid's IntSets; they erase in the order the sets iterate,
+ which decides the order the candidate count index sees the changes in.
+ */
 class GridEditor {
     Grid& _grid;
 public:
     GridEditor(Grid& g);
 
-    bool removeCandidatesFromIndicesExcludingIndices(const IntSet& candidates, const IntSet& indices, const IntSet& excludeIndices);
+    template <typename CandidateSet, typename IndexSet, typename ExcludeSet>
+    bool removeCandidatesFromIndicesExcludingIndices(const CandidateSet& candidates, const IndexSet& indices, const ExcludeSet& excludeIndices);
 
-    bool removeCandidateFromIndices(const int candidate, const IntSet& indices);
-    bool removeCandidateFromIndicesExcludingIndices(const int candidate, const IntSet& indices, const IntSet& excludeIndices);
+    template <typename IndexSet>
+    bool removeCandidateFromIndices(const int candidate, const IndexSet& indices);
+    template <typename IndexSet, typename ExcludeSet>
+    bool removeCandidateFromIndicesExcludingIndices(const int candidate, const IndexSet& indices, const ExcludeSet& excludeIndices);
 
     bool removeCandidateFromRowOfCellIndexExcluding(const int candidate, const IntSet& excludeIndices, const int cellIndex);
     bool removeCandidateFromColumnOfCellIndexExcluding(const int candidate, const IntSet& excludeIndices, const int cellIndex);
     bool removeCandidateFromSubgridOfCellIndexExcluding(const int candidate, const IntSet& excludeIndices, const int cellIndex);
 
-    bool removeCandidatesFromIndicesThatAreNotInCandidateSet(const IntSet& indices, const IntSet& candidatesToKeep);
+    template <typename IndexSet, typename CandidateSet>
+    bool removeCandidatesFromIndicesThatAreNotInCandidateSet(const IndexSet& indices, const CandidateSet& candidatesToKeep);
 
-    void setCellValueAndUpdateCandidates(Cell& cell, const int candidate, const int cellIndex);
+    void setCellValueAndUpdateCandidates(const int candidate, const int cellIndex);
 };
 
+#pragma mark - Remove method
+
+template <typename CandidateSet, typename IndexSet, typename ExcludeSet>
+bool GridEditor::removeCandidatesFromIndicesExcludingIndices(const CandidateSet& candidates, const IndexSet& indices, const ExcludeSet& excludeIndices) {
+    bool anyErased = false;
+    for (auto index = indices.begin(); index != indices.end(); ++index) {
+        if (excludeIndices.find(*index) == excludeIndices.end()) {
+            for (auto candidate = candidates.begin(); candidate != candidates.end(); ++candidate) {
+                const int numberErased = _grid.eraseCellCandidate(*index, *candidate);
+                if (numberErased > 0) {
+                    anyErased = true;
+                }
+            }
+        }
+    }
+    return anyErased;
+}
+
+#pragma mark - Remove convenience
+
+template <typename IndexSet>
+bool GridEditor::removeCandidateFromIndices(const int candidate, const IndexSet& indices) {
+    bool anyErased = false;
+    for (auto index = indices.begin(); index != indices.end(); ++index) {
+        if (_grid.eraseCellCandidate(*index, candidate) > 0) {
+            anyErased = true;
+        }
+    }
+    return anyErased;
+}
+
+template <typename IndexSet, typename ExcludeSet>
+bool GridEditor::removeCandidateFromIndicesExcludingIndices(const int candidate, const IndexSet& indices, const ExcludeSet& excludeIndices) {
+    bool anyErased = false;
+    for (auto index = indices.begin(); index != indices.end(); ++index) {
+        if (excludeIndices.find(*index) == excludeIndices.end() && _grid.eraseCellCandidate(*index, candidate) > 0) {
+            anyErased = true;
+        }
+    }
+    return anyErased;
+}
+
+#pragma mark -
+
+template <typename IndexSet, typename CandidateSet>
+bool GridEditor::removeCandidatesFromIndicesThatAreNotInCandidateSet(const IndexSet& indices, const CandidateSet& candidatesToKeep) {
+    bool anyErased = false;
+    const int gridSize = _grid.getSize();
+    for (auto index = indices.begin(); index != indices.end(); ++index) {
+        for (int candidate = 1; candidate <= gridSize; candidate++) {
+            if (candidatesToKeep.find(candidate) == candidatesToKeep.end()) {
+                int numberErased = _grid.eraseCellCandidate(*index, candidate);
+                if (numberErased > 0) {
+                    anyErased = true;
+                }
+            }
+        }
+    }
+    return anyErased;
+}
+
 #endif /* GridEditor_hpp */
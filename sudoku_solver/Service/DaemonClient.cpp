@@ -0,0 +1,94 @@
+//
+//  DaemonClient.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "DaemonClient.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "DaemonProtocol.hpp"
+
+DaemonClient::DaemonClient() : _fd(-1) {}
+
+DaemonClient::~DaemonClient() {
+    disconnect();
+}
+
+bool DaemonClient::connectTo(const std::string& socketPath) {
+    disconnect();
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        _lastError = "socket path too long";
+        return false;
+    }
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    _fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (_fd < 0 || connect(_fd, (sockaddr*)&address, sizeof(address)) < 0) {
+        _lastError = strerror(errno);
+        disconnect();
+        return false;
+    }
+#ifdef SO_NOSIGPIPE
+    const int noSignal = 1;
+    setsockopt(_fd, SOL_SOCKET, SO_NOSIGPIPE, &noSignal, sizeof(noSignal));
+#endif
+    return true;
+}
+
+void DaemonClient::disconnect() {
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+}
+
+const std::string& DaemonClient::getLastError() const {
+    return _lastError;
+}
+
+// sends one request and reads the answer, which has to be of the expected type
+static bool exchange(const int fd, const MessageType type, const std::string& body, const MessageType expected, std::string& answer, std::string& error) {
+    MessageType answerType;
+    if (fd < 0 || !writeFrame(fd, type, body) || !readFrame(fd, answerType, answer)) {
+        error = "connection lost";
+        return false;
+    }
+    if (answerType != expected) {
+        error = answerType == MessageType::Error ? answer : "unexpected answer";
+        return false;
+    }
+    return true;
+}
+
+bool DaemonClient::solve(const std::string& puzzle, SolveStatus& status, std::string& solution) {
+    std::string answer;
+    if (!exchange(_fd, MessageType::Solve, puzzle, MessageType::SolveResult, answer, _lastError)) {
+        return false;
+    }
+    if (answer.empty()) {
+        _lastError = "empty answer";
+        return false;
+    }
+    status = (SolveStatus)answer[0];
+    solution = answer.substr(1);
+    return true;
+}
+
+bool DaemonClient::requestStatistics(std::string& text) {
+    return exchange(_fd, MessageType::Stats, "", MessageType::Stats, text, _lastError);
+}
+
+bool DaemonClient::requestShutdown() {
+    std::string answer;
+    return exchange(_fd, MessageType::Shutdown, "", MessageType::Shutdown, answer, _lastError);
+}
@@ -0,0 +1,41 @@
+//
+//  DaemonClient.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef DaemonClient_hpp
+#define DaemonClient_hpp
+
+#include <string>
+
+#include "SolveMonitor.hpp"
+
+/**
+ One connection to a SolveDaemon. Requests are synchronous: each call sends one frame and waits for the answer.
+ Every call returns false once the connection is gone (or the daemon answered with an Error frame).
+ */
+class DaemonClient {
+    int _fd;
+    std::string _lastError;
+
+public:
+    DaemonClient();
+    ~DaemonClient();
+
+    DaemonClient(const DaemonClient&) = delete;
+    DaemonClient& operator=(const DaemonClient&) = delete;
+
+    bool connectTo(const std::string& socketPath);
+    void disconnect();
+
+    // puzzle and solution in compactPrint format
+    bool solve(const std::string& puzzle, SolveStatus& status, std::string& solution);
+    bool requestStatistics(std::string& text);
+    bool requestShutdown();
+
+    const std::string& getLastError() const;
+};
+
+#endif /* DaemonClient_hpp */
@@ -0,0 +1,81 @@
+//
+//  DaemonProtocol.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "DaemonProtocol.hpp"
+
+#include <cerrno>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static bool writeAll(const int fd, const char* data, size_t length) {
+    while (length > 0) {
+        // MSG_NOSIGNAL isn't everywhere; where it's missing SIGPIPE has to be ignored by the caller
+#ifdef MSG_NOSIGNAL
+        const ssize_t written = send(fd, data, length, MSG_NOSIGNAL);
+#else
+        const ssize_t written = write(fd, data, length);
+#endif
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+static bool readAll(const int fd, char* data, size_t length) {
+    while (length > 0) {
+        const ssize_t count = read(fd, data, length);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        data += count;
+        length -= count;
+    }
+    return true;
+}
+
+bool writeFrame(const int fd, const MessageType type, const std::string& body) {
+    const uint32_t length = (uint32_t)body.size() + 1;
+    if (length > kMaxFrameSize) {
+        return false;
+    }
+    // one write for the header, type and body keeps small messages in a single segment
+    std::string frame;
+    frame.reserve(4 + length);
+    for (int shift = 0; shift < 32; shift += 8) {
+        frame.push_back((char)((length >> shift) & 0xff));
+    }
+    frame.push_back((char)type);
+    frame += body;
+    return writeAll(fd, frame.data(), frame.size());
+}
+
+bool readFrame(const int fd, MessageType& type, std::string& body) {
+    unsigned char header[4];
+    if (!readAll(fd, (char*)header, sizeof(header))) {
+        return false;
+    }
+    const uint32_t length = header[0] | (header[1] << 8) | (header[2] << 16) | ((uint32_t)header[3] << 24);
+    if (length == 0 || length > kMaxFrameSize) {
+        return false;
+    }
+    char typeByte;
+    if (!readAll(fd, &typeByte, 1)) {
+        return false;
+    }
+    type = (MessageType)typeByte;
+    body.resize(length - 1);
+    return length == 1 || readAll(fd, &body[0], length - 1);
+}
@@ -0,0 +1,41 @@
+//
+//  DaemonProtocol.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef DaemonProtocol_hpp
+#define DaemonProtocol_hpp
+
+#include <cstdint>
+#include <string>
+
+/**
+ Wire format shared by SolveDaemon and DaemonClient over a Unix domain stream socket.
+
+ Every message is a frame: a 4-byte little endian length, then that many bytes of payload. The payload's first
+ byte is the message type and the rest is its body:
+
+ - Solve: body is the puzzle in compactPrint format; the answer is a SolveResult whose body is one status byte
+   (SolveStatus) followed by the grid in compactPrint format (the puzzle itself when unsolved);
+ - Stats: empty body; the answer is a Stats message with "name value" lines;
+ - Shutdown: empty body; the daemon answers with an empty Shutdown message and stops accepting connections;
+ - Error: sent back for a malformed request, body is the reason.
+ */
+enum class MessageType : uint8_t {
+    Solve = 1,
+    SolveResult = 2,
+    Stats = 3,
+    Shutdown = 4,
+    Error = 5
+};
+
+// larger frames are rejected before anything is allocated for them
+static const uint32_t kMaxFrameSize = 1 << 20;
+
+// both retry on EINTR and partial transfers; false on error or end of stream
+bool writeFrame(const int fd, const MessageType type, const std::string& body);
+bool readFrame(const int fd, MessageType& type, std::string& body);
+
+#endif /* DaemonProtocol_hpp */
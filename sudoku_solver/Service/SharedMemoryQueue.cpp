@@ -0,0 +1,428 @@
+//
+//  SharedMemoryQueue.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "SharedMemoryQueue.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "the rings need address-free atomics");
+
+static const uint32_t kMagic = 0x5355444b;     // "SUDK"
+static const uint32_t kVersion = 1;
+static const size_t kCacheLineBytes = 64;
+// a sleeping take wakes at least this often, so it notices a closed queue even if the wake-up was missed (a producer
+// that died between pushing and waking, say)
+static const int kWaitSliceMicroseconds = 100000;
+#ifndef __linux__
+// without futexes, how long a waiting take sleeps between looks
+static const int kPollMicroseconds = 200;
+#endif
+// how long attach waits for a segment that is still being set up
+static const int kAttachTimeoutMilliseconds = 1000;
+
+enum RingIndex {
+    kFreeRing,
+    kSubmittedRing,
+    kCompletedRing
+};
+
+struct SharedMemoryQueue::Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t maxGridSize;
+    uint64_t ringBytes;
+    uint64_t recordStride;
+    uint64_t totalBytes;
+    std::atomic<uint32_t> ready;
+    std::atomic<uint32_t> closed;
+};
+
+/**
+ One bounded MPMC queue of slot indices. Each cell's sequence says whose turn it is: equal to a position, the cell
+ is free for the push that claims that position; one past it, it holds the value for the pop that claims it. The
+ cells follow the struct in the segment.
+ */
+struct SharedMemoryQueue::Ring {
+    struct Cell {
+        std::atomic<uint64_t> sequence;
+        uint32_t slot;
+    };
+
+    alignas(kCacheLineBytes) std::atomic<uint64_t> enqueuePosition;
+    alignas(kCacheLineBytes) std::atomic<uint64_t> dequeuePosition;
+    // bumped by every push; the futex that waiting takes sleep on
+    alignas(kCacheLineBytes) std::atomic<uint32_t> event;
+    std::atomic<uint32_t> waiterCount;
+    uint64_t mask;
+
+    Cell* cells() {
+        return reinterpret_cast<Cell*>(this + 1);
+    }
+};
+
+static size_t roundUp(const size_t bytes, const size_t alignment) {
+    return (bytes + alignment - 1) / alignment * alignment;
+}
+
+static uint32_t roundUpToPowerOfTwo(const uint32_t count) {
+    uint32_t result = 1;
+    while (result < count) {
+        result <<= 1;
+    }
+    return result;
+}
+
+static size_t headerBytes() {
+    return roundUp(sizeof(SharedMemoryQueue::Header), kCacheLineBytes);
+}
+
+static size_t ringBytes(const uint32_t slotCount) {
+    return roundUp(sizeof(SharedMemoryQueue::Ring) + slotCount * sizeof(SharedMemoryQueue::Ring::Cell), kCacheLineBytes);
+}
+
+static size_t recordStride(const int maxGridSize) {
+    return roundUp(sizeof(SlotRecord) + maxGridSize * maxGridSize, sizeof(uint64_t));
+}
+
+#pragma mark - Waiting
+
+static void wakeWaiters(std::atomic<uint32_t>& event, const int count) {
+#ifdef __linux__
+    // not FUTEX_PRIVATE_FLAG: the waiters are in other processes
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&event), FUTEX_WAKE, count, nullptr, nullptr, 0);
+#else
+    (void)event;
+    (void)count;
+#endif
+}
+
+// returns after a wake-up, when the event no longer holds seen, or after about microseconds
+static void waitForEvent(std::atomic<uint32_t>& event, const uint32_t seen, const int microseconds) {
+#ifdef __linux__
+    timespec timeout;
+    timeout.tv_sec = microseconds / 1000000;
+    timeout.tv_nsec = (microseconds % 1000000) * 1000;
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&event), FUTEX_WAIT, seen, &timeout, nullptr, 0);
+#else
+    if (event.load() == seen) {
+        std::this_thread::sleep_for(std::chrono::microseconds(std::min(microseconds, kPollMicroseconds)));
+    }
+#endif
+}
+
+static inline void spinPause() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+#pragma mark - Segment
+
+SharedMemoryQueue::SharedMemoryQueue() : _owner(false), _memory(nullptr), _mappedSize(0), _header(nullptr), _rings{nullptr, nullptr, nullptr}, _slots(nullptr) {}
+
+SharedMemoryQueue::~SharedMemoryQueue() {
+    detach();
+}
+
+bool SharedMemoryQueue::_map(const int fd, const size_t size) {
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        _lastError = std::string("mmap: ") + strerror(errno);
+        return false;
+    }
+    _memory = memory;
+    _mappedSize = size;
+    _header = static_cast<Header*>(memory);
+    return true;
+}
+
+void SharedMemoryQueue::_locate() {
+    char* base = static_cast<char*>(_memory) + headerBytes();
+    for (int ring = 0; ring < 3; ring++) {
+        _rings[ring] = reinterpret_cast<Ring*>(base + ring * _header->ringBytes);
+    }
+    _slots = base + 3 * _header->ringBytes;
+}
+
+bool SharedMemoryQueue::create(const std::string& name, const SharedMemoryOptions options) {
+    detach();
+    if (options.maxGridSize < 1 || options.slotCount < 1 || options.slotCount > (1u << 24)) {
+        _lastError = "invalid slot count or grid size";
+        return false;
+    }
+    const uint32_t slotCount = roundUpToPowerOfTwo(options.slotCount);
+    const size_t ringSize = ringBytes(slotCount);
+    const size_t stride = recordStride(options.maxGridSize);
+    const size_t totalBytes = headerBytes() + 3 * ringSize + slotCount * stride;
+
+    const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        _lastError = "shm_open " + name + ": " + strerror(errno);
+        return false;
+    }
+    if (ftruncate(fd, totalBytes) != 0) {
+        _lastError = std::string("ftruncate: ") + strerror(errno);
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    if (!_map(fd, totalBytes)) {
+        shm_unlink(name.c_str());
+        return false;
+    }
+    _name = name;
+    _owner = true;
+
+    // the segment starts zeroed, so ready stays 0 until everything below is in place
+    _header = new (_memory) Header();
+    _header->magic = kMagic;
+    _header->version = kVersion;
+    _header->slotCount = slotCount;
+    _header->maxGridSize = options.maxGridSize;
+    _header->ringBytes = ringSize;
+    _header->recordStride = stride;
+    _header->totalBytes = totalBytes;
+    _header->closed.store(0);
+    _locate();
+    for (int index = 0; index < 3; index++) {
+        Ring* ring = new (_rings[index]) Ring();
+        ring->enqueuePosition.store(0);
+        ring->dequeuePosition.store(0);
+        ring->event.store(0);
+        ring->waiterCount.store(0);
+        ring->mask = slotCount - 1;
+        Ring::Cell* cells = ring->cells();
+        for (uint32_t cell = 0; cell < slotCount; cell++) {
+            new (&cells[cell]) Ring::Cell();
+            cells[cell].sequence.store(cell);
+        }
+    }
+    for (uint32_t slot = 0; slot < slotCount; slot++) {
+        _push(*_rings[kFreeRing], slot);
+    }
+    _header->ready.store(1, std::memory_order_release);
+    return true;
+}
+
+bool SharedMemoryQueue::attach(const std::string& name) {
+    detach();
+    const int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        _lastError = "shm_open " + name + ": " + strerror(errno);
+        return false;
+    }
+    // the creator may still be between shm_open and ftruncate
+    struct stat status;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kAttachTimeoutMilliseconds);
+    while (fstat(fd, &status) == 0 && (size_t)status.st_size < headerBytes() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if ((size_t)status.st_size < headerBytes()) {
+        _lastError = name + " is not a solver queue";
+        ::close(fd);
+        return false;
+    }
+    if (!_map(fd, status.st_size)) {
+        return false;
+    }
+    _name = name;
+    while (_header->ready.load(std::memory_order_acquire) == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (_header->ready.load(std::memory_order_acquire) == 0 || _header->magic != kMagic || _header->version != kVersion || _header->totalBytes != _mappedSize) {
+        _lastError = name + " is not a solver queue of this version";
+        detach();
+        return false;
+    }
+    _locate();
+    return true;
+}
+
+void SharedMemoryQueue::detach() {
+    if (_memory != nullptr) {
+        munmap(_memory, _mappedSize);
+    }
+    if (_owner) {
+        shm_unlink(_name.c_str());
+    }
+    _owner = false;
+    _memory = nullptr;
+    _mappedSize = 0;
+    _header = nullptr;
+    _rings[0] = _rings[1] = _rings[2] = nullptr;
+    _slots = nullptr;
+}
+
+uint32_t SharedMemoryQueue::getSlotCount() const {
+    return _header->slotCount;
+}
+
+int SharedMemoryQueue::getMaxGridSize() const {
+    return _header->maxGridSize;
+}
+
+SlotRecord& SharedMemoryQueue::recordOfSlot(const uint32_t slot) {
+    return *reinterpret_cast<SlotRecord*>(_slots + slot * _header->recordStride);
+}
+
+char* SharedMemoryQueue::cellsOfSlot(const uint32_t slot) {
+    return _slots + slot * _header->recordStride + sizeof(SlotRecord);
+}
+
+const std::string& SharedMemoryQueue::getLastError() const {
+    return _lastError;
+}
+
+#pragma mark - Rings
+
+// every ring has a cell for every slot, so a push always finds room
+void SharedMemoryQueue::_push(Ring& ring, const uint32_t slot) {
+    Ring::Cell* cells = ring.cells();
+    uint64_t position = ring.enqueuePosition.load(std::memory_order_relaxed);
+    Ring::Cell* cell;
+    while (true) {
+        cell = &cells[position & ring.mask];
+        const int64_t difference = (int64_t)cell->sequence.load(std::memory_order_acquire) - (int64_t)position;
+        if (difference == 0) {
+            if (ring.enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            // a pop that claimed this cell hasn't finished reading it yet
+            spinPause();
+            position = ring.enqueuePosition.load(std::memory_order_relaxed);
+        } else {
+            position = ring.enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+    cell->slot = slot;
+    cell->sequence.store(position + 1, std::memory_order_release);
+
+    ring.event.fetch_add(1);
+    if (ring.waiterCount.load() > 0) {
+        wakeWaiters(ring.event, 1);
+    }
+}
+
+bool SharedMemoryQueue::_pop(Ring& ring, uint32_t& slot) {
+    Ring::Cell* cells = ring.cells();
+    uint64_t position = ring.dequeuePosition.load(std::memory_order_relaxed);
+    Ring::Cell* cell;
+    while (true) {
+        cell = &cells[position & ring.mask];
+        const int64_t difference = (int64_t)cell->sequence.load(std::memory_order_acquire) - (int64_t)(position + 1);
+        if (difference == 0) {
+            if (ring.dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            return false;
+        } else {
+            position = ring.dequeuePosition.load(std::memory_order_relaxed);
+        }
+    }
+    slot = cell->slot;
+    cell->sequence.store(position + ring.mask + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ A waiter registers before it reads the event and looks once more, and a push bumps the event before it checks for
+ waiters, so either the push sees the waiter and wakes it or the waiter's last look sees the push.
+ */
+bool SharedMemoryQueue::_take(Ring& ring, uint32_t& slot, const int timeoutMicroseconds, const int spinCount) {
+    if (_pop(ring, slot)) {
+        return true;
+    }
+    for (int spin = 0; spin < spinCount; spin++) {
+        spinPause();
+        if (_pop(ring, slot)) {
+            return true;
+        }
+    }
+    auto start = std::chrono::steady_clock::now();
+    while (true) {
+        if (timeoutMicroseconds == 0 || _header->closed.load() != 0) {
+            return _pop(ring, slot);
+        }
+        int waitMicroseconds = kWaitSliceMicroseconds;
+        if (timeoutMicroseconds > 0) {
+            const long elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+            if (elapsed >= timeoutMicroseconds) {
+                return _pop(ring, slot);
+            }
+            waitMicroseconds = std::min(waitMicroseconds, (int)(timeoutMicroseconds - elapsed));
+        }
+
+        ring.waiterCount.fetch_add(1);
+        const uint32_t seen = ring.event.load();
+        const bool found = _pop(ring, slot);
+        if (!found) {
+            waitForEvent(ring.event, seen, waitMicroseconds);
+        }
+        ring.waiterCount.fetch_sub(1);
+        if (found || _pop(ring, slot)) {
+            return true;
+        }
+    }
+}
+
+bool SharedMemoryQueue::acquireFreeSlot(uint32_t& slot, const int timeoutMicroseconds, const int spinCount) {
+    return _take(*_rings[kFreeRing], slot, timeoutMicroseconds, spinCount);
+}
+
+void SharedMemoryQueue::submit(const uint32_t slot) {
+    _push(*_rings[kSubmittedRing], slot);
+}
+
+bool SharedMemoryQueue::takeSubmitted(uint32_t& slot, const int timeoutMicroseconds, const int spinCount) {
+    return _take(*_rings[kSubmittedRing], slot, timeoutMicroseconds, spinCount);
+}
+
+void SharedMemoryQueue::complete(const uint32_t slot) {
+    _push(*_rings[kCompletedRing], slot);
+}
+
+bool SharedMemoryQueue::takeCompleted(uint32_t& slot, const int timeoutMicroseconds, const int spinCount) {
+    return _take(*_rings[kCompletedRing], slot, timeoutMicroseconds, spinCount);
+}
+
+void SharedMemoryQueue::release(const uint32_t slot) {
+    _push(*_rings[kFreeRing], slot);
+}
+
+void SharedMemoryQueue::close() {
+    _header->closed.store(1);
+    for (int index = 0; index < 3; index++) {
+        _rings[index]->event.fetch_add(1);
+        wakeWaiters(_rings[index]->event, INT_MAX);
+    }
+}
+
+bool SharedMemoryQueue::isClosed() const {
+    return _header->closed.load() != 0;
+}
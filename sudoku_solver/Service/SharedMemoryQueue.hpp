@@ -0,0 +1,108 @@
+//
+//  SharedMemoryQueue.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef SharedMemoryQueue_hpp
+#define SharedMemoryQueue_hpp
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct SharedMemoryOptions {
+    // rounded up to a power of two
+    uint32_t slotCount = 1024;
+    // records hold grids up to this size
+    int maxGridSize = 9;
+};
+
+// the fixed part of a slot; the grid's cells follow it (see SharedMemoryQueue::cellsOfSlot)
+struct SlotRecord {
+    uint64_t tag;       // the producer's, handed back untouched
+    uint32_t size;      // grid size; the cells are size * size compactPrint characters
+    uint8_t status;     // SolveStatus, written by the solver
+    uint8_t reserved[3];
+};
+
+/**
+ Transport between co-located processes over a POSIX shared memory segment, so that puzzles and solutions are
+ neither serialized into frames nor copied through the kernel.
+
+ The segment holds a fixed number of slots, each a SlotRecord followed by room for one grid, and three rings of
+ slot indices: free, submitted and completed. A producer takes a free slot, writes the puzzle into it and submits
+ it; the solver takes submitted slots, overwrites the puzzle with the solution in place and completes them; the
+ producer takes completed slots, reads them and frees them. Every slot index is in exactly one ring or held by one
+ party, so a ring never fills up.
+
+ The rings are bounded multi-producer multi-consumer queues (a sequence number per cell, positions claimed with
+ compare-and-swap), so any number of producer and solver threads, in any number of processes, can share them
+ without locks; one producer and one solver is just the uncontended case. A take can spin for a while and then
+ sleep on a futex that every push bumps (Linux; elsewhere it sleeps in short intervals). Pushes only make the
+ wake-up call when someone is waiting.
+
+ The solver side creates the segment and unlinks it when it is done; producers attach to it by name. Completions
+ go to whoever takes them, so producers that share a queue also share the collecting (the tag says whose a record
+ is); separate producer processes are simplest with a queue each.
+ */
+class SharedMemoryQueue {
+public:
+    struct Ring;
+    struct Header;
+
+private:
+    std::string _name;
+    bool _owner;
+    void* _memory;
+    size_t _mappedSize;
+    Header* _header;
+    Ring* _rings[3];
+    char* _slots;
+    std::string _lastError;
+
+    bool _map(const int fd, const size_t size);
+    void _locate();
+
+    static void _push(Ring& ring, const uint32_t slot);
+    static bool _pop(Ring& ring, uint32_t& slot);
+    bool _take(Ring& ring, uint32_t& slot, const int timeoutMicroseconds, const int spinCount);
+
+public:
+    SharedMemoryQueue();
+    ~SharedMemoryQueue();
+
+    SharedMemoryQueue(const SharedMemoryQueue&) = delete;
+    SharedMemoryQueue& operator=(const SharedMemoryQueue&) = delete;
+
+    // name as for shm_open ("/sudoku"); create fails when a segment of that name exists
+    bool create(const std::string& name, const SharedMemoryOptions options);
+    bool attach(const std::string& name);
+    // unmaps, and unlinks the segment when this side created it
+    void detach();
+
+    uint32_t getSlotCount() const;
+    int getMaxGridSize() const;
+    SlotRecord& recordOfSlot(const uint32_t slot);
+    char* cellsOfSlot(const uint32_t slot);
+
+    // the takes wait up to timeoutMicroseconds (0 only looks, negative waits until something arrives or the queue
+    // closes), spinning spinCount times before they sleep; false when nothing came
+    bool acquireFreeSlot(uint32_t& slot, const int timeoutMicroseconds, const int spinCount);
+    void submit(const uint32_t slot);
+    bool takeSubmitted(uint32_t& slot, const int timeoutMicroseconds, const int spinCount);
+    void complete(const uint32_t slot);
+    bool takeCompleted(uint32_t& slot, const int timeoutMicroseconds, const int spinCount);
+    void release(const uint32_t slot);
+
+    // wakes everyone waiting; from then on a take gives up as soon as its ring is empty, so the solvers stop once
+    // the submitted slots are done
+    void close();
+    bool isClosed() const;
+
+    const std::string& getLastError() const;
+};
+
+#endif /* SharedMemoryQueue_hpp */
@@ -0,0 +1,96 @@
+//
+//  SharedMemoryServer.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "SharedMemoryServer.hpp"
+
+#include <algorithm>
+
+#include "Solver.hpp"
+
+SharedMemoryServer::SharedMemoryServer(SharedMemoryQueue& queue, ThreadPool& pool, const int spinCount) : _queue(queue), _pool(pool), _spinCount(std::max(0, spinCount)) {
+    _contexts.resize(_pool.getThreadCount());
+}
+
+void SharedMemoryServer::run() {
+    _pool.runOnEachWorker([&](const int workerIndex) {
+        _workerLoop(_contexts[workerIndex]);
+    });
+}
+
+SharedMemoryServerStatistics SharedMemoryServer::getStatistics() const {
+    SharedMemoryServerStatistics statistics;
+    for (auto context = _contexts.begin(); context != _contexts.end(); ++context) {
+        statistics.add(context->statistics);
+    }
+    return statistics;
+}
+
+void SharedMemoryServer::_workerLoop(WorkerContext& context) {
+    uint32_t slots[LaneSolver::kLaneCount];
+    uint32_t slot;
+    while (_queue.takeSubmitted(slot, -1, _spinCount)) {
+        int laneCount = 0;
+        do {
+            SlotRecord& record = _queue.recordOfSlot(slot);
+            context.statistics.requestCount += 1;
+            if (!_isValidRequest(record)) {
+                context.statistics.invalidRequestCount += 1;
+                record.status = (uint8_t)SolveStatus::NoSolution;
+                _queue.complete(slot);
+            } else if (LaneSolver::supportsSize(record.size)) {
+                slots[laneCount++] = slot;
+            } else {
+                _solveOne(context, slot);
+            }
+        } while (laneCount < LaneSolver::kLaneCount && _queue.takeSubmitted(slot, 0, 0));
+
+        if (laneCount > 0) {
+            _solveLanes(context, slots, laneCount);
+        }
+    }
+}
+
+bool SharedMemoryServer::_isValidRequest(const SlotRecord& record) const {
+    // a queue created elsewhere may allow records larger than Grid can build
+    const int size = record.size;
+    return size <= _queue.getMaxGridSize() && Grid::supportsSize(size);
+}
+
+void SharedMemoryServer::_solveLanes(WorkerContext& context, const uint32_t* slots, const int count) {
+    if (context.laneGrids.empty()) {
+        context.laneGrids.assign(LaneSolver::kLaneCount, Grid(9));
+    }
+    SolveStatus statuses[LaneSolver::kLaneCount];
+    for (int i = 0; i < count; i++) {
+        context.laneGrids[i].loadCompactCharacters(_queue.cellsOfSlot(slots[i]), 81);
+    }
+    LaneSolver::solveBatch(context.laneGrids.data(), count, statuses, context.statistics.laneStatistics);
+    for (int i = 0; i < count; i++) {
+        context.laneGrids[i].compactPrintTo(_queue.cellsOfSlot(slots[i]));
+        _queue.recordOfSlot(slots[i]).status = (uint8_t)statuses[i];
+        context.statistics.solvedCount += statuses[i] == SolveStatus::Solved;
+        _queue.complete(slots[i]);
+    }
+}
+
+void SharedMemoryServer::_solveOne(WorkerContext& context, const uint32_t slot) {
+    SlotRecord& record = _queue.recordOfSlot(slot);
+    const int size = record.size;
+    auto found = context.grids.find(size);
+    if (found == context.grids.end()) {
+        found = context.grids.insert(std::make_pair(size, Grid(size))).first;
+    }
+    Grid& grid = found->second;
+    grid.loadCompactCharacters(_queue.cellsOfSlot(slot), size * size);
+    Solver solver(grid);
+    solver.setVerbose(false);
+    const SolveStatus status = solver.solve().status;
+    grid.compactPrintTo(_queue.cellsOfSlot(slot));
+    record.status = (uint8_t)status;
+    context.statistics.solvedCount += status == SolveStatus::Solved;
+    _queue.complete(slot);
+}
@@ -0,0 +1,68 @@
+//
+//  SharedMemoryServer.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef SharedMemoryServer_hpp
+#define SharedMemoryServer_hpp
+
+#include <map>
+#include <vector>
+
+#include "Grid.hpp"
+#include "LaneSolver.hpp"
+#include "SharedMemoryQueue.hpp"
+#include "ThreadPool.hpp"
+
+struct SharedMemoryServerStatistics {
+    long requestCount = 0;
+    long invalidRequestCount = 0;   // sizes that aren't squares or don't fit the records
+    long solvedCount = 0;
+    LaneStatistics laneStatistics;
+
+    void add(const SharedMemoryServerStatistics& other) {
+        requestCount += other.requestCount;
+        invalidRequestCount += other.invalidRequestCount;
+        solvedCount += other.solvedCount;
+        laneStatistics.add(other.laneStatistics);
+    }
+};
+
+/**
+ Solves the puzzles submitted to a SharedMemoryQueue until it is closed.
+
+ Every pool worker waits on the submitted ring itself; once it has one puzzle it takes whatever else is already
+ there, up to LaneSolver::kLaneCount, so 9x9 puzzles are solved in lanes as soon as the load allows it and a lone
+ puzzle doesn't wait for company. Puzzles are loaded straight from their slots into the worker's warm grids and the
+ solutions are written back over them, as SolveDaemon does with its requests.
+ */
+class SharedMemoryServer {
+    struct WorkerContext {
+        std::map<int, Grid> grids;      // by size, reused for every puzzle of that size
+        GridVector laneGrids;
+        SharedMemoryServerStatistics statistics;
+    };
+
+    SharedMemoryQueue& _queue;
+    ThreadPool& _pool;
+    int _spinCount;
+    std::vector<WorkerContext> _contexts;
+
+    void _workerLoop(WorkerContext& context);
+    bool _isValidRequest(const SlotRecord& record) const;
+    void _solveLanes(WorkerContext& context, const uint32_t* slots, const int count);
+    void _solveOne(WorkerContext& context, const uint32_t slot);
+
+public:
+    // spinCount: how many times a worker looks at the ring before it goes to sleep on it
+    SharedMemoryServer(SharedMemoryQueue& queue, ThreadPool& pool, const int spinCount);
+
+    // blocks until the queue is closed and every submitted puzzle has been completed
+    void run();
+
+    SharedMemoryServerStatistics getStatistics() const;
+};
+
+#endif /* SharedMemoryServer_hpp */
@@ -0,0 +1,284 @@
+//
+//  SolveDaemon.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "SolveDaemon.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "DaemonProtocol.hpp"
+#include "Solver.hpp"
+
+// how often the accept loop checks for a stop request
+static const int kAcceptPollMilliseconds = 100;
+
+SolveDaemon::SolveDaemon(const std::string socketPath, ThreadPool& pool, const DaemonOptions options) : _socketPath(socketPath), _pool(pool), _options(options), _listenFd(-1), _stopping(false), _batcherStopping(false), _activeConnectionCount(0) {
+    _options.maxBatchSize = std::max(1, _options.maxBatchSize);
+    _options.batchDelayMicroseconds = std::max(0, _options.batchDelayMicroseconds);
+    _contexts.resize(_pool.getThreadCount());
+}
+
+SolveDaemon::~SolveDaemon() {
+    if (_listenFd >= 0) {
+        close(_listenFd);
+    }
+}
+
+void SolveDaemon::stop() {
+    _stopping = true;
+}
+
+#pragma mark - Connections
+
+bool SolveDaemon::run() {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (_socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "socket path too long: " << _socketPath << std::endl;
+        return false;
+    }
+    strncpy(address.sun_path, _socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    _listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (_listenFd < 0) {
+        std::cerr << "socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+    unlink(_socketPath.c_str());
+    if (bind(_listenFd, (sockaddr*)&address, sizeof(address)) < 0 || listen(_listenFd, SOMAXCONN) < 0) {
+        std::cerr << "unable to listen on " << _socketPath << ": " << strerror(errno) << std::endl;
+        close(_listenFd);
+        _listenFd = -1;
+        return false;
+    }
+    _startTime = std::chrono::steady_clock::now();
+
+    std::thread batcher(&SolveDaemon::_batchLoop, this);
+
+    while (!_stopping) {
+        pollfd listenPoll = {_listenFd, POLLIN, 0};
+        if (poll(&listenPoll, 1, kAcceptPollMilliseconds) <= 0) {
+            continue;
+        }
+        const int fd = accept(_listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+#ifdef SO_NOSIGPIPE
+        const int noSignal = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &noSignal, sizeof(noSignal));
+#endif
+        {
+            std::lock_guard<std::mutex> lock(_connectionMutex);
+            _connectionFds.insert(fd);
+            _activeConnectionCount += 1;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _statistics.connectionCount += 1;
+        }
+        std::thread(&SolveDaemon::_serveConnection, this, fd).detach();
+    }
+
+    close(_listenFd);
+    _listenFd = -1;
+    unlink(_socketPath.c_str());
+
+    // wakes connection threads blocked reading from clients that are still connected
+    {
+        std::unique_lock<std::mutex> lock(_connectionMutex);
+        for (auto fd = _connectionFds.begin(); fd != _connectionFds.end(); ++fd) {
+            shutdown(*fd, SHUT_RDWR);
+        }
+        _connectionClosed.wait(lock, [&] { return _activeConnectionCount == 0; });
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _batcherStopping = true;
+        _requestQueued.notify_all();
+    }
+    batcher.join();
+    return true;
+}
+
+void SolveDaemon::_serveConnection(const int fd) {
+    MessageType type;
+    std::string body;
+    while (readFrame(fd, type, body)) {
+        bool written = false;
+        switch (type) {
+            case MessageType::Solve: {
+                // compactStringSize also turns down sizes over Grid's limit, whose grids can't be built
+                if (Grid::compactStringSize(body) == 0) {
+                    {
+                        std::lock_guard<std::mutex> lock(_mutex);
+                        _statistics.invalidRequestCount += 1;
+                    }
+                    written = writeFrame(fd, MessageType::Error, "invalid puzzle length " + std::to_string(body.length()) + ", expected a square grid up to 64x64");
+                    break;
+                }
+                PendingSolve request;
+                request.puzzle = body;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _queue.push_back(&request);
+                    _statistics.requestCount += 1;
+                    _requestQueued.notify_all();
+                    _requestsDone.wait(lock, [&] { return request.done; });
+                }
+                written = writeFrame(fd, MessageType::SolveResult, std::string(1, (char)request.status) + request.solution);
+                break;
+            }
+            case MessageType::Stats:
+                written = writeFrame(fd, MessageType::Stats, _statisticsText());
+                break;
+            case MessageType::Shutdown:
+                written = writeFrame(fd, MessageType::Shutdown, "");
+                stop();
+                break;
+            default:
+                written = writeFrame(fd, MessageType::Error, "unknown message type");
+                break;
+        }
+        if (!written) {
+            break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_connectionMutex);
+    close(fd);
+    _connectionFds.erase(fd);
+    _activeConnectionCount -= 1;
+    // notified under the lock, so run can't return (and destroy this daemon) before this thread is done with it
+    _connectionClosed.notify_all();
+}
+
+#pragma mark - Batches
+
+void SolveDaemon::_batchLoop() {
+    while (true) {
+        std::vector<PendingSolve*> batch;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _requestQueued.wait(lock, [&] { return _batcherStopping || !_queue.empty(); });
+            if (_queue.empty()) {
+                return;
+            }
+            if ((int)_queue.size() < _options.maxBatchSize && _options.batchDelayMicroseconds > 0) {
+                _requestQueued.wait_for(lock, std::chrono::microseconds(_options.batchDelayMicroseconds), [&] {
+                    return _batcherStopping || (int)_queue.size() >= _options.maxBatchSize;
+                });
+            }
+            const size_t count = std::min(_queue.size(), (size_t)_options.maxBatchSize);
+            batch.assign(_queue.begin(), _queue.begin() + count);
+            _queue.erase(_queue.begin(), _queue.begin() + count);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        _solveBatch(batch);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto request = batch.begin(); request != batch.end(); ++request) {
+            (*request)->done = true;
+            _statistics.solvedCount += (*request)->status == SolveStatus::Solved;
+        }
+        _statistics.batchCount += 1;
+        _statistics.largestBatch = std::max(_statistics.largestBatch, (long)batch.size());
+        _statistics.solveSeconds += elapsed.count();
+        for (auto context = _contexts.begin(); context != _contexts.end(); ++context) {
+            _statistics.laneStatistics.add(context->laneStatistics);
+            context->laneStatistics = LaneStatistics();
+        }
+        _requestsDone.notify_all();
+    }
+}
+
+void SolveDaemon::_solveBatch(std::vector<PendingSolve*>& batch) {
+    std::vector<PendingSolve*> lanes;
+    std::vector<PendingSolve*> others;
+    for (auto request = batch.begin(); request != batch.end(); ++request) {
+        (LaneSolver::supportsSize(Grid::compactStringSize((*request)->puzzle)) ? lanes : others).push_back(*request);
+    }
+
+    SolveLimits limits;
+    if (_options.requestTimeoutSeconds > 0) {
+        limits.setTimeout(_options.requestTimeoutSeconds);
+    }
+    limits.maxNodes = _options.requestMaxNodes;
+
+    const int laneItemCount = (int)((lanes.size() + LaneSolver::kLaneCount - 1) / LaneSolver::kLaneCount);
+    _pool.parallelFor(laneItemCount + (int)others.size(), [&](const int workerIndex, const int itemIndex) {
+        WorkerContext& context = _contexts[workerIndex];
+        if (itemIndex < laneItemCount) {
+            const int first = itemIndex * LaneSolver::kLaneCount;
+            const int count = std::min((int)lanes.size() - first, LaneSolver::kLaneCount);
+            _solveLanes(context, &lanes[first], count, limits);
+        } else {
+            _solveOne(context, *others[itemIndex - laneItemCount], limits);
+        }
+    });
+}
+
+void SolveDaemon::_solveLanes(WorkerContext& context, PendingSolve** requests, const int count, const SolveLimits& limits) {
+    if (context.laneGrids.empty()) {
+        context.laneGrids.assign(LaneSolver::kLaneCount, Grid(9));
+    }
+    SolveStatus statuses[LaneSolver::kLaneCount];
+    for (int i = 0; i < count; i++) {
+        context.laneGrids[i].loadCompactString(requests[i]->puzzle);
+    }
+    LaneSolver::solveBatch(context.laneGrids.data(), count, statuses, context.laneStatistics, limits);
+    for (int i = 0; i < count; i++) {
+        requests[i]->status = statuses[i];
+        requests[i]->solution = context.laneGrids[i].compactPrint();
+    }
+}
+
+void SolveDaemon::_solveOne(WorkerContext& context, PendingSolve& request, const SolveLimits& limits) {
+    const int size = Grid::compactStringSize(request.puzzle);
+    auto found = context.grids.find(size);
+    if (found == context.grids.end()) {
+        found = context.grids.insert(std::make_pair(size, Grid(size))).first;
+    }
+    Grid& grid = found->second;
+    grid.loadCompactString(request.puzzle);
+    Solver solver(grid, limits);
+    solver.setVerbose(false);
+    request.status = solver.solve().status;
+    request.solution = grid.compactPrint();
+}
+
+#pragma mark - Statistics
+
+std::string SolveDaemon::_statisticsText() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::chrono::duration<double> uptime = std::chrono::steady_clock::now() - _startTime;
+    std::stringstream text;
+    text << "uptime_seconds " << uptime.count() << "\n";
+    text << "threads " << _pool.getThreadCount() << "\n";
+    text << "connections " << _statistics.connectionCount << "\n";
+    text << "requests " << _statistics.requestCount << "\n";
+    text << "invalid_requests " << _statistics.invalidRequestCount << "\n";
+    text << "solved " << _statistics.solvedCount << "\n";
+    text << "batches " << _statistics.batchCount << "\n";
+    text << "mean_batch " << (_statistics.batchCount > 0 ? (double)(_statistics.requestCount - (long)_queue.size()) / _statistics.batchCount : 0) << "\n";
+    text << "largest_batch " << _statistics.largestBatch << "\n";
+    text << "solve_seconds " << _statistics.solveSeconds << "\n";
+    text << "lane_solved " << _statistics.laneStatistics.laneSolvedCount << "\n";
+    text << "lane_contradictions " << _statistics.laneStatistics.laneContradictionCount << "\n";
+    text << "scalar " << _statistics.laneStatistics.scalarCount << "\n";
+    return text.str();
+}
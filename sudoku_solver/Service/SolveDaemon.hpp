@@ -0,0 +1,114 @@
+//
+//  SolveDaemon.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef SolveDaemon_hpp
+#define SolveDaemon_hpp
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "Grid.hpp"
+#include "LaneSolver.hpp"
+#include "SolveMonitor.hpp"
+#include "ThreadPool.hpp"
+
+struct DaemonOptions {
+    int maxBatchSize = 256;
+    // once a request is waiting, how long the batcher waits for more before it starts solving
+    int batchDelayMicroseconds = 200;
+    // per request, counted from the start of its batch, so one hard puzzle can't hold up the batcher (and every
+    // request queued behind it); such a request is answered with BudgetExhausted. 0 means no limit
+    double requestTimeoutSeconds = 10;
+    long requestMaxNodes = 0;
+};
+
+struct DaemonStatistics {
+    long connectionCount = 0;
+    long requestCount = 0;
+    long invalidRequestCount = 0;
+    long batchCount = 0;
+    long largestBatch = 0;
+    long solvedCount = 0;
+    double solveSeconds = 0;            // time spent in batches
+    LaneStatistics laneStatistics;
+};
+
+/**
+ Long running solver behind a Unix domain socket (see DaemonProtocol for the frames), so that callers don't pay for
+ process startup and table initialization on every puzzle.
+
+ Each connection gets a thread that reads requests and waits for its answers; Solve requests from all connections
+ go into one queue. A batcher thread takes whatever has queued up (after waiting batchDelayMicroseconds for more,
+ up to maxBatchSize) and spreads it over the pool: 9x9 puzzles in groups of LaneSolver::kLaneCount, other sizes one
+ by one. While a batch is solving, the next one queues up, so batches grow with the load. Puzzles of a size Grid
+ doesn't support are answered with an Error frame and never reach the batcher.
+
+ Every worker keeps a warm context: blank grids per size that puzzles are loaded into in place, so a request
+ doesn't rebuild the grid's index maps.
+ */
+class SolveDaemon {
+    struct PendingSolve {
+        std::string puzzle;
+        SolveStatus status = SolveStatus::NoSolution;
+        std::string solution;
+        bool done = false;
+    };
+    struct WorkerContext {
+        std::map<int, Grid> grids;      // by size, reused for every puzzle of that size
+        GridVector laneGrids;
+        LaneStatistics laneStatistics;
+    };
+
+    std::string _socketPath;
+    ThreadPool& _pool;
+    DaemonOptions _options;
+    int _listenFd;
+    std::atomic<bool> _stopping;
+    std::chrono::steady_clock::time_point _startTime;
+
+    std::mutex _mutex;
+    std::condition_variable _requestQueued;
+    std::condition_variable _requestsDone;
+    std::vector<PendingSolve*> _queue;
+    bool _batcherStopping;              // only once every connection is gone, so no request is left waiting
+    DaemonStatistics _statistics;
+
+    // connection threads are detached; run waits for the count to drop to zero before returning
+    std::mutex _connectionMutex;
+    std::condition_variable _connectionClosed;
+    std::unordered_set<int> _connectionFds;
+    int _activeConnectionCount;
+
+    std::vector<WorkerContext> _contexts;
+
+    void _serveConnection(const int fd);
+    void _batchLoop();
+    void _solveBatch(std::vector<PendingSolve*>& batch);
+    void _solveLanes(WorkerContext& context, PendingSolve** requests, const int count, const SolveLimits& limits);
+    void _solveOne(WorkerContext& context, PendingSolve& request, const SolveLimits& limits);
+    std::string _statisticsText();
+
+public:
+    SolveDaemon(const std::string socketPath, ThreadPool& pool, const DaemonOptions options);
+    ~SolveDaemon();
+
+    SolveDaemon(const SolveDaemon&) = delete;
+    SolveDaemon& operator=(const SolveDaemon&) = delete;
+
+    // listens until a Shutdown request or stop(); false when the socket can't be set up
+    bool run();
+    void stop();
+};
+
+#endif /* SolveDaemon_hpp */
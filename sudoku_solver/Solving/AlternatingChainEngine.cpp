@@ -0,0 +1,237 @@
+//
+//  AlternatingChainEngine.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "AlternatingChainEngine.hpp"
+
+#include <algorithm>
+
+AlternatingChainEngine::AlternatingChainEngine(const int size, const int maxChainLength) : _topology(BitmaskTopology::topologyForSize(supportsSize(size) ? size : 1)) {
+    _size = _topology.size;
+    _cellCount = _topology.cellCount;
+    _nodeCount = _cellCount * _size;
+    _maxChainLength = maxChainLength;
+    _synchronized = false;
+    _candidates.assign(_cellCount, 0);
+    _strongLinks.assign(_nodeCount * kStrongSlotCount, -1);
+    _stateStamps.assign(_nodeCount * 2, 0);
+    _stateDepths.assign(_nodeCount * 2, 0);
+    _queue.reserve(_nodeCount * 2);
+    _stamp = 0;
+}
+
+bool AlternatingChainEngine::supportsSize(const int size) {
+    return BitmaskSolver::supportsSize(size);
+}
+
+// the search visits every weak neighbour of every true candidate, which grows quickly with the grid
+int AlternatingChainEngine::defaultMaxChainLength(const int size) {
+    return size <= 9 ? 16 : size <= 16 ? 10 : 6;
+}
+
+#pragma mark - Link graph
+
+void AlternatingChainEngine::_updateCellLinks(const int cellIndex) {
+    const CandidateMask candidates = _candidates[cellIndex];
+    const bool bivalue = countOfMask(candidates) == 2;
+    const int first = bivalue ? _node(cellIndex, valueForBit(candidates & (~candidates + 1))) : -1;
+    const int second = bivalue ? _node(cellIndex, valueForBit(candidates & (candidates - 1))) : -1;
+    for (CandidateMask rest = candidates; rest != 0; rest &= rest - 1) {
+        const int node = _node(cellIndex, valueForBit(rest & (~rest + 1)));
+        _strongLinks[node * kStrongSlotCount] = !bivalue ? -1 : node == first ? second : first;
+    }
+}
+
+void AlternatingChainEngine::_updateUnitLinks(const int unitIndex, const int value) {
+    const CandidateMask bit = bitForValue(value);
+    const int* unit = &_topology.units[unitIndex * _size];
+    const int slot = 1 + unitIndex / _size;
+    int positions[2] = {-1, -1};
+    int positionCount = 0;
+    for (int offset = 0; offset < _size; offset++) {
+        if (_candidates[unit[offset]] & bit) {
+            if (positionCount < 2) {
+                positions[positionCount] = _node(unit[offset], value);
+            }
+            positionCount += 1;
+            _strongLinks[_node(unit[offset], value) * kStrongSlotCount + slot] = -1;
+        }
+    }
+    if (positionCount == 2) {
+        _strongLinks[positions[0] * kStrongSlotCount + slot] = positions[1];
+        _strongLinks[positions[1] * kStrongSlotCount + slot] = positions[0];
+    }
+}
+
+void AlternatingChainEngine::_rebuild() {
+    std::fill(_strongLinks.begin(), _strongLinks.end(), -1);
+    for (int cellIndex = 0; cellIndex < _cellCount; cellIndex++) {
+        _updateCellLinks(cellIndex);
+    }
+    for (int unitIndex = 0; unitIndex < 3 * _size; unitIndex++) {
+        for (int value = 1; value <= _size; value++) {
+            _updateUnitLinks(unitIndex, value);
+        }
+    }
+}
+
+// only the candidate's cell and its three units can gain or lose strong links
+void AlternatingChainEngine::_removeCandidate(const int cellIndex, const int value) {
+    _candidates[cellIndex] &= ~bitForValue(value);
+    std::fill_n(_strongLinks.begin() + _node(cellIndex, value) * kStrongSlotCount, kStrongSlotCount, -1);
+    _updateCellLinks(cellIndex);
+    _updateUnitLinks(_topology.rowOfCell[cellIndex], value);
+    _updateUnitLinks(_size + _topology.columnOfCell[cellIndex], value);
+    _updateUnitLinks(2 * _size + _topology.subgridOfCell[cellIndex], value);
+}
+
+void AlternatingChainEngine::synchronize(const Grid& grid) {
+    if (grid.getSize() != _size || !supportsSize(_size)) {
+        return;
+    }
+    CandidateMaskVector candidates(_cellCount, 0);
+    bool anyAdded = false;
+    for (int cellIndex = 0; cellIndex < _cellCount; cellIndex++) {
+        const Cell& cell = grid.cellAtIndex(cellIndex);
+        if (cell.getValue() == -1) {
+            const IntSet& cellCandidates = cell.getCandidates();
+            for (auto candidate = cellCandidates.begin(); candidate != cellCandidates.end(); ++candidate) {
+                if (*candidate >= 1 && *candidate <= _size) {
+                    candidates[cellIndex] |= bitForValue(*candidate);
+                }
+            }
+        }
+        anyAdded = anyAdded || (candidates[cellIndex] & ~_candidates[cellIndex]) != 0;
+    }
+
+    if (!_synchronized || anyAdded) {
+        _candidates = candidates;
+        _rebuild();
+        _synchronized = true;
+        return;
+    }
+    for (int cellIndex = 0; cellIndex < _cellCount; cellIndex++) {
+        for (CandidateMask removed = _candidates[cellIndex] & ~candidates[cellIndex]; removed != 0; removed &= removed - 1) {
+            _removeCandidate(cellIndex, valueForBit(removed & (~removed + 1)));
+        }
+    }
+}
+
+#pragma mark - Chains
+
+bool AlternatingChainEngine::_visit(const int state, const int depth) {
+    if (_stateStamps[state] == _stamp) {
+        return false;
+    }
+    _stateStamps[state] = _stamp;
+    _stateDepths[state] = depth;
+    _queue.push_back(state);
+    return true;
+}
+
+// start or end is true, so a candidate that can't be true alongside either of them goes
+void AlternatingChainEngine::_eliminateSeenByBoth(const int start, const int end, EliminationVector& eliminations) const {
+    const int startCell = start / _size;
+    const int endCell = end / _size;
+    const CandidateMask startBit = bitForValue(start % _size + 1);
+    const CandidateMask endBit = bitForValue(end % _size + 1);
+    const int wordCount = _topology.cellWordCount;
+
+    if (startBit == endBit) {
+        const int* peer = &_topology.peers[startCell * _topology.peerCount];
+        for (int i = 0; i < _topology.peerCount; i++) {
+            const int cellIndex = peer[i];
+            if (cellIndex != endCell && (_candidates[cellIndex] & startBit) && ((_topology.peerBits[endCell * wordCount + cellIndex / 64] >> (cellIndex % 64)) & 1)) {
+                eliminations.push_back(Elimination{cellIndex, startBit});
+            }
+        }
+    } else if (startCell == endCell) {
+        const CandidateMask others = _candidates[startCell] & ~startBit & ~endBit;
+        if (others) {
+            eliminations.push_back(Elimination{startCell, others});
+        }
+    } else if ((_topology.peerBits[startCell * wordCount + endCell / 64] >> (endCell % 64)) & 1) {
+        if (_candidates[endCell] & startBit) {
+            eliminations.push_back(Elimination{endCell, startBit});
+        }
+        if (_candidates[startCell] & endBit) {
+            eliminations.push_back(Elimination{startCell, endBit});
+        }
+    }
+}
+
+void AlternatingChainEngine::_searchFrom(const int start, EliminationVector& eliminations) {
+    _stamp += 1;
+    _queue.clear();
+    _visit(start * 2, 0);
+
+    for (size_t head = 0; head < _queue.size(); head++) {
+        const int state = _queue[head];
+        const int node = state / 2;
+        const int depth = _stateDepths[state];
+        if (depth >= _maxChainLength) {
+            continue;
+        }
+
+        if ((state & 1) == 0) {
+            // false: each strong partner is true
+            const int* slots = &_strongLinks[node * kStrongSlotCount];
+            for (int slot = 0; slot < kStrongSlotCount; slot++) {
+                const int partner = slots[slot];
+                if (partner == -1 || !_visit(partner * 2 + 1, depth + 1)) {
+                    continue;
+                }
+                if (partner == start) {
+                    // assuming the start false proves it true
+                    const int cellIndex = start / _size;
+                    const CandidateMask others = _candidates[cellIndex] & ~bitForValue(start % _size + 1);
+                    if (others) {
+                        eliminations.push_back(Elimination{cellIndex, others});
+                    }
+                    return;
+                }
+                _eliminateSeenByBoth(start, partner, eliminations);
+            }
+        } else {
+            // true: every weak neighbour is false; only those with a strong link can continue the chain
+            const int cellIndex = node / _size;
+            const int value = node % _size + 1;
+            const CandidateMask bit = bitForValue(value);
+            for (CandidateMask rest = _candidates[cellIndex] & ~bit; rest != 0; rest &= rest - 1) {
+                const int neighbour = _node(cellIndex, valueForBit(rest & (~rest + 1)));
+                if (_hasStrongLink(neighbour)) {
+                    _visit(neighbour * 2, depth + 1);
+                }
+            }
+            const int* peer = &_topology.peers[cellIndex * _topology.peerCount];
+            for (int i = 0; i < _topology.peerCount; i++) {
+                if (_candidates[peer[i]] & bit) {
+                    const int neighbour = _node(peer[i], value);
+                    if (_hasStrongLink(neighbour)) {
+                        _visit(neighbour * 2, depth + 1);
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool AlternatingChainEngine::findEliminations(EliminationVector& eliminations) {
+    const size_t initialCount = eliminations.size();
+    if (!_synchronized) {
+        return false;
+    }
+    if (_stamp > 0x3fffffff) {
+        std::fill(_stateStamps.begin(), _stateStamps.end(), 0);
+        _stamp = 0;
+    }
+    for (int node = 0; node < _nodeCount; node++) {
+        if (_hasStrongLink(node)) {
+            _searchFrom(node, eliminations);
+        }
+    }
+    return eliminations.size() > initialCount;
+}
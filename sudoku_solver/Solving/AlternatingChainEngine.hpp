@@ -0,0 +1,80 @@
+//
+//  AlternatingChainEngine.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef AlternatingChainEngine_hpp
+#define AlternatingChainEngine_hpp
+
+#include <vector>
+
+#include "BitmaskSolver.hpp"
+#include "BitmaskTechniques.hpp"
+#include "Grid.hpp"
+
+/**
+ Alternating inference chains over a link graph whose nodes are the grid's candidates, numbered
+ cellIndex * size + value - 1.
+
+ A strong link joins the only two candidates of a cell or the only two places for a value in a unit: one of them is
+ true. Weak links join candidates that can't both be true (same cell, or same value in peer cells); they follow from
+ the topology and are never stored. Strong links are kept in a flat array with one slot for the cell and one per
+ unit, and are updated incrementally: synchronize only revisits the cell and units of each candidate that
+ disappeared since the last call.
+
+ Chains are found by a breadth first search from every candidate with a strong link, over (candidate, is true)
+ states: assuming the start is false, a strong link makes its partner true and a weak link makes the partner of a
+ true candidate false. Every candidate reached as true gives "start or end is true", so any candidate weakly linked
+ to both ends goes. A start that comes back as true is placed instead.
+ */
+class AlternatingChainEngine {
+    static const int kStrongSlotCount = 4;  // cell, row, column, subgrid
+
+    const BitmaskTopology& _topology;
+    int _size;
+    int _cellCount;
+    int _nodeCount;
+    int _maxChainLength;
+    bool _synchronized;
+
+    CandidateMaskVector _candidates;        // 0 for answered cells
+    IntVector _strongLinks;                 // kStrongSlotCount per node, -1 for none
+
+    // breadth first search scratch, by state (node * 2 + is true)
+    IntVector _stateStamps;
+    IntVector _stateDepths;
+    IntVector _queue;
+    int _stamp;
+
+    inline int _node(const int cellIndex, const int value) const {
+        return cellIndex * _size + value - 1;
+    }
+    inline bool _hasStrongLink(const int node) const {
+        const int* slots = &_strongLinks[node * kStrongSlotCount];
+        return slots[0] != -1 || slots[1] != -1 || slots[2] != -1 || slots[3] != -1;
+    }
+
+    void _rebuild();
+    void _removeCandidate(const int cellIndex, const int value);
+    void _updateCellLinks(const int cellIndex);
+    void _updateUnitLinks(const int unitIndex, const int value);
+
+    bool _visit(const int state, const int depth);
+    void _eliminateSeenByBoth(const int start, const int end, EliminationVector& eliminations) const;
+    void _searchFrom(const int start, EliminationVector& eliminations);
+
+public:
+    // maxChainLength counts links; chains only run on sizes BitmaskSolver supports
+    AlternatingChainEngine(const int size, const int maxChainLength);
+
+    static bool supportsSize(const int size);
+    static int defaultMaxChainLength(const int size);
+
+    // brings the graph up to date with the grid's candidates (rebuilding it only if a candidate came back)
+    void synchronize(const Grid& grid);
+    bool findEliminations(EliminationVector& eliminations);
+};
+
+#endif /* AlternatingChainEngine_hpp */
@@ -0,0 +1,433 @@
+//
+//  BackjumpingSearch.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "BackjumpingSearch.hpp"
+
+#include <cstring>
+
+static const size_t kMaxNogoodCount = 100000;
+
+BackjumpingSearch::BackjumpingSearch(const Grid& grid, SolveMonitor* monitor, const int maxNogoodSize) : _topology(BitmaskTopology::topologyForSize(grid.getSize())) {
+    _size = grid.getSize();
+    _cellCount = _size * _size;
+    _allValuesMask = _size == 64 ? ~(CandidateMask)0 : (((CandidateMask)1) << _size) - 1;
+    _monitor = monitor;
+    _maxNogoodSize = maxNogoodSize;
+
+    _values.assign(_cellCount, 0);
+    _candidates.assign(_cellCount, _allValuesMask);
+    _eliminatedBy.assign(_cellCount * _size, -1);
+    _levelOfCell.assign(_cellCount, 0);
+    _causeOfCell.assign(_cellCount, Cause::Given);
+    _unitOfCell.assign(_cellCount, -1);
+    _queue.reserve(_cellCount);
+    _queueHead = 0;
+    _level = 0;
+    _decisionCells.assign(_cellCount + 1, -1);
+    _decisionValues.assign(_cellCount + 1, 0);
+    _pendingCells.reserve(_cellCount);
+    _visitStamps.assign(_cellCount, 0);
+    _visitStamp = 0;
+    // levels go up to the number of cells, and the deepest node's children hand back a set one level further down
+    _levelWordCount = (_cellCount + 2 + 63) / 64;
+    _nogoodsByCandidate.resize(maxNogoodSize > 0 ? _cellCount * _size : 0);
+    _nogoodBytes = 0;
+    _stopped = false;
+    if (_monitor != nullptr) {
+        _monitor->setMemoryUsage(MemoryCategory::TopologyTables, grid.getSharedTableBytes() + _topology.getMemoryFootprint());
+    }
+
+    // the givens and whatever they imply make up level 0, which never shows up in a conflict set
+    _consistent = true;
+    for (int cellIndex = 0; cellIndex < _cellCount && _consistent; cellIndex++) {
+        const int value = grid.cellAtIndex(cellIndex).getValue();
+        if (value != -1) {
+            _consistent = _assign(cellIndex, value, Cause::Given, -1);
+        }
+    }
+    _consistent = _consistent && _propagate();
+}
+
+#pragma mark - Trail
+
+void BackjumpingSearch::_saveCell(const int cellIndex) {
+    _trail.push_back(TrailEntry{cellIndex, _values[cellIndex], _candidates[cellIndex]});
+}
+
+void BackjumpingSearch::_undoTrail(const size_t trailSize) {
+    while (_trail.size() > trailSize) {
+        const TrailEntry& entry = _trail.back();
+        _values[entry.cellIndex] = entry.value;
+        _candidates[entry.cellIndex] = entry.candidates;
+        _trail.pop_back();
+    }
+}
+
+#pragma mark - Propagation with reasons
+
+bool BackjumpingSearch::_assign(const int cellIndex, const int value, const Cause cause, const int unitIndex) {
+    const CandidateMask bit = bitForValue(value);
+    _saveCell(cellIndex);
+    // the other candidates are removed by this assignment
+    for (CandidateMask others = _candidates[cellIndex] & ~bit; others != 0; others &= others - 1) {
+        _eliminatedBy[_candidateIndex(cellIndex, valueForBit(others & (~others + 1)))] = cellIndex;
+    }
+    const bool wasCandidate = (_candidates[cellIndex] & bit) != 0;
+    _values[cellIndex] = value;
+    _candidates[cellIndex] = bit;
+    _levelOfCell[cellIndex] = _level;
+    _causeOfCell[cellIndex] = cause;
+    _unitOfCell[cellIndex] = unitIndex;
+    if (!wasCandidate) {
+        _conflictCells.assign({cellIndex, _eliminatedBy[_candidateIndex(cellIndex, value)]});
+        return false;
+    }
+    _queue.push_back(cellIndex);
+    return true;
+}
+
+bool BackjumpingSearch::_eliminate(const int sourceCellIndex, const int cellIndex, const int value) {
+    const CandidateMask bit = bitForValue(value);
+    if ((_candidates[cellIndex] & bit) == 0) {
+        return true;
+    }
+    if (_values[cellIndex] == value) {
+        _conflictCells.assign({sourceCellIndex, cellIndex});
+        return false;
+    }
+    _saveCell(cellIndex);
+    _candidates[cellIndex] &= ~bit;
+    _eliminatedBy[_candidateIndex(cellIndex, value)] = sourceCellIndex;
+
+    const CandidateMask remaining = _candidates[cellIndex];
+    if (remaining == 0) {
+        _conflictCells.clear();
+        for (int other = 1; other <= _size; other++) {
+            _conflictCells.push_back(_eliminatedBy[_candidateIndex(cellIndex, other)]);
+        }
+        return false;
+    }
+    if ((remaining & (remaining - 1)) == 0) {
+        return _assign(cellIndex, valueForBit(remaining), Cause::NakedSingle, -1);
+    }
+    return true;
+}
+
+bool BackjumpingSearch::_propagateHiddenSingles(bool& anyAssigned) {
+    const int unitCount = 3 * _size;
+    for (int unitIndex = 0; unitIndex < unitCount; unitIndex++) {
+        const int* unit = &_topology.units[unitIndex * _size];
+        CandidateMask once = 0;
+        CandidateMask twice = 0;
+        CandidateMask placed = 0;
+        for (int i = 0; i < _size; i++) {
+            const CandidateMask candidates = _candidates[unit[i]];
+            if (_values[unit[i]] != 0) {
+                placed |= candidates;
+            } else {
+                twice |= once & candidates;
+                once |= candidates;
+            }
+        }
+        const CandidateMask missing = _allValuesMask & ~placed & ~once;
+        if (missing != 0) {
+            // some value has no cell left in this unit, each cell lost it to its own reason
+            const int value = valueForBit(missing & (~missing + 1));
+            _conflictCells.clear();
+            for (int i = 0; i < _size; i++) {
+                _conflictCells.push_back(_eliminatedBy[_candidateIndex(unit[i], value)]);
+            }
+            return false;
+        }
+        for (CandidateMask singles = once & ~twice & ~placed; singles != 0; singles &= singles - 1) {
+            const CandidateMask bit = singles & (~singles + 1);
+            for (int i = 0; i < _size; i++) {
+                const int cellIndex = unit[i];
+                if (_values[cellIndex] == 0 && (_candidates[cellIndex] & bit) != 0) {
+                    if (!_assign(cellIndex, valueForBit(bit), Cause::HiddenSingle, unitIndex)) {
+                        return false;
+                    }
+                    anyAssigned = true;
+                    break;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool BackjumpingSearch::_propagate() {
+    while (true) {
+        while (_queueHead < _queue.size()) {
+            const int cellIndex = _queue[_queueHead++];
+            const int value = _values[cellIndex];
+            const int* peers = &_topology.peers[cellIndex * _topology.peerCount];
+            for (int i = 0; i < _topology.peerCount; i++) {
+                if (!_eliminate(cellIndex, peers[i], value)) {
+                    return false;
+                }
+            }
+        }
+        bool anyAssigned = false;
+        if (!_propagateHiddenSingles(anyAssigned)) {
+            return false;
+        }
+        if (!anyAssigned) {
+            return true;
+        }
+    }
+}
+
+#pragma mark - Conflict analysis
+
+// bit sets of decision levels
+static inline void addLevel(uint64_t* levels, const int level) {
+    levels[level >> 6] |= ((uint64_t)1) << (level & 63);
+}
+
+static inline bool hasLevel(const uint64_t* levels, const int level) {
+    return (levels[level >> 6] >> (level & 63)) & 1;
+}
+
+/**
+ Adds the decision levels behind the assignments in _pendingCells: follows each assignment back through the
+ candidates that made it forced (and the assignments that removed those) until reaching decisions. Level 0 is left
+ out. Leaves _pendingCells empty.
+ */
+void BackjumpingSearch::_addDecisionLevels(uint64_t* levels) {
+    _visitStamp += 1;
+    IntVector& pending = _pendingCells;
+    while (!pending.empty()) {
+        const int cellIndex = pending.back();
+        pending.pop_back();
+        if (cellIndex < 0 || _visitStamps[cellIndex] == _visitStamp || _levelOfCell[cellIndex] == 0) {
+            continue;
+        }
+        _visitStamps[cellIndex] = _visitStamp;
+        const int value = _values[cellIndex];
+        switch (_causeOfCell[cellIndex]) {
+            case Cause::Given:
+                break;
+            case Cause::Decision:
+                addLevel(levels, _levelOfCell[cellIndex]);
+                break;
+            case Cause::NakedSingle:
+                for (int other = 1; other <= _size; other++) {
+                    if (other != value) {
+                        pending.push_back(_eliminatedBy[_candidateIndex(cellIndex, other)]);
+                    }
+                }
+                break;
+            case Cause::HiddenSingle: {
+                const int* unit = &_topology.units[_unitOfCell[cellIndex] * _size];
+                for (int i = 0; i < _size; i++) {
+                    if (unit[i] != cellIndex) {
+                        pending.push_back(_eliminatedBy[_candidateIndex(unit[i], value)]);
+                    }
+                }
+                break;
+            }
+        }
+    }
+}
+
+bool BackjumpingSearch::_violatesNogood(const int cellIndex, const int value, uint64_t* levels) {
+    if (_maxNogoodSize <= 0) {
+        return false;
+    }
+    const IntVector& nogoodIndices = _nogoodsByCandidate[_candidateIndex(cellIndex, value)];
+    for (auto nogoodIndex = nogoodIndices.begin(); nogoodIndex != nogoodIndices.end(); ++nogoodIndex) {
+        const Nogood& nogood = _nogoods[*nogoodIndex];
+        _pendingCells.clear();
+        bool allHold = true;
+        for (size_t i = 0; i < nogood.cellIndices.size() && allHold; i++) {
+            if (nogood.cellIndices[i] == cellIndex) {
+                continue;
+            }
+            allHold = _values[nogood.cellIndices[i]] == nogood.values[i];
+            _pendingCells.push_back(nogood.cellIndices[i]);
+        }
+        if (allHold) {
+            _addDecisionLevels(levels);
+            return true;
+        }
+    }
+    _pendingCells.clear();
+    return false;
+}
+
+void BackjumpingSearch::_recordNogood(const uint64_t* levels) {
+    int levelCount = 0;
+    for (int word = 0; word < _levelWordCount; word++) {
+        levelCount += __builtin_popcountll(levels[word]);
+    }
+    if (levelCount == 0 || levelCount > _maxNogoodSize || _nogoods.size() >= kMaxNogoodCount) {
+        return;
+    }
+    Nogood nogood;
+    for (int word = 0; word < _levelWordCount; word++) {
+        for (uint64_t bits = levels[word]; bits != 0; bits &= bits - 1) {
+            const int level = word * 64 + __builtin_ctzll(bits);
+            nogood.cellIndices.push_back(_decisionCells[level]);
+            nogood.values.push_back(_decisionValues[level]);
+        }
+    }
+    const int nogoodIndex = (int)_nogoods.size();
+    for (size_t i = 0; i < nogood.cellIndices.size(); i++) {
+        _nogoodsByCandidate[_candidateIndex(nogood.cellIndices[i], nogood.values[i])].push_back(nogoodIndex);
+    }
+    _nogoods.push_back(nogood);
+    // its own two lists and its entries in _nogoodsByCandidate
+    _nogoodBytes += (nogood.cellIndices.capacity() + nogood.values.capacity() + nogood.cellIndices.size()) * sizeof(int);
+    _reportMemory();
+    _statistics.nogoodCount += 1;
+}
+
+#pragma mark - Search
+
+int BackjumpingSearch::_selectBranchCell() const {
+    int result = -1;
+    int minCount = _size + 1;
+    for (int cellIndex = 0; cellIndex < _cellCount; cellIndex++) {
+        if (_values[cellIndex] == 0) {
+            const int count = countOfMask(_candidates[cellIndex]);
+            if (count < minCount) {
+                minCount = count;
+                result = cellIndex;
+                if (count <= 2) {
+                    break;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+/**
+ Returns true once every cell is assigned. Otherwise the ConflictLevels set of this node's depth gets the decision
+ levels (all below this node's own decision) that made every value of the branch cell fail.
+ */
+bool BackjumpingSearch::_search() {
+    _statistics.nodeCount += 1;
+    const int parentLevel = _level;
+    const int level = parentLevel + 1;
+    // this node's sets and its children's conflict set
+    const size_t levelSetWords = (size_t)(2 * (level + 1)) * _levelWordCount;
+    if (_levelSets.size() < levelSetWords) {
+        _levelSets.resize(levelSetWords, 0);
+    }
+    if (_level > _statistics.maxDepth) {
+        _statistics.maxDepth = _level;
+        _reportMemory();
+    }
+    if (_monitor != nullptr && !_monitor->countNode(_level)) {
+        _stopped = true;
+        return false;
+    }
+    const int cellIndex = _selectBranchCell();
+    if (cellIndex < 0) {
+        return true;
+    }
+
+    const size_t setBytes = _levelWordCount * sizeof(uint64_t);
+    uint64_t* accumulatedLevels = _levelSet(AccumulatedLevels, parentLevel);
+    memset(accumulatedLevels, 0, setBytes);
+    // the values the cell already lost are part of why its remaining ones are the only options
+    _pendingCells.clear();
+    for (int value = 1; value <= _size; value++) {
+        if ((_candidates[cellIndex] & bitForValue(value)) == 0) {
+            _pendingCells.push_back(_eliminatedBy[_candidateIndex(cellIndex, value)]);
+        }
+    }
+    _addDecisionLevels(accumulatedLevels);
+
+    for (CandidateMask remaining = _candidates[cellIndex]; remaining != 0; remaining &= remaining - 1) {
+        const int value = valueForBit(remaining & (~remaining + 1));
+        const size_t trailSize = _trail.size();
+        _level = level;
+        _decisionCells[level] = cellIndex;
+        _decisionValues[level] = value;
+
+        // filled here when the value fails at once, otherwise by the child node
+        memset(_levelSet(ConflictLevels, level), 0, setBytes);
+        if (_violatesNogood(cellIndex, value, _levelSet(ConflictLevels, level))) {
+            _statistics.nogoodPruneCount += 1;
+            addLevel(_levelSet(ConflictLevels, level), level);
+        } else {
+            _statistics.branchCount += 1;
+            _queue.clear();
+            _queueHead = 0;
+            if (_assign(cellIndex, value, Cause::Decision, -1) && _propagate()) {
+                if (_search()) {
+                    return true;
+                }
+            } else {
+                _pendingCells.assign(_conflictCells.begin(), _conflictCells.end());
+                _addDecisionLevels(_levelSet(ConflictLevels, level));
+            }
+        }
+        _undoTrail(trailSize);
+        _level = parentLevel;
+        if (_stopped) {
+            return false;
+        }
+
+        // the child may have grown the sets, which moves them
+        uint64_t* childLevels = _levelSet(ConflictLevels, level);
+        if (!hasLevel(childLevels, level)) {
+            // this decision played no part, so the remaining values would fail the same way
+            _statistics.backjumpCount += 1;
+            memcpy(_levelSet(ConflictLevels, parentLevel), childLevels, setBytes);
+            return false;
+        }
+        accumulatedLevels = _levelSet(AccumulatedLevels, parentLevel);
+        childLevels[level >> 6] &= ~(((uint64_t)1) << (level & 63));
+        for (int word = 0; word < _levelWordCount; word++) {
+            accumulatedLevels[word] |= childLevels[word];
+        }
+    }
+
+    accumulatedLevels = _levelSet(AccumulatedLevels, parentLevel);
+    _recordNogood(accumulatedLevels);
+    memcpy(_levelSet(ConflictLevels, parentLevel), accumulatedLevels, setBytes);
+    return false;
+}
+
+bool BackjumpingSearch::_reportMemory() {
+    if (_monitor == nullptr) {
+        return true;
+    }
+    const size_t intCount = _values.capacity() + _eliminatedBy.capacity() + _levelOfCell.capacity() + _unitOfCell.capacity() + _queue.capacity()
+        + _decisionCells.capacity() + _decisionValues.capacity() + _conflictCells.capacity() + _pendingCells.capacity() + _visitStamps.capacity();
+    size_t bytes = intCount * sizeof(int) + _candidates.capacity() * sizeof(CandidateMask) + _causeOfCell.capacity() * sizeof(Cause);
+    bytes += _trail.capacity() * sizeof(TrailEntry) + _levelSets.capacity() * sizeof(uint64_t);
+    bytes += _nogoods.capacity() * sizeof(Nogood) + _nogoodsByCandidate.capacity() * sizeof(IntVector) + _nogoodBytes;
+    return _monitor->setMemoryUsage(MemoryCategory::SearchState, bytes);
+}
+
+bool BackjumpingSearch::search(Grid& result) {
+    _statistics = SearchStatistics();
+    if (!_reportMemory() || !_consistent) {
+        return false;
+    }
+    if (!_search()) {
+        return false;
+    }
+    result = Grid(_size);
+    for (int cellIndex = 0; cellIndex < _cellCount; cellIndex++) {
+        result.setCellValue(cellIndex, _values[cellIndex]);
+    }
+    return true;
+}
+
+bool BackjumpingSearch::wasStopped() const {
+    return _stopped;
+}
+
+const SearchStatistics& BackjumpingSearch::getStatistics() const {
+    return _statistics;
+}
@@ -0,0 +1,130 @@
+//
+//  BackjumpingSearch.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef BackjumpingSearch_hpp
+#define BackjumpingSearch_hpp
+
+#include <vector>
+
+#include "BitmaskSolver.hpp"
+#include "DepthFirstSearchSolver.hpp"
+#include "Grid.hpp"
+#include "SolveMonitor.hpp"
+
+/**
+ Depth first search with conflict-directed backjumping, used by DepthFirstSearchSolver when
+ SearchOptions::conflictDirectedBackjumping is set.
+
+ Propagation (naked and hidden singles on bitmasks) records why every candidate disappeared: the cell whose
+ assignment removed it. Every assignment records its cause: a decision, a naked single or a hidden single in a unit.
+ When a branch dies, the contradiction is traced back through those reasons to the set of decision levels that
+ caused it. A level that is not in that set would fail the same way with any of its other values, so the search
+ skips them and returns to the deepest level that is.
+
+ Optionally, small conflict sets are kept as nogoods (cell = value assignments that cannot all hold) and checked
+ before each decision.
+
+ Its state is a few words per cell and candidate rather than a grid per level, which makes it the search that
+ Solver falls back to when DFS goes over the memory cap.
+ */
+class BackjumpingSearch {
+    enum class Cause {
+        Given,
+        Decision,
+        NakedSingle,
+        HiddenSingle
+    };
+    struct TrailEntry {
+        int cellIndex;
+        int value;
+        CandidateMask candidates;
+    };
+    struct Nogood {
+        IntVector cellIndices;
+        IntVector values;
+    };
+
+    const BitmaskTopology& _topology;
+    int _size;
+    int _cellCount;
+    CandidateMask _allValuesMask;
+    SolveMonitor* _monitor;
+    int _maxNogoodSize;
+
+    IntVector _values;
+    CandidateMaskVector _candidates;
+    // indexed by cellIndex * size + value - 1: the cell whose assignment removed that candidate
+    IntVector _eliminatedBy;
+    IntVector _levelOfCell;
+    std::vector<Cause> _causeOfCell;
+    IntVector _unitOfCell;              // the unit of a hidden single
+    std::vector<TrailEntry> _trail;
+    IntVector _queue;
+    size_t _queueHead;
+    int _level;
+    IntVector _decisionCells;           // by level
+    IntVector _decisionValues;
+
+    IntVector _conflictCells;           // the assignments behind the last contradiction
+    IntVector _pendingCells;            // what _addDecisionLevels still has to trace back
+    IntVector _visitStamps;
+    int _visitStamp;
+
+    // sets of decision levels, one bit per level, _levelWordCount words each: per search depth the conflict set the
+    // node at that depth hands back and the one it accumulates over its values. They grow with the depth and are
+    // reused from node to node, so conflict analysis doesn't allocate
+    enum LevelSetKind {
+        ConflictLevels,
+        AccumulatedLevels
+    };
+    std::vector<uint64_t> _levelSets;
+    int _levelWordCount;
+
+    std::vector<Nogood> _nogoods;
+    std::vector<IntVector> _nogoodsByCandidate;
+    size_t _nogoodBytes;
+
+    SearchStatistics _statistics;
+    bool _stopped;
+    bool _consistent;
+
+    inline int _candidateIndex(const int cellIndex, const int value) const {
+        return cellIndex * _size + value - 1;
+    }
+
+    void _saveCell(const int cellIndex);
+    void _undoTrail(const size_t trailSize);
+    bool _assign(const int cellIndex, const int value, const Cause cause, const int unitIndex);
+    bool _eliminate(const int sourceCellIndex, const int cellIndex, const int value);
+    bool _propagate();
+    bool _propagateHiddenSingles(bool& anyAssigned);
+
+    // only valid until the sets grow, which happens when _search goes deeper
+    inline uint64_t* _levelSet(const LevelSetKind kind, const int depth) {
+        return &_levelSets[(2 * depth + kind) * _levelWordCount];
+    }
+    void _addDecisionLevels(uint64_t* levels);
+    bool _violatesNogood(const int cellIndex, const int value, uint64_t* levels);
+    void _recordNogood(const uint64_t* levels);
+
+    // tells the monitor what the trail, the per-cell arrays and the nogoods hold; false once that is over the cap
+    bool _reportMemory();
+
+    int _selectBranchCell() const;
+    bool _search();
+
+public:
+    // monitor may be null; the grid size must be supported by BitmaskSolver
+    BackjumpingSearch(const Grid& grid, SolveMonitor* monitor, const int maxNogoodSize);
+
+    // true with the solution written to result
+    bool search(Grid& result);
+    bool wasStopped() const;
+    const SearchStatistics& getStatistics() const;
+};
+
+#endif /* BackjumpingSearch_hpp */
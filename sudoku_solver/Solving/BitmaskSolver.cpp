@@ -0,0 +1,613 @@
+//
+//  BitmaskSolver.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "BitmaskSolver.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+
+static const int kMaxBitmaskGridSize = 64;
+
+#pragma mark - Topology
+
+static BitmaskTopology* buildTopology(const int size) {
+    BitmaskTopology* topology = new BitmaskTopology();
+    const int subSize = (int)round(sqrt(size));
+    const int cellCount = size * size;
+    topology->size = size;
+    topology->subSize = subSize;
+    topology->cellCount = cellCount;
+    topology->rowOfCell.resize(cellCount);
+    topology->columnOfCell.resize(cellCount);
+    topology->subgridOfCell.resize(cellCount);
+
+    for (int cellIndex = 0; cellIndex < cellCount; cellIndex++) {
+        const int row = cellIndex / size;
+        const int column = cellIndex % size;
+        topology->rowOfCell[cellIndex] = row;
+        topology->columnOfCell[cellIndex] = column;
+        topology->subgridOfCell[cellIndex] = (row / subSize) * subSize + column / subSize;
+    }
+
+    // rows, then columns, then subgrids
+    topology->units.resize(3 * size * size);
+    for (int row = 0; row < size; row++) {
+        for (int column = 0; column < size; column++) {
+            topology->units[row * size + column] = row * size + column;
+        }
+    }
+    for (int column = 0; column < size; column++) {
+        for (int row = 0; row < size; row++) {
+            topology->units[(size + column) * size + row] = row * size + column;
+        }
+    }
+    for (int subgrid = 0; subgrid < size; subgrid++) {
+        const int startRow = (subgrid / subSize) * subSize;
+        const int startColumn = (subgrid % subSize) * subSize;
+        for (int offset = 0; offset < size; offset++) {
+            const int row = startRow + offset / subSize;
+            const int column = startColumn + offset % subSize;
+            topology->units[(2 * size + subgrid) * size + offset] = row * size + column;
+        }
+    }
+
+    // every cell has the same number of peers: the rest of its row and column plus the rest of its subgrid
+    topology->peerCount = 2 * (size - 1) + (subSize - 1) * (subSize - 1);
+    topology->peers.reserve(cellCount * topology->peerCount);
+    topology->cellWordCount = (cellCount + 63) / 64;
+    topology->peerBits.assign(cellCount * topology->cellWordCount, 0);
+    for (int cellIndex = 0; cellIndex < cellCount; cellIndex++) {
+        for (int other = 0; other < cellCount; other++) {
+            if (other == cellIndex) {
+                continue;
+            }
+            if (topology->rowOfCell[other] == topology->rowOfCell[cellIndex]
+                || topology->columnOfCell[other] == topology->columnOfCell[cellIndex]
+                || topology->subgridOfCell[other] == topology->subgridOfCell[cellIndex]) {
+                topology->peers.push_back(other);
+                topology->peerBits[cellIndex * topology->cellWordCount + other / 64] |= ((uint64_t)1) << (other % 64);
+            }
+        }
+    }
+    return topology;
+}
+
+size_t BitmaskTopology::getMemoryFootprint() const {
+    const size_t intCount = units.capacity() + peers.capacity() + rowOfCell.capacity() + columnOfCell.capacity() + subgridOfCell.capacity();
+    return sizeof(BitmaskTopology) + intCount * sizeof(int) + peerBits.capacity() * sizeof(uint64_t);
+}
+
+const BitmaskTopology& BitmaskTopology::topologyForSize(const int size) {
+    static std::mutex mutex;
+    static std::map<int, std::unique_ptr<BitmaskTopology>> topologies;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<BitmaskTopology>& topology = topologies[size];
+    if (!topology) {
+        topology.reset(buildTopology(size));
+    }
+    return *topology;
+}
+
+#pragma mark - Construction
+
+BitmaskSolver::BitmaskSolver(const int size) : _topology(BitmaskTopology::topologyForSize(size)) {
+    _size = size;
+    _cellCount = size * size;
+    _allValuesMask = size == 64 ? ~(CandidateMask)0 : (((CandidateMask)1) << size) - 1;
+    _rowUsed.resize(size);
+    _columnUsed.resize(size);
+    _subgridUsed.resize(size);
+    _givenCandidates.resize(_cellCount);
+    _values.resize(_cellCount);
+    _candidates.resize(_cellCount);
+    _trail.reserve(_cellCount * 4);
+    _singlesQueue.reserve(_cellCount);
+    _solutionCount = 0;
+    _solutionLimit = 0;
+    _nodeCount = 0;
+    _nodeLimit = 0;
+    _nodeLimitReached = false;
+    _rng = nullptr;
+    _rootDepth = 0;
+    _atUnexploredNode = false;
+    clearGivens();
+}
+
+BitmaskSolver::BitmaskSolver(const Grid& grid) : BitmaskSolver(grid.getSize()) {
+    for (int cellIndex = 0; cellIndex < _cellCount; cellIndex++) {
+        const int value = grid.cellAtIndex(cellIndex).getValue();
+        if (value != -1) {
+            setGiven(cellIndex, value);
+        }
+    }
+}
+
+bool BitmaskSolver::supportsSize(const int size) {
+    const int root = (int)round(sqrt(size));
+    return size >= 1 && size <= kMaxBitmaskGridSize && root * root == size;
+}
+
+int BitmaskSolver::getSize() const {
+    return _size;
+}
+
+int BitmaskSolver::getCellCount() const {
+    return _cellCount;
+}
+
+#pragma mark - Givens
+
+void BitmaskSolver::clearGivens() {
+    _givens.assign(_cellCount, -1);
+    _givenCount = 0;
+    _conflictingGivenCount = 0;
+    std::fill(_rowUsed.begin(), _rowUsed.end(), 0);
+    std::fill(_columnUsed.begin(), _columnUsed.end(), 0);
+    std::fill(_subgridUsed.begin(), _subgridUsed.end(), 0);
+    std::fill(_givenCandidates.begin(), _givenCandidates.end(), _allValuesMask);
+}
+
+void BitmaskSolver::_updateGivenCandidates(const int cellIndex) {
+    if (_givens[cellIndex] != -1) {
+        _givenCandidates[cellIndex] = 0;
+    } else {
+        const CandidateMask used = _rowUsed[_topology.rowOfCell[cellIndex]] | _columnUsed[_topology.columnOfCell[cellIndex]] | _subgridUsed[_topology.subgridOfCell[cellIndex]];
+        _givenCandidates[cellIndex] = _allValuesMask & ~used;
+    }
+}
+
+// a given that clashes with an existing one is rejected and remembered, so the puzzle reports no solutions
+bool BitmaskSolver::setGiven(const int cellIndex, const int value) {
+    if (value < 1 || value > _size) {
+        return false;
+    }
+    if (_givens[cellIndex] != -1) {
+        clearGiven(cellIndex);
+    }
+    const CandidateMask bit = bitForValue(value);
+    const int row = _topology.rowOfCell[cellIndex];
+    const int column = _topology.columnOfCell[cellIndex];
+    const int subgrid = _topology.subgridOfCell[cellIndex];
+    if ((_rowUsed[row] | _columnUsed[column] | _subgridUsed[subgrid]) & bit) {
+        _conflictingGivenCount += 1;
+        return false;
+    }
+    _givens[cellIndex] = value;
+    _givenCount += 1;
+    _rowUsed[row] |= bit;
+    _columnUsed[column] |= bit;
+    _subgridUsed[subgrid] |= bit;
+    _givenCandidates[cellIndex] = 0;
+    const int* peer = &_topology.peers[cellIndex * _topology.peerCount];
+    const int* peerEnd = peer + _topology.peerCount;
+    for (; peer != peerEnd; ++peer) {
+        _givenCandidates[*peer] &= ~bit;
+    }
+    return true;
+}
+
+void BitmaskSolver::clearGiven(const int cellIndex) {
+    const int value = _givens[cellIndex];
+    if (value == -1) {
+        return;
+    }
+    const CandidateMask bit = bitForValue(value);
+    _givens[cellIndex] = -1;
+    _givenCount -= 1;
+    _rowUsed[_topology.rowOfCell[cellIndex]] &= ~bit;
+    _columnUsed[_topology.columnOfCell[cellIndex]] &= ~bit;
+    _subgridUsed[_topology.subgridOfCell[cellIndex]] &= ~bit;
+    // only the cell and its peers can get the value back
+    _updateGivenCandidates(cellIndex);
+    const int* peer = &_topology.peers[cellIndex * _topology.peerCount];
+    const int* peerEnd = peer + _topology.peerCount;
+    for (; peer != peerEnd; ++peer) {
+        _updateGivenCandidates(*peer);
+    }
+}
+
+int BitmaskSolver::getGiven(const int cellIndex) const {
+    return _givens[cellIndex];
+}
+
+int BitmaskSolver::getGivenCount() const {
+    return _givenCount;
+}
+
+#pragma mark - Propagation
+
+void BitmaskSolver::_saveCell(const int cellIndex) {
+    TrailEntry entry;
+    entry.cellIndex = cellIndex;
+    entry.value = _values[cellIndex];
+    entry.candidates = _candidates[cellIndex];
+    _trail.push_back(entry);
+}
+
+void BitmaskSolver::_undoTrail(const size_t trailSize) {
+    while (_trail.size() > trailSize) {
+        const TrailEntry& entry = _trail.back();
+        _values[entry.cellIndex] = entry.value;
+        _candidates[entry.cellIndex] = entry.candidates;
+        _trail.pop_back();
+    }
+    _singlesQueue.clear();
+}
+
+// starts the search state from the givens and the candidates they leave, which setGiven and clearGiven keep current
+bool BitmaskSolver::_loadGivens() {
+    _trail.clear();
+    _singlesQueue.clear();
+    if (_conflictingGivenCount > 0) {
+        return false;
+    }
+    _values = _givens;
+    _candidates = _givenCandidates;
+    for (int cellIndex = 0; cellIndex < _cellCount; cellIndex++) {
+        if (_givens[cellIndex] == -1) {
+            const CandidateMask candidates = _candidates[cellIndex];
+            if (candidates == 0) {
+                return false;
+            }
+            if (countOfMask(candidates) == 1) {
+                _singlesQueue.push_back(cellIndex);
+            }
+        }
+    }
+    return true;
+}
+
+bool BitmaskSolver::_assign(const int cellIndex, const int value) {
+    const CandidateMask bit = bitForValue(value);
+    if ((_candidates[cellIndex] & bit) == 0) {
+        return false;
+    }
+    _saveCell(cellIndex);
+    _values[cellIndex] = value;
+    _candidates[cellIndex] = 0;
+
+    const int* peer = &_topology.peers[cellIndex * _topology.peerCount];
+    const int* peerEnd = peer + _topology.peerCount;
+    for (; peer != peerEnd; ++peer) {
+        const CandidateMask peerCandidates = _candidates[*peer];
+        if (peerCandidates & bit) {
+            _saveCell(*peer);
+            const CandidateMask remaining = peerCandidates & ~bit;
+            _candidates[*peer] = remaining;
+            if (remaining == 0) {
+                return false;
+            }
+            if ((remaining & (remaining - 1)) == 0) {
+                _singlesQueue.push_back(*peer);
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ A value that fits in only one cell of a unit goes there. A value that fits nowhere in a unit (and isn't placed
+ yet) is a contradiction.
+ */
+bool BitmaskSolver::_propagateHiddenSingles(bool& anyAssigned) {
+    const int unitCount = 3 * _size;
+    for (int unitIndex = 0; unitIndex < unitCount; unitIndex++) {
+        const int* unit = &_topology.units[unitIndex * _size];
+        CandidateMask seenOnce = 0;
+        CandidateMask seenTwice = 0;
+        CandidateMask placed = 0;
+        for (int offset = 0; offset < _size; offset++) {
+            const int cellIndex = unit[offset];
+            if (_values[cellIndex] != -1) {
+                placed |= bitForValue(_values[cellIndex]);
+            } else {
+                const CandidateMask candidates = _candidates[cellIndex];
+                seenTwice |= seenOnce & candidates;
+                seenOnce |= candidates;
+            }
+        }
+        if ((seenOnce | placed) != _allValuesMask) {
+            return false;
+        }
+        CandidateMask hidden = seenOnce & ~seenTwice;
+        while (hidden) {
+            const CandidateMask bit = hidden & (~hidden + 1);
+            hidden &= hidden - 1;
+            for (int offset = 0; offset < _size; offset++) {
+                const int cellIndex = unit[offset];
+                if (_candidates[cellIndex] & bit) {
+                    if (!_assign(cellIndex, valueForBit(bit))) {
+                        return false;
+                    }
+                    anyAssigned = true;
+                    break;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool BitmaskSolver::_propagate() {
+    while (true) {
+        while (!_singlesQueue.empty()) {
+            const int cellIndex = _singlesQueue.back();
+            _singlesQueue.pop_back();
+            if (_values[cellIndex] != -1) {
+                continue;
+            }
+            const CandidateMask candidates = _candidates[cellIndex];
+            if (candidates == 0) {
+                return false;
+            }
+            if (!_assign(cellIndex, valueForBit(candidates))) {
+                return false;
+            }
+        }
+        bool anyAssigned = false;
+        if (!_propagateHiddenSingles(anyAssigned)) {
+            return false;
+        }
+        if (!anyAssigned && _singlesQueue.empty()) {
+            return true;
+        }
+    }
+}
+
+#pragma mark - Search
+
+int BitmaskSolver::_selectBranchCell() const {
+    int result = -1;
+    int minCount = _size + 1;
+    for (int cellIndex = 0; cellIndex < _cellCount; cellIndex++) {
+        if (_values[cellIndex] == -1) {
+            const int count = countOfMask(_candidates[cellIndex]);
+            if (count < minCount) {
+                minCount = count;
+                result = cellIndex;
+                if (count <= 2) {
+                    break;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+void BitmaskSolver::_search() {
+    _nodeCount += 1;
+    if (_nodeLimit > 0 && _nodeCount > _nodeLimit) {
+        _nodeLimitReached = true;
+        return;
+    }
+
+    const int cellIndex = _selectBranchCell();
+    if (cellIndex == -1) {
+        _solutionCount += 1;
+        if (_solutionCount == 1) {
+            _solution = _values;
+        }
+        return;
+    }
+
+    CandidateMask remaining = _candidates[cellIndex];
+    int values[kMaxBitmaskGridSize];
+    int valueCount = 0;
+    while (remaining) {
+        const CandidateMask bit = remaining & (~remaining + 1);
+        remaining &= remaining - 1;
+        values[valueCount++] = valueForBit(bit);
+    }
+    if (_rng != nullptr) {
+        std::shuffle(values, values + valueCount, *_rng);
+    }
+
+    for (int valueIndex = 0; valueIndex < valueCount; valueIndex++) {
+        const size_t trailSize = _trail.size();
+        if (_assign(cellIndex, values[valueIndex]) && _propagate()) {
+            _search();
+        }
+        _undoTrail(trailSize);
+        if (_solutionCount >= _solutionLimit || _nodeLimitReached) {
+            return;
+        }
+    }
+}
+
+int BitmaskSolver::_runSearch(const int limit, std::mt19937_64* rng) {
+    _solutionCount = 0;
+    _solutionLimit = limit;
+    _nodeCount = 0;
+    _nodeLimit = 0;
+    _nodeLimitReached = false;
+    _rng = rng;
+    if (_loadGivens() && _propagate()) {
+        _search();
+    }
+    _rng = nullptr;
+    return _solutionCount;
+}
+
+int BitmaskSolver::countSolutions(const int limit) {
+    return _runSearch(limit, nullptr);
+}
+
+bool BitmaskSolver::hasUniqueSolution() {
+    return countSolutions(2) == 1;
+}
+
+/**
+ Any other solution has to differ from solution in a removed cell, or it would solve the puzzle that solution is
+ the only answer to. The first removed cell where it differs splits the search into disjoint cases: case i keeps
+ the removed cells before i at solution's values and excludes solution's value from cell i. The cases share one
+ propagated root on the trail, each one extending the last by a single assignment, and none of them contains the
+ known solution's subtree.
+ */
+bool BitmaskSolver::hasSolutionOtherThan(const IntVector& solution, const IntVector& removedCells, const long nodeLimit) {
+    _solutionCount = 0;
+    _solutionLimit = 1;
+    _nodeCount = 0;
+    _nodeLimit = nodeLimit;
+    _nodeLimitReached = false;
+    _rng = nullptr;
+    if (!_loadGivens() || !_propagate()) {
+        return false;
+    }
+    for (auto cellIndex = removedCells.begin(); cellIndex != removedCells.end(); ++cellIndex) {
+        // propagation only places a removed cell at solution's value, which leaves no case to search
+        if (_values[*cellIndex] != -1) {
+            continue;
+        }
+        const CandidateMask bit = bitForValue(solution[*cellIndex]);
+        const CandidateMask others = _candidates[*cellIndex] & ~bit;
+        if (others != 0) {
+            const size_t trailSize = _trail.size();
+            _saveCell(*cellIndex);
+            _candidates[*cellIndex] = others;
+            if ((others & (others - 1)) == 0) {
+                _singlesQueue.push_back(*cellIndex);
+            }
+            if (_propagate()) {
+                _search();
+            }
+            _undoTrail(trailSize);
+            if (_solutionCount > 0 || _nodeLimitReached) {
+                return true;
+            }
+        }
+        if (!_assign(*cellIndex, solution[*cellIndex]) || !_propagate()) {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool BitmaskSolver::findRandomSolution(std::mt19937_64& rng) {
+    return _runSearch(1, &rng) == 1;
+}
+
+#pragma mark - Enumeration
+
+bool BitmaskSolver::startEnumeration(const BranchVector& path, const int rootDepth, const bool nodeFinished) {
+    _frames.clear();
+    _nodeCount = 0;
+    _rootDepth = 0;
+    _atUnexploredNode = false;
+    if (!_loadGivens() || !_propagate()) {
+        // no solutions at all; only the empty path leads anywhere
+        return path.empty();
+    }
+    for (auto decision = path.begin(); decision != path.end(); ++decision) {
+        if (_selectBranchCell() != decision->cellIndex || decision->value < 1 || decision->value > _size) {
+            return false;
+        }
+        const CandidateMask bit = bitForValue(decision->value);
+        // the values below this one were tried before it
+        const CandidateMask later = _candidates[decision->cellIndex] & ~(bit | (bit - 1));
+        _frames.push_back(EnumerationFrame{decision->cellIndex, decision->value, later, _trail.size()});
+        if (!_assign(decision->cellIndex, decision->value) || !_propagate()) {
+            _frames.clear();
+            return false;
+        }
+    }
+    _rootDepth = std::min(rootDepth, (int)path.size());
+    _atUnexploredNode = !nodeFinished;
+    return true;
+}
+
+EnumerationStep BitmaskSolver::stepEnumeration(const long nodeBudget) {
+    long exploredCount = 0;
+    while (true) {
+        if (_atUnexploredNode) {
+            if (exploredCount >= nodeBudget) {
+                return EnumerationStep::Paused;
+            }
+            exploredCount += 1;
+            _nodeCount += 1;
+            _atUnexploredNode = false;
+            const int cellIndex = _selectBranchCell();
+            if (cellIndex == -1) {
+                return EnumerationStep::Solution;
+            }
+            _frames.push_back(EnumerationFrame{cellIndex, 0, _candidates[cellIndex], _trail.size()});
+        }
+
+        // the next untried value of the deepest frame that has one left
+        while (!_atUnexploredNode) {
+            if ((int)_frames.size() <= _rootDepth) {
+                return EnumerationStep::Exhausted;
+            }
+            EnumerationFrame& frame = _frames.back();
+            _undoTrail(frame.trailSize);
+            if (frame.remaining == 0) {
+                _frames.pop_back();
+                continue;
+            }
+            const CandidateMask bit = frame.remaining & (~frame.remaining + 1);
+            frame.remaining &= frame.remaining - 1;
+            frame.value = valueForBit(bit);
+            _atUnexploredNode = _assign(frame.cellIndex, frame.value) && _propagate();
+        }
+    }
+}
+
+void BitmaskSolver::getEnumerationPosition(BranchVector& path, bool& nodeFinished) const {
+    path.clear();
+    for (auto frame = _frames.begin(); frame != _frames.end(); ++frame) {
+        path.push_back(Branch{frame->cellIndex, frame->value});
+    }
+    nodeFinished = !_atUnexploredNode;
+}
+
+bool BitmaskSolver::branchesAt(const BranchVector& path, BranchVector& branches) {
+    branches.clear();
+    if (!startEnumeration(path, (int)path.size(), false) || !_atUnexploredNode) {
+        return false;
+    }
+    const int cellIndex = _selectBranchCell();
+    if (cellIndex == -1) {
+        return false;
+    }
+    CandidateMask remaining = _candidates[cellIndex];
+    while (remaining) {
+        const CandidateMask bit = remaining & (~remaining + 1);
+        remaining &= remaining - 1;
+        const size_t trailSize = _trail.size();
+        if (_assign(cellIndex, valueForBit(bit)) && _propagate()) {
+            branches.push_back(Branch{cellIndex, valueForBit(bit)});
+        }
+        _undoTrail(trailSize);
+    }
+    return true;
+}
+
+const IntVector& BitmaskSolver::getValues() const {
+    return _values;
+}
+
+const IntVector& BitmaskSolver::getSolution() const {
+    return _solution;
+}
+
+long BitmaskSolver::getNodeCount() const {
+    return _nodeCount;
+}
+
+#pragma mark - Conversion
+
+Grid BitmaskSolver::solutionGrid() const {
+    Grid result(_size);
+    if (_solution.size() == (size_t)_cellCount) {
+        for (int cellIndex = 0; cellIndex < _cellCount; cellIndex++) {
+            result.setCellValue(cellIndex, _solution[cellIndex]);
+        }
+    }
+    return result;
+}
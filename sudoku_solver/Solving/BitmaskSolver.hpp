@@ -0,0 +1,179 @@
+//
+//  BitmaskSolver.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef BitmaskSolver_hpp
+#define BitmaskSolver_hpp
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "BranchSelector.hpp"
+#include "Grid.hpp"
+
+typedef uint64_t CandidateMask;
+typedef std::vector<int> IntVector;
+typedef std::vector<CandidateMask> CandidateMaskVector;
+
+inline CandidateMask bitForValue(const int value) {
+    return ((CandidateMask)1) << (value - 1);
+}
+
+inline int valueForBit(const CandidateMask bit) {
+    return __builtin_ctzll(bit) + 1;
+}
+
+inline int countOfMask(const CandidateMask mask) {
+    return __builtin_popcountll(mask);
+}
+
+/**
+ Flat cell/unit/peer tables for one grid size, shared by every BitmaskSolver of that size.
+
+ units: 3 * size units (rows, then columns, then subgrids) of size cell indices each
+ peers: peerCount cell indices per cell (every other cell sharing a row, column or subgrid)
+ peerBits: the same peers as a cell bit set of cellWordCount words per cell
+ */
+struct BitmaskTopology {
+    int size;
+    int subSize;
+    int cellCount;
+    int peerCount;
+    int cellWordCount;
+    IntVector units;
+    IntVector peers;
+    std::vector<uint64_t> peerBits;
+    IntVector rowOfCell;
+    IntVector columnOfCell;
+    IntVector subgridOfCell;
+
+    size_t getMemoryFootprint() const;
+
+    static const BitmaskTopology& topologyForSize(const int size);
+};
+
+enum class EnumerationStep {
+    Solution,       // getValues holds a solution
+    Paused,         // the node budget ran out; the next step carries on
+    Exhausted       // every solution below the enumeration's root has been seen
+};
+
+/**
+ Compact search engine for counting and finding solutions quickly, used where the same puzzle is solved
+ over and over (generation, uniqueness checks).
+
+ Candidates are one bit per value, so grids up to 64x64 are supported. The givens are kept separately from the
+ search state together with per-row/column/subgrid "used" masks; setGiven and clearGiven update those masks in
+ place, together with the candidates they leave each empty cell, so adding or removing a clue never requires
+ re-reading the whole puzzle. Every search starts from those candidates and propagates naked and hidden singles on
+ an undo trail instead of copying grids.
+
+ Enumeration walks the same search tree with an explicit stack instead of recursion, so it can stop after any node
+ and pick up again later, in another solver or process, from the decisions that lead to where it stopped. Branch
+ cells are chosen deterministically and values are tried in ascending order, so a decision path always leads back
+ to the same node.
+ */
+class BitmaskSolver {
+    struct TrailEntry {
+        int cellIndex;
+        int value;
+        CandidateMask candidates;
+    };
+
+    const BitmaskTopology& _topology;
+    int _size;
+    int _cellCount;
+    CandidateMask _allValuesMask;
+
+    IntVector _givens;
+    int _givenCount;
+    int _conflictingGivenCount;
+    CandidateMaskVector _rowUsed;
+    CandidateMaskVector _columnUsed;
+    CandidateMaskVector _subgridUsed;
+    CandidateMaskVector _givenCandidates;   // each empty cell's candidates from the used masks alone
+
+    IntVector _values;
+    CandidateMaskVector _candidates;
+    std::vector<TrailEntry> _trail;
+    IntVector _singlesQueue;
+
+    struct EnumerationFrame {
+        int cellIndex;
+        int value;
+        CandidateMask remaining;        // values not tried yet
+        size_t trailSize;               // before value was assigned
+    };
+
+    IntVector _solution;
+    int _solutionCount;
+    int _solutionLimit;
+    long _nodeCount;
+    long _nodeLimit;                // 0 for none
+    bool _nodeLimitReached;
+    std::mt19937_64* _rng;
+
+    std::vector<EnumerationFrame> _frames;
+    int _rootDepth;
+    bool _atUnexploredNode;
+
+    void _updateGivenCandidates(const int cellIndex);
+    bool _loadGivens();
+    void _saveCell(const int cellIndex);
+    void _undoTrail(const size_t trailSize);
+    bool _assign(const int cellIndex, const int value);
+    bool _propagate();
+    bool _propagateHiddenSingles(bool& anyAssigned);
+    int _selectBranchCell() const;
+    void _search();
+    int _runSearch(const int limit, std::mt19937_64* rng);
+
+public:
+    BitmaskSolver(const int size);
+    BitmaskSolver(const Grid& grid);
+
+    static bool supportsSize(const int size);
+
+    int getSize() const;
+    int getCellCount() const;
+
+    void clearGivens();
+    bool setGiven(const int cellIndex, const int value);
+    void clearGiven(const int cellIndex);
+    int getGiven(const int cellIndex) const;
+    int getGivenCount() const;
+
+    // counts solutions of the current givens, stopping as soon as limit solutions were seen
+    int countSolutions(const int limit);
+    bool hasUniqueSolution();
+    // whether the givens allow a solution other than solution, given that solution is the only one once the
+    // removedCells get their values back; only a solution that differs in a removed cell is searched for. A search
+    // that runs past nodeLimit nodes (0 for no limit) couldn't rule one out and counts as true
+    bool hasSolutionOtherThan(const IntVector& solution, const IntVector& removedCells, const long nodeLimit);
+    // finds one solution, trying values of each branch cell in random order
+    bool findRandomSolution(std::mt19937_64& rng);
+
+    // positions the enumeration at the node path leads to (replaying the decisions from the givens) and never
+    // backtracks above its first rootDepth decisions; nodeFinished says that node was already explored. false when
+    // the path doesn't lead anywhere in this puzzle's tree
+    bool startEnumeration(const BranchVector& path, const int rootDepth, const bool nodeFinished);
+    // explores up to nodeBudget nodes, stopping early at a solution
+    EnumerationStep stepEnumeration(const long nodeBudget);
+    // where a later startEnumeration picks up after the last step (Solution or Paused)
+    void getEnumerationPosition(BranchVector& path, bool& nodeFinished) const;
+    // the branches of the node path leads to that propagation doesn't refute, in enumeration order; false when that
+    // node is a solution or dead already
+    bool branchesAt(const BranchVector& path, BranchVector& branches);
+    const IntVector& getValues() const;
+
+    const IntVector& getSolution() const;
+    long getNodeCount() const;
+
+    Grid solutionGrid() const;
+};
+
+#endif /* BitmaskSolver_hpp */
@@ -0,0 +1,565 @@
+//
+//  BitmaskTechniques.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "BitmaskTechniques.hpp"
+
+#include <algorithm>
+
+// almost locked sets are found by enumerating subsets of each unit, so both their size and their number are capped
+static const int kMaxAlmostLockedSetCount = 2000;
+
+// larger subsets only for small grids, where units have few open cells
+static int maxAlmostLockedSetCellCount(const int size) {
+    return size <= 9 ? 4 : size <= 16 ? 3 : 2;
+}
+
+static inline CandidateMask lowestBit(const CandidateMask mask) {
+    return mask & (~mask + 1);
+}
+
+BitmaskTechniques::BitmaskTechniques(const Grid& grid) : _topology(BitmaskTopology::topologyForSize(supportsSize(grid.getSize()) ? grid.getSize() : 1)) {
+    _size = _topology.size;
+    _cellCount = _topology.cellCount;
+    _wordCount = _topology.cellWordCount;
+    _candidates.assign(_cellCount, 0);
+    _cellsWithCandidate.assign(_size, CellBits(_wordCount, 0));
+    if (grid.getSize() != _size) {
+        return;
+    }
+
+    for (int cellIndex = 0; cellIndex < _cellCount; cellIndex++) {
+        const Cell& cell = grid.cellAtIndex(cellIndex);
+        if (cell.getValue() != -1) {
+            continue;
+        }
+        const IntSet& candidates = cell.getCandidates();
+        for (auto candidate = candidates.begin(); candidate != candidates.end(); ++candidate) {
+            if (*candidate >= 1 && *candidate <= _size) {
+                _candidates[cellIndex] |= bitForValue(*candidate);
+                _cellsWithCandidate[*candidate - 1][cellIndex / 64] |= ((uint64_t)1) << (cellIndex % 64);
+            }
+        }
+    }
+}
+
+bool BitmaskTechniques::supportsSize(const int size) {
+    return BitmaskSolver::supportsSize(size);
+}
+
+#pragma mark - Helpers
+
+void BitmaskTechniques::_eliminateFromCells(const CellBits& cells, const CandidateMask candidates, EliminationVector& eliminations) const {
+    for (int word = 0; word < _wordCount; word++) {
+        uint64_t bits = cells[word];
+        while (bits) {
+            const int cellIndex = word * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            const CandidateMask removed = _candidates[cellIndex] & candidates;
+            if (removed) {
+                eliminations.push_back(Elimination{cellIndex, removed});
+            }
+        }
+    }
+}
+
+// removes value from every cell that sees all of cellIndices
+void BitmaskTechniques::_eliminateFromCommonPeers(const IntVector& cellIndices, const int value, EliminationVector& eliminations) const {
+    CellBits targets = _cellsWithCandidate[value - 1];
+    for (auto cellIndex = cellIndices.begin(); cellIndex != cellIndices.end(); ++cellIndex) {
+        const uint64_t* peers = _peersOf(*cellIndex);
+        for (int word = 0; word < _wordCount; word++) {
+            targets[word] &= peers[word];
+        }
+    }
+    for (auto cellIndex = cellIndices.begin(); cellIndex != cellIndices.end(); ++cellIndex) {
+        targets[*cellIndex / 64] &= ~(((uint64_t)1) << (*cellIndex % 64));
+    }
+    _eliminateFromCells(targets, bitForValue(value), eliminations);
+}
+
+int BitmaskTechniques::_countInUnit(const int unitIndex, const CandidateMask bit) const {
+    const int* unit = &_topology.units[unitIndex * _size];
+    int count = 0;
+    for (int offset = 0; offset < _size; offset++) {
+        if (_candidates[unit[offset]] & bit) {
+            count += 1;
+        }
+    }
+    return count;
+}
+
+#pragma mark - Wings
+
+/**
+ A bivalue pivot {x, y} with two bivalue pincers it sees, {x, z} and {y, z}: whichever value the pivot takes, one
+ pincer is z, so z goes from every cell that sees both pincers.
+ */
+bool BitmaskTechniques::findXYWings(EliminationVector& eliminations) const {
+    const size_t initialCount = eliminations.size();
+    IntVector pincers;
+    for (int pivot = 0; pivot < _cellCount; pivot++) {
+        const CandidateMask pivotCandidates = _candidates[pivot];
+        if (countOfMask(pivotCandidates) != 2) {
+            continue;
+        }
+        pincers.clear();
+        const int* peer = &_topology.peers[pivot * _topology.peerCount];
+        for (int i = 0; i < _topology.peerCount; i++) {
+            const CandidateMask candidates = _candidates[peer[i]];
+            if (countOfMask(candidates) == 2 && countOfMask(candidates & pivotCandidates) == 1) {
+                pincers.push_back(peer[i]);
+            }
+        }
+        for (size_t i = 0; i < pincers.size(); i++) {
+            for (size_t j = i + 1; j < pincers.size(); j++) {
+                const CandidateMask first = _candidates[pincers[i]];
+                const CandidateMask second = _candidates[pincers[j]];
+                const CandidateMask z = first & ~pivotCandidates;
+                if ((first & pivotCandidates) != (second & pivotCandidates) && z == (second & ~pivotCandidates)) {
+                    _eliminateFromCommonPeers(IntVector({pincers[i], pincers[j]}), valueForBit(z), eliminations);
+                }
+            }
+        }
+    }
+    return eliminations.size() > initialCount;
+}
+
+/**
+ Like an XY-Wing with a pivot {x, y, z}: z is in the pivot or one of the pincers, so only cells that see all three
+ lose it.
+ */
+bool BitmaskTechniques::findXYZWings(EliminationVector& eliminations) const {
+    const size_t initialCount = eliminations.size();
+    IntVector pincers;
+    for (int pivot = 0; pivot < _cellCount; pivot++) {
+        const CandidateMask pivotCandidates = _candidates[pivot];
+        if (countOfMask(pivotCandidates) != 3) {
+            continue;
+        }
+        pincers.clear();
+        const int* peer = &_topology.peers[pivot * _topology.peerCount];
+        for (int i = 0; i < _topology.peerCount; i++) {
+            const CandidateMask candidates = _candidates[peer[i]];
+            if (countOfMask(candidates) == 2 && (candidates & ~pivotCandidates) == 0) {
+                pincers.push_back(peer[i]);
+            }
+        }
+        for (size_t i = 0; i < pincers.size(); i++) {
+            for (size_t j = i + 1; j < pincers.size(); j++) {
+                const CandidateMask first = _candidates[pincers[i]];
+                const CandidateMask second = _candidates[pincers[j]];
+                if (first != second) {
+                    _eliminateFromCommonPeers(IntVector({pivot, pincers[i], pincers[j]}), valueForBit(first & second), eliminations);
+                }
+            }
+        }
+    }
+    return eliminations.size() > initialCount;
+}
+
+/**
+ Two bivalue cells with the same {x, y} that don't see each other, joined by a strong link on x (a unit with x in
+ exactly two cells, one seeing each of them): one of the two cells must be y, so y goes from their common peers.
+ */
+bool BitmaskTechniques::findWWings(EliminationVector& eliminations) const {
+    const size_t initialCount = eliminations.size();
+
+    // strong links as pairs of cells, by value - 1
+    std::vector<IntVector> strongLinks(_size);
+    for (int unitIndex = 0; unitIndex < 3 * _size; unitIndex++) {
+        const int* unit = &_topology.units[unitIndex * _size];
+        for (int value = 1; value <= _size; value++) {
+            const CandidateMask bit = bitForValue(value);
+            int positions[2];
+            int positionCount = 0;
+            for (int offset = 0; offset < _size && positionCount <= 2; offset++) {
+                if (_candidates[unit[offset]] & bit) {
+                    if (positionCount < 2) {
+                        positions[positionCount] = unit[offset];
+                    }
+                    positionCount += 1;
+                }
+            }
+            if (positionCount == 2) {
+                strongLinks[value - 1].push_back(positions[0]);
+                strongLinks[value - 1].push_back(positions[1]);
+            }
+        }
+    }
+
+    IntVector bivalueCells;
+    for (int cellIndex = 0; cellIndex < _cellCount; cellIndex++) {
+        if (countOfMask(_candidates[cellIndex]) == 2) {
+            bivalueCells.push_back(cellIndex);
+        }
+    }
+    for (size_t i = 0; i < bivalueCells.size(); i++) {
+        const int first = bivalueCells[i];
+        for (size_t j = i + 1; j < bivalueCells.size(); j++) {
+            const int second = bivalueCells[j];
+            const CandidateMask pair = _candidates[first];
+            if (_candidates[second] != pair || _isPeer(first, second)) {
+                continue;
+            }
+            for (CandidateMask rest = pair; rest != 0; rest &= rest - 1) {
+                const CandidateMask x = lowestBit(rest);
+                const IntVector& links = strongLinks[valueForBit(x) - 1];
+                for (size_t link = 0; link < links.size(); link += 2) {
+                    const int c = links[link];
+                    const int d = links[link + 1];
+                    if (c == first || c == second || d == first || d == second) {
+                        continue;
+                    }
+                    if ((_isPeer(c, first) && _isPeer(d, second)) || (_isPeer(c, second) && _isPeer(d, first))) {
+                        _eliminateFromCommonPeers(IntVector({first, second}), valueForBit(pair & ~x), eliminations);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    return eliminations.size() > initialCount;
+}
+
+#pragma mark - Uniqueness
+
+/**
+ The roof of a unique rectangle: the two corners that have more than the pair {x, y}, which share a row or column.
+ At least one of them must take one of its extra values, or x and y could be swapped around the rectangle.
+ */
+bool BitmaskTechniques::_uniqueRectangleRoof(const int roofA, const int roofB, const CandidateMask pair, EliminationVector& eliminations) const {
+    const size_t initialCount = eliminations.size();
+    const CandidateMask extrasA = _candidates[roofA] & ~pair;
+    const CandidateMask extrasB = _candidates[roofB] & ~pair;
+
+    // type 2: the same single extra z in both, so one of them is z
+    if (extrasA == extrasB && countOfMask(extrasA) == 1) {
+        _eliminateFromCommonPeers(IntVector({roofA, roofB}), valueForBit(extrasA), eliminations);
+    }
+
+    IntVector sharedUnits;
+    if (_topology.rowOfCell[roofA] == _topology.rowOfCell[roofB]) {
+        sharedUnits.push_back(_topology.rowOfCell[roofA]);
+    }
+    if (_topology.columnOfCell[roofA] == _topology.columnOfCell[roofB]) {
+        sharedUnits.push_back(_size + _topology.columnOfCell[roofA]);
+    }
+    if (_topology.subgridOfCell[roofA] == _topology.subgridOfCell[roofB]) {
+        sharedUnits.push_back(2 * _size + _topology.subgridOfCell[roofA]);
+    }
+
+    const CandidateMask extras = extrasA | extrasB;
+    for (auto unitIndex = sharedUnits.begin(); unitIndex != sharedUnits.end(); ++unitIndex) {
+        // type 4: x only in the roof within this unit, so both roof cells can't be y
+        for (CandidateMask rest = pair; rest != 0; rest &= rest - 1) {
+            const CandidateMask bit = lowestBit(rest);
+            if (_countInUnit(*unitIndex, bit) == 2) {
+                const CandidateMask other = pair & ~bit;
+                eliminations.push_back(Elimination{roofA, other});
+                eliminations.push_back(Elimination{roofB, other});
+            }
+        }
+
+        // type 3: the roof acts as one cell with the extras as candidates; look for a naked subset with it
+        const int* unit = &_topology.units[*unitIndex * _size];
+        IntVector others;
+        for (int offset = 0; offset < _size; offset++) {
+            const int cellIndex = unit[offset];
+            if (cellIndex != roofA && cellIndex != roofB && _candidates[cellIndex] != 0 && countOfMask(_candidates[cellIndex] | extras) <= 4) {
+                others.push_back(cellIndex);
+            }
+        }
+        // n cells plus the roof with n + 1 candidates between them lock those candidates in the unit
+        auto eliminateLockedCandidates = [&](const IntVector& subset) {
+            CandidateMask locked = extras;
+            for (auto cellIndex = subset.begin(); cellIndex != subset.end(); ++cellIndex) {
+                locked |= _candidates[*cellIndex];
+            }
+            if (countOfMask(locked) != (int)subset.size() + 1) {
+                return;
+            }
+            for (int offset = 0; offset < _size; offset++) {
+                const int cellIndex = unit[offset];
+                const CandidateMask removed = _candidates[cellIndex] & locked;
+                if (removed && cellIndex != roofA && cellIndex != roofB && std::find(subset.begin(), subset.end(), cellIndex) == subset.end()) {
+                    eliminations.push_back(Elimination{cellIndex, removed});
+                }
+            }
+        };
+        const size_t otherCount = others.size();
+        for (size_t i = 0; i < otherCount; i++) {
+            eliminateLockedCandidates(IntVector({others[i]}));
+            for (size_t j = i + 1; j < otherCount; j++) {
+                eliminateLockedCandidates(IntVector({others[i], others[j]}));
+                for (size_t k = j + 1; k < otherCount; k++) {
+                    eliminateLockedCandidates(IntVector({others[i], others[j], others[k]}));
+                }
+            }
+        }
+    }
+    return eliminations.size() > initialCount;
+}
+
+/**
+ Four cells in two rows, two columns and two subgrids that all hold the pair {x, y} would let a unique puzzle swap
+ x and y, so some corner must take another value.
+
+ - type 1: three corners are exactly {x, y}, so the fourth loses x and y;
+ - types 2 to 4: two corners sharing a row or column are exactly {x, y} (see _uniqueRectangleRoof for the others).
+ */
+bool BitmaskTechniques::findUniqueRectangles(EliminationVector& eliminations) const {
+    const size_t initialCount = eliminations.size();
+    const int subSize = _topology.subSize;
+    for (int firstRow = 0; firstRow < _size; firstRow++) {
+        for (int secondRow = firstRow + 1; secondRow < _size; secondRow++) {
+            const bool sameBand = firstRow / subSize == secondRow / subSize;
+            for (int firstColumn = 0; firstColumn < _size; firstColumn++) {
+                const CandidateMask columnCommon = _candidates[firstRow * _size + firstColumn] & _candidates[secondRow * _size + firstColumn];
+                if (countOfMask(columnCommon) < 2) {
+                    continue;
+                }
+                for (int secondColumn = firstColumn + 1; secondColumn < _size; secondColumn++) {
+                    // exactly two subgrids
+                    if (sameBand == (firstColumn / subSize == secondColumn / subSize)) {
+                        continue;
+                    }
+                    const int corners[4] = {
+                        firstRow * _size + firstColumn, firstRow * _size + secondColumn,
+                        secondRow * _size + firstColumn, secondRow * _size + secondColumn
+                    };
+                    const CandidateMask common = columnCommon & _candidates[corners[1]] & _candidates[corners[3]];
+                    if (countOfMask(common) < 2) {
+                        continue;
+                    }
+                    for (CandidateMask xRest = common; xRest != 0; xRest &= xRest - 1) {
+                        for (CandidateMask yRest = xRest & (xRest - 1); yRest != 0; yRest &= yRest - 1) {
+                            const CandidateMask pair = lowestBit(xRest) | lowestBit(yRest);
+                            int exactCount = 0;
+                            int exactMask = 0;
+                            for (int corner = 0; corner < 4; corner++) {
+                                if (_candidates[corners[corner]] == pair) {
+                                    exactCount += 1;
+                                    exactMask |= 1 << corner;
+                                }
+                            }
+                            if (exactCount == 3) {
+                                for (int corner = 0; corner < 4; corner++) {
+                                    if ((exactMask & (1 << corner)) == 0) {
+                                        eliminations.push_back(Elimination{corners[corner], pair});
+                                    }
+                                }
+                            } else if (exactCount == 2 && exactMask != 0x9 && exactMask != 0x6) {
+                                // the roof is the two corners that aren't exact; diagonal floors don't count
+                                IntVector roof;
+                                for (int corner = 0; corner < 4; corner++) {
+                                    if ((exactMask & (1 << corner)) == 0) {
+                                        roof.push_back(corners[corner]);
+                                    }
+                                }
+                                _uniqueRectangleRoof(roof[0], roof[1], pair, eliminations);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return eliminations.size() > initialCount;
+}
+
+/**
+ Bivalue Universal Grave + 1: every open cell has two candidates except one with three. If that cell weren't the
+ value that appears three times in its units, every value would appear exactly twice per unit and the puzzle would
+ have two solutions.
+ */
+bool BitmaskTechniques::findBugPlusOne(EliminationVector& eliminations) const {
+    int tripleCell = -1;
+    for (int cellIndex = 0; cellIndex < _cellCount; cellIndex++) {
+        const int count = countOfMask(_candidates[cellIndex]);
+        if (count == 0 || count == 2) {
+            continue;
+        }
+        if (count != 3 || tripleCell != -1) {
+            return false;
+        }
+        tripleCell = cellIndex;
+    }
+    if (tripleCell == -1) {
+        return false;
+    }
+
+    const CandidateMask candidates = _candidates[tripleCell];
+    const int rowUnit = _topology.rowOfCell[tripleCell];
+    const int columnUnit = _size + _topology.columnOfCell[tripleCell];
+    const int subgridUnit = 2 * _size + _topology.subgridOfCell[tripleCell];
+    for (CandidateMask rest = candidates; rest != 0; rest &= rest - 1) {
+        const CandidateMask bit = lowestBit(rest);
+        if (_countInUnit(rowUnit, bit) == 3 && _countInUnit(columnUnit, bit) == 3 && _countInUnit(subgridUnit, bit) == 3) {
+            eliminations.push_back(Elimination{tripleCell, candidates & ~bit});
+            return true;
+        }
+    }
+    return false;
+}
+
+#pragma mark - Almost locked sets
+
+/**
+ An almost locked set is n cells of one unit with n + 1 candidates between them. Each set is collected once: single
+ cells only from their row, and subgrid subsets only when they don't lie in one row or column.
+ */
+void BitmaskTechniques::_collectAlmostLockedSets(const int maxCellCount, std::vector<AlmostLockedSet>& sets) const {
+    IntVector chosen;
+    for (int unitIndex = 0; unitIndex < 3 * _size; unitIndex++) {
+        const bool isSubgrid = unitIndex >= 2 * _size;
+        const int* unit = &_topology.units[unitIndex * _size];
+        IntVector cells;
+        for (int offset = 0; offset < _size; offset++) {
+            const int count = countOfMask(_candidates[unit[offset]]);
+            if (count >= 2 && count <= maxCellCount + 1) {
+                cells.push_back(unit[offset]);
+            }
+        }
+
+        // subsets in increasing index order, as a stack of positions in cells
+        IntVector positions;
+        std::vector<CandidateMask> masks;
+        int next = 0;
+        while (true) {
+            if (next < (int)cells.size() && (int)positions.size() < maxCellCount) {
+                const CandidateMask mask = (masks.empty() ? 0 : masks.back()) | _candidates[cells[next]];
+                if (countOfMask(mask) > maxCellCount + 1) {
+                    // no superset can be almost locked either
+                    next += 1;
+                    continue;
+                }
+                positions.push_back(next);
+                masks.push_back(mask);
+                next += 1;
+
+                const int cellCount = (int)positions.size();
+                if (countOfMask(mask) != cellCount + 1 || (cellCount == 1 && unitIndex >= _size)) {
+                    continue;
+                }
+                bool sameRow = true;
+                bool sameColumn = true;
+                for (int i = 1; i < cellCount; i++) {
+                    sameRow = sameRow && _topology.rowOfCell[cells[positions[i]]] == _topology.rowOfCell[cells[positions[0]]];
+                    sameColumn = sameColumn && _topology.columnOfCell[cells[positions[i]]] == _topology.columnOfCell[cells[positions[0]]];
+                }
+                if (isSubgrid && (sameRow || sameColumn)) {
+                    continue;
+                }
+
+                AlmostLockedSet set;
+                set.candidates = mask;
+                set.cells.assign(_wordCount, 0);
+                for (int i = 0; i < cellCount; i++) {
+                    const int cellIndex = cells[positions[i]];
+                    set.cells[cellIndex / 64] |= ((uint64_t)1) << (cellIndex % 64);
+                }
+                for (CandidateMask rest = mask; rest != 0; rest &= rest - 1) {
+                    const CandidateMask bit = lowestBit(rest);
+                    CellBits withValue(_wordCount, 0);
+                    CellBits seenByAll(_wordCount, ~(uint64_t)0);
+                    for (int i = 0; i < cellCount; i++) {
+                        const int cellIndex = cells[positions[i]];
+                        if (_candidates[cellIndex] & bit) {
+                            withValue[cellIndex / 64] |= ((uint64_t)1) << (cellIndex % 64);
+                            const uint64_t* peers = _peersOf(cellIndex);
+                            for (int word = 0; word < _wordCount; word++) {
+                                seenByAll[word] &= peers[word];
+                            }
+                        }
+                    }
+                    set.values.push_back(valueForBit(bit));
+                    set.cellsWithValue.push_back(withValue);
+                    set.seenByAll.push_back(seenByAll);
+                }
+                sets.push_back(set);
+                if ((int)sets.size() >= kMaxAlmostLockedSetCount) {
+                    return;
+                }
+            } else {
+                if (positions.empty()) {
+                    break;
+                }
+                next = positions.back() + 1;
+                positions.pop_back();
+                masks.pop_back();
+            }
+        }
+    }
+}
+
+static int indexOfValue(const IntVector& values, const int value) {
+    for (int i = 0; i < (int)values.size(); i++) {
+        if (values[i] == value) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ Two almost locked sets A and B with no cell in common and a restricted common value x: every x of A sees every x
+ of B, so x is in at most one of them and the other becomes a locked set. For any other common value z, one of the
+ sets holds z, so z goes from every cell that sees all of A's and B's z cells.
+ */
+bool BitmaskTechniques::findAlmostLockedSetsXZ(EliminationVector& eliminations) const {
+    const size_t initialCount = eliminations.size();
+    std::vector<AlmostLockedSet> sets;
+    _collectAlmostLockedSets(maxAlmostLockedSetCellCount(_size), sets);
+
+    CellBits targets(_wordCount);
+    for (size_t i = 0; i < sets.size(); i++) {
+        const AlmostLockedSet& first = sets[i];
+        for (size_t j = i + 1; j < sets.size(); j++) {
+            const AlmostLockedSet& second = sets[j];
+            const CandidateMask common = first.candidates & second.candidates;
+            if (countOfMask(common) < 2) {
+                continue;
+            }
+            bool overlapping = false;
+            for (int word = 0; word < _wordCount && !overlapping; word++) {
+                overlapping = (first.cells[word] & second.cells[word]) != 0;
+            }
+            if (overlapping) {
+                continue;
+            }
+
+            for (CandidateMask xRest = common; xRest != 0; xRest &= xRest - 1) {
+                const CandidateMask x = lowestBit(xRest);
+                const int xValue = valueForBit(x);
+                const CellBits& secondXCells = second.cellsWithValue[indexOfValue(second.values, xValue)];
+                const CellBits& seenByFirstXCells = first.seenByAll[indexOfValue(first.values, xValue)];
+                bool restricted = true;
+                for (int word = 0; word < _wordCount && restricted; word++) {
+                    restricted = (secondXCells[word] & ~seenByFirstXCells[word]) == 0;
+                }
+                if (!restricted) {
+                    continue;
+                }
+                for (CandidateMask zRest = common; zRest != 0; zRest &= zRest - 1) {
+                    const CandidateMask z = lowestBit(zRest);
+                    if (z == x) {
+                        continue;
+                    }
+                    const int zValue = valueForBit(z);
+                    const CellBits& firstSeen = first.seenByAll[indexOfValue(first.values, zValue)];
+                    const CellBits& secondSeen = second.seenByAll[indexOfValue(second.values, zValue)];
+                    const CellBits& withZ = _cellsWithCandidate[zValue - 1];
+                    for (int word = 0; word < _wordCount; word++) {
+                        targets[word] = firstSeen[word] & secondSeen[word] & withZ[word] & ~first.cells[word] & ~second.cells[word];
+                    }
+                    _eliminateFromCells(targets, z, eliminations);
+                }
+            }
+        }
+    }
+    return eliminations.size() > initialCount;
+}
@@ -0,0 +1,82 @@
+//
+//  BitmaskTechniques.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef BitmaskTechniques_hpp
+#define BitmaskTechniques_hpp
+
+#include <cstdint>
+#include <vector>
+
+#include "BitmaskSolver.hpp"
+#include "Grid.hpp"
+
+typedef std::vector<uint64_t> CellBits;
+
+struct Elimination {
+    int cellIndex;
+    CandidateMask candidates;
+};
+
+typedef std::vector<Elimination> EliminationVector;
+
+/**
+ Wing, uniqueness and almost-locked-set techniques on a bitmask snapshot of a grid's candidates, used by
+ ConstraintSolver once its own techniques stall.
+
+ Candidates are one bit per value and sets of cells are bit sets with the topology's precomputed peer sets, so
+ "cells that see both pincers and still have z" is an AND of three cell sets. Every finder only reports the
+ eliminations it found (several per call when the grid allows); the caller applies them.
+
+ Unique rectangles and BUG+1 assume the puzzle has exactly one solution.
+ */
+class BitmaskTechniques {
+    struct AlmostLockedSet {
+        CandidateMask candidates;
+        CellBits cells;
+        IntVector values;
+        std::vector<CellBits> cellsWithValue;   // parallel to values
+        std::vector<CellBits> seenByAll;        // cells that see every cell of the set holding that value
+    };
+
+    const BitmaskTopology& _topology;
+    int _size;
+    int _cellCount;
+    int _wordCount;
+
+    CandidateMaskVector _candidates;            // 0 for answered cells
+    std::vector<CellBits> _cellsWithCandidate;  // by value - 1
+
+    inline bool _isPeer(const int cellIndex, const int other) const {
+        return (_topology.peerBits[cellIndex * _wordCount + other / 64] >> (other % 64)) & 1;
+    }
+    inline const uint64_t* _peersOf(const int cellIndex) const {
+        return &_topology.peerBits[cellIndex * _wordCount];
+    }
+
+    void _eliminateFromCells(const CellBits& cells, const CandidateMask candidates, EliminationVector& eliminations) const;
+    void _eliminateFromCommonPeers(const IntVector& cellIndices, const int value, EliminationVector& eliminations) const;
+    int _countInUnit(const int unitIndex, const CandidateMask bit) const;
+
+    bool _uniqueRectangleRoof(const int roofA, const int roofB, const CandidateMask pair, EliminationVector& eliminations) const;
+    void _collectAlmostLockedSets(const int maxCellCount, std::vector<AlmostLockedSet>& sets) const;
+
+public:
+    BitmaskTechniques(const Grid& grid);
+
+    // grids up to 64x64
+    static bool supportsSize(const int size);
+
+    bool findXYWings(EliminationVector& eliminations) const;
+    bool findXYZWings(EliminationVector& eliminations) const;
+    bool findWWings(EliminationVector& eliminations) const;
+    // types 1 to 4
+    bool findUniqueRectangles(EliminationVector& eliminations) const;
+    bool findBugPlusOne(EliminationVector& eliminations) const;
+    bool findAlmostLockedSetsXZ(EliminationVector& eliminations) const;
+};
+
+#endif /* BitmaskTechniques_hpp */
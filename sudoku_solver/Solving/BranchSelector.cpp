@@ -0,0 +1,210 @@
+//
+//  BranchSelector.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "BranchSelector.hpp"
+
+#include <algorithm>
+
+BranchSelector::BranchSelector(const BranchingStrategy strategy, const ValueOrdering valueOrdering) : _strategy(strategy), _valueOrdering(valueOrdering) {}
+
+#pragma mark - Cells of units and peers
+
+// every other cell in the row, column and subgrid of cellIndex, each listed once
+static IntVector peerIndicesOfCell(const Grid& grid, const int cellIndex) {
+    const int size = grid.getSize();
+    const int subSize = grid.getSubSize();
+    const int row = grid.rowOfCellIndex(cellIndex);
+    const int column = grid.columnOfCellIndex(cellIndex);
+    IntVector result;
+    for (int i = 0; i < size; i++) {
+        if (i != column) {
+            result.push_back(grid.indexAtRowAndColumn(row, i));
+        }
+        if (i != row) {
+            result.push_back(grid.indexAtRowAndColumn(i, column));
+        }
+    }
+    const int startRow = (row / subSize) * subSize;
+    const int startColumn = (column / subSize) * subSize;
+    for (int currentRow = startRow; currentRow < startRow + subSize; currentRow++) {
+        for (int currentColumn = startColumn; currentColumn < startColumn + subSize; currentColumn++) {
+            if (currentRow != row && currentColumn != column) {
+                result.push_back(grid.indexAtRowAndColumn(currentRow, currentColumn));
+            }
+        }
+    }
+    return result;
+}
+
+// units 0 to size - 1 are the rows, then come the columns and then the subgrids
+static IntVector cellIndicesOfUnit(const Grid& grid, const int unitIndex) {
+    const int size = grid.getSize();
+    const int subSize = grid.getSubSize();
+    IntVector result;
+    if (unitIndex < size) {
+        for (int column = 0; column < size; column++) {
+            result.push_back(grid.indexAtRowAndColumn(unitIndex, column));
+        }
+    } else if (unitIndex < 2 * size) {
+        for (int row = 0; row < size; row++) {
+            result.push_back(grid.indexAtRowAndColumn(row, unitIndex - size));
+        }
+    } else {
+        const int subgridIndex = unitIndex - 2 * size;
+        const int startRow = (subgridIndex / subSize) * subSize;
+        const int startColumn = (subgridIndex % subSize) * subSize;
+        for (int row = startRow; row < startRow + subSize; row++) {
+            for (int column = startColumn; column < startColumn + subSize; column++) {
+                result.push_back(grid.indexAtRowAndColumn(row, column));
+            }
+        }
+    }
+    return result;
+}
+
+static int unansweredPeerCount(const Grid& grid, const int cellIndex) {
+    const IntVector peers = peerIndicesOfCell(grid, cellIndex);
+    int result = 0;
+    for (auto peer = peers.begin(); peer != peers.end(); ++peer) {
+        if (grid.cellAtIndex(*peer).getValue() == -1) {
+            result += 1;
+        }
+    }
+    return result;
+}
+
+// number of peer candidates that placing value in the cell would remove
+static int constrainedPeerCount(const Grid& grid, const Branch& branch) {
+    const IntVector peers = peerIndicesOfCell(grid, branch.cellIndex);
+    int result = 0;
+    for (auto peer = peers.begin(); peer != peers.end(); ++peer) {
+        const IntSet& candidates = grid.cellAtIndex(*peer).getCandidates();
+        if (candidates.find(branch.value) != candidates.end()) {
+            result += 1;
+        }
+    }
+    return result;
+}
+
+#pragma mark - Selection
+
+int BranchSelector::_selectCell(const Grid& state, std::mt19937_64* rng) const {
+    if (_strategy == BranchingStrategy::MinimumRemainingValues) {
+        return rng != nullptr ? state.getCellIndexWithFewestCandidates(*rng) : state.getCellIndexWithFewestCandidates();
+    }
+
+    const IntVector tiedCells = state.getCellIndicesWithCandidateCount(state.getFewestCandidateCount());
+    int result = -1;
+    int bestDegree = -1;
+    int tieCount = 0;
+    for (auto cellIndex = tiedCells.begin(); cellIndex != tiedCells.end(); ++cellIndex) {
+        const int degree = tiedCells.size() > 1 ? unansweredPeerCount(state, *cellIndex) : 0;
+        if (degree > bestDegree) {
+            result = *cellIndex;
+            bestDegree = degree;
+            tieCount = 1;
+        } else if (degree == bestDegree && rng != nullptr) {
+            tieCount += 1;
+            if ((*rng)() % tieCount == 0) {
+                result = *cellIndex;
+            }
+        }
+    }
+    return result;
+}
+
+/**
+ Looks for the digit missing from a unit with the fewest possible positions. Returns false if none has fewer than
+ maxBranchCount positions; returns true with no branches if a missing digit has no position left.
+ */
+bool BranchSelector::_selectUnitBranches(const Grid& state, const int maxBranchCount, BranchVector& branches) const {
+    const int size = state.getSize();
+    int bestCount = maxBranchCount;
+    int bestUnitIndex = -1;
+    int bestValue = -1;
+    std::vector<int> positionCounts(size + 1);
+    std::vector<bool> placed(size + 1);
+    for (int unitIndex = 0; unitIndex < 3 * size && bestCount > 1; unitIndex++) {
+        const IntVector cells = cellIndicesOfUnit(state, unitIndex);
+        std::fill(positionCounts.begin(), positionCounts.end(), 0);
+        std::fill(placed.begin(), placed.end(), false);
+        for (auto cellIndex = cells.begin(); cellIndex != cells.end(); ++cellIndex) {
+            const Cell& cell = state.cellAtIndex(*cellIndex);
+            if (cell.getValue() != -1) {
+                placed[cell.getValue()] = true;
+                continue;
+            }
+            const IntSet& candidates = cell.getCandidates();
+            for (auto candidate = candidates.begin(); candidate != candidates.end(); ++candidate) {
+                positionCounts[*candidate] += 1;
+            }
+        }
+        for (int value = 1; value <= size; value++) {
+            if (placed[value] || positionCounts[value] >= bestCount) {
+                continue;
+            }
+            if (positionCounts[value] == 0) {
+                branches.clear();
+                return true;
+            }
+            bestCount = positionCounts[value];
+            bestUnitIndex = unitIndex;
+            bestValue = value;
+        }
+    }
+    if (bestUnitIndex < 0) {
+        return false;
+    }
+
+    branches.clear();
+    const IntVector cells = cellIndicesOfUnit(state, bestUnitIndex);
+    for (auto cellIndex = cells.begin(); cellIndex != cells.end(); ++cellIndex) {
+        const Cell& cell = state.cellAtIndex(*cellIndex);
+        if (cell.getValue() == -1 && cell.getCandidates().find(bestValue) != cell.getCandidates().end()) {
+            branches.push_back(Branch{*cellIndex, bestValue});
+        }
+    }
+    return true;
+}
+
+void BranchSelector::_orderBranches(const Grid& state, BranchVector& branches, std::mt19937_64* rng) const {
+    if (rng != nullptr) {
+        std::shuffle(branches.begin(), branches.end(), *rng);
+    }
+    if (_valueOrdering == ValueOrdering::LeastConstraining && branches.size() > 1) {
+        // stable, so branches that constrain equally keep their (possibly shuffled) order
+        std::vector<std::pair<int, Branch>> scoredBranches;
+        for (auto branch = branches.begin(); branch != branches.end(); ++branch) {
+            scoredBranches.push_back(std::make_pair(constrainedPeerCount(state, *branch), *branch));
+        }
+        std::stable_sort(scoredBranches.begin(), scoredBranches.end(), [](const std::pair<int, Branch>& a, const std::pair<int, Branch>& b) {
+            return a.first < b.first;
+        });
+        for (size_t i = 0; i < branches.size(); i++) {
+            branches[i] = scoredBranches[i].second;
+        }
+    }
+}
+
+BranchVector BranchSelector::selectBranches(const Grid& state, std::mt19937_64* rng) const {
+    BranchVector branches;
+    const int cellIndex = _selectCell(state, rng);
+    if (cellIndex < 0) {
+        return branches;
+    }
+
+    const IntSet& candidates = state.cellAtIndex(cellIndex).getCandidates();
+    const bool usedUnit = _strategy == BranchingStrategy::CellOrUnit && _selectUnitBranches(state, (int)candidates.size(), branches);
+    if (!usedUnit) {
+        for (auto candidate = candidates.begin(); candidate != candidates.end(); ++candidate) {
+            branches.push_back(Branch{cellIndex, *candidate});
+        }
+    }
+
+    _orderBranches(state, branches, rng);
+    return branches;
+}
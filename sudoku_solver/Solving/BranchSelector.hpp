@@ -0,0 +1,55 @@
+//
+//  BranchSelector.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef BranchSelector_hpp
+#define BranchSelector_hpp
+
+#include <random>
+#include <vector>
+
+#include "Grid.hpp"
+
+enum class BranchingStrategy {
+    MinimumRemainingValues,     // a cell with the fewest candidates
+    DegreeTieBreak,             // as above, ties go to the cell with the most unanswered peers
+    CellOrUnit                  // the DegreeTieBreak cell, or the positions of one digit in a unit if there are fewer
+};
+
+enum class ValueOrdering {
+    Natural,            // candidate set order
+    LeastConstraining   // try the placement that removes the fewest candidates from peers first
+};
+
+struct Branch {
+    int cellIndex;
+    int value;
+};
+
+typedef std::vector<Branch> BranchVector;
+
+/**
+ Chooses what DFS branches on. A cell branch tries each candidate of one cell; a unit branch tries each cell of a
+ row, column or subgrid that can still hold a digit the unit is missing. Either way exactly one of the branches
+ holds in any solution, so the search stays complete.
+ */
+class BranchSelector {
+    BranchingStrategy _strategy;
+    ValueOrdering _valueOrdering;
+
+    int _selectCell(const Grid& state, std::mt19937_64* rng) const;
+    bool _selectUnitBranches(const Grid& state, const int maxBranchCount, BranchVector& branches) const;
+    void _orderBranches(const Grid& state, BranchVector& branches, std::mt19937_64* rng) const;
+
+public:
+    BranchSelector(const BranchingStrategy strategy, const ValueOrdering valueOrdering);
+
+    // branches in the order they should be tried, empty when some cell or unit has no options left;
+    // rng (may be null) breaks ties at random
+    BranchVector selectBranches(const Grid& state, std::mt19937_64* rng) const;
+};
+
+#endif /* BranchSelector_hpp */
@@ -18,6 +18,28 @@ class CombinationListCreator {
 public:
     // return a list of all n choose k combinations from 0 to n - 1
     static IntVectorVector makeCombinationList(const int n, const int k);
+
+    // walks the same combinations in place: start from {0, ..., k - 1} and step until this returns false, so the
+    // caller needs one k-sized buffer instead of the whole list
+    template <typename Vector>
+    static bool nextCombination(Vector& combination, const int n);
 };
 
+template <typename Vector>
+bool CombinationListCreator::nextCombination(Vector& combination, const int n) {
+    const int k = (int)combination.size();
+    int position = k - 1;
+    while (position >= 0 && combination[position] == n - k + position) {
+        position--;
+    }
+    if (position < 0) {
+        return false;
+    }
+    combination[position] += 1;
+    for (int i = position + 1; i < k; i++) {
+        combination[i] = combination[i - 1] + 1;
+    }
+    return true;
+}
+
 #endif /* CombinationListCreator_hpp */
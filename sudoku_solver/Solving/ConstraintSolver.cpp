@@ -7,22 +7,53 @@
 
 #include "ConstraintSolver.hpp"
 
+#include "AlternatingChainEngine.hpp"
+#include "BitmaskTechniques.hpp"
 #include "CombinationListCreator.hpp"
 #include "DepthFirstSearchSolver.hpp"
+#include "TemplateEngine.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
 
-ConstraintSolver::ConstraintSolver(Grid& g) : _grid(g), _editor(g) {}
+ConstraintSolver::ConstraintSolver(Grid& g) : ConstraintSolver(g, nullptr, kDefaultTechniques) {}
+
+ConstraintSolver::ConstraintSolver(Grid& g, SolveMonitor* monitor) : ConstraintSolver(g, monitor, kDefaultTechniques) {}
+
+ConstraintSolver::ConstraintSolver(Grid& g, SolveMonitor* monitor, const TechniqueMask techniques) : _grid(g), _editor(g), _monitor(monitor), _techniques(techniques) {}
+
+ConstraintSolver::~ConstraintSolver() {}
+
+bool ConstraintSolver::_shouldStop() {
+    return _monitor != nullptr && _monitor->shouldStop();
+}
+
+bool ConstraintSolver::_isEnabled(const Technique technique) const {
+    return technique == Technique::Singles || (_techniques & techniqueBit(technique)) != 0;
+}
+
+void ConstraintSolver::setTechniqueEnabled(const Technique technique, const bool enabled) {
+    if (enabled) {
+        _techniques |= techniqueBit(technique);
+    } else {
+        _techniques &= ~techniqueBit(technique);
+    }
+}
+
+TechniqueMask ConstraintSolver::getTechniques() const {
+    return _techniques;
+}
 
 #pragma mark - One possible value in cell
 
 bool ConstraintSolver::_updateCellsWithOneCandidate() {
     bool anyCellUpdated = false;
     for (int cellIndex = 0; cellIndex < _grid.numberOfCells(); cellIndex++) {
-        Cell& cell = _grid.cellAtIndex(cellIndex);
+        const Cell& cell = _grid.cellAtIndex(cellIndex);
         if (cell.getValue() == -1 && cell.getCandidates().size() == 1) {
             int value = *cell.getCandidates().begin();
-            _editor.setCellValueAndUpdateCandidates(cell, value, cellIndex);
+            _editor.setCellValueAndUpdateCandidates(value, cellIndex);
             anyCellUpdated = true;
         }
     }
@@ -39,15 +70,29 @@ bool ConstraintSolver::_updateCellsWithOneCandidate() {
  n: 2 to grid._subSize
  */
 
+// the arena counterpart of Grid::getCandidateCellIndexListsFromIndices: the same sets, filled in the same order, so
+// they iterate in the same order too
+static CandidateCellLists _candidateCellListsOfIndices(const Grid& grid, const IntSet& indices) {
+    CandidateCellLists result(grid.getSize() + 1);
+    for (auto currentIndex = indices.begin(); currentIndex != indices.end(); ++currentIndex) {
+        const IntSet& candidates = grid.cellAtIndex(*currentIndex).getCandidates();
+        for (auto candidate = candidates.begin(); candidate != candidates.end(); ++candidate) {
+            result[*candidate].insert(*currentIndex);
+        }
+    }
+    return result;
+}
+
 bool ConstraintSolver::_processSubgroupExclusion(const IntSet& groupIndices, const bool isRowOrColumn) {
+    ScratchScope scope;
     bool result = false;
     int gridSize = _grid.getSize();
     int subgridSize = _grid.getSubSize();
-    IntToIntSetMap candidateCellLists = _grid.getCandidateCellIndexListsFromIndices(groupIndices);
+    const CandidateCellLists candidateCellLists = _candidateCellListsOfIndices(_grid, groupIndices);
     for (int currentValue = 1; currentValue <= gridSize; currentValue++) {
         for (int currentValueCount = 2; currentValueCount <= subgridSize; currentValueCount++) {
-            const IntSet& currentValueIndices = candidateCellLists[currentValue];
-            if (currentValueIndices.size() == currentValueCount) {
+            const ScratchIntSet& currentValueIndices = candidateCellLists[currentValue];
+            if ((int)currentValueIndices.size() == currentValueCount) {
                 if (isRowOrColumn) {
                     if (_grid.indicesAreInSameSubgrid(currentValueIndices)) {
                         const int cellIndex = *currentValueIndices.begin(); // just use first index since it's used to determine subgrid
@@ -78,20 +123,20 @@ bool ConstraintSolver::_filterCandidatesUsingSubgroupExclusion() {
     const int subgridSize = _grid.getSubSize();
 
     for (int row = 0; row < gridSize; row++) {
-        IntSet rowIndices = _grid.commonRowIndicesOfCellAtIndex(row * gridSize);
+        const IntSet& rowIndices = _grid.commonRowIndicesOfCellAtIndex(row * gridSize);
         const bool rowResult = _processSubgroupExclusion(rowIndices, true);
         result = result || rowResult;
     }
 
     for (int col = 0; col < gridSize; col++) {
-        IntSet columnIndices = _grid.commonColumnIndicesOfCellAtIndex(col);
+        const IntSet& columnIndices = _grid.commonColumnIndicesOfCellAtIndex(col);
         const bool columnResult = _processSubgroupExclusion(columnIndices, true);
         result = result || columnResult;
     }
 
     for (int startRow = 0; startRow < gridSize; startRow += subgridSize) {
         for (int startColumn = 0; startColumn < gridSize; startColumn += subgridSize) {
-            IntSet subgridIndices = _grid.commonSubgridIndicesOfCellAtIndex(startRow * gridSize + startColumn);
+            const IntSet& subgridIndices = _grid.commonSubgridIndicesOfCellAtIndex(startRow * gridSize + startColumn);
             const bool subgridResult = _processSubgroupExclusion(subgridIndices, false);
             result = result || subgridResult;
         }
@@ -122,8 +167,8 @@ bool ConstraintSolver::_filterCandidatesUsingSubgroupExclusion() {
  If these cells also fall into the same group of another type (e.g. we were testing subgrid and these 3 all all in the same row or column), you can remove {2, 6, 8} from the other cells of the second group.
  */
 
-static IntVector _getCandidatesWithCountsUpToCount(Grid& grid, IntToIntSetMap& candidateCellLists, const int count) {
-    IntVector result;
+static ScratchIntVector _getCandidatesWithCountsUpToCount(Grid& grid, const CandidateCellLists& candidateCellLists, const int count) {
+    ScratchIntVector result;
     const int gridSize = grid.getSize();
     for (int currentValue = 1; currentValue <= gridSize; currentValue++) {
         const int cellIndexListSize = (int)candidateCellLists[currentValue].size();
@@ -134,51 +179,65 @@ static IntVector _getCandidatesWithCountsUpToCount(Grid& grid, IntToIntSetMap& c
     return result;
 }
 
-bool ConstraintSolver::_processChains(const IntSet& groupIndices, const bool isRowOrColumn) {
+bool ConstraintSolver::_processChainsOfSize(const bool isRowOrColumn, const CandidateCellLists& candidateCellLists, const int chainSize) {
+    ScratchScope scope;
     bool result = false;
-    int maxChainSize = _grid.getNumberOfUnansweredCellsInIndices(groupIndices) - 1;
-    IntToIntSetMap candidateCellLists = _grid.getCandidateCellIndexListsFromIndices(groupIndices);
-    for (int currentChainSize = 1; currentChainSize <= maxChainSize; currentChainSize++) {
-        IntVector candidatesThatAreInAtMostChainSizeCells = _getCandidatesWithCountsUpToCount(_grid, candidateCellLists, currentChainSize);
-        if (candidatesThatAreInAtMostChainSizeCells.size() >= currentChainSize) {
-            const IntVectorVector indexCombinationList = CombinationListCreator::makeCombinationList((int)candidatesThatAreInAtMostChainSizeCells.size(), currentChainSize);
-            for (auto indexCombination = indexCombinationList.begin(); indexCombination != indexCombinationList.end(); ++indexCombination) {
-                IntSet cellIndexSet = IntSet();
-                IntSet chainValueSet = IntSet();
-                for (auto currentTupleIndex = indexCombination->begin(); currentTupleIndex != indexCombination->end(); ++currentTupleIndex) {
-                    const int currentCandidate = candidatesThatAreInAtMostChainSizeCells[*currentTupleIndex];
-                    IntSet candidateCellList = candidateCellLists[currentCandidate];
-                    chainValueSet.insert(currentCandidate);
-                    cellIndexSet.insert(candidateCellList.begin(), candidateCellList.end());
-                }
+    const ScratchIntVector candidatesThatAreInAtMostChainSizeCells = _getCandidatesWithCountsUpToCount(_grid, candidateCellLists, chainSize);
+    const int candidateCount = (int)candidatesThatAreInAtMostChainSizeCells.size();
+    if (candidateCount >= chainSize) {
+        ScratchIntVector indexCombination(chainSize);
+        for (int i = 0; i < chainSize; i++) {
+            indexCombination[i] = i;
+        }
+        do {
+            ScratchScope combinationScope;
+            ScratchIntSet cellIndexSet;
+            ScratchIntSet chainValueSet;
+            for (auto currentTupleIndex = indexCombination.begin(); currentTupleIndex != indexCombination.end(); ++currentTupleIndex) {
+                const int currentCandidate = candidatesThatAreInAtMostChainSizeCells[*currentTupleIndex];
+                const ScratchIntSet& candidateCellList = candidateCellLists[currentCandidate];
+                chainValueSet.insert(currentCandidate);
+                cellIndexSet.insert(candidateCellList.begin(), candidateCellList.end());
+            }
 
-                if (cellIndexSet.size() == currentChainSize) {
-                    // remove all other values from cells in cellIndexSet that aren't in chainValueSet
-                    bool anyUpdated = _editor.removeCandidatesFromIndicesThatAreNotInCandidateSet(cellIndexSet, chainValueSet);
-                    result = result || anyUpdated;
-                    if (isRowOrColumn) {
-                        if (_grid.indicesAreInSameSubgrid(cellIndexSet)) {
-                            const int cellIndex = *cellIndexSet.begin();
-                            const IntSet subgridIndices = _grid.commonSubgridIndicesOfCellAtIndex(cellIndex);
-                            const bool anyRemoved = _editor.removeCandidatesFromIndicesExcludingIndices(chainValueSet, subgridIndices, cellIndexSet);
-                            result = result || anyRemoved;
-                        }
-                    } else {
-                        if (_grid.indicesAreInSameRow(cellIndexSet)) {
-                            const int cellIndex = *cellIndexSet.begin();
-                            const IntSet rowIndices = _grid.commonRowIndicesOfCellAtIndex(cellIndex);
-                            const bool anyRemoved = _editor.removeCandidatesFromIndicesExcludingIndices(chainValueSet, rowIndices, cellIndexSet);
-                            result = result || anyRemoved;
-                        } else if (_grid.indicesAreInSameColumn(cellIndexSet)) {
-                            const int cellIndex = *cellIndexSet.begin();
-                            const IntSet columnIndices = _grid.commonColumnIndicesOfCellAtIndex(cellIndex);
-                            const bool anyRemoved = _editor.removeCandidatesFromIndicesExcludingIndices(chainValueSet, columnIndices, cellIndexSet);
-                            result = result || anyRemoved;
-                        }
+            if ((int)cellIndexSet.size() == chainSize) {
+                // remove all other values from cells in cellIndexSet that aren't in chainValueSet
+                bool anyUpdated = _editor.removeCandidatesFromIndicesThatAreNotInCandidateSet(cellIndexSet, chainValueSet);
+                result = result || anyUpdated;
+                if (isRowOrColumn) {
+                    if (_grid.indicesAreInSameSubgrid(cellIndexSet)) {
+                        const int cellIndex = *cellIndexSet.begin();
+                        const IntSet& subgridIndices = _grid.commonSubgridIndicesOfCellAtIndex(cellIndex);
+                        const bool anyRemoved = _editor.removeCandidatesFromIndicesExcludingIndices(chainValueSet, subgridIndices, cellIndexSet);
+                        result = result || anyRemoved;
+                    }
+                } else {
+                    if (_grid.indicesAreInSameRow(cellIndexSet)) {
+                        const int cellIndex = *cellIndexSet.begin();
+                        const IntSet& rowIndices = _grid.commonRowIndicesOfCellAtIndex(cellIndex);
+                        const bool anyRemoved = _editor.removeCandidatesFromIndicesExcludingIndices(chainValueSet, rowIndices, cellIndexSet);
+                        result = result || anyRemoved;
+                    } else if (_grid.indicesAreInSameColumn(cellIndexSet)) {
+                        const int cellIndex = *cellIndexSet.begin();
+                        const IntSet& columnIndices = _grid.commonColumnIndicesOfCellAtIndex(cellIndex);
+                        const bool anyRemoved = _editor.removeCandidatesFromIndicesExcludingIndices(chainValueSet, columnIndices, cellIndexSet);
+                        result = result || anyRemoved;
                     }
                 }
             }
-        }
+        } while (CombinationListCreator::nextCombination(indexCombination, candidateCount));
+    }
+    return result;
+}
+
+bool ConstraintSolver::_processChains(const IntSet& groupIndices, const bool isRowOrColumn) {
+    ScratchScope scope;
+    bool result = false;
+    int maxChainSize = _grid.getNumberOfUnansweredCellsInIndices(groupIndices) - 1;
+    const CandidateCellLists candidateCellLists = _candidateCellListsOfIndices(_grid, groupIndices);
+    for (int currentChainSize = 1; currentChainSize <= maxChainSize; currentChainSize++) {
+        const bool anyUpdated = _processChainsOfSize(isRowOrColumn, candidateCellLists, currentChainSize);
+        result = result || anyUpdated;
     }
     return result;
 }
@@ -190,20 +249,29 @@ bool ConstraintSolver::_filterCandidatesUsingChains() {
     const int subgridSize = _grid.getSubSize();
 
     for (int row = 0; row < gridSize; row++) {
-        IntSet rowIndices = _grid.commonRowIndicesOfCellAtIndex(row * gridSize);
+        const IntSet& rowIndices = _grid.commonRowIndicesOfCellAtIndex(row * gridSize);
+        if (_shouldStop()) {
+            return result;
+        }
         const bool rowResult = _processChains(rowIndices, true);
         result = result || rowResult;
     }
 
     for (int col = 0; col < gridSize; col++) {
-        IntSet columnIndices = _grid.commonColumnIndicesOfCellAtIndex(col);
+        const IntSet& columnIndices = _grid.commonColumnIndicesOfCellAtIndex(col);
+        if (_shouldStop()) {
+            return result;
+        }
         const bool columnResult = _processChains(columnIndices, true);
         result = result || columnResult;
     }
 
     for (int startRow = 0; startRow < gridSize; startRow += subgridSize) {
         for (int startColumn = 0; startColumn < gridSize; startColumn += subgridSize) {
-            IntSet subgridIndices = _grid.commonSubgridIndicesOfCellAtIndex(startRow * gridSize + startColumn);
+            const IntSet& subgridIndices = _grid.commonSubgridIndicesOfCellAtIndex(startRow * gridSize + startColumn);
+            if (_shouldStop()) {
+                return result;
+            }
             const bool subgridResult = _processChains(subgridIndices, false);
             result = result || subgridResult;
         }
@@ -212,19 +280,68 @@ bool ConstraintSolver::_filterCandidatesUsingChains() {
     return result;
 }
 
+// same as above, but only for one chain size so the scheduler can try smaller chains first
+bool ConstraintSolver::_filterCandidatesUsingChainsOfSize(const int chainSize) {
+    bool result = false;
+
+    const int gridSize = _grid.getSize();
+    const int subgridSize = _grid.getSubSize();
+
+    for (int row = 0; row < gridSize; row++) {
+        const IntSet& rowIndices = _grid.commonRowIndicesOfCellAtIndex(row * gridSize);
+        if (chainSize < _grid.getNumberOfUnansweredCellsInIndices(rowIndices)) {
+            ScratchScope scope;
+            const CandidateCellLists candidateCellLists = _candidateCellListsOfIndices(_grid, rowIndices);
+            const bool rowResult = _processChainsOfSize(true, candidateCellLists, chainSize);
+            result = result || rowResult;
+        }
+    }
+
+    for (int col = 0; col < gridSize; col++) {
+        const IntSet& columnIndices = _grid.commonColumnIndicesOfCellAtIndex(col);
+        if (chainSize < _grid.getNumberOfUnansweredCellsInIndices(columnIndices)) {
+            ScratchScope scope;
+            const CandidateCellLists candidateCellLists = _candidateCellListsOfIndices(_grid, columnIndices);
+            const bool columnResult = _processChainsOfSize(true, candidateCellLists, chainSize);
+            result = result || columnResult;
+        }
+    }
+
+    for (int startRow = 0; startRow < gridSize; startRow += subgridSize) {
+        for (int startColumn = 0; startColumn < gridSize; startColumn += subgridSize) {
+            const IntSet& subgridIndices = _grid.commonSubgridIndicesOfCellAtIndex(startRow * gridSize + startColumn);
+            if (chainSize < _grid.getNumberOfUnansweredCellsInIndices(subgridIndices)) {
+                ScratchScope scope;
+                const CandidateCellLists candidateCellLists = _candidateCellListsOfIndices(_grid, subgridIndices);
+                const bool subgridResult = _processChainsOfSize(false, candidateCellLists, chainSize);
+                result = result || subgridResult;
+            }
+        }
+    }
+
+    return result;
+}
+
 #pragma mark - Boxes
 
 /**
  This handles "X-Wing"- and "Swordfish"-type cases covered here: http://www.sudokudragon.com/sudokustrategy.htm
  */
 
-IntPairVector ConstraintSolver::_getCellIndexPairList(const int pairValue, const bool forRow) {
-    IntPairVector cellIndexPairList;
+// the caller's scope reclaims the pair list along with the per-group sets built here
+ScratchIntPairVector ConstraintSolver::_getCellIndexPairList(const int pairValue, const bool forRow) {
+    ScratchIntPairVector cellIndexPairList;
     const int gridSize = _grid.getSize();
     for (int sizeCounter = 0; sizeCounter < gridSize; sizeCounter++) {
-        IntSet indices = forRow ?  _grid.commonRowIndicesOfCellAtIndex(sizeCounter * gridSize) : _grid.commonColumnIndicesOfCellAtIndex(sizeCounter);
-        IntToIntSetMap candidateCellLists = _grid.getCandidateCellIndexListsFromIndices(indices);
-        IntSet cellIndexSet = candidateCellLists[pairValue];
+        const IntSet& indices = forRow ?  _grid.commonRowIndicesOfCellAtIndex(sizeCounter * gridSize) : _grid.commonColumnIndicesOfCellAtIndex(sizeCounter);
+        // the pairValue list of the group's candidate cell lists, inserted in the same order
+        ScratchIntSet cellIndexSet;
+        for (auto index = indices.begin(); index != indices.end(); ++index) {
+            const IntSet& candidates = _grid.cellAtIndex(*index).getCandidates();
+            if (candidates.find(pairValue) != candidates.end()) {
+                cellIndexSet.insert(*index);
+            }
+        }
         if (cellIndexSet.size() == 2) {
             int first = -1;
             int second = -1;
@@ -249,72 +366,80 @@ bool ConstraintSolver::_filterCandidatesUsingBoxes() {
     const int subgridSize = _grid.getSubSize();
 
     for (int pairValue = 1; pairValue <= gridSize; pairValue++) {
+        ScratchScope scope;
         // get all pairs in each row
-        IntPairVector cellIndexPairList = _getCellIndexPairList(pairValue, true);
+        const ScratchIntPairVector cellIndexPairList = _getCellIndexPairList(pairValue, true);
 
         int cellIndexPairListSize = (int)cellIndexPairList.size();
         if (cellIndexPairListSize >= 2) {
-            for (int groupSize = 2; groupSize <= subgridSize; groupSize++) {
-                IntVectorVector indexCombinationList = CombinationListCreator::makeCombinationList(cellIndexPairListSize, groupSize);
-                for (auto indexCombination = indexCombinationList.begin(); indexCombination != indexCombinationList.end(); ++indexCombination) {
-                    IntVector& idxCombo = *indexCombination;
+            for (int groupSize = 2; groupSize <= subgridSize && groupSize <= cellIndexPairListSize; groupSize++) {
+                ScratchIntVector idxCombo(groupSize);
+                for (int i = 0; i < groupSize; i++) {
+                    idxCombo[i] = i;
+                }
+                do {
+                    ScratchScope combinationScope;
 
                     // get all the cell indices
-                    IntSet cellIndexSet = IntSet();
+                    ScratchIntSet cellIndexSet;
                     for (auto index = idxCombo.begin(); index != idxCombo.end(); ++index) {
-                        IntPair cellIndexPair = cellIndexPairList[*index];
+                        const IntPair& cellIndexPair = cellIndexPairList[*index];
                         cellIndexSet.insert(cellIndexPair.first);
                         cellIndexSet.insert(cellIndexPair.second);
                     }
 
                     // see if the cells only take up groupSize columns
-                    IntSet columnSet = _grid.columnSetOfCellIndices(cellIndexSet);
+                    const ScratchIntSet columnSet = _grid.columnSetOfCellIndices(cellIndexSet);
 
                     // if so, remove that value from the columns
-                    if (columnSet.size() == groupSize) {
+                    if ((int)columnSet.size() == groupSize) {
                         for (auto columnIndex = columnSet.begin(); columnIndex != columnSet.end(); ++columnIndex) {
-                            IntSet columnIndices = _grid.commonColumnIndicesOfCellAtIndex(*columnIndex);
+                            const IntSet& columnIndices = _grid.commonColumnIndicesOfCellAtIndex(*columnIndex);
                             const bool anyUpdated = _editor.removeCandidateFromIndicesExcludingIndices(pairValue, columnIndices, cellIndexSet);
                             result = result || anyUpdated;
                         }
                     }
-                }
+                } while (CombinationListCreator::nextCombination(idxCombo, cellIndexPairListSize));
             }
         }
     }
 
     // copied and pasted for columns (slight modifications):
     for (int pairValue = 1; pairValue <= gridSize; pairValue++) {
+        ScratchScope scope;
         // get all pairs in each row
-        IntPairVector cellIndexPairList = _getCellIndexPairList(pairValue, false);
+        const ScratchIntPairVector cellIndexPairList = _getCellIndexPairList(pairValue, false);
 
         int cellIndexPairListSize = (int)cellIndexPairList.size();
         if (cellIndexPairListSize >= 2) {
             for (int groupSize = 2; groupSize <= cellIndexPairListSize; groupSize++) {
-                IntVectorVector indexCombinationList = CombinationListCreator::makeCombinationList(cellIndexPairListSize, groupSize);
-                for (auto indexCombination = indexCombinationList.begin(); indexCombination != indexCombinationList.end(); ++indexCombination) {
-                    IntVector& idxCombo = *indexCombination;
+                ScratchIntVector idxCombo(groupSize);
+                for (int i = 0; i < groupSize; i++) {
+                    idxCombo[i] = i;
+                }
+                do {
+                    ScratchScope combinationScope;
 
                     // get all the cell indices
-                    IntSet cellIndexSet = IntSet();
+                    ScratchIntSet cellIndexSet;
                     for (auto index = idxCombo.begin(); index != idxCombo.end(); ++index) {
-                        IntPair cellIndexPair = cellIndexPairList[*index];
+                        const IntPair& cellIndexPair = cellIndexPairList[*index];
                         cellIndexSet.insert(cellIndexPair.first);
                         cellIndexSet.insert(cellIndexPair.second);
                     }
 
                     // see if the cells only take up groupSize columns
-                    IntSet rowSet = _grid.rowSetOfCellIndices(cellIndexSet);
+                    const ScratchIntSet rowSet = _grid.rowSetOfCellIndices(cellIndexSet);
 
                     // if so, remove that value from the columns
-                    if (rowSet.size() == groupSize) {
+                    if ((int)rowSet.size() == groupSize) {
                         for (auto rowIndex = rowSet.begin(); rowIndex != rowSet.end(); ++rowIndex) {
-                            IntSet rowIndices = _grid.commonRowIndicesOfCellAtIndex(*rowIndex * gridSize);
+                            const IntSet& rowIndices = _grid.commonRowIndicesOfCellAtIndex(*rowIndex * gridSize);
                             const bool anyUpdated = _editor.removeCandidateFromIndicesExcludingIndices(pairValue, rowIndices, cellIndexSet);
                             result = result || anyUpdated;
                         }
                     }
-                }
+                } while (CombinationListCreator::nextCombination(idxCombo, cellIndexPairListSize));
             }
         }
     }
@@ -328,126 +453,100 @@ bool ConstraintSolver::_filterCandidatesUsingBoxes() {
  This handles Alternate Pair Deduction covered here: http://www.sudokudragon.com/advancedstrategy.htm
  */
 
-void ConstraintSolver::_buildPairChain(const int startIndex, const int candidateValue, IntSet& visitedIndices, IntVector& pairChain, IntToBoolMap& colorMap, IntToIntToIntSetMap& rowMap, IntToIntToIntSetMap& colMap, IntToIntToIntSetMap& subgridMap) {
-    // for indexing into maps
-    const int rowIndex = _grid.rowOfCellIndex(startIndex);
-    const int colIndex = _grid.columnOfCellIndex(startIndex);
-    const int subgridIndex = _grid.subgridIndexAtRowAndColumn(rowIndex, colIndex);
-
-    // check for pair in current row
-    const IntSet rowCandidateCellList = rowMap[rowIndex][candidateValue];
-    if (rowCandidateCellList.size() == 2 && rowCandidateCellList.find(startIndex) != rowCandidateCellList.end()) {
-        IntVector cellIndexPair = IntVector(rowCandidateCellList.begin(), rowCandidateCellList.end());
-        const int otherCellIndex = cellIndexPair[0] == startIndex ? cellIndexPair[1] : cellIndexPair[0];
-        if (visitedIndices.find(otherCellIndex) == visitedIndices.end()) {
-            visitedIndices.insert(otherCellIndex);
-            pairChain.push_back(otherCellIndex);
-            const bool parentColor = colorMap[startIndex];
-            colorMap[otherCellIndex] = !parentColor;
-            _buildPairChain(otherCellIndex, candidateValue, visitedIndices, pairChain, colorMap, rowMap, colMap, subgridMap);
-        }
-    }
-
-    // check for pair in current column
-    const IntSet columnCandidateCellList = colMap[colIndex][candidateValue];
-    if (columnCandidateCellList.size() == 2 && columnCandidateCellList.find(startIndex) != columnCandidateCellList.end()) {
-        IntVector cellIndexPair = IntVector(columnCandidateCellList.begin(), columnCandidateCellList.end());
-        const int otherCellIndex = cellIndexPair[0] == startIndex ? cellIndexPair[1] : cellIndexPair[0];
-        if (visitedIndices.find(otherCellIndex) == visitedIndices.end()) {
-            visitedIndices.insert(otherCellIndex);
-            pairChain.push_back(otherCellIndex);
-            const bool parentColor = colorMap[startIndex];
-            colorMap[otherCellIndex] = !parentColor;
-            _buildPairChain(otherCellIndex, candidateValue, visitedIndices, pairChain, colorMap, rowMap, colMap, subgridMap);
+// unitPairs holds, for each row, column and subgrid (units 0 to 3 * size - 1 in that order) and each candidate, the
+// two cells of the unit that have it at (unit * (size + 1) + candidate) * 2, or -1 when it has more or fewer places
+static ScratchIntVector _unitPairsOfGrid(const Grid& grid) {
+    const int gridSize = grid.getSize();
+    const int subgridSize = grid.getSubSize();
+    ScratchIntVector result(3 * gridSize * (gridSize + 1) * 2, -1);
+    ScratchIntVector counts(gridSize + 1);
+    for (int unit = 0; unit < 3 * gridSize; unit++) {
+        const int group = unit % gridSize;
+        const IntSet& indices = unit < gridSize ? grid.commonRowIndicesOfCellAtIndex(group * gridSize) :
+            unit < 2 * gridSize ? grid.commonColumnIndicesOfCellAtIndex(group) :
+            grid.commonSubgridIndicesOfCellAtIndex((group / subgridSize) * subgridSize * gridSize + (group % subgridSize) * subgridSize);
+        std::fill(counts.begin(), counts.end(), 0);
+        int* unitEntries = &result[unit * (gridSize + 1) * 2];
+        for (auto index = indices.begin(); index != indices.end(); ++index) {
+            const IntSet& candidates = grid.cellAtIndex(*index).getCandidates();
+            for (auto candidate = candidates.begin(); candidate != candidates.end(); ++candidate) {
+                if (counts[*candidate] < 2) {
+                    unitEntries[*candidate * 2 + counts[*candidate]] = *index;
+                }
+                counts[*candidate] += 1;
+            }
         }
-    }
-
-    // check for pair in current subgrid
-    const IntSet subgridCandidateCellList = subgridMap[subgridIndex][candidateValue];
-    if (subgridCandidateCellList.size() == 2 && subgridCandidateCellList.find(startIndex) != subgridCandidateCellList.end()) {
-        IntVector cellIndexPair = IntVector(subgridCandidateCellList.begin(), subgridCandidateCellList.end());
-        const int otherCellIndex = cellIndexPair[0] == startIndex ? cellIndexPair[1] : cellIndexPair[0];
-        if (visitedIndices.find(otherCellIndex) == visitedIndices.end()) {
-            visitedIndices.insert(otherCellIndex);
-            pairChain.push_back(otherCellIndex);
-            const bool parentColor = colorMap[startIndex];
-            colorMap[otherCellIndex] = !parentColor;
-            _buildPairChain(otherCellIndex, candidateValue, visitedIndices, pairChain, colorMap, rowMap, colMap, subgridMap);
+        for (int candidate = 1; candidate <= gridSize; candidate++) {
+            if (counts[candidate] != 2) {
+                unitEntries[candidate * 2] = -1;
+                unitEntries[candidate * 2 + 1] = -1;
+            }
         }
     }
-}
-
-// row index -> candidate -> cell list (IntSet)
-static IntToIntToIntSetMap _rowMapForCandidate(Grid& grid) {
-    std::unordered_map<int, IntToIntSetMap> result;
-    const int gridSize = grid.getSize();
-    for (int row = 0; row < gridSize; row++) {
-        IntSet indices = grid.commonRowIndicesOfCellAtIndex(row * gridSize);
-        result[row] = grid.getCandidateCellIndexListsFromIndices(indices);
-    }
     return result;
 }
 
-// column index -> candidate -> cell list (IntSet)
-static IntToIntToIntSetMap _columnMapForCandidate(Grid& grid) {
-    std::unordered_map<int, IntToIntSetMap> result;
-    const int gridSize = grid.getSize();
-    for (int col = 0; col < gridSize; col++) {
-        IntSet indices = grid.commonColumnIndicesOfCellAtIndex(col);
-        result[col] = grid.getCandidateCellIndexListsFromIndices(indices);
-    }
-    return result;
-}
+void ConstraintSolver::_buildPairChain(const int startIndex, const int candidateValue, ScratchIntVector& visited, ScratchIntVector& pairChain, ScratchIntVector& colors, const ScratchIntVector& unitPairs) {
+    const int gridSize = _grid.getSize();
+    const int rowIndex = _grid.rowOfCellIndex(startIndex);
+    const int colIndex = _grid.columnOfCellIndex(startIndex);
+    const int subgridIndex = _grid.subgridIndexAtRowAndColumn(rowIndex, colIndex);
 
-// subgrid index -> candidate -> cell list (IntSet)
-static IntToIntToIntSetMap _subgridMapForCandidate(Grid& grid) {
-    std::unordered_map<int, IntToIntSetMap> result;
-    const int gridSize = grid.getSize();
-    const int subgridSize = grid.getSubSize();
-    for (int row = 0; row < gridSize; row += subgridSize) {
-        for (int col = 0; col < gridSize; col += subgridSize) {
-            const int subgridIndex = grid.subgridIndexAtRowAndColumn(row, col);
-            IntSet indices = grid.commonSubgridIndicesOfCellAtIndex(row * gridSize + col);
-            result[subgridIndex] = grid.getCandidateCellIndexListsFromIndices(indices);
+    // check for a pair in the current row, column and subgrid
+    const int units[] = {rowIndex, gridSize + colIndex, 2 * gridSize + subgridIndex};
+    for (auto unit = std::begin(units); unit != std::end(units); ++unit) {
+        const int* pair = &unitPairs[(*unit * (gridSize + 1) + candidateValue) * 2];
+        if (pair[0] != startIndex && pair[1] != startIndex) {
+            continue;
+        }
+        const int otherCellIndex = pair[0] == startIndex ? pair[1] : pair[0];
+        if (!visited[otherCellIndex]) {
+            visited[otherCellIndex] = 1;
+            pairChain.push_back(otherCellIndex);
+            colors[otherCellIndex] = !colors[startIndex];
+            _buildPairChain(otherCellIndex, candidateValue, visited, pairChain, colors, unitPairs);
         }
     }
-    return result;
 }
 
 bool ConstraintSolver::_filterUsingAlternatePairs() {
+    ScratchScope scope;
     bool result = false;
 
-    IntToIntToIntSetMap rowToCandidateToCellList = _rowMapForCandidate(_grid);
-    IntToIntToIntSetMap colToCandidateToCellList = _columnMapForCandidate(_grid);
-    IntToIntToIntSetMap subgridToCandidateToCellList = _subgridMapForCandidate(_grid);
+    const ScratchIntVector unitPairs = _unitPairsOfGrid(_grid);
+    // indexed by cell; a color is only read for cells of the current chain, which all got one while it was built
+    ScratchIntVector colors(_grid.numberOfCells(), 0);
 
     const int gridSize = _grid.getSize();
     for (int candidateValue = 1; candidateValue <= gridSize; candidateValue++) {
-        IntSet visitedIndices = IntSet();
+        if (_shouldStop()) {
+            return result;
+        }
+        ScratchScope candidateScope;
+        ScratchIntVector visited(_grid.numberOfCells(), 0);
+        ScratchIntVector pairChain;
+        pairChain.reserve(_grid.numberOfCells());
         for (int cellIndex = 0; cellIndex < _grid.numberOfCells(); cellIndex++) {
-            visitedIndices.insert(cellIndex);
-            IntVector pairChain;
-            IntToBoolMap colorMap;
+            visited[cellIndex] = 1;
+            pairChain.clear();
             pairChain.push_back(cellIndex);
-            colorMap[cellIndex] = true; // doesn't matter what start is
-            _buildPairChain(cellIndex, candidateValue, visitedIndices, pairChain, colorMap, rowToCandidateToCellList, colToCandidateToCellList, subgridToCandidateToCellList);
+            colors[cellIndex] = 1; // doesn't matter what start is
+            _buildPairChain(cellIndex, candidateValue, visited, pairChain, colors, unitPairs);
 
             const int pairChainSize = (int)pairChain.size();
-            if (pairChainSize > 2) {
-                IntVectorVector indexCombinationList = CombinationListCreator::makeCombinationList(pairChainSize, 2);
-                for (auto indexCombination = indexCombinationList.begin(); indexCombination != indexCombinationList.end(); ++indexCombination) {
-                    IntVector& idxCombo = *indexCombination;
-                    const int firstIndex = pairChain[idxCombo[0]];
-                    const int secondIndex = pairChain[idxCombo[1]];
-                    const IntSet pairSet = IntSet({firstIndex, secondIndex});
-                    if (colorMap[firstIndex] != colorMap[secondIndex] && !_grid.indicesAreInSameRow(pairSet) && !_grid.indicesAreInSameColumn(pairSet)) {
-                        const int rowFirst = _grid.rowOfCellIndex(firstIndex);
-                        const int colFirst = _grid.columnOfCellIndex(firstIndex);
-                        const int rowSecond = _grid.rowOfCellIndex(secondIndex);
-                        const int colSecond = _grid.columnOfCellIndex(secondIndex);
+            for (int first = 0; first < pairChainSize && pairChainSize > 2; first++) {
+                for (int second = first + 1; second < pairChainSize; second++) {
+                    const int firstIndex = pairChain[first];
+                    const int secondIndex = pairChain[second];
+                    const int rowFirst = _grid.rowOfCellIndex(firstIndex);
+                    const int colFirst = _grid.columnOfCellIndex(firstIndex);
+                    const int rowSecond = _grid.rowOfCellIndex(secondIndex);
+                    const int colSecond = _grid.columnOfCellIndex(secondIndex);
+                    if (colors[firstIndex] != colors[secondIndex] && rowFirst != rowSecond && colFirst != colSecond) {
+                        ScratchScope pairScope;
                         const int firstIntersectionIndex = _grid.indexAtRowAndColumn(rowFirst, colSecond);
                         const int secondIntersectionIndex = _grid.indexAtRowAndColumn(rowSecond, colFirst);
-                        const IntSet pairIntersectionSet = IntSet({firstIntersectionIndex, secondIntersectionIndex});
+                        const ScratchIntSet pairIntersectionSet({firstIntersectionIndex, secondIntersectionIndex});
                         const bool candidateRemoved = _editor.removeCandidateFromIndices(candidateValue, pairIntersectionSet);
                         result = result || candidateRemoved;
                     }
@@ -458,43 +557,144 @@ bool ConstraintSolver::_filterUsingAlternatePairs() {
     return result;
 }
 
+#pragma mark - Wings, uniqueness, almost locked sets, chains and templates
+
+static bool findEliminations(const BitmaskTechniques& techniques, const Technique technique, EliminationVector& eliminations) {
+    switch (technique) {
+        case Technique::XYWing:
+            return techniques.findXYWings(eliminations);
+        case Technique::XYZWing:
+            return techniques.findXYZWings(eliminations);
+        case Technique::WWing:
+            return techniques.findWWings(eliminations);
+        case Technique::UniqueRectangle:
+            return techniques.findUniqueRectangles(eliminations);
+        case Technique::BugPlusOne:
+            return techniques.findBugPlusOne(eliminations);
+        case Technique::AlmostLockedSets:
+            return techniques.findAlmostLockedSetsXZ(eliminations);
+        default:
+            return false;
+    }
+}
+
+bool ConstraintSolver::_findAlternatingChainEliminations(EliminationVector& eliminations) {
+    if (!AlternatingChainEngine::supportsSize(_grid.getSize())) {
+        return false;
+    }
+    if (!_chainEngine) {
+        _chainEngine.reset(new AlternatingChainEngine(_grid.getSize(), AlternatingChainEngine::defaultMaxChainLength(_grid.getSize())));
+    }
+    _chainEngine->synchronize(_grid);
+    return _chainEngine->findEliminations(eliminations);
+}
+
+bool ConstraintSolver::_findTemplateEliminations(EliminationVector& eliminations) {
+    if (!TemplateEngine::supportsSize(_grid.getSize())) {
+        return false;
+    }
+    if (!_templateEngine) {
+        _templateEngine.reset(new TemplateEngine());
+    }
+    return _templateEngine->findEliminations(_grid, eliminations);
+}
+
+/**
+ Runs the enabled bitmask techniques in scheduler order on one snapshot of the candidates and applies the
+ eliminations of the first one that finds any, or of all of them with applyAll (every one is sound on the same
+ snapshot, and it saves a round of the slower techniques per extra one). appliedTechnique is set to the first
+ technique that removed anything.
+ */
+bool ConstraintSolver::_filterCandidatesUsingAdvancedTechniques(const bool applyAll, Technique& appliedTechnique) {
+    // nothing to do when every technique from XYWing on is off
+    if (!BitmaskTechniques::supportsSize(_grid.getSize()) || (_techniques & ~(techniqueBit(Technique::XYWing) - 1)) == 0) {
+        return false;
+    }
+    const BitmaskTechniques techniques(_grid);
+    EliminationVector eliminations;
+    bool result = false;
+    for (int technique = (int)Technique::XYWing; technique < kTechniqueCount; technique++) {
+        if (_shouldStop()) {
+            break;
+        }
+        if (!_isEnabled((Technique)technique)) {
+            continue;
+        }
+        if ((Technique)technique == Technique::AlternatingChains) {
+            // the chain graph reads the grid itself, so it sees what the techniques before it removed
+            if (!_findAlternatingChainEliminations(eliminations)) {
+                continue;
+            }
+        } else if ((Technique)technique == Technique::Templates) {
+            if (!_findTemplateEliminations(eliminations)) {
+                continue;
+            }
+        } else if (!findEliminations(techniques, (Technique)technique, eliminations)) {
+            continue;
+        }
+        bool techniqueResult = false;
+        for (auto elimination = eliminations.begin(); elimination != eliminations.end(); ++elimination) {
+            for (CandidateMask candidates = elimination->candidates; candidates != 0; candidates &= candidates - 1) {
+                if (_grid.eraseCellCandidate(elimination->cellIndex, valueForBit(candidates & (~candidates + 1))) > 0) {
+                    techniqueResult = true;
+                }
+            }
+        }
+        eliminations.clear();
+        if (techniqueResult && !result) {
+            appliedTechnique = (Technique)technique;
+            result = true;
+        }
+        if (result && !applyAll) {
+            break;
+        }
+    }
+    return result;
+}
+
 #pragma mark - Set possible values
 
-static void _eraseCandidateIfAppropriate(Grid& grid, IntSet& indices, IntSet& candidates, const int cellIndex) {
+static_assert(Grid::kMaxSize <= 64, "_valuesInIndicesExcept keeps values as bits of a uint64_t");
+
+// the values of the cells in indices other than cellIndex, as bits (value - 1)
+static uint64_t _valuesInIndicesExcept(const Grid& grid, const IntSet& indices, const int cellIndex) {
+    uint64_t result = 0;
     for (auto index = indices.begin(); index != indices.end(); ++index) {
         if (*index != cellIndex) {
-            Cell& otherCell = grid.cellAtIndex(*index);
+            const Cell& otherCell = grid.cellAtIndex(*index);
             if (otherCell.getValue() != -1) {
-                candidates.erase(otherCell.getValue());
+                result |= ((uint64_t)1) << (otherCell.getValue() - 1);
             }
         }
     }
+    return result;
 }
 
 void ConstraintSolver::_setCandidatesNaive() {
     for (int cellIndex = 0; cellIndex < _grid.numberOfCells(); cellIndex++) {
-        Cell& cell = _grid.cellAtIndex(cellIndex);
+        const Cell& cell = _grid.cellAtIndex(cellIndex);
         if (cell.getValue() == -1) {
-            IntSet candidates = _grid.allCandidates();
-            IntSet rowIndices = _grid.commonRowIndicesOfCellAtIndex(cellIndex);
-            _eraseCandidateIfAppropriate(_grid, rowIndices, candidates, cellIndex);
-            IntSet columnIndices = _grid.commonColumnIndicesOfCellAtIndex(cellIndex);
-            _eraseCandidateIfAppropriate(_grid, columnIndices, candidates, cellIndex);
-            IntSet subgridIndices = _grid.commonSubgridIndicesOfCellAtIndex(cellIndex);
-            _eraseCandidateIfAppropriate(_grid, subgridIndices, candidates, cellIndex);
-            cell.setCandidates(candidates);
+            const uint64_t peerValues = _valuesInIndicesExcept(_grid, _grid.commonRowIndicesOfCellAtIndex(cellIndex), cellIndex) |
+                _valuesInIndicesExcept(_grid, _grid.commonColumnIndicesOfCellAtIndex(cellIndex), cellIndex) |
+                _valuesInIndicesExcept(_grid, _grid.commonSubgridIndicesOfCellAtIndex(cellIndex), cellIndex);
+            _grid.setCellCandidatesExcluding(cellIndex, _grid.allCandidates(), peerValues);
         }
     }
 }
 
 void ConstraintSolver::_setCandidates() {
     _setCandidatesNaive();
-    while (true) {
-        const bool subgroupResult = _filterCandidatesUsingSubgroupExclusion();
-        const bool chainResult = _filterCandidatesUsingChains();
-        const bool boxResult = _filterCandidatesUsingBoxes();
-        const bool alternatePairResult = _filterUsingAlternatePairs();
-        if (!subgroupResult && !chainResult && !boxResult && !alternatePairResult) {
+    while (!_shouldStop()) {
+        const bool subgroupResult = _isEnabled(Technique::SubgroupExclusion) && _filterCandidatesUsingSubgroupExclusion();
+        const bool chainResult = !_shouldStop() && _isEnabled(Technique::Chains) && _filterCandidatesUsingChains();
+        const bool boxResult = !_shouldStop() && _isEnabled(Technique::Boxes) && _filterCandidatesUsingBoxes();
+        const bool alternatePairResult = !_shouldStop() && _isEnabled(Technique::AlternatePairs) && _filterUsingAlternatePairs();
+        if (subgroupResult || chainResult || boxResult || alternatePairResult) {
+            continue;
+        }
+        // the bitmask techniques only once the cheaper ones are stuck
+        Technique appliedTechnique;
+        if (_shouldStop() || !_filterCandidatesUsingAdvancedTechniques(true, appliedTechnique)) {
             break;
         }
     }
@@ -506,8 +706,52 @@ void ConstraintSolver::propagateContraints() {
     _setCandidates();
 
     while (_updateCellsWithOneCandidate()) {
-        if (_grid.isSolved()) {
+        if (_grid.isSolved() || _shouldStop()) {
             break;
         }
     }
 }
+
+#pragma mark - Technique scheduler
+
+void ConstraintSolver::setNaiveCandidates() {
+    _setCandidatesNaive();
+}
+
+/**
+ Applies the cheapest technique that makes progress and reports which one it was: singles, then subgroup
+ exclusion, then chains from size 1 upwards, then boxes, alternate pairs and the bitmask techniques in enum order,
+ skipping the ones that are switched off. Returns false when none of them changes the grid (solved or stalled).
+ */
+bool ConstraintSolver::applyCheapestTechnique(TechniqueStep& step) {
+    step.chainSize = 0;
+
+    if (_updateCellsWithOneCandidate()) {
+        step.technique = Technique::Singles;
+        return true;
+    }
+    if (_isEnabled(Technique::SubgroupExclusion) && _filterCandidatesUsingSubgroupExclusion()) {
+        step.technique = Technique::SubgroupExclusion;
+        return true;
+    }
+    const int gridSize = _grid.getSize();
+    for (int chainSize = 1; chainSize < gridSize && _isEnabled(Technique::Chains); chainSize++) {
+        if (_filterCandidatesUsingChainsOfSize(chainSize)) {
+            step.technique = Technique::Chains;
+            step.chainSize = chainSize;
+            return true;
+        }
+    }
+    if (_isEnabled(Technique::Boxes) && _filterCandidatesUsingBoxes()) {
+        step.technique = Technique::Boxes;
+        return true;
+    }
+    if (_isEnabled(Technique::AlternatePairs) && _filterUsingAlternatePairs()) {
+        step.technique = Technique::AlternatePairs;
+        return true;
+    }
+    if (_filterCandidatesUsingAdvancedTechniques(false, step.technique)) {
+        return true;
+    }
+    return false;
+}
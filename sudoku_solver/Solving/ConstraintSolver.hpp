@@ -8,13 +8,20 @@
 #ifndef ConstraintSolver_hpp
 #define ConstraintSolver_hpp
 
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include "BitmaskTechniques.hpp"
 #include "Grid.hpp"
 #include "GridEditor.hpp"
+#include "ScratchArena.hpp"
+#include "SolveMonitor.hpp"
+
+class AlternatingChainEngine;
+class TemplateEngine;
 
 typedef std::unordered_set<int> IntSet;
 typedef std::vector<int> IntVector;
@@ -22,12 +29,63 @@ typedef std::unordered_map<int, std::unordered_set<int>> IntToIntSetMap;
 typedef std::unordered_map<int, bool> IntToBoolMap;
 typedef std::pair<int, int> IntPair;
 typedef std::vector<IntVector> IntVectorVector;
-typedef std::unordered_map<int, std::unordered_map<int, std::unordered_set<int>>> IntToIntToIntSetMap;
 typedef std::vector<std::pair<int, int>> IntPairVector;
 
+// candidate -> the cells of one group that have it, indexed by value (0 unused); the passes keep these and their
+// other temporaries in the thread's ScratchArena
+typedef std::vector<ScratchIntSet, ArenaAllocator<ScratchIntSet>> CandidateCellLists;
+typedef std::vector<IntPair, ArenaAllocator<IntPair>> ScratchIntPairVector;
+
+// in the order the scheduler tries them, cheapest first
+enum class Technique {
+    Singles,
+    SubgroupExclusion,
+    Chains,
+    Boxes,
+    AlternatePairs,
+    XYWing,
+    XYZWing,
+    WWing,
+    UniqueRectangle,
+    BugPlusOne,
+    AlmostLockedSets,
+    AlternatingChains,
+    Templates
+};
+
+static const int kTechniqueCount = 13;
+
+// one bit per Technique
+typedef unsigned TechniqueMask;
+
+inline TechniqueMask techniqueBit(const Technique technique) {
+    return 1u << (int)technique;
+}
+
+static const TechniqueMask kAllTechniques = (1u << kTechniqueCount) - 1;
+// unique rectangles and BUG+1 assume the puzzle has one solution, which searches that count solutions can't
+static const TechniqueMask kDefaultTechniques = kAllTechniques & ~techniqueBit(Technique::UniqueRectangle) & ~techniqueBit(Technique::BugPlusOne);
+
+struct TechniqueStep {
+    Technique technique;
+    // only meaningful for Chains; a chain of size 1 is a hidden single
+    int chainSize;
+};
+
 class ConstraintSolver {
+    // times the private kernels one by one
+    friend class KernelBenchmark;
+
     Grid& _grid;
     GridEditor _editor;
+    SolveMonitor* _monitor;
+    TechniqueMask _techniques;
+    // created on first use and kept in step with the grid, so later passes only update the links that changed
+    std::unique_ptr<AlternatingChainEngine> _chainEngine;
+    std::unique_ptr<TemplateEngine> _templateEngine;
+    bool _shouldStop();
+    bool _isEnabled(const Technique technique) const;
+
     void _setCandidates();
     void _setCandidatesNaive();
     bool _updateCellsWithOneCandidate();
@@ -36,19 +94,36 @@ class ConstraintSolver {
     bool _filterCandidatesUsingChains();
     bool _filterCandidatesUsingBoxes();
     bool _filterUsingAlternatePairs();
+    bool _findAlternatingChainEliminations(EliminationVector& eliminations);
+    bool _findTemplateEliminations(EliminationVector& eliminations);
+    bool _filterCandidatesUsingAdvancedTechniques(const bool applyAll, Technique& appliedTechnique);
 
     bool _processSubgroupExclusion(const IntSet& indices, const bool isRowOrColumn);
     bool _processChains(const IntSet& indices, const bool isRowOrColumn);
+    bool _processChainsOfSize(const bool isRowOrColumn, const CandidateCellLists& candidateCellLists, const int chainSize);
+    bool _filterCandidatesUsingChainsOfSize(const int chainSize);
 
-    IntPairVector _getCellIndexPairList(const int pairValue, const bool forRow);
+    ScratchIntPairVector _getCellIndexPairList(const int pairValue, const bool forRow);
 
-    void _buildPairChain(const int startIndex, const int candidateValue, IntSet& visitedIndices, IntVector& pairChain, IntToBoolMap& colorMap, IntToIntToIntSetMap& rowMap, IntToIntToIntSetMap& colMap, IntToIntToIntSetMap& subgridMap);
+    void _buildPairChain(const int startIndex, const int candidateValue, ScratchIntVector& visited, ScratchIntVector& pairChain, ScratchIntVector& colors, const ScratchIntVector& unitPairs);
 
 public:
     ConstraintSolver(Grid&);
+    // stops propagating (leaving the grid partially propagated) once the monitor says so
+    ConstraintSolver(Grid&, SolveMonitor* monitor);
+    ConstraintSolver(Grid&, SolveMonitor* monitor, const TechniqueMask techniques);
+    ~ConstraintSolver();
     void solve();
 
+    // singles always run; the other techniques can be switched off one by one (kDefaultTechniques to start with)
+    void setTechniqueEnabled(const Technique technique, const bool enabled);
+    TechniqueMask getTechniques() const;
+
     void propagateContraints();
+
+    // step-by-step solving for grading: start from naive candidates, then apply one technique at a time
+    void setNaiveCandidates();
+    bool applyCheapestTechnique(TechniqueStep& step);
 };
 
 
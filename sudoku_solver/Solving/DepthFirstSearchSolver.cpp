@@ -7,47 +7,277 @@
 
 #include "DepthFirstSearchSolver.hpp"
 
+#include "BackjumpingSearch.hpp"
+#include "BitmaskSolver.hpp"
 #include "ConstraintSolver.hpp"
 
+#include <algorithm>
+#include <climits>
+#include <cmath>
 #include <iostream>
+#include <vector>
 
-DepthFirstSearchSolver::DepthFirstSearchSolver(Grid& g) : _grid(g) {}
+DepthFirstSearchSolver::DepthFirstSearchSolver(Grid& g) : DepthFirstSearchSolver(g, nullptr, SearchOptions()) {}
 
-void DepthFirstSearchSolver::_pushChildrenOfState(const Grid& state, GridStack& gridStack) {
-    const int gridSize = state.getSize();
+DepthFirstSearchSolver::DepthFirstSearchSolver(Grid& g, SolveMonitor* monitor) : DepthFirstSearchSolver(g, monitor, SearchOptions()) {}
 
-    const int nextCellIndex = state.getCellIndexWithFewestCandidates();
-    const Cell& nextCell = state.cellAtIndex(nextCellIndex);
+DepthFirstSearchSolver::DepthFirstSearchSolver(Grid& g, SolveMonitor* monitor, const SearchOptions options) : _grid(g), _monitor(monitor), _options(options), _branchSelector(options.branching, options.valueOrdering), _prober(g.getSize(), options.lookaheadPool), _rng(options.seed), _bytesPerDepth(0), _fixedBytes(0) {}
 
-    const IntSet& candidates = nextCell.getCandidates();
-    for (auto candidate = candidates.begin(); candidate != candidates.end(); ++ candidate) {
-        Grid child = state;
-        child.cellAtIndex(nextCellIndex).setValue(*candidate, gridSize);
-        ConstraintSolver(child).propagateContraints();
-        gridStack.push(child);
-        if (child.isSolved()) {
-            break;
+#pragma mark - Restarts
+
+// the Luby sequence 1, 1, 2, 1, 1, 2, 4, 1, 1, 2, 1, 1, 2, 4, 8, ... for i >= 1
+static long lubyValue(long i) {
+    while (true) {
+        int k = 1;
+        while ((1L << k) - 1 < i) {
+            k++;
+        }
+        if (i == (1L << k) - 1) {
+            return 1L << (k - 1);
+        }
+        i = i - (1L << (k - 1)) + 1;
+    }
+}
+
+long DepthFirstSearchSolver::_nodeLimitForRun(const int runIndex) const {
+    const long base = std::max(1L, _options.restartBaseNodes);
+    switch (_options.restartSchedule) {
+        case RestartSchedule::None:
+            return 0;
+        case RestartSchedule::Luby:
+            return base * lubyValue(runIndex + 1);
+        case RestartSchedule::Geometric: {
+            // checkRestartOptions rejects factors up to 1; should one get here anyway, the limit still doubles
+            const double factor = _options.restartGrowthFactor > 1 ? _options.restartGrowthFactor : 2;
+            const double limit = base * pow(factor, runIndex);
+            return limit < (double)(LONG_MAX / 2) ? (long)limit : LONG_MAX / 2;
+        }
+    }
+    return 0;
+}
+
+bool DepthFirstSearchSolver::restartScheduleFromName(const std::string& name, RestartSchedule& schedule) {
+    if (name == "none") {
+        schedule = RestartSchedule::None;
+    } else if (name == "luby") {
+        schedule = RestartSchedule::Luby;
+    } else if (name == "geometric") {
+        schedule = RestartSchedule::Geometric;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool DepthFirstSearchSolver::checkRestartOptions(const SearchOptions& options, std::string& error) {
+    if (options.restartSchedule == RestartSchedule::Geometric && !(options.restartGrowthFactor > 1)) {
+        error = "geometric restarts need a growth factor above 1, not " + std::to_string(options.restartGrowthFactor);
+        return false;
+    }
+    return true;
+}
+
+#pragma mark - Memory
+
+void DepthFirstSearchSolver::_startMemoryAccounting() {
+    const size_t gridBytes = sizeof(Grid) + _grid.getMemoryFootprint();
+    _bytesPerDepth = sizeof(DepthGrids) + gridBytes * (_options.lookahead ? 2 : 1);
+    _fixedBytes = 2 * gridBytes;
+    if (_options.transpositionTable != nullptr) {
+        _fixedBytes += _options.transpositionTable->getMemoryFootprint();
+    }
+    _reportMemory();
+}
+
+void DepthFirstSearchSolver::_reportMemory() {
+    if (_monitor == nullptr) {
+        return;
+    }
+    _monitor->setMemoryUsage(MemoryCategory::SearchState, _fixedBytes + _gridsByDepth.size() * _bytesPerDepth);
+    _monitor->setMemoryUsage(MemoryCategory::PropagationScratch, ScratchArena::forCurrentThread().getCapacity());
+}
+
+void DepthFirstSearchSolver::_releaseMemory() {
+    std::deque<DepthGrids>().swap(_gridsByDepth);
+    if (_monitor != nullptr) {
+        _monitor->setMemoryUsage(MemoryCategory::SearchState, 0);
+    }
+}
+
+#pragma mark - Search
+
+DepthFirstSearchSolver::DepthGrids& DepthFirstSearchSolver::_gridsAtDepth(const int depth) {
+    if ((int)_gridsByDepth.size() <= depth) {
+        while ((int)_gridsByDepth.size() <= depth) {
+            _gridsByDepth.emplace_back();
         }
+        _reportMemory();
     }
+    return _gridsByDepth[depth];
 }
 
+/**
+ Returns the number of solutions below node, counting at most up to the run's solution limit, or -1 when the run
+ was cut off. Subtrees that were explored completely go into the transposition table, so a state reached again
+ through a different order of decisions is not explored twice.
+ */
+long DepthFirstSearchSolver::_explore(const SearchNode& node, SearchRun& run) {
+    const Grid& state = node.grid;
+    _statistics.nodeCount += 1;
+    run.nodeCount += 1;
+    if (node.depth > _statistics.maxDepth) {
+        _statistics.maxDepth = node.depth;
+    }
+    if (state.isSolved()) {
+        if (run.solutionCount == 0) {
+            run.solution = state;
+        }
+        run.solutionCount += 1;
+        return 1;
+    }
+    if (_monitor != nullptr && !_monitor->countNode(node.depth)) {
+        run.outcome = RunOutcome::Stopped;
+        return -1;
+    }
+    if (run.nodeLimit > 0 && run.nodeCount > run.nodeLimit) {
+        run.outcome = RunOutcome::NodeLimitReached;
+        return -1;
+    }
+    if (!state.isValid()) {
+        return 0;
+    }
+
+    TranspositionTable* table = _options.transpositionTable;
+    long cachedCount = 0;
+    if (table != nullptr && table->lookup(state.getHash(), cachedCount) && (cachedCount == 0 || !run.needsSolution)) {
+        _statistics.transpositionHitCount += 1;
+        run.solutionCount += cachedCount;
+        return cachedCount;
+    }
+
+    // the look-ahead narrows a copy; the table keeps using the hash of the state as it was reached
+    DepthGrids& grids = _gridsAtDepth(node.depth);
+    if (_monitor != nullptr && _monitor->isStopped()) {
+        run.outcome = RunOutcome::Stopped;
+        return -1;
+    }
+    Grid& probedState = grids.probed;
+    const Grid* branchState = &state;
+    if (_options.lookahead) {
+        probedState = state;
+        const bool consistent = _prober.probe(probedState);
+        _copyProbeStatistics();
+        if (_monitor != nullptr && _monitor->isStopped()) {
+            run.outcome = RunOutcome::Stopped;
+            return -1;
+        }
+        const long probedCount = !consistent ? 0 : probedState.isSolved() ? 1 : -1;
+        if (probedCount >= 0) {
+            if (probedCount == 1) {
+                if (run.solutionCount == 0) {
+                    run.solution = probedState;
+                }
+                run.solutionCount += 1;
+            }
+            if (table != nullptr) {
+                table->store(state.getHash(), probedCount);
+            }
+            return probedCount;
+        }
+        branchState = &probedState;
+    }
+
+    const BranchVector branches = _branchSelector.selectBranches(*branchState, _options.randomize ? &_rng : nullptr);
+    long total = 0;
+    for (auto branch = branches.begin(); branch != branches.end(); ++branch) {
+        Grid& child = grids.child;
+        child = *branchState;
+        child.setCellValue(branch->cellIndex, branch->value);
+        ConstraintSolver(child, _monitor, _options.techniques).propagateContraints();
+        _statistics.branchCount += 1;
+        if (_monitor != nullptr && _monitor->isStopped()) {
+            run.outcome = RunOutcome::Stopped;
+            return -1;
+        }
+        const long childCount = _explore(SearchNode{child, node.depth + 1}, run);
+        if (childCount < 0) {
+            return -1;
+        }
+        total += childCount;
+        if (run.solutionCount >= run.solutionLimit) {
+            // the count may be cut short, so it is not cached
+            return total;
+        }
+    }
+    if (table != nullptr) {
+        table->store(state.getHash(), total);
+    }
+    return total;
+}
+
+void DepthFirstSearchSolver::_copyProbeStatistics() {
+    const ProbeStatistics& probeStatistics = _prober.getStatistics();
+    _statistics.probeCount = probeStatistics.probeCount;
+    _statistics.failedLiteralCount = probeStatistics.failedLiteralCount;
+    _statistics.forcedCount = probeStatistics.forcedCount;
+}
+
+DepthFirstSearchSolver::RunOutcome DepthFirstSearchSolver::_searchOnce(const long nodeLimit, Grid& result) {
+    SearchRun run = SearchRun{nodeLimit, 0, 1, 0, true, RunOutcome::Exhausted, Grid()};
+    _explore(SearchNode{_grid, 0}, run);
+    if (run.solutionCount > 0) {
+        result = run.solution;
+        return RunOutcome::Solved;
+    }
+    return run.outcome;
+}
+
+/**
+ Without restarts this is a single complete DFS. With a restart schedule, each run is cut off after its node
+ limit and the search starts over from the root with the RNG where the last run left it, so the next run explores
+ a different part of the tree. The limits keep growing, so a run eventually finishes (solving the grid or proving
+ there is no solution). With a transposition table, later runs also skip the subtrees earlier runs proved dead.
+ */
 Grid DepthFirstSearchSolver::search() {
     Grid result = _grid;
 
-    GridStack gridStack;
-    gridStack.push(_grid);
+    if (_options.conflictDirectedBackjumping && BitmaskSolver::supportsSize(_grid.getSize())) {
+        {
+            BackjumpingSearch backjumpingSearch(_grid, _monitor, _options.maxNogoodSize);
+            backjumpingSearch.search(result);
+            _statistics = backjumpingSearch.getStatistics();
+        }
+        _releaseMemory();
+        return result;
+    }
 
-    while (!gridStack.empty()) {
-        Grid currentGrid = gridStack.top();
-        gridStack.pop();
-        if (currentGrid.isSolved()) {
-            result = currentGrid;
+    _statistics = SearchStatistics();
+    _startMemoryAccounting();
+
+    for (int runIndex = 0; ; runIndex++) {
+        const RunOutcome outcome = _searchOnce(_nodeLimitForRun(runIndex), result);
+        if (outcome != RunOutcome::NodeLimitReached) {
             break;
         }
-        if (currentGrid.isValid()) {
-            _pushChildrenOfState(currentGrid, gridStack);
-        }
+        _statistics.restartCount += 1;
     }
 
+    _releaseMemory();
     return result;
 }
+
+long DepthFirstSearchSolver::countSolutions(const long limit) {
+    _statistics = SearchStatistics();
+    _startMemoryAccounting();
+    SearchRun run = SearchRun{0, 0, limit, 0, false, RunOutcome::Exhausted, Grid()};
+    const long count = _explore(SearchNode{_grid, 0}, run);
+    _releaseMemory();
+    if (count < 0) {
+        return -1;
+    }
+    return std::min(run.solutionCount, limit);
+}
+
+const SearchStatistics& DepthFirstSearchSolver::getStatistics() const {
+    return _statistics;
+}
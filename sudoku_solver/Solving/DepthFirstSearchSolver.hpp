@@ -8,21 +8,136 @@
 #ifndef DepthFirstSearchSolver_hpp
 #define DepthFirstSearchSolver_hpp
 
+#include <deque>
 #include <list>
-#include <stack>
+#include <random>
 
+#include "BranchSelector.hpp"
+#include "ConstraintSolver.hpp"
 #include "Grid.hpp"
+#include "LookaheadProber.hpp"
+#include "SolveMonitor.hpp"
+#include "TranspositionTable.hpp"
+
+// the state is owned by the caller (the root grid or the level's child grid), so passing a node copies nothing
+struct SearchNode {
+    const Grid& grid;
+    int depth;
+};
+
+struct SearchStatistics {
+    long nodeCount = 0;     // states taken off the stack, summed over restarts
+    long branchCount = 0;   // child states pushed
+    int maxDepth = 0;
+    int restartCount = 0;
+    // backjumping only
+    long backjumpCount = 0;     // levels whose remaining values were skipped
+    long nogoodCount = 0;
+    long nogoodPruneCount = 0;  // branches cut because they completed a nogood
+    long transpositionHitCount = 0;
+    // look-ahead only
+    long probeCount = 0;
+    long failedLiteralCount = 0;
+    long forcedCount = 0;
+};
+
+enum class RestartSchedule {
+    None,
+    Luby,       // restartBaseNodes * (1, 1, 2, 1, 1, 2, 4, 1, ...)
+    Geometric   // restartBaseNodes * restartGrowthFactor^i
+};
+
+struct SearchOptions {
+    // what ConstraintSolver may use on the root and on every child state
+    TechniqueMask techniques = kDefaultTechniques;
+    BranchingStrategy branching = BranchingStrategy::CellOrUnit;
+    ValueOrdering valueOrdering = ValueOrdering::LeastConstraining;
+    // break cell ties and order equally good branches at random
+    bool randomize = false;
+    unsigned long long seed = 0;
+    RestartSchedule restartSchedule = RestartSchedule::None;
+    long restartBaseNodes = 32;
+    double restartGrowthFactor = 1.5;
+    // trace each dead end back to the decisions behind it and return straight to the deepest one; propagates
+    // singles only and ignores the branching, ordering, restart and look-ahead options (grids up to 64x64)
+    bool conflictDirectedBackjumping = false;
+    // with backjumping, keep dead ends over at most this many decisions as nogoods (0 keeps none)
+    int maxNogoodSize = 0;
+    // not owned; may be shared by several searches, also on different threads
+    TranspositionTable* transpositionTable = nullptr;
+    // probe both alternatives of every bivalue cell and bi-location value before branching (see LookaheadProber)
+    bool lookahead = false;
+    // not owned; runs the probes when set, so it must not be the pool this search runs on
+    ThreadPool* lookaheadPool = nullptr;
+};
 
-typedef std::stack<Grid> GridStack;
 typedef std::unordered_set<int> IntSet;
 
 class DepthFirstSearchSolver {
+    enum class RunOutcome {
+        Solved,
+        Exhausted,
+        NodeLimitReached,
+        Stopped
+    };
+
     Grid& _grid;
-    void _pushChildrenOfState(const Grid& state, GridStack& gridStack);
+    SolveMonitor* _monitor;
+    SearchOptions _options;
+    BranchSelector _branchSelector;
+    LookaheadProber _prober;
+    std::mt19937_64 _rng;
+    SearchStatistics _statistics;
+
+    struct SearchRun {
+        long nodeLimit;         // 0 means no limit
+        long nodeCount;
+        long solutionLimit;
+        long solutionCount;
+        bool needsSolution;     // keep the first solution, which cached counts cannot provide
+        RunOutcome outcome;
+        Grid solution;
+    };
+
+    // the child and look-ahead grids of each depth, reused from node to node: assigning a grid of the same size
+    // keeps its buffers, so the search stops allocating for them once it has been as deep as it goes. A deque keeps
+    // the shallower levels in place while deeper ones are added.
+    struct DepthGrids {
+        Grid child;
+        Grid probed;
+    };
+    std::deque<DepthGrids> _gridsByDepth;
+    DepthGrids& _gridsAtDepth(const int depth);
+
+    // what the monitor is told the search holds: the grids of every depth reached so far, estimated from the root
+    // grid (which has the most candidates), plus the result grids and the transposition table
+    size_t _bytesPerDepth;
+    size_t _fixedBytes;
+    void _startMemoryAccounting();
+    void _reportMemory();
+    void _releaseMemory();
+
+    long _explore(const SearchNode& node, SearchRun& run);
+    RunOutcome _searchOnce(const long nodeLimit, Grid& result);
+    long _nodeLimitForRun(const int runIndex) const;
+    void _copyProbeStatistics();
 
 public:
     DepthFirstSearchSolver(Grid&);
+    // gives up (returning the unsolved input) as soon as the monitor stops the solve, which includes going over
+    // SolveLimits::maxMemoryBytes
+    DepthFirstSearchSolver(Grid&, SolveMonitor* monitor);
+    DepthFirstSearchSolver(Grid&, SolveMonitor* monitor, const SearchOptions options);
     Grid search();
+    // counts solutions up to limit without restarts; -1 when the monitor stopped the count
+    long countSolutions(const long limit);
+
+    const SearchStatistics& getStatistics() const;
+
+    // none, luby or geometric; false for any other name
+    static bool restartScheduleFromName(const std::string& name, RestartSchedule& schedule);
+    // false with an error when a restart schedule's node limits wouldn't keep growing, so it could restart forever
+    static bool checkRestartOptions(const SearchOptions& options, std::string& error);
 };
 
 
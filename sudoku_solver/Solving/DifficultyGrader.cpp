@@ -0,0 +1,162 @@
+//
+//  DifficultyGrader.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "DifficultyGrader.hpp"
+
+DifficultyGrader::DifficultyGrader(Grid& g) : _grid(g) {}
+
+static bool isHarderStep(const TechniqueStep& step, const TechniqueStep& hardest) {
+    if (step.technique != hardest.technique) {
+        return (int)step.technique > (int)hardest.technique;
+    }
+    return step.chainSize > hardest.chainSize;
+}
+
+static Difficulty difficultyOfStep(const TechniqueStep& step) {
+    switch (step.technique) {
+        case Technique::Singles:
+            return Difficulty::Easy;
+        case Technique::SubgroupExclusion:
+            return Difficulty::Medium;
+        case Technique::Chains:
+            if (step.chainSize <= 1) {
+                return Difficulty::Easy;
+            }
+            return step.chainSize == 2 ? Difficulty::Medium : Difficulty::Hard;
+        case Technique::Boxes:
+            return Difficulty::Hard;
+        case Technique::AlternatePairs:
+        case Technique::XYWing:
+        case Technique::XYZWing:
+        case Technique::WWing:
+        case Technique::UniqueRectangle:
+        case Technique::BugPlusOne:
+        case Technique::AlmostLockedSets:
+        case Technique::AlternatingChains:
+            return Difficulty::Expert;
+        case Technique::Templates:
+            return Difficulty::Extreme;
+    }
+    return Difficulty::Extreme;
+}
+
+GradeReport DifficultyGrader::grade() {
+    GradeReport report;
+    if (!_grid.isValid()) {
+        report.difficulty = Difficulty::Invalid;
+        return report;
+    }
+
+    ConstraintSolver solver(_grid, nullptr, kAllTechniques);
+    solver.setNaiveCandidates();
+
+    Difficulty difficulty = Difficulty::Easy;
+    TechniqueStep step;
+    while (solver.applyCheapestTechnique(step)) {
+        report.stepCounts[(int)step.technique] += 1;
+        report.totalSteps += 1;
+        if (step.chainSize > report.largestChainSize) {
+            report.largestChainSize = step.chainSize;
+        }
+        if (isHarderStep(step, report.hardestStep)) {
+            report.hardestStep = step;
+        }
+        const Difficulty stepDifficulty = difficultyOfStep(step);
+        if ((int)stepDifficulty > (int)difficulty) {
+            difficulty = stepDifficulty;
+        }
+    }
+
+    if (_grid.isSolved()) {
+        report.solvedWithLogic = true;
+        report.solved = true;
+        report.difficulty = difficulty;
+        return report;
+    }
+
+    DepthFirstSearchSolver searchSolver(_grid);
+    Grid dfsResult = searchSolver.search();
+    report.searchStatistics = searchSolver.getStatistics();
+    if (dfsResult.isSolved()) {
+        _grid = dfsResult;
+        report.solved = true;
+        report.difficulty = Difficulty::Extreme;
+    } else {
+        report.difficulty = Difficulty::Invalid;
+    }
+    return report;
+}
+
+GradeReportVector DifficultyGrader::gradeAll(GridVector& grids, ThreadPool& pool) {
+    GradeReportVector result(grids.size());
+    pool.parallelFor((int)grids.size(), [&](const int, const int itemIndex) {
+        result[itemIndex] = DifficultyGrader(grids[itemIndex]).grade();
+    });
+    return result;
+}
+
+#pragma mark - Names
+
+std::string DifficultyGrader::difficultyName(const Difficulty difficulty) {
+    switch (difficulty) {
+        case Difficulty::Easy:
+            return "easy";
+        case Difficulty::Medium:
+            return "medium";
+        case Difficulty::Hard:
+            return "hard";
+        case Difficulty::Expert:
+            return "expert";
+        case Difficulty::Extreme:
+            return "extreme";
+        case Difficulty::Invalid:
+            return "invalid";
+    }
+    return "";
+}
+
+std::string DifficultyGrader::techniqueName(const Technique technique) {
+    switch (technique) {
+        case Technique::Singles:
+            return "singles";
+        case Technique::SubgroupExclusion:
+            return "subgroup-exclusion";
+        case Technique::Chains:
+            return "chains";
+        case Technique::Boxes:
+            return "boxes";
+        case Technique::AlternatePairs:
+            return "alternate-pairs";
+        case Technique::XYWing:
+            return "xy-wing";
+        case Technique::XYZWing:
+            return "xyz-wing";
+        case Technique::WWing:
+            return "w-wing";
+        case Technique::UniqueRectangle:
+            return "unique-rectangle";
+        case Technique::BugPlusOne:
+            return "bug-plus-one";
+        case Technique::AlmostLockedSets:
+            return "als-xz";
+        case Technique::AlternatingChains:
+            return "aic";
+        case Technique::Templates:
+            return "templates";
+    }
+    return "";
+}
+
+bool DifficultyGrader::techniqueFromName(const std::string& name, Technique& technique) {
+    for (int index = 0; index < kTechniqueCount; index++) {
+        if (techniqueName((Technique)index) == name) {
+            technique = (Technique)index;
+            return true;
+        }
+    }
+    return false;
+}
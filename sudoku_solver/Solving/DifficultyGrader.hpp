@@ -0,0 +1,66 @@
+//
+//  DifficultyGrader.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef DifficultyGrader_hpp
+#define DifficultyGrader_hpp
+
+#include <string>
+#include <vector>
+
+#include "ConstraintSolver.hpp"
+#include "DepthFirstSearchSolver.hpp"
+#include "Grid.hpp"
+#include "ThreadPool.hpp"
+
+enum class Difficulty {
+    Easy,       // singles and hidden singles
+    Medium,     // subgroup exclusion and pairs
+    Hard,       // larger chains and boxes
+    Expert,     // alternate pairs, wings, unique rectangles, BUG+1, almost locked sets and alternating chains
+    Extreme,    // needs templates, or logic stalls and needs DFS
+    Invalid     // no solution
+};
+
+struct GradeReport {
+    Difficulty difficulty = Difficulty::Easy;
+    bool solvedWithLogic = false;
+    bool solved = false;
+
+    // hardest step the logic needed; chain size is only set for Chains
+    TechniqueStep hardestStep = TechniqueStep{Technique::Singles, 0};
+    long stepCounts[kTechniqueCount] = {};
+    long totalSteps = 0;
+    int largestChainSize = 0;
+
+    // only filled when the logic stalled and DFS had to finish the grid
+    SearchStatistics searchStatistics;
+};
+
+typedef std::vector<GradeReport> GradeReportVector;
+typedef std::vector<Grid> GridVector;
+
+/**
+ Labels a puzzle by the hardest technique needed to solve it with logic alone, using the cheapest technique
+ that makes progress at every step. Every technique is enabled, including the ones that assume a unique solution. When the logic stalls, the rest is left to DFS and its depth and branch count
+ are reported instead.
+ */
+class DifficultyGrader {
+    Grid& _grid;
+
+public:
+    DifficultyGrader(Grid&);
+    GradeReport grade();
+
+    // grades (and solves) every grid in place, spread over the pool
+    static GradeReportVector gradeAll(GridVector& grids, ThreadPool& pool);
+
+    static std::string difficultyName(const Difficulty difficulty);
+    static std::string techniqueName(const Technique technique);
+    static bool techniqueFromName(const std::string& name, Technique& technique);
+};
+
+#endif /* DifficultyGrader_hpp */
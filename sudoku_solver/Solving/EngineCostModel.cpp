@@ -0,0 +1,197 @@
+//
+//  EngineCostModel.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "EngineCostModel.hpp"
+
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+static const std::string kModelHeader = "engine_cost_model 1";
+// the choice without any weights: from 25x25 on the technique passes get slow and DFS tends to time out, while
+// clause learning copes
+static const int kSatMinimumSize = 25;
+
+SearchOptions SolveStrategy::searchOptions(const SearchOptions& base) const {
+    SearchOptions options = base;
+    options.techniques &= techniques;
+    options.conflictDirectedBackjumping |= conflictDirectedBackjumping;
+    return options;
+}
+
+EngineCostModel::EngineCostModel() : _weights(strategies().size()), _variances(strategies().size(), 0) {}
+
+#pragma mark - Strategies
+
+static SolveStrategyVector buildStrategies() {
+    SolveStrategyVector strategies;
+
+    SolveStrategy light;
+    light.name = "light";
+    light.techniques = techniqueBit(Technique::SubgroupExclusion);
+    strategies.push_back(light);
+
+    SolveStrategy standard;
+    standard.name = "standard";
+    strategies.push_back(standard);
+
+    // backjumping only propagates singles, so the root gets nothing more either
+    SolveStrategy backjump;
+    backjump.name = "backjump";
+    backjump.techniques = 0;
+    backjump.conflictDirectedBackjumping = true;
+    strategies.push_back(backjump);
+
+    SolveStrategy sat;
+    sat.name = "sat";
+    sat.useSat = true;
+    strategies.push_back(sat);
+
+    return strategies;
+}
+
+const SolveStrategyVector& EngineCostModel::strategies() {
+    static const SolveStrategyVector strategies = buildStrategies();
+    return strategies;
+}
+
+int EngineCostModel::strategyIndex(const std::string& name) {
+    const SolveStrategyVector& all = strategies();
+    for (int index = 0; index < (int)all.size(); index++) {
+        if (all[index].name == name) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+// "sudoku_bench calibrate --count 40" on the default corpora; inputs as in PuzzleFeatures::modelInputs
+static EngineCostModel buildBuiltInModel() {
+    EngineCostModel model;
+    model.setWeights("light", {-16.6145101, 2.09335731, 3.27792515, 1.86731148, -2.96162917, -1.85235}, 0.409734547);
+    model.setWeights("standard", {-16.9154135, 2.66871307, 2.07980485, 0.918907422, -1.16078955, -1.14899748}, 0.144116428);
+    model.setWeights("backjump", {-16.2518353, 1.63638711, 0.372201218, 2.43442059, -0.0348771146, -0.0392976113}, 0.481544892);
+    model.setWeights("sat", {-14.5886507, 1.30579566, 1.30965463, 0.825306672, -0.462416432, -0.693512393}, 0.0431533031);
+    return model;
+}
+
+const EngineCostModel& EngineCostModel::builtIn() {
+    static const EngineCostModel model = buildBuiltInModel();
+    return model;
+}
+
+#pragma mark - Prediction
+
+bool EngineCostModel::setWeights(const std::string& strategyName, const DoubleVector& weights, const double variance) {
+    const int index = strategyIndex(strategyName);
+    if (index < 0 || weights.size() != PuzzleFeatures::kModelInputCount || variance < 0) {
+        return false;
+    }
+    _weights[index] = weights;
+    _variances[index] = variance;
+    return true;
+}
+
+bool EngineCostModel::hasWeights(const int strategyIndex) const {
+    return !_weights[strategyIndex].empty();
+}
+
+double EngineCostModel::predictSeconds(const PuzzleFeatures& features, const int strategyIndex) const {
+    const DoubleVector& weights = _weights[strategyIndex];
+    if (weights.empty()) {
+        return 0;
+    }
+    const PuzzleFeatures::ModelInputs inputs = features.modelInputs();
+    double logSeconds = _variances[strategyIndex] / 2;
+    for (int i = 0; i < PuzzleFeatures::kModelInputCount; i++) {
+        logSeconds += weights[i] * inputs[i];
+    }
+    return std::exp(logSeconds);
+}
+
+const SolveStrategy& EngineCostModel::choose(const PuzzleFeatures& features) const {
+    const SolveStrategyVector& all = strategies();
+    // clashing givens fail on the first propagation pass, whatever the model thinks
+    if (features.contradiction) {
+        return all[strategyIndex("light")];
+    }
+    int bestIndex = -1;
+    double bestSeconds = 0;
+    for (int index = 0; index < (int)all.size(); index++) {
+        if (!hasWeights(index)) {
+            continue;
+        }
+        const double seconds = predictSeconds(features, index);
+        if (bestIndex < 0 || seconds < bestSeconds) {
+            bestIndex = index;
+            bestSeconds = seconds;
+        }
+    }
+    if (bestIndex < 0) {
+        return all[strategyIndex(features.size >= kSatMinimumSize ? "sat" : "standard")];
+    }
+    return all[bestIndex];
+}
+
+#pragma mark - Files
+
+bool EngineCostModel::write(const std::string& filename) const {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+    file << std::setprecision(9);
+    file << kModelHeader << "\n";
+    const SolveStrategyVector& all = strategies();
+    for (int index = 0; index < (int)all.size(); index++) {
+        if (!hasWeights(index)) {
+            continue;
+        }
+        file << "weights " << all[index].name << " " << _variances[index];
+        for (auto weight = _weights[index].begin(); weight != _weights[index].end(); ++weight) {
+            file << " " << *weight;
+        }
+        file << "\n";
+    }
+    return file.good();
+}
+
+bool EngineCostModel::read(const std::string& filename, EngineCostModel& model, std::string& error) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        error = "unable to open " + filename;
+        return false;
+    }
+    std::string line;
+    if (!getline(file, line) || line != kModelHeader) {
+        error = filename + " is not an engine cost model";
+        return false;
+    }
+    model = EngineCostModel();
+    int lineNumber = 1;
+    while (getline(file, line)) {
+        lineNumber += 1;
+        if (line.empty()) {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string type;
+        std::string name;
+        double variance;
+        fields >> type >> name >> variance;
+        DoubleVector weights(PuzzleFeatures::kModelInputCount);
+        for (auto weight = weights.begin(); weight != weights.end(); ++weight) {
+            fields >> *weight;
+        }
+        if (type != "weights" || fields.fail() || !model.setWeights(name, weights, variance)) {
+            error = filename + ":" + std::to_string(lineNumber) + ": invalid line";
+            return false;
+        }
+    }
+    return true;
+}
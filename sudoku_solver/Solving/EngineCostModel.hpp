@@ -0,0 +1,70 @@
+//
+//  EngineCostModel.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef EngineCostModel_hpp
+#define EngineCostModel_hpp
+
+#include <string>
+#include <vector>
+
+#include "ConstraintSolver.hpp"
+#include "DepthFirstSearchSolver.hpp"
+#include "PuzzleFeatures.hpp"
+
+// one way of solving a puzzle that the automatic engine can pick
+struct SolveStrategy {
+    std::string name;
+    bool useSat = false;
+    // intersected with the caller's techniques, so techniques switched off stay off
+    TechniqueMask techniques = kAllTechniques;
+    bool conflictDirectedBackjumping = false;
+
+    // the caller's options with this strategy's techniques and backjumping applied
+    SearchOptions searchOptions(const SearchOptions& base) const;
+};
+
+typedef std::vector<SolveStrategy> SolveStrategyVector;
+
+/**
+ Predicts how long each strategy takes on a puzzle from its PuzzleFeatures and picks the fastest, so easy puzzles
+ skip the expensive technique passes and hard ones go straight to backjumping or SAT.
+
+ Each strategy has a linear model of ln(seconds) over PuzzleFeatures::modelInputs plus the variance of its
+ residuals, and the prediction is the mean of that lognormal, exp(w·x + variance / 2): a strategy that is fast on
+ most puzzles but times out on a few pays for its tail. The weights are fitted offline by "sudoku_bench
+ calibrate", which times every strategy on the benchmark corpora; builtIn holds the weights of a calibration run
+ and a model file from another run can be read in its place.
+
+ The model file is plain text: a "engine_cost_model 1" header, then one "weights strategy variance w0 w1 ..."
+ line per strategy. Strategies without weights are never picked; without any weights the choice falls back to
+ SAT from 25x25 on and the standard technique set below that.
+ */
+class EngineCostModel {
+    // indexed like strategies(); empty for strategies without weights
+    std::vector<DoubleVector> _weights;
+    DoubleVector _variances;
+
+public:
+    EngineCostModel();
+
+    // light (singles and subgroup exclusion, then DFS), standard (every technique, then DFS), backjump and sat
+    static const SolveStrategyVector& strategies();
+    static int strategyIndex(const std::string& name);
+    static const EngineCostModel& builtIn();
+
+    bool setWeights(const std::string& strategyName, const DoubleVector& weights, const double variance);
+    bool hasWeights(const int strategyIndex) const;
+
+    // mean of the fitted lognormal; 0 for strategies without weights
+    double predictSeconds(const PuzzleFeatures& features, const int strategyIndex) const;
+    const SolveStrategy& choose(const PuzzleFeatures& features) const;
+
+    bool write(const std::string& filename) const;
+    static bool read(const std::string& filename, EngineCostModel& model, std::string& error);
+};
+
+#endif /* EngineCostModel_hpp */
@@ -0,0 +1,293 @@
+//
+//  LaneSolver.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "LaneSolver.hpp"
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+#include "BitmaskSolver.hpp"
+#include "Solver.hpp"
+
+static const int kSize = 9;
+static const int kCellCount = 81;
+static const uint16_t kAllValues = 0x1ff;
+
+#pragma mark - Lane vectors
+
+#if defined(__GNUC__) || defined(__clang__)
+
+#if defined(__GNUC__) && !defined(__clang__)
+// the helpers below are internal, so passing 32-byte vectors without AVX enabled doesn't cross an ABI boundary
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+typedef uint16_t LaneVector __attribute__((vector_size(2 * LaneSolver::kLaneCount)));
+
+static inline LaneVector splat(const uint16_t value) {
+    LaneVector vector = {};
+    return vector | value;
+}
+
+// all ones in the lanes that are zero
+static inline LaneVector isZero(const LaneVector vector) {
+    return (LaneVector)(vector == 0);
+}
+
+#else
+
+struct LaneVector {
+    uint16_t lanes[LaneSolver::kLaneCount];
+
+    inline uint16_t& operator[](const int lane) { return lanes[lane]; }
+    inline uint16_t operator[](const int lane) const { return lanes[lane]; }
+};
+
+#define LANE_OPERATOR(op) \
+    static inline LaneVector operator op(const LaneVector& a, const LaneVector& b) { \
+        LaneVector result; \
+        for (int lane = 0; lane < LaneSolver::kLaneCount; lane++) { \
+            result.lanes[lane] = (uint16_t)(a.lanes[lane] op b.lanes[lane]); \
+        } \
+        return result; \
+    } \
+    static inline LaneVector& operator op##=(LaneVector& a, const LaneVector& b) { \
+        a = a op b; \
+        return a; \
+    }
+
+LANE_OPERATOR(&)
+LANE_OPERATOR(|)
+LANE_OPERATOR(^)
+LANE_OPERATOR(-)
+
+#undef LANE_OPERATOR
+
+static inline LaneVector operator~(const LaneVector& a) {
+    LaneVector result;
+    for (int lane = 0; lane < LaneSolver::kLaneCount; lane++) {
+        result.lanes[lane] = (uint16_t)~a.lanes[lane];
+    }
+    return result;
+}
+
+static inline LaneVector splat(const uint16_t value) {
+    LaneVector result;
+    for (int lane = 0; lane < LaneSolver::kLaneCount; lane++) {
+        result.lanes[lane] = value;
+    }
+    return result;
+}
+
+static inline LaneVector isZero(const LaneVector& vector) {
+    LaneVector result;
+    for (int lane = 0; lane < LaneSolver::kLaneCount; lane++) {
+        result.lanes[lane] = vector.lanes[lane] == 0 ? 0xffff : 0;
+    }
+    return result;
+}
+
+#endif
+
+static inline LaneVector select(const LaneVector mask, const LaneVector whenSet, const LaneVector otherwise) {
+    return (whenSet & mask) | (otherwise & ~mask);
+}
+
+static inline bool anyLaneSet(const LaneVector vector) {
+    uint16_t result = 0;
+    for (int lane = 0; lane < LaneSolver::kLaneCount; lane++) {
+        result |= vector[lane];
+    }
+    return result != 0;
+}
+
+#pragma mark - Line and subgrid intersections
+
+// a row or column segment of a subgrid, with the rest of the subgrid and the rest of the line
+struct Intersection {
+    int segment[3];
+    int subgridRest[6];
+    int lineRest[6];
+};
+
+static const std::vector<Intersection>& intersections() {
+    static std::unique_ptr<std::vector<Intersection>> result;
+    static std::once_flag flag;
+    std::call_once(flag, []() {
+        result.reset(new std::vector<Intersection>());
+        for (int subgrid = 0; subgrid < kSize; subgrid++) {
+            const int startRow = subgrid / 3 * 3;
+            const int startColumn = subgrid % 3 * 3;
+            for (int isColumn = 0; isColumn < 2; isColumn++) {
+                for (int line = 0; line < 3; line++) {
+                    Intersection intersection;
+                    int segmentCount = 0, subgridRestCount = 0, lineRestCount = 0;
+                    for (int offset = 0; offset < kSize; offset++) {
+                        const int row = startRow + offset / 3;
+                        const int column = startColumn + offset % 3;
+                        const bool onLine = isColumn ? column == startColumn + line : row == startRow + line;
+                        if (onLine) {
+                            intersection.segment[segmentCount++] = row * kSize + column;
+                        } else {
+                            intersection.subgridRest[subgridRestCount++] = row * kSize + column;
+                        }
+                    }
+                    for (int position = 0; position < kSize; position++) {
+                        const int row = isColumn ? position : startRow + line;
+                        const int column = isColumn ? startColumn + line : position;
+                        if ((isColumn ? row / 3 : column / 3) != (isColumn ? startRow / 3 : startColumn / 3)) {
+                            intersection.lineRest[lineRestCount++] = row * kSize + column;
+                        }
+                    }
+                    result->push_back(intersection);
+                }
+            }
+        }
+    });
+    return *result;
+}
+
+#pragma mark - Propagation
+
+// one round of naked singles, hidden singles and locked candidates on every lane; true when any lane changed
+static bool propagateRound(LaneVector* cells, const BitmaskTopology& topology) {
+    LaneVector changed = splat(0);
+
+    for (int cellIndex = 0; cellIndex < kCellCount; cellIndex++) {
+        const LaneVector cell = cells[cellIndex];
+        const LaneVector single = isZero(cell & (cell - splat(1))) & ~isZero(cell);
+        const LaneVector placed = cell & single;
+        if (!anyLaneSet(placed)) {
+            continue;
+        }
+        const int* peer = &topology.peers[cellIndex * topology.peerCount];
+        for (int i = 0; i < topology.peerCount; i++) {
+            const LaneVector before = cells[peer[i]];
+            cells[peer[i]] = before & ~placed;
+            changed |= before ^ cells[peer[i]];
+        }
+    }
+
+    for (int unitIndex = 0; unitIndex < 3 * kSize; unitIndex++) {
+        const int* unit = &topology.units[unitIndex * kSize];
+        LaneVector once = splat(0);
+        LaneVector twice = splat(0);
+        for (int offset = 0; offset < kSize; offset++) {
+            twice |= once & cells[unit[offset]];
+            once |= cells[unit[offset]];
+        }
+        const LaneVector unique = once & ~twice;
+        for (int offset = 0; offset < kSize; offset++) {
+            const LaneVector before = cells[unit[offset]];
+            const LaneVector hit = before & unique;
+            cells[unit[offset]] = select(~isZero(hit), hit, before);
+            changed |= before ^ cells[unit[offset]];
+        }
+    }
+
+    const std::vector<Intersection>& lineSubgridIntersections = intersections();
+    for (auto intersection = lineSubgridIntersections.begin(); intersection != lineSubgridIntersections.end(); ++intersection) {
+        const LaneVector segment = cells[intersection->segment[0]] | cells[intersection->segment[1]] | cells[intersection->segment[2]];
+        LaneVector subgridRest = splat(0);
+        LaneVector lineRest = splat(0);
+        for (int i = 0; i < 6; i++) {
+            subgridRest |= cells[intersection->subgridRest[i]];
+            lineRest |= cells[intersection->lineRest[i]];
+        }
+        // pointing: values only in the segment within the subgrid leave the rest of the line, and claiming the reverse
+        const LaneVector pointing = segment & ~subgridRest;
+        const LaneVector claiming = segment & ~lineRest;
+        for (int i = 0; i < 6; i++) {
+            const LaneVector lineBefore = cells[intersection->lineRest[i]];
+            cells[intersection->lineRest[i]] = lineBefore & ~pointing;
+            changed |= lineBefore ^ cells[intersection->lineRest[i]];
+            const LaneVector subgridBefore = cells[intersection->subgridRest[i]];
+            cells[intersection->subgridRest[i]] = subgridBefore & ~claiming;
+            changed |= subgridBefore ^ cells[intersection->subgridRest[i]];
+        }
+    }
+
+    return anyLaneSet(changed);
+}
+
+#pragma mark - Batches
+
+bool LaneSolver::supportsSize(const int size) {
+    return size == kSize;
+}
+
+void LaneSolver::solveBatch(Grid* grids, const int count, SolveStatus* statuses, LaneStatistics& statistics) {
+    solveBatch(grids, count, statuses, statistics, SolveLimits());
+}
+
+void LaneSolver::solveBatch(Grid* grids, const int count, SolveStatus* statuses, LaneStatistics& statistics, const SolveLimits& limits) {
+    if (count <= 0) {
+        return;
+    }
+    const BitmaskTopology& topology = BitmaskTopology::topologyForSize(kSize);
+
+    // unused lanes repeat the first puzzle so that every lane holds a valid grid
+    LaneVector cells[kCellCount];
+    for (int cellIndex = 0; cellIndex < kCellCount; cellIndex++) {
+        for (int lane = 0; lane < kLaneCount; lane++) {
+            const int value = grids[lane < count ? lane : 0].cellAtIndex(cellIndex).getValue();
+            cells[cellIndex][lane] = value >= 1 && value <= kSize ? (uint16_t)bitForValue(value) : kAllValues;
+        }
+    }
+
+    while (propagateRound(cells, topology)) {}
+    statistics.batchCount += 1;
+
+    for (int lane = 0; lane < count; lane++) {
+        Grid& grid = grids[lane];
+        bool solved = true;
+        bool contradiction = false;
+        for (int cellIndex = 0; cellIndex < kCellCount; cellIndex++) {
+            const uint16_t candidates = cells[cellIndex][lane];
+            contradiction = contradiction || candidates == 0;
+            solved = solved && countOfMask(candidates) == 1;
+        }
+        if (contradiction) {
+            statuses[lane] = SolveStatus::NoSolution;
+            statistics.laneContradictionCount += 1;
+            continue;
+        }
+
+        // the stalled lanes still hand over every value they placed
+        for (int cellIndex = 0; cellIndex < kCellCount; cellIndex++) {
+            const uint16_t candidates = cells[cellIndex][lane];
+            if (grid.cellAtIndex(cellIndex).getValue() == -1 && countOfMask(candidates) == 1) {
+                grid.setCellValue(cellIndex, valueForBit(candidates));
+            }
+        }
+        if (solved) {
+            statuses[lane] = grid.isValid() ? SolveStatus::Solved : SolveStatus::NoSolution;
+            statistics.laneSolvedCount += 1;
+        } else {
+            Solver solver(grid, limits);
+            solver.setVerbose(false);
+            statuses[lane] = solver.solve().status;
+            statistics.scalarCount += 1;
+        }
+    }
+}
+
+SolveStatusVector LaneSolver::solveAll(GridVector& grids, ThreadPool& pool, LaneStatistics& statistics) {
+    SolveStatusVector result(grids.size(), SolveStatus::NoSolution);
+    const int batchCount = (int)((grids.size() + kLaneCount - 1) / kLaneCount);
+    std::vector<LaneStatistics> batchStatistics(batchCount);
+    pool.parallelFor(batchCount, [&](const int, const int itemIndex) {
+        const int first = itemIndex * kLaneCount;
+        const int count = std::min(kLaneCount, (int)grids.size() - first);
+        solveBatch(&grids[first], count, &result[first], batchStatistics[itemIndex]);
+    });
+    for (auto batch = batchStatistics.begin(); batch != batchStatistics.end(); ++batch) {
+        statistics.add(*batch);
+    }
+    return result;
+}
@@ -0,0 +1,62 @@
+//
+//  LaneSolver.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef LaneSolver_hpp
+#define LaneSolver_hpp
+
+#include <cstdint>
+#include <vector>
+
+#include "Grid.hpp"
+#include "SolveMonitor.hpp"
+#include "ThreadPool.hpp"
+
+typedef std::vector<Grid> GridVector;
+typedef std::vector<SolveStatus> SolveStatusVector;
+
+struct LaneStatistics {
+    long batchCount = 0;
+    long laneSolvedCount = 0;       // finished by the lanes alone
+    long laneContradictionCount = 0;
+    long scalarCount = 0;           // handed to Solver once the lanes stalled
+
+    void add(const LaneStatistics& other) {
+        batchCount += other.batchCount;
+        laneSolvedCount += other.laneSolvedCount;
+        laneContradictionCount += other.laneContradictionCount;
+        scalarCount += other.scalarCount;
+    }
+};
+
+/**
+ Batch engine for 9x9 puzzles that propagates kLaneCount puzzles at once, one per 16-bit lane of a vector
+ register: every cell is a vector of candidate masks, one per puzzle.
+
+ Naked singles, hidden singles and locked candidates (pointing and claiming) run in lock step on all lanes with
+ nothing but AND/OR/compare, so there is no branch per puzzle. Rounds repeat until no lane changes. Lanes that end
+ up solved are checked and written back; lanes that stall are finished by Solver (propagation and DFS) one puzzle
+ at a time, starting from the values the lanes placed.
+
+ The vectors use the compiler's vector extensions, which become AVX2 or SSE instructions depending on the target;
+ other compilers get a plain array with the same operators.
+ */
+class LaneSolver {
+public:
+    static const int kLaneCount = 16;
+
+    static bool supportsSize(const int size);
+
+    // solves every grid in place; batches of kLaneCount are spread over the pool
+    static SolveStatusVector solveAll(GridVector& grids, ThreadPool& pool, LaneStatistics& statistics);
+
+    // solves up to kLaneCount grids in place
+    static void solveBatch(Grid* grids, const int count, SolveStatus* statuses, LaneStatistics& statistics);
+    // the same, with the limits applied to each stalled puzzle that Solver finishes
+    static void solveBatch(Grid* grids, const int count, SolveStatus* statuses, LaneStatistics& statistics, const SolveLimits& limits);
+};
+
+#endif /* LaneSolver_hpp */
@@ -0,0 +1,446 @@
+//
+//  LookaheadProber.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "LookaheadProber.hpp"
+
+#include "GridEditor.hpp"
+
+#include <algorithm>
+
+LookaheadProber::LookaheadProber(const int size, ThreadPool* pool) : _topology(BitmaskTopology::topologyForSize(supportsSize(size) ? size : 1)) {
+    _size = size;
+    _cellCount = size * size;
+    _allValuesMask = size == 64 ? ~(CandidateMask)0 : (((CandidateMask)1) << size) - 1;
+    _pool = pool;
+    _round = 0;
+    _scratchStates.resize(pool != nullptr ? pool->getThreadCount() : 1);
+}
+
+bool LookaheadProber::supportsSize(const int size) {
+    return BitmaskSolver::supportsSize(size);
+}
+
+const ProbeStatistics& LookaheadProber::getStatistics() const {
+    return _statistics;
+}
+
+#pragma mark - Propagation
+
+void LookaheadProber::_saveCell(ProbeState& state, const int cellIndex) const {
+    TrailEntry entry;
+    entry.cellIndex = cellIndex;
+    entry.value = state.values[cellIndex];
+    entry.candidates = state.candidates[cellIndex];
+    state.trail.push_back(entry);
+}
+
+void LookaheadProber::_undoTrail(ProbeState& state, const size_t trailSize) const {
+    while (state.trail.size() > trailSize) {
+        const TrailEntry& entry = state.trail.back();
+        state.values[entry.cellIndex] = entry.value;
+        state.candidates[entry.cellIndex] = entry.candidates;
+        state.trail.pop_back();
+    }
+    state.queue.clear();
+}
+
+bool LookaheadProber::_assign(ProbeState& state, const int cellIndex, const int value) const {
+    const CandidateMask bit = bitForValue(value);
+    if ((state.candidates[cellIndex] & bit) == 0) {
+        return false;
+    }
+    _saveCell(state, cellIndex);
+    state.values[cellIndex] = value;
+    state.candidates[cellIndex] = 0;
+
+    const int* peer = &_topology.peers[cellIndex * _topology.peerCount];
+    const int* peerEnd = peer + _topology.peerCount;
+    for (; peer != peerEnd; ++peer) {
+        if ((state.candidates[*peer] & bit) && !_eliminate(state, *peer, bit)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LookaheadProber::_eliminate(ProbeState& state, const int cellIndex, const CandidateMask mask) const {
+    const CandidateMask candidates = state.candidates[cellIndex];
+    if (state.values[cellIndex] != -1 || (candidates & mask) == 0) {
+        return true;
+    }
+    _saveCell(state, cellIndex);
+    const CandidateMask remaining = candidates & ~mask;
+    state.candidates[cellIndex] = remaining;
+    if (remaining == 0) {
+        return false;
+    }
+    if ((remaining & (remaining - 1)) == 0) {
+        state.queue.push_back(cellIndex);
+    }
+    return true;
+}
+
+bool LookaheadProber::_propagateHiddenSingles(ProbeState& state, bool& anyChange) const {
+    const int unitCount = 3 * _size;
+    for (int unitIndex = 0; unitIndex < unitCount; unitIndex++) {
+        const int* unit = &_topology.units[unitIndex * _size];
+        CandidateMask seenOnce = 0;
+        CandidateMask seenTwice = 0;
+        CandidateMask placed = 0;
+        for (int offset = 0; offset < _size; offset++) {
+            const int cellIndex = unit[offset];
+            if (state.values[cellIndex] != -1) {
+                placed |= bitForValue(state.values[cellIndex]);
+            } else {
+                const CandidateMask candidates = state.candidates[cellIndex];
+                seenTwice |= seenOnce & candidates;
+                seenOnce |= candidates;
+            }
+        }
+        if ((seenOnce | placed) != _allValuesMask) {
+            return false;
+        }
+        CandidateMask hidden = seenOnce & ~seenTwice & ~placed;
+        while (hidden) {
+            const CandidateMask bit = hidden & (~hidden + 1);
+            hidden &= hidden - 1;
+            int target = -1;
+            for (int offset = 0; offset < _size; offset++) {
+                if (state.candidates[unit[offset]] & bit) {
+                    target = unit[offset];
+                    break;
+                }
+            }
+            // the only cell left for this value took another hidden single of the unit
+            if (target == -1 || !_assign(state, target, valueForBit(bit))) {
+                return false;
+            }
+            anyChange = true;
+        }
+    }
+    return true;
+}
+
+/**
+ For every row or column segment of a subgrid: a value of the segment that appears nowhere else in the subgrid is
+ removed from the rest of the line (pointing), and one that appears nowhere else in the line is removed from the
+ rest of the subgrid (claiming).
+ */
+bool LookaheadProber::_propagateSubgroupExclusion(ProbeState& state, bool& anyChange) const {
+    const int subSize = _topology.subSize;
+    for (int subgrid = 0; subgrid < _size; subgrid++) {
+        const int* box = &_topology.units[(2 * _size + subgrid) * _size];
+        for (int isColumn = 0; isColumn < 2; isColumn++) {
+            for (int segment = 0; segment < subSize; segment++) {
+                // offsets of the segment within the subgrid
+                CandidateMask segmentMask = 0;
+                CandidateMask boxRestMask = 0;
+                for (int offset = 0; offset < _size; offset++) {
+                    const int lineOfOffset = isColumn ? offset % subSize : offset / subSize;
+                    if (lineOfOffset == segment) {
+                        segmentMask |= state.candidates[box[offset]];
+                    } else {
+                        boxRestMask |= state.candidates[box[offset]];
+                    }
+                }
+                if (segmentMask == 0) {
+                    continue;
+                }
+                const int firstCell = box[isColumn ? segment : segment * subSize];
+                const int lineIndex = isColumn ? _size + _topology.columnOfCell[firstCell] : _topology.rowOfCell[firstCell];
+                const int* line = &_topology.units[lineIndex * _size];
+                CandidateMask lineRestMask = 0;
+                for (int offset = 0; offset < _size; offset++) {
+                    if (_topology.subgridOfCell[line[offset]] != subgrid) {
+                        lineRestMask |= state.candidates[line[offset]];
+                    }
+                }
+
+                const CandidateMask pointing = segmentMask & ~boxRestMask & lineRestMask;
+                if (pointing) {
+                    for (int offset = 0; offset < _size; offset++) {
+                        if (_topology.subgridOfCell[line[offset]] != subgrid && !_eliminate(state, line[offset], pointing)) {
+                            return false;
+                        }
+                    }
+                    anyChange = true;
+                }
+                const CandidateMask claiming = segmentMask & ~lineRestMask & boxRestMask;
+                if (claiming) {
+                    for (int offset = 0; offset < _size; offset++) {
+                        const int lineOfOffset = isColumn ? offset % subSize : offset / subSize;
+                        if (lineOfOffset != segment && !_eliminate(state, box[offset], claiming)) {
+                            return false;
+                        }
+                    }
+                    anyChange = true;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// naked singles, hidden singles and subgroup exclusion until none of them changes anything
+bool LookaheadProber::_propagate(ProbeState& state) const {
+    while (true) {
+        while (!state.queue.empty()) {
+            const int cellIndex = state.queue.back();
+            state.queue.pop_back();
+            if (state.values[cellIndex] != -1) {
+                continue;
+            }
+            const CandidateMask candidates = state.candidates[cellIndex];
+            if (candidates == 0 || !_assign(state, cellIndex, valueForBit(candidates))) {
+                return false;
+            }
+        }
+        bool anyChange = false;
+        if (!_propagateHiddenSingles(state, anyChange)) {
+            return false;
+        }
+        if (anyChange || !state.queue.empty()) {
+            continue;
+        }
+        if (!_propagateSubgroupExclusion(state, anyChange)) {
+            return false;
+        }
+        if (!anyChange && state.queue.empty()) {
+            return true;
+        }
+    }
+}
+
+#pragma mark - Probing
+
+// the grid's own candidates, narrowed by the values already placed in each unit
+bool LookaheadProber::_loadBase(const Grid& grid) {
+    _base.values.assign(_cellCount, -1);
+    _base.candidates.assign(_cellCount, 0);
+    _base.trail.clear();
+    _base.queue.clear();
+    CandidateMaskVector used(3 * _size, 0);
+    for (int cellIndex = 0; cellIndex < _cellCount; cellIndex++) {
+        const int value = grid.cellAtIndex(cellIndex).getValue();
+        if (value == -1) {
+            continue;
+        }
+        const CandidateMask bit = bitForValue(value);
+        CandidateMask& rowUsed = used[_topology.rowOfCell[cellIndex]];
+        CandidateMask& columnUsed = used[_size + _topology.columnOfCell[cellIndex]];
+        CandidateMask& subgridUsed = used[2 * _size + _topology.subgridOfCell[cellIndex]];
+        if ((rowUsed | columnUsed | subgridUsed) & bit) {
+            return false;
+        }
+        rowUsed |= bit;
+        columnUsed |= bit;
+        subgridUsed |= bit;
+        _base.values[cellIndex] = value;
+    }
+    for (int cellIndex = 0; cellIndex < _cellCount; cellIndex++) {
+        if (_base.values[cellIndex] != -1) {
+            continue;
+        }
+        CandidateMask candidates = 0;
+        const IntSet& cellCandidates = grid.cellAtIndex(cellIndex).getCandidates();
+        for (auto candidate = cellCandidates.begin(); candidate != cellCandidates.end(); ++candidate) {
+            if (*candidate >= 1 && *candidate <= _size) {
+                candidates |= bitForValue(*candidate);
+            }
+        }
+        candidates &= ~(used[_topology.rowOfCell[cellIndex]] | used[_size + _topology.columnOfCell[cellIndex]] | used[2 * _size + _topology.subgridOfCell[cellIndex]]);
+        _base.candidates[cellIndex] = candidates;
+        if (candidates == 0) {
+            return false;
+        }
+        if (countOfMask(candidates) == 1) {
+            _base.queue.push_back(cellIndex);
+        }
+    }
+    return _propagate(_base);
+}
+
+int LookaheadProber::_literalIndex(std::vector<int>& literalIndexOfCandidate, const int cellIndex, const int value) {
+    int& index = literalIndexOfCandidate[cellIndex * _size + value - 1];
+    if (index == -1) {
+        index = (int)_literals.size();
+        _literals.push_back(Literal{cellIndex, value});
+    }
+    return index;
+}
+
+// bivalue cells and values with two places left in a unit; a literal shared by several pairs is probed once
+void LookaheadProber::_collectPairs() {
+    _literals.clear();
+    _pairs.clear();
+    std::vector<int> literalIndexOfCandidate(_cellCount * _size, -1);
+
+    for (int cellIndex = 0; cellIndex < _cellCount; cellIndex++) {
+        const CandidateMask candidates = _base.candidates[cellIndex];
+        if (_base.values[cellIndex] == -1 && countOfMask(candidates) == 2) {
+            const int first = valueForBit(candidates & (~candidates + 1));
+            const int second = valueForBit(candidates & (candidates - 1));
+            _pairs.push_back(IntVector({_literalIndex(literalIndexOfCandidate, cellIndex, first), _literalIndex(literalIndexOfCandidate, cellIndex, second)}));
+        }
+    }
+
+    const int unitCount = 3 * _size;
+    for (int unitIndex = 0; unitIndex < unitCount; unitIndex++) {
+        const int* unit = &_topology.units[unitIndex * _size];
+        for (int value = 1; value <= _size; value++) {
+            const CandidateMask bit = bitForValue(value);
+            int positions[2];
+            int positionCount = 0;
+            for (int offset = 0; offset < _size && positionCount <= 2; offset++) {
+                if (_base.candidates[unit[offset]] & bit) {
+                    if (positionCount < 2) {
+                        positions[positionCount] = unit[offset];
+                    }
+                    positionCount += 1;
+                }
+            }
+            if (positionCount == 2) {
+                _pairs.push_back(IntVector({_literalIndex(literalIndexOfCandidate, positions[0], value), _literalIndex(literalIndexOfCandidate, positions[1], value)}));
+            }
+        }
+    }
+}
+
+void LookaheadProber::_probeLiteral(const int workerIndex, const int literalIndex) {
+    ProbeState& state = _scratchStates[workerIndex];
+    if (state.round != _round) {
+        state.values = _base.values;
+        state.candidates = _base.candidates;
+        state.trail.clear();
+        state.queue.clear();
+        state.round = _round;
+    }
+
+    const Literal& literal = _literals[literalIndex];
+    const bool consistent = _assign(state, literal.cellIndex, literal.value) && _propagate(state);
+    _failed[literalIndex] = !consistent;
+    if (consistent) {
+        CandidateMaskVector& outcome = _outcomes[literalIndex];
+        outcome.resize(_cellCount);
+        for (int cellIndex = 0; cellIndex < _cellCount; cellIndex++) {
+            const int value = state.values[cellIndex];
+            outcome[cellIndex] = value != -1 ? bitForValue(value) : state.candidates[cellIndex];
+        }
+    }
+    _undoTrail(state, 0);
+}
+
+/**
+ Probes every literal of the base state, then removes failed literals and whatever every consistent alternative of
+ a pair rules out, and propagates the result. Returns false when the base state has no solution.
+ */
+bool LookaheadProber::_runRound(bool& anyChange) {
+    anyChange = false;
+    _collectPairs();
+    if (_pairs.empty()) {
+        return true;
+    }
+
+    _round += 1;
+    _statistics.roundCount += 1;
+    _statistics.probeCount += (long)_literals.size();
+    _failed.assign(_literals.size(), 0);
+    _outcomes.resize(_literals.size());
+    if (_pool != nullptr && _pool->getThreadCount() > 1) {
+        _pool->parallelFor((int)_literals.size(), [&](const int workerIndex, const int literalIndex) {
+            _probeLiteral(workerIndex, literalIndex);
+        });
+    } else {
+        for (int literalIndex = 0; literalIndex < (int)_literals.size(); literalIndex++) {
+            _probeLiteral(0, literalIndex);
+        }
+    }
+
+    CandidateMaskVector failedMasks(_cellCount, 0);
+    for (size_t literalIndex = 0; literalIndex < _literals.size(); literalIndex++) {
+        if (_failed[literalIndex]) {
+            const Literal& literal = _literals[literalIndex];
+            failedMasks[literal.cellIndex] |= bitForValue(literal.value);
+        }
+    }
+    CandidateMaskVector allowed = _base.candidates;
+    CandidateMaskVector reachable(_cellCount);
+    for (auto pair = _pairs.begin(); pair != _pairs.end(); ++pair) {
+        std::fill(reachable.begin(), reachable.end(), 0);
+        bool anyConsistent = false;
+        for (auto literalIndex = pair->begin(); literalIndex != pair->end(); ++literalIndex) {
+            if (_failed[*literalIndex]) {
+                continue;
+            }
+            anyConsistent = true;
+            const CandidateMaskVector& outcome = _outcomes[*literalIndex];
+            for (int cellIndex = 0; cellIndex < _cellCount; cellIndex++) {
+                reachable[cellIndex] |= outcome[cellIndex];
+            }
+        }
+        if (!anyConsistent) {
+            return false;
+        }
+        for (int cellIndex = 0; cellIndex < _cellCount; cellIndex++) {
+            allowed[cellIndex] &= reachable[cellIndex];
+        }
+    }
+
+    for (int cellIndex = 0; cellIndex < _cellCount; cellIndex++) {
+        const CandidateMask removed = _base.candidates[cellIndex] & ~(allowed[cellIndex] & ~failedMasks[cellIndex]);
+        if (_base.values[cellIndex] != -1 || removed == 0) {
+            continue;
+        }
+        _statistics.failedLiteralCount += countOfMask(removed & failedMasks[cellIndex]);
+        _statistics.forcedCount += countOfMask(removed & ~failedMasks[cellIndex]);
+        anyChange = true;
+        if (!_eliminate(_base, cellIndex, removed)) {
+            return false;
+        }
+    }
+    return !anyChange || _propagate(_base);
+}
+
+// values first (each one clears its peers' candidates), then the candidates of the cells still open
+void LookaheadProber::_storeBase(Grid& grid) const {
+    GridEditor editor(grid);
+    for (int cellIndex = 0; cellIndex < _cellCount; cellIndex++) {
+        const int value = _base.values[cellIndex];
+        if (value != -1 && grid.cellAtIndex(cellIndex).getValue() == -1) {
+            editor.setCellValueAndUpdateCandidates(value, cellIndex);
+        }
+    }
+    for (int cellIndex = 0; cellIndex < _cellCount; cellIndex++) {
+        if (_base.values[cellIndex] != -1) {
+            continue;
+        }
+        const CandidateMask candidates = _base.candidates[cellIndex];
+        const IntSet cellCandidates = grid.cellAtIndex(cellIndex).getCandidates();
+        for (auto candidate = cellCandidates.begin(); candidate != cellCandidates.end(); ++candidate) {
+            if (*candidate < 1 || *candidate > _size || (candidates & bitForValue(*candidate)) == 0) {
+                grid.eraseCellCandidate(cellIndex, *candidate);
+            }
+        }
+    }
+}
+
+bool LookaheadProber::probe(Grid& grid) {
+    if (!supportsSize(_size) || grid.getSize() != _size) {
+        return true;
+    }
+    if (!_loadBase(grid)) {
+        return false;
+    }
+    bool anyChange = true;
+    while (anyChange) {
+        if (!_runRound(anyChange)) {
+            return false;
+        }
+    }
+    _storeBase(grid);
+    return true;
+}
@@ -0,0 +1,98 @@
+//
+//  LookaheadProber.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef LookaheadProber_hpp
+#define LookaheadProber_hpp
+
+#include <vector>
+
+#include "BitmaskSolver.hpp"
+#include "Grid.hpp"
+#include "ThreadPool.hpp"
+
+struct ProbeStatistics {
+    long roundCount = 0;
+    long probeCount = 0;            // tentative assignments propagated
+    long failedLiteralCount = 0;    // candidates removed because assigning them led to a contradiction
+    long forcedCount = 0;           // candidates removed because every alternative of a pair rules them out
+};
+
+/**
+ Look-ahead stage run before branching. Every bivalue cell (one of two values) and every bi-location value (one of
+ two cells in a unit) gives a pair of alternatives, exactly one of which holds. Each alternative is tried on a copy
+ of the grid's state and propagated with singles and subgroup exclusion:
+
+ - an alternative that leads to a contradiction is a failed literal, so that candidate is removed;
+ - a candidate that is gone after every alternative of a pair is removed, and a value placed by every alternative
+   is placed (forcing chains).
+
+ Rounds repeat on the reduced state until a round finds nothing new. All probes of a round share one read-only base
+ state; with a pool, they are spread over its workers, each with its own scratch state and undo trail.
+ */
+class LookaheadProber {
+    struct TrailEntry {
+        int cellIndex;
+        int value;
+        CandidateMask candidates;
+    };
+    struct ProbeState {
+        IntVector values;
+        CandidateMaskVector candidates;
+        std::vector<TrailEntry> trail;
+        IntVector queue;
+        long round = -1;            // the base round this scratch state was copied from
+    };
+    struct Literal {
+        int cellIndex;
+        int value;
+    };
+
+    const BitmaskTopology& _topology;
+    int _size;
+    int _cellCount;
+    CandidateMask _allValuesMask;
+    ThreadPool* _pool;
+
+    ProbeState _base;
+    std::vector<ProbeState> _scratchStates;    // one per worker
+    long _round;
+
+    std::vector<Literal> _literals;
+    std::vector<IntVector> _pairs;              // two literal indices each
+    std::vector<char> _failed;                  // by literal
+    std::vector<CandidateMaskVector> _outcomes; // by literal: the candidates left after propagating it
+
+    ProbeStatistics _statistics;
+
+    void _saveCell(ProbeState& state, const int cellIndex) const;
+    void _undoTrail(ProbeState& state, const size_t trailSize) const;
+    bool _assign(ProbeState& state, const int cellIndex, const int value) const;
+    bool _eliminate(ProbeState& state, const int cellIndex, const CandidateMask mask) const;
+    bool _propagate(ProbeState& state) const;
+    bool _propagateHiddenSingles(ProbeState& state, bool& anyChange) const;
+    bool _propagateSubgroupExclusion(ProbeState& state, bool& anyChange) const;
+
+    bool _loadBase(const Grid& grid);
+    int _literalIndex(std::vector<int>& literalIndexOfCandidate, const int cellIndex, const int value);
+    void _collectPairs();
+    void _probeLiteral(const int workerIndex, const int literalIndex);
+    bool _runRound(bool& anyChange);
+    void _storeBase(Grid& grid) const;
+
+public:
+    // pool may be null (probes run on the calling thread); it must not be the pool running the caller
+    LookaheadProber(const int size, ThreadPool* pool);
+
+    static bool supportsSize(const int size);
+
+    // applies every deduction to the grid; false when the grid turns out to have no solution
+    bool probe(Grid& grid);
+
+    const ProbeStatistics& getStatistics() const;
+};
+
+#endif /* LookaheadProber_hpp */
@@ -0,0 +1,102 @@
+//
+//  PuzzleFeatures.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "PuzzleFeatures.hpp"
+
+#include <cmath>
+#include <cstdint>
+
+#include "ScratchArena.hpp"
+
+typedef uint64_t ValueMask;
+
+PuzzleFeatures PuzzleFeatures::extract(const Grid& grid) {
+    PuzzleFeatures features;
+    const int size = grid.getSize();
+    const int subSize = grid.getSubSize();
+    if (size < 1 || size > kMaxGridSize) {
+        return features;
+    }
+    const int cellCount = size * size;
+    const ValueMask allValues = size == 64 ? ~(ValueMask)0 : (((ValueMask)1) << size) - 1;
+
+    ValueMask rowUsed[kMaxGridSize] = {};
+    ValueMask columnUsed[kMaxGridSize] = {};
+    ValueMask subgridUsed[kMaxGridSize] = {};
+    for (int cellIndex = 0; cellIndex < cellCount; cellIndex++) {
+        const int value = grid.cellAtIndex(cellIndex).getValue();
+        if (value == -1) {
+            continue;
+        }
+        if (value < 1 || value > size) {
+            return PuzzleFeatures();
+        }
+        const ValueMask bit = ((ValueMask)1) << (value - 1);
+        const int row = grid.rowOfCellIndex(cellIndex);
+        const int column = grid.columnOfCellIndex(cellIndex);
+        const int subgrid = grid.subgridIndexAtRowAndColumn(row, column);
+        if ((rowUsed[row] | columnUsed[column] | subgridUsed[subgrid]) & bit) {
+            features.contradiction = true;
+        }
+        rowUsed[row] |= bit;
+        columnUsed[column] |= bit;
+        subgridUsed[subgrid] |= bit;
+        features.clueCount += 1;
+    }
+
+    features.size = size;
+    features.emptyCount = cellCount - features.clueCount;
+    ScratchScope scope;
+    std::vector<ValueMask, ArenaAllocator<ValueMask>> candidates(cellCount, 0);
+    long candidateTotal = 0;
+    for (int cellIndex = 0; cellIndex < cellCount; cellIndex++) {
+        if (grid.cellAtIndex(cellIndex).getValue() != -1) {
+            continue;
+        }
+        const int row = grid.rowOfCellIndex(cellIndex);
+        const int column = grid.columnOfCellIndex(cellIndex);
+        candidates[cellIndex] = allValues & ~(rowUsed[row] | columnUsed[column] | subgridUsed[grid.subgridIndexAtRowAndColumn(row, column)]);
+        const int count = __builtin_popcountll(candidates[cellIndex]);
+        features.candidateHistogram[count] += 1;
+        candidateTotal += count;
+    }
+    features.bivalueCount = features.candidateHistogram[2];
+    features.nakedSingleCount = features.candidateHistogram[1];
+    features.contradiction |= features.candidateHistogram[0] > 0;
+    features.meanCandidates = features.emptyCount == 0 ? 0 : (double)candidateTotal / features.emptyCount;
+
+    // a value seen exactly once among a unit's candidates has one place left (values already placed aren't candidates)
+    const auto countHiddenSingles = [&](const int firstCell, const int rowStep, const int columnStep, const int width) {
+        ValueMask seenOnce = 0;
+        ValueMask seenTwice = 0;
+        for (int i = 0; i < size; i++) {
+            const ValueMask mask = candidates[firstCell + (i / width) * rowStep + (i % width) * columnStep];
+            seenTwice |= seenOnce & mask;
+            seenOnce |= mask;
+        }
+        features.hiddenSingleCount += __builtin_popcountll(seenOnce & ~seenTwice);
+    };
+    for (int unit = 0; unit < size; unit++) {
+        countHiddenSingles(unit * size, 0, 1, size);
+        countHiddenSingles(unit, 0, size, size);
+        countHiddenSingles((unit / subSize) * subSize * size + (unit % subSize) * subSize, size, 1, subSize);
+    }
+    return features;
+}
+
+PuzzleFeatures::ModelInputs PuzzleFeatures::modelInputs() const {
+    const int cellCount = size * size;
+    const double empty = std::max(1, emptyCount);
+    ModelInputs inputs;
+    inputs[0] = 1;
+    inputs[1] = std::log((double)std::max(1, cellCount));
+    inputs[2] = cellCount == 0 ? 0 : (double)emptyCount / cellCount;
+    inputs[3] = size == 0 ? 0 : meanCandidates / size;
+    inputs[4] = bivalueCount / empty;
+    inputs[5] = (nakedSingleCount + hiddenSingleCount) / empty;
+    return inputs;
+}
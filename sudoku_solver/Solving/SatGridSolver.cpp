@@ -0,0 +1,169 @@
+//
+//  SatGridSolver.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "SatGridSolver.hpp"
+
+// what a thread keeps from one grid to the next
+struct SatGridWorkspace {
+    SatSolver solver;
+    // indexed by cellIndex * size + value - 1, -1 when the pair is ruled out
+    std::vector<int> variableOfCandidate;
+    // values used by each row, column and subgrid
+    std::vector<bool> rowUsed;
+    std::vector<bool> columnUsed;
+    std::vector<bool> subgridUsed;
+    LiteralVector literals;
+    LiteralVector pair;
+    IntVector rowCells;
+    IntVector columnCells;
+    IntVector subgridCells;
+};
+
+static SatGridWorkspace& workspaceForCurrentThread() {
+    static thread_local SatGridWorkspace workspace;
+    return workspace;
+}
+
+SatGridSolver::SatGridSolver(Grid& g, SolveMonitor* monitor) : _grid(g), _monitor(monitor) {}
+
+static void addAtMostOne(SatGridWorkspace& workspace, const LiteralVector& literals) {
+    workspace.pair.resize(2);
+    for (size_t i = 0; i < literals.size(); i++) {
+        for (size_t j = i + 1; j < literals.size(); j++) {
+            workspace.pair[0] = literals[i] ^ 1;
+            workspace.pair[1] = literals[j] ^ 1;
+            workspace.solver.addClause(workspace.pair);
+        }
+    }
+}
+
+// exactly one of each value the unit is missing; returns false if one of them has nowhere to go
+bool SatGridSolver::_addUnitClauses(SatGridWorkspace& workspace, const IntVector& cellIndices) {
+    const int size = _grid.getSize();
+    LiteralVector& positions = workspace.literals;
+    for (int value = 1; value <= size; value++) {
+        positions.clear();
+        bool placed = false;
+        for (auto cellIndex = cellIndices.begin(); cellIndex != cellIndices.end(); ++cellIndex) {
+            if (_grid.cellAtIndex(*cellIndex).getValue() == value) {
+                placed = true;
+                break;
+            }
+            const int variable = workspace.variableOfCandidate[*cellIndex * size + value - 1];
+            if (variable >= 0) {
+                positions.push_back(positiveLiteral(variable));
+            }
+        }
+        if (placed) {
+            continue;
+        }
+        if (!workspace.solver.addClause(positions)) {
+            return false;
+        }
+        addAtMostOne(workspace, positions);
+    }
+    return true;
+}
+
+bool SatGridSolver::_encode(SatGridWorkspace& workspace) {
+    const int size = _grid.getSize();
+    const int subSize = _grid.getSubSize();
+    const int cellCount = size * size;
+    SatSolver& solver = workspace.solver;
+
+    std::vector<bool>& rowUsed = workspace.rowUsed;
+    std::vector<bool>& columnUsed = workspace.columnUsed;
+    std::vector<bool>& subgridUsed = workspace.subgridUsed;
+    rowUsed.assign(size * (size + 1), false);
+    columnUsed.assign(size * (size + 1), false);
+    subgridUsed.assign(size * (size + 1), false);
+    for (int cellIndex = 0; cellIndex < cellCount; cellIndex++) {
+        const int value = _grid.cellAtIndex(cellIndex).getValue();
+        if (value != -1) {
+            const int row = _grid.rowOfCellIndex(cellIndex);
+            const int column = _grid.columnOfCellIndex(cellIndex);
+            rowUsed[row * (size + 1) + value] = true;
+            columnUsed[column * (size + 1) + value] = true;
+            subgridUsed[_grid.subgridIndexAtRowAndColumn(row, column) * (size + 1) + value] = true;
+        }
+    }
+
+    std::vector<int>& variableOfCandidate = workspace.variableOfCandidate;
+    variableOfCandidate.assign(cellCount * size, -1);
+    LiteralVector& values = workspace.literals;
+    for (int cellIndex = 0; cellIndex < cellCount; cellIndex++) {
+        if (_grid.cellAtIndex(cellIndex).getValue() != -1) {
+            continue;
+        }
+        const int row = _grid.rowOfCellIndex(cellIndex);
+        const int column = _grid.columnOfCellIndex(cellIndex);
+        const int subgrid = _grid.subgridIndexAtRowAndColumn(row, column);
+        values.clear();
+        for (int value = 1; value <= size; value++) {
+            if (!rowUsed[row * (size + 1) + value] && !columnUsed[column * (size + 1) + value] && !subgridUsed[subgrid * (size + 1) + value]) {
+                const int variable = solver.addVariable();
+                variableOfCandidate[cellIndex * size + value - 1] = variable;
+                values.push_back(positiveLiteral(variable));
+            }
+        }
+        if (!solver.addClause(values)) {
+            return false;
+        }
+        addAtMostOne(workspace, values);
+    }
+
+    IntVector& rowCells = workspace.rowCells;
+    IntVector& columnCells = workspace.columnCells;
+    IntVector& subgridCells = workspace.subgridCells;
+    for (int unit = 0; unit < size; unit++) {
+        rowCells.clear();
+        columnCells.clear();
+        subgridCells.clear();
+        const int startRow = (unit / subSize) * subSize;
+        const int startColumn = (unit % subSize) * subSize;
+        for (int i = 0; i < size; i++) {
+            rowCells.push_back(_grid.indexAtRowAndColumn(unit, i));
+            columnCells.push_back(_grid.indexAtRowAndColumn(i, unit));
+            subgridCells.push_back(_grid.indexAtRowAndColumn(startRow + i / subSize, startColumn + i % subSize));
+        }
+        if (!_addUnitClauses(workspace, rowCells) || !_addUnitClauses(workspace, columnCells) || !_addUnitClauses(workspace, subgridCells)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+SatResult SatGridSolver::solve() {
+    if (!_grid.isValid()) {
+        return SatResult::Unsatisfiable;
+    }
+
+    SatGridWorkspace& workspace = workspaceForCurrentThread();
+    SatSolver& solver = workspace.solver;
+    solver.reset();
+    SatResult result = _encode(workspace) ? solver.solve(_monitor) : SatResult::Unsatisfiable;
+    _statistics = solver.getStatistics();
+    if (result != SatResult::Satisfiable) {
+        return result;
+    }
+
+    const int size = _grid.getSize();
+    for (int cellIndex = 0; cellIndex < size * size; cellIndex++) {
+        for (int value = 1; value <= size; value++) {
+            const int variable = workspace.variableOfCandidate[cellIndex * size + value - 1];
+            if (variable >= 0 && solver.valueOfVariable(variable)) {
+                _grid.setCellValue(cellIndex, value);
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+const SatStatistics& SatGridSolver::getStatistics() const {
+    return _statistics;
+}
@@ -0,0 +1,47 @@
+//
+//  SatGridSolver.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef SatGridSolver_hpp
+#define SatGridSolver_hpp
+
+#include <vector>
+
+#include "Grid.hpp"
+#include "SatSolver.hpp"
+#include "SolveMonitor.hpp"
+
+struct SatGridWorkspace;
+
+/**
+ Solves a grid by handing it to SatSolver. There is one variable per (cell, value) pair that the givens still
+ allow, so given cells and values already placed in a peer never reach the solver.
+
+ The minimal encoding is "every cell has a value" plus "no value twice in a unit". The redundant "at most one value
+ per cell" and "every value somewhere in each unit" clauses are added too, since they let unit propagation find
+ naked and hidden singles directly.
+
+ The SatSolver and the encoder's buffers belong to the calling thread and are reset for every grid rather than
+ rebuilt, so solving puzzle after puzzle stops allocating once the largest formula has been seen.
+ */
+class SatGridSolver {
+    Grid& _grid;
+    SolveMonitor* _monitor;
+    SatStatistics _statistics;
+
+    bool _encode(SatGridWorkspace& workspace);
+    bool _addUnitClauses(SatGridWorkspace& workspace, const IntVector& cellIndices);
+
+public:
+    // monitor may be null
+    SatGridSolver(Grid&, SolveMonitor* monitor);
+
+    // fills in the grid when it returns Satisfiable and leaves it untouched otherwise
+    SatResult solve();
+    const SatStatistics& getStatistics() const;
+};
+
+#endif /* SatGridSolver_hpp */
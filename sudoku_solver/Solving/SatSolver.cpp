@@ -0,0 +1,614 @@
+//
+//  SatSolver.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "SatSolver.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+static const double kVariableDecay = 0.95;
+static const double kClauseDecay = 0.999;
+static const double kActivityLimit = 1e100;
+static const long kRestartBaseConflicts = 100;
+static const long kMinimumMaxLearnedClauses = 2000;
+
+// element x (from 0) of the Luby sequence 1, 1, 2, 1, 1, 2, 4, ... scaled as y^k
+static double lubySequence(const double y, int x) {
+    int size = 1;
+    int sequence = 0;
+    while (size < x + 1) {
+        sequence += 1;
+        size = 2 * size + 1;
+    }
+    while (size - 1 != x) {
+        size = (size - 1) >> 1;
+        sequence -= 1;
+        x = x % size;
+    }
+    return pow(y, sequence);
+}
+
+SatSolver::SatSolver() {
+    reset();
+}
+
+void SatSolver::reset() {
+    _clauses.clear();
+    _literals.clear();
+    // the lists stay allocated for the variables of the next formula (see addVariable)
+    for (auto watchers = _watches.begin(); watchers != _watches.end(); ++watchers) {
+        watchers->clear();
+    }
+    for (auto implied = _binaryImplications.begin(); implied != _binaryImplications.end(); ++implied) {
+        implied->clear();
+    }
+    _inconsistent = false;
+
+    _assignment.clear();
+    _level.clear();
+    _reasonClause.clear();
+    _reasonLiteral.clear();
+    _savedPhase.clear();
+    _activity.clear();
+    _seen.clear();
+
+    _trail.clear();
+    _trailLimits.clear();
+    _propagationHead = 0;
+    _conflict.clear();
+
+    _heap.clear();
+    _heapPosition.clear();
+
+    _variableIncrement = 1;
+    _clauseIncrement = 1;
+    _maxLearnedClauses = kMinimumMaxLearnedClauses;
+    _liveLearnedClauses = 0;
+    _statistics = SatStatistics();
+}
+
+#pragma mark - Building the formula
+
+int SatSolver::addVariable() {
+    const int variable = (int)_assignment.size();
+    _assignment.push_back(-1);
+    _level.push_back(0);
+    _reasonClause.push_back(-1);
+    _reasonLiteral.push_back(-1);
+    // try the positive phase first: for grids that means placing a value, which propagates much further
+    _savedPhase.push_back(true);
+    _activity.push_back(0);
+    _seen.push_back(false);
+    _heapPosition.push_back(-1);
+    if ((int)_watches.size() < 2 * (variable + 1)) {
+        _watches.resize(2 * (variable + 1));
+        _binaryImplications.resize(2 * (variable + 1));
+    }
+    _heapInsert(variable);
+    _statistics.variableCount += 1;
+    return variable;
+}
+
+int SatSolver::getVariableCount() const {
+    return (int)_assignment.size();
+}
+
+bool SatSolver::addClause(const LiteralVector& literals) {
+    if (_inconsistent) {
+        return false;
+    }
+    LiteralVector& clause = _newClause;
+    clause.assign(literals.begin(), literals.end());
+    std::sort(clause.begin(), clause.end());
+    clause.erase(std::unique(clause.begin(), clause.end()), clause.end());
+
+    size_t kept = 0;
+    for (size_t i = 0; i < clause.size(); i++) {
+        const Literal literal = clause[i];
+        if (_valueOfLiteral(literal) == 1 || (i > 0 && clause[i - 1] == (literal ^ 1))) {
+            // satisfied or tautological
+            return true;
+        }
+        if (_valueOfLiteral(literal) == -1) {
+            clause[kept++] = literal;
+        }
+    }
+    clause.resize(kept);
+    _statistics.clauseCount += 1;
+
+    if (clause.empty()) {
+        _inconsistent = true;
+        return false;
+    }
+    if (clause.size() == 1) {
+        _enqueue(clause[0], -1, -1);
+    } else if (clause.size() == 2) {
+        _binaryImplications[clause[0]].push_back(clause[1]);
+        _binaryImplications[clause[1]].push_back(clause[0]);
+    } else {
+        const int clauseIndex = _storeClause(clause, false);
+        _watches[clause[0]].push_back(Watcher{clauseIndex, clause[1]});
+        _watches[clause[1]].push_back(Watcher{clauseIndex, clause[0]});
+    }
+    return true;
+}
+
+int SatSolver::_storeClause(const LiteralVector& literals, const bool learned) {
+    const int clauseIndex = (int)_clauses.size();
+    _clauses.push_back(Clause{(int)_literals.size(), (int)literals.size(), learned, false, 0});
+    _literals.insert(_literals.end(), literals.begin(), literals.end());
+    return clauseIndex;
+}
+
+Literal* SatSolver::_literalsOf(const Clause& clause) {
+    return _literals.data() + clause.start;
+}
+
+const Literal* SatSolver::_literalsOf(const Clause& clause) const {
+    return _literals.data() + clause.start;
+}
+
+#pragma mark - Assignment
+
+int8_t SatSolver::_valueOfLiteral(const Literal literal) const {
+    const int8_t value = _assignment[literal >> 1];
+    if (value < 0) {
+        return -1;
+    }
+    return (literal & 1) ? 1 - value : value;
+}
+
+bool SatSolver::valueOfVariable(const int variable) const {
+    return _assignment[variable] == 1;
+}
+
+int SatSolver::_decisionLevel() const {
+    return (int)_trailLimits.size();
+}
+
+void SatSolver::_enqueue(const Literal literal, const int reasonClause, const Literal reasonLiteral) {
+    const int variable = literal >> 1;
+    _assignment[variable] = (literal & 1) ? 0 : 1;
+    _level[variable] = _decisionLevel();
+    _reasonClause[variable] = reasonClause;
+    _reasonLiteral[variable] = reasonLiteral;
+    _trail.push_back(literal);
+}
+
+void SatSolver::_backtrack(const int level) {
+    if (_decisionLevel() <= level) {
+        return;
+    }
+    for (int i = (int)_trail.size() - 1; i >= _trailLimits[level]; i--) {
+        const int variable = _trail[i] >> 1;
+        _savedPhase[variable] = _assignment[variable] == 1;
+        _assignment[variable] = -1;
+        _heapInsert(variable);
+    }
+    _trail.resize(_trailLimits[level]);
+    _trailLimits.resize(level);
+    _propagationHead = _trail.size();
+}
+
+#pragma mark - Propagation
+
+/**
+ Watch lists are keyed by the literal that has to become false for the clause to need a look. The blocker is some
+ other literal of the clause; while it is true the clause is satisfied and is skipped without being touched.
+ */
+bool SatSolver::_propagate() {
+    while (_propagationHead < _trail.size()) {
+        const Literal falseLiteral = _trail[_propagationHead++] ^ 1;
+        _statistics.propagationCount += 1;
+
+        const LiteralVector& implied = _binaryImplications[falseLiteral];
+        for (auto other = implied.begin(); other != implied.end(); ++other) {
+            const int8_t value = _valueOfLiteral(*other);
+            if (value == 0) {
+                _conflict.assign({falseLiteral, *other});
+                return false;
+            }
+            if (value == -1) {
+                _enqueue(*other, -1, falseLiteral);
+            }
+        }
+
+        std::vector<Watcher>& watchers = _watches[falseLiteral];
+        size_t i = 0;
+        size_t j = 0;
+        while (i < watchers.size()) {
+            const Watcher watcher = watchers[i++];
+            if (_valueOfLiteral(watcher.blocker) == 1) {
+                watchers[j++] = watcher;
+                continue;
+            }
+            Clause& clause = _clauses[watcher.clauseIndex];
+            if (clause.deleted) {
+                continue;
+            }
+            Literal* literals = _literalsOf(clause);
+            if (literals[0] == falseLiteral) {
+                std::swap(literals[0], literals[1]);
+            }
+            const Literal first = literals[0];
+            if (first != watcher.blocker && _valueOfLiteral(first) == 1) {
+                watchers[j++] = Watcher{watcher.clauseIndex, first};
+                continue;
+            }
+
+            bool foundWatch = false;
+            for (int k = 2; k < clause.size; k++) {
+                if (_valueOfLiteral(literals[k]) != 0) {
+                    std::swap(literals[1], literals[k]);
+                    _watches[literals[1]].push_back(Watcher{watcher.clauseIndex, first});
+                    foundWatch = true;
+                    break;
+                }
+            }
+            if (foundWatch) {
+                continue;
+            }
+
+            watchers[j++] = Watcher{watcher.clauseIndex, first};
+            if (_valueOfLiteral(first) == 0) {
+                _conflict.assign(literals, literals + clause.size);
+                while (i < watchers.size()) {
+                    watchers[j++] = watchers[i++];
+                }
+                watchers.resize(j);
+                return false;
+            }
+            _enqueue(first, watcher.clauseIndex, -1);
+        }
+        watchers.resize(j);
+    }
+    return true;
+}
+
+#pragma mark - Conflict analysis
+
+// a literal can be left out of the learned clause if everything that implied it is already in the clause
+bool SatSolver::_isRedundant(const Literal literal) const {
+    const int variable = literal >> 1;
+    if (_reasonLiteral[variable] >= 0) {
+        const int other = _reasonLiteral[variable] >> 1;
+        return _seen[other] || _level[other] == 0;
+    }
+    if (_reasonClause[variable] < 0) {
+        return false;
+    }
+    const Clause& reason = _clauses[_reasonClause[variable]];
+    const Literal* reasonLiterals = _literalsOf(reason);
+    for (const Literal* reasonLiteral = reasonLiterals; reasonLiteral != reasonLiterals + reason.size; ++reasonLiteral) {
+        const int other = *reasonLiteral >> 1;
+        if (other != variable && !_seen[other] && _level[other] > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ Walks the trail back from the conflict, resolving on current-level literals until only one is left (the first
+ unique implication point). Fills learned with the asserting literal first and returns the level to jump back to.
+ */
+int SatSolver::_analyze(LiteralVector& learned) {
+    learned.clear();
+    learned.push_back(-1);
+
+    const int currentLevel = _decisionLevel();
+    Literal binaryReason[2];
+    const Literal* reasonBegin = _conflict.data();
+    const Literal* reasonEnd = reasonBegin + _conflict.size();
+    int pathCount = 0;
+    Literal implied = -1;
+    int trailIndex = (int)_trail.size() - 1;
+    while (true) {
+        for (const Literal* literal = reasonBegin; literal != reasonEnd; ++literal) {
+            const int variable = *literal >> 1;
+            if (*literal == implied || _seen[variable] || _level[variable] == 0) {
+                continue;
+            }
+            _bumpVariable(variable);
+            _seen[variable] = true;
+            if (_level[variable] >= currentLevel) {
+                pathCount += 1;
+            } else {
+                learned.push_back(*literal);
+            }
+        }
+        while (!_seen[_trail[trailIndex] >> 1]) {
+            trailIndex--;
+        }
+        implied = _trail[trailIndex--];
+        const int variable = implied >> 1;
+        _seen[variable] = false;
+        pathCount -= 1;
+        if (pathCount == 0) {
+            break;
+        }
+        if (_reasonClause[variable] >= 0) {
+            _bumpClause(_reasonClause[variable]);
+            const Clause& reason = _clauses[_reasonClause[variable]];
+            reasonBegin = _literalsOf(reason);
+            reasonEnd = reasonBegin + reason.size;
+        } else {
+            binaryReason[0] = implied;
+            binaryReason[1] = _reasonLiteral[variable];
+            reasonBegin = binaryReason;
+            reasonEnd = binaryReason + 2;
+        }
+    }
+    learned[0] = implied ^ 1;
+
+    LiteralVector& unminimized = _unminimized;
+    unminimized.assign(learned.begin(), learned.end());
+    size_t kept = 1;
+    for (size_t i = 1; i < learned.size(); i++) {
+        if (!_isRedundant(learned[i])) {
+            learned[kept++] = learned[i];
+        }
+    }
+    learned.resize(kept);
+    for (auto literal = unminimized.begin() + 1; literal != unminimized.end(); ++literal) {
+        _seen[*literal >> 1] = false;
+    }
+
+    if (learned.size() == 1) {
+        return 0;
+    }
+    size_t deepest = 1;
+    for (size_t i = 2; i < learned.size(); i++) {
+        if (_level[learned[i] >> 1] > _level[learned[deepest] >> 1]) {
+            deepest = i;
+        }
+    }
+    std::swap(learned[1], learned[deepest]);
+    return _level[learned[1] >> 1];
+}
+
+void SatSolver::_addLearnedClause(const LiteralVector& learned) {
+    _statistics.learnedClauseCount += 1;
+    if (learned.size() == 1) {
+        _enqueue(learned[0], -1, -1);
+    } else if (learned.size() == 2) {
+        _binaryImplications[learned[0]].push_back(learned[1]);
+        _binaryImplications[learned[1]].push_back(learned[0]);
+        _enqueue(learned[0], -1, learned[1]);
+    } else {
+        const int clauseIndex = _storeClause(learned, true);
+        _bumpClause(clauseIndex);
+        _watches[learned[0]].push_back(Watcher{clauseIndex, learned[1]});
+        _watches[learned[1]].push_back(Watcher{clauseIndex, learned[0]});
+        _liveLearnedClauses += 1;
+        _enqueue(learned[0], clauseIndex, -1);
+    }
+}
+
+#pragma mark - Learned clause deletion
+
+bool SatSolver::_isLocked(const int clauseIndex) const {
+    const Literal first = _literalsOf(_clauses[clauseIndex])[0];
+    return _reasonClause[first >> 1] == clauseIndex && _valueOfLiteral(first) == 1;
+}
+
+// drops the less active half of the learned clauses; their watchers are removed lazily during propagation
+void SatSolver::_reduceLearnedClauses() {
+    std::vector<int>& candidates = _reductionCandidates;
+    candidates.clear();
+    for (int clauseIndex = 0; clauseIndex < (int)_clauses.size(); clauseIndex++) {
+        const Clause& clause = _clauses[clauseIndex];
+        if (clause.learned && !clause.deleted && !_isLocked(clauseIndex)) {
+            candidates.push_back(clauseIndex);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [this](const int a, const int b) {
+        return _clauses[a].activity < _clauses[b].activity;
+    });
+    for (size_t i = 0; i < candidates.size() / 2; i++) {
+        Clause& clause = _clauses[candidates[i]];
+        clause.deleted = true;
+        clause.size = 0;
+        _liveLearnedClauses -= 1;
+    }
+    _compactLiterals();
+}
+
+// clauses keep their order in _literals, so each one only ever moves towards the front
+void SatSolver::_compactLiterals() {
+    int end = 0;
+    for (auto clause = _clauses.begin(); clause != _clauses.end(); ++clause) {
+        std::copy(_literals.begin() + clause->start, _literals.begin() + clause->start + clause->size, _literals.begin() + end);
+        clause->start = end;
+        end += clause->size;
+    }
+    _literals.resize(end);
+}
+
+#pragma mark - Activity
+
+void SatSolver::_bumpVariable(const int variable) {
+    _activity[variable] += _variableIncrement;
+    if (_activity[variable] > kActivityLimit) {
+        for (auto activity = _activity.begin(); activity != _activity.end(); ++activity) {
+            *activity /= kActivityLimit;
+        }
+        _variableIncrement /= kActivityLimit;
+    }
+    if (_heapPosition[variable] >= 0) {
+        _heapUp(_heapPosition[variable]);
+    }
+}
+
+void SatSolver::_bumpClause(const int clauseIndex) {
+    Clause& clause = _clauses[clauseIndex];
+    if (!clause.learned) {
+        return;
+    }
+    clause.activity += _clauseIncrement;
+    if (clause.activity > kActivityLimit) {
+        for (auto other = _clauses.begin(); other != _clauses.end(); ++other) {
+            other->activity /= kActivityLimit;
+        }
+        _clauseIncrement /= kActivityLimit;
+    }
+}
+
+#pragma mark - Decision heap
+
+void SatSolver::_heapInsert(const int variable) {
+    if (_heapPosition[variable] >= 0) {
+        return;
+    }
+    _heapPosition[variable] = (int)_heap.size();
+    _heap.push_back(variable);
+    _heapUp(_heapPosition[variable]);
+}
+
+int SatSolver::_heapPop() {
+    const int top = _heap[0];
+    _heap[0] = _heap.back();
+    _heapPosition[_heap[0]] = 0;
+    _heap.pop_back();
+    _heapPosition[top] = -1;
+    if (!_heap.empty()) {
+        _heapDown(0);
+    }
+    return top;
+}
+
+void SatSolver::_heapUp(int position) {
+    const int variable = _heap[position];
+    while (position > 0) {
+        const int parent = (position - 1) / 2;
+        if (_activity[_heap[parent]] >= _activity[variable]) {
+            break;
+        }
+        _heap[position] = _heap[parent];
+        _heapPosition[_heap[position]] = position;
+        position = parent;
+    }
+    _heap[position] = variable;
+    _heapPosition[variable] = position;
+}
+
+void SatSolver::_heapDown(int position) {
+    const int variable = _heap[position];
+    const int heapSize = (int)_heap.size();
+    while (2 * position + 1 < heapSize) {
+        int child = 2 * position + 1;
+        if (child + 1 < heapSize && _activity[_heap[child + 1]] > _activity[_heap[child]]) {
+            child += 1;
+        }
+        if (_activity[_heap[child]] <= _activity[variable]) {
+            break;
+        }
+        _heap[position] = _heap[child];
+        _heapPosition[_heap[position]] = position;
+        position = child;
+    }
+    _heap[position] = variable;
+    _heapPosition[variable] = position;
+}
+
+int SatSolver::_pickBranchVariable() {
+    while (!_heap.empty()) {
+        const int variable = _heapPop();
+        if (_assignment[variable] < 0) {
+            return variable;
+        }
+    }
+    return -1;
+}
+
+#pragma mark - Search
+
+SatResult SatSolver::solve(SolveMonitor* monitor) {
+    if (_inconsistent || !_propagate()) {
+        _inconsistent = true;
+        return SatResult::Unsatisfiable;
+    }
+
+    if (monitor != nullptr && !monitor->setMemoryUsage(MemoryCategory::SearchState, getMemoryFootprint())) {
+        return SatResult::Stopped;
+    }
+
+    _maxLearnedClauses = std::max(kMinimumMaxLearnedClauses, (long)_clauses.size() / 3);
+    int restartIndex = 0;
+    long restartConflictLimit = kRestartBaseConflicts;
+    long conflictsSinceRestart = 0;
+    LiteralVector& learned = _learned;
+    while (true) {
+        if (!_propagate()) {
+            _statistics.conflictCount += 1;
+            conflictsSinceRestart += 1;
+            if (_decisionLevel() == 0) {
+                _inconsistent = true;
+                return SatResult::Unsatisfiable;
+            }
+            const int backjumpLevel = _analyze(learned);
+            _backtrack(backjumpLevel);
+            _addLearnedClause(learned);
+            _variableIncrement /= kVariableDecay;
+            _clauseIncrement /= kClauseDecay;
+            if (monitor != nullptr && monitor->shouldStop()) {
+                _backtrack(0);
+                return SatResult::Stopped;
+            }
+            continue;
+        }
+
+        if (conflictsSinceRestart >= restartConflictLimit) {
+            _backtrack(0);
+            restartIndex += 1;
+            _statistics.restartCount += 1;
+            conflictsSinceRestart = 0;
+            restartConflictLimit = (long)(kRestartBaseConflicts * lubySequence(2, restartIndex));
+            if (monitor != nullptr && !monitor->setMemoryUsage(MemoryCategory::SearchState, getMemoryFootprint())) {
+                return SatResult::Stopped;
+            }
+        }
+        if (_liveLearnedClauses - (long)_trail.size() >= _maxLearnedClauses) {
+            _reduceLearnedClauses();
+            _maxLearnedClauses += _maxLearnedClauses / 10;
+            if (monitor != nullptr && !monitor->setMemoryUsage(MemoryCategory::SearchState, getMemoryFootprint())) {
+                _backtrack(0);
+                return SatResult::Stopped;
+            }
+        }
+
+        const int variable = _pickBranchVariable();
+        if (variable < 0) {
+            return SatResult::Satisfiable;
+        }
+        _statistics.decisionCount += 1;
+        if (monitor != nullptr && !monitor->countNode(_decisionLevel() + 1)) {
+            _heapInsert(variable);
+            _backtrack(0);
+            return SatResult::Stopped;
+        }
+        _trailLimits.push_back((int)_trail.size());
+        _enqueue(_savedPhase[variable] ? positiveLiteral(variable) : negativeLiteral(variable), -1, -1);
+    }
+}
+
+const SatStatistics& SatSolver::getStatistics() const {
+    return _statistics;
+}
+
+size_t SatSolver::getMemoryFootprint() const {
+    size_t bytes = _clauses.capacity() * sizeof(Clause) + _literals.capacity() * sizeof(Literal);
+    bytes += _watches.capacity() * sizeof(std::vector<Watcher>) + _binaryImplications.capacity() * sizeof(LiteralVector);
+    for (size_t literal = 0; literal < _watches.size(); literal++) {
+        bytes += _watches[literal].capacity() * sizeof(Watcher) + _binaryImplications[literal].capacity() * sizeof(Literal);
+    }
+    const size_t intCount = _level.capacity() + _reasonClause.capacity() + _reasonLiteral.capacity() + _trail.capacity() + _trailLimits.capacity()
+        + _heap.capacity() + _heapPosition.capacity();
+    bytes += intCount * sizeof(int) + _assignment.capacity() + _activity.capacity() * sizeof(double);
+    bytes += (_savedPhase.capacity() + _seen.capacity()) / 8;
+    return bytes;
+}
@@ -0,0 +1,146 @@
+//
+//  SatSolver.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef SatSolver_hpp
+#define SatSolver_hpp
+
+#include <cstdint>
+#include <vector>
+
+#include "SolveMonitor.hpp"
+
+// variable v has the positive literal 2v and the negative literal 2v + 1
+typedef int Literal;
+typedef std::vector<Literal> LiteralVector;
+
+inline Literal positiveLiteral(const int variable) {
+    return 2 * variable;
+}
+inline Literal negativeLiteral(const int variable) {
+    return 2 * variable + 1;
+}
+
+enum class SatResult {
+    Satisfiable,
+    Unsatisfiable,
+    Stopped     // the monitor ran out of budget or was cancelled
+};
+
+struct SatStatistics {
+    int variableCount = 0;
+    long clauseCount = 0;       // original clauses, binary ones included
+    long decisionCount = 0;
+    long conflictCount = 0;
+    long propagationCount = 0;
+    long learnedClauseCount = 0;
+    int restartCount = 0;
+};
+
+/**
+ A small CDCL solver: two-watched-literal propagation (binary clauses live directly in implication lists),
+ first-UIP conflict analysis with local clause minimization, VSIDS decisions with phase saving,
+ Luby restarts and activity-based deletion of learned clauses.
+
+ Decisions are counted as nodes on the monitor, so SolveLimits apply the same way they do for DFS; the memory the
+ solver holds is reported as search state when the solve starts, on restarts and after learned clauses are
+ reduced, so a solve over the memory cap stops there. reset empties
+ the solver for the next formula but keeps every buffer, so a solver reused from puzzle to puzzle stops allocating
+ once it has seen its largest formula.
+ */
+class SatSolver {
+    // the literals live in _literals, from start on; deleted clauses give theirs back when the learned clauses are
+    // reduced
+    struct Clause {
+        int start;
+        int size;
+        bool learned;
+        bool deleted;
+        double activity;
+    };
+    struct Watcher {
+        int clauseIndex;
+        Literal blocker;
+    };
+
+    std::vector<Clause> _clauses;
+    LiteralVector _literals;
+    std::vector<std::vector<Watcher>> _watches;             // by the literal that has to become false
+    std::vector<LiteralVector> _binaryImplications;         // same, for binary clauses: the other literal
+    bool _inconsistent;
+
+    // per variable
+    std::vector<int8_t> _assignment;    // -1 unassigned, 0 false, 1 true
+    std::vector<int> _level;
+    std::vector<int> _reasonClause;     // -1 for decisions and binary reasons
+    std::vector<Literal> _reasonLiteral; // the false literal of a binary reason, -1 otherwise
+    std::vector<bool> _savedPhase;
+    std::vector<double> _activity;
+    std::vector<bool> _seen;
+
+    LiteralVector _trail;
+    std::vector<int> _trailLimits;      // trail size at the start of each decision level
+    size_t _propagationHead;
+    LiteralVector _conflict;
+
+    std::vector<int> _heap;             // variables by activity, max first
+    std::vector<int> _heapPosition;     // -1 when not in the heap
+
+    // scratch, kept so that a reused solver doesn't allocate for them again
+    LiteralVector _newClause;
+    LiteralVector _learned;
+    LiteralVector _unminimized;
+    std::vector<int> _reductionCandidates;
+
+    double _variableIncrement;
+    double _clauseIncrement;
+    long _maxLearnedClauses;
+    long _liveLearnedClauses;
+    SatStatistics _statistics;
+
+    Literal* _literalsOf(const Clause& clause);
+    const Literal* _literalsOf(const Clause& clause) const;
+    int _storeClause(const LiteralVector& literals, const bool learned);
+    void _compactLiterals();
+    int8_t _valueOfLiteral(const Literal literal) const;
+    int _decisionLevel() const;
+    void _enqueue(const Literal literal, const int reasonClause, const Literal reasonLiteral);
+    bool _propagate();
+    int _analyze(LiteralVector& learned);
+    bool _isRedundant(const Literal literal) const;
+    void _backtrack(const int level);
+    void _addLearnedClause(const LiteralVector& learned);
+    void _reduceLearnedClauses();
+    bool _isLocked(const int clauseIndex) const;
+    int _pickBranchVariable();
+
+    void _bumpVariable(const int variable);
+    void _bumpClause(const int clauseIndex);
+    void _heapInsert(const int variable);
+    int _heapPop();
+    void _heapUp(int position);
+    void _heapDown(int position);
+
+public:
+    SatSolver();
+    void reset();
+
+    int addVariable();
+    int getVariableCount() const;
+    // returns false once the clauses are known to be unsatisfiable
+    bool addClause(const LiteralVector& literals);
+
+    // monitor may be null
+    SatResult solve(SolveMonitor* monitor);
+    // only meaningful after solve returned Satisfiable
+    bool valueOfVariable(const int variable) const;
+
+    const SatStatistics& getStatistics() const;
+    // bytes held by the clause database, watch lists and per-variable arrays, from their capacities
+    size_t getMemoryFootprint() const;
+};
+
+#endif /* SatSolver_hpp */
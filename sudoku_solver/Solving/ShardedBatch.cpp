@@ -0,0 +1,449 @@
+//
+//  ShardedBatch.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "ShardedBatch.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <queue>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Solver.hpp"
+
+static const std::string kCheckpointHeader = "sudoku_shard_checkpoint 1";
+
+// FNV-1a, so shards on different hosts and builds agree on it (std::hash makes no such promise)
+static const uint64_t kHashOffset = 14695981039346656037ULL;
+static const uint64_t kHashPrime = 1099511628211ULL;
+
+static uint64_t hashBytes(uint64_t hash, const std::string& bytes) {
+    for (auto byte = bytes.begin(); byte != bytes.end(); ++byte) {
+        hash = (hash ^ (unsigned char)*byte) * kHashPrime;
+    }
+    return hash;
+}
+
+// the running hash over the input's records; the newline keeps "ab" + "c" apart from "a" + "bc"
+static uint64_t hashRecord(const uint64_t hash, const std::string& line) {
+    return (hashBytes(hash, line) ^ '\n') * kHashPrime;
+}
+
+static bool fileExists(const std::string& path) {
+    struct stat status;
+    return stat(path.c_str(), &status) == 0;
+}
+
+#pragma mark - Shards
+
+bool ShardSpec::parse(const std::string& text, ShardSpec& spec) {
+    const size_t slash = text.find('/');
+    if (slash == std::string::npos) {
+        return false;
+    }
+    char* end = nullptr;
+    const long index = strtol(text.c_str(), &end, 10);
+    if (end != text.c_str() + slash) {
+        return false;
+    }
+    const long count = strtol(text.c_str() + slash + 1, &end, 10);
+    if (*end != '\0' || count < 1 || index < 0 || index >= count) {
+        return false;
+    }
+    spec.index = (int)index;
+    spec.count = (int)count;
+    return true;
+}
+
+bool ShardSpec::contains(const long recordIndex, const std::string& line) const {
+    if (mode == ShardMode::Hash) {
+        return (int)(hashBytes(kHashOffset, line) % count) == index;
+    }
+    return (int)(recordIndex % count) == index;
+}
+
+std::string ShardSpec::modeName() const {
+    return mode == ShardMode::Hash ? "hash" : "index";
+}
+
+#pragma mark - Checkpoints
+
+bool ShardCheckpoint::write(const std::string& filename) const {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+    file << std::setprecision(9);
+    file << kCheckpointHeader << "\n";
+    file << "shard " << shard.index << " " << shard.count << " " << shard.modeName() << "\n";
+    file << "next_record " << nextRecord << "\n";
+    file << "output_bytes " << outputBytes << "\n";
+    file << "input_hash " << std::hex << inputHash << std::dec << "\n";
+    file << "complete " << (complete ? 1 : 0) << "\n";
+    file << "puzzles " << puzzleCount << "\n";
+    file << "solved " << solvedCount << "\n";
+    file << "solve_seconds " << solveSeconds << "\n";
+    file << "lane_batches " << laneStatistics.batchCount << "\n";
+    file << "lane_solved " << laneStatistics.laneSolvedCount << "\n";
+    file << "lane_contradictions " << laneStatistics.laneContradictionCount << "\n";
+    file << "scalar " << laneStatistics.scalarCount << "\n";
+    file.flush();
+    return file.good();
+}
+
+bool ShardCheckpoint::read(const std::string& filename, std::string& error) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        error = "unable to open " + filename;
+        return false;
+    }
+    std::string line;
+    if (!getline(file, line) || line != kCheckpointHeader) {
+        error = filename + " is not a shard checkpoint";
+        return false;
+    }
+    *this = ShardCheckpoint();
+    int lineNumber = 1;
+    while (getline(file, line)) {
+        lineNumber += 1;
+        if (line.empty()) {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string name;
+        fields >> name;
+        bool valid = true;
+        if (name == "shard") {
+            std::string mode;
+            fields >> shard.index >> shard.count >> mode;
+            valid = mode == "index" || mode == "hash";
+            shard.mode = mode == "hash" ? ShardMode::Hash : ShardMode::RecordIndex;
+        } else if (name == "next_record") {
+            fields >> nextRecord;
+        } else if (name == "output_bytes") {
+            fields >> outputBytes;
+        } else if (name == "input_hash") {
+            fields >> std::hex >> inputHash >> std::dec;
+        } else if (name == "complete") {
+            int value;
+            fields >> value;
+            complete = value != 0;
+        } else if (name == "puzzles") {
+            fields >> puzzleCount;
+        } else if (name == "solved") {
+            fields >> solvedCount;
+        } else if (name == "solve_seconds") {
+            fields >> solveSeconds;
+        } else if (name == "lane_batches") {
+            fields >> laneStatistics.batchCount;
+        } else if (name == "lane_solved") {
+            fields >> laneStatistics.laneSolvedCount;
+        } else if (name == "lane_contradictions") {
+            fields >> laneStatistics.laneContradictionCount;
+        } else if (name == "scalar") {
+            fields >> laneStatistics.scalarCount;
+        }
+        if (!valid || fields.fail()) {
+            error = filename + ":" + std::to_string(lineNumber) + ": invalid record";
+            return false;
+        }
+    }
+    return true;
+}
+
+void ShardCheckpoint::addStatistics(const ShardCheckpoint& other) {
+    puzzleCount += other.puzzleCount;
+    solvedCount += other.solvedCount;
+    solveSeconds += other.solveSeconds;
+    laneStatistics.add(other.laneStatistics);
+}
+
+#pragma mark - Runner
+
+ShardedBatchRunner::ShardedBatchRunner(ThreadPool& pool, const ShardSpec shard, const ShardOptions options, const ResultFormatter formatter) : _pool(pool), _shard(shard), _options(options), _formatter(formatter) {
+    _options.chunkSize = std::max(1, _options.chunkSize);
+}
+
+std::string ShardedBatchRunner::checkpointPath(const std::string& outputPath) {
+    return outputPath + ".checkpoint";
+}
+
+const std::string& ShardedBatchRunner::getLastError() const {
+    return _lastError;
+}
+
+// one line per record: its index, a tab and the formatter's line (or the input line and invalid)
+void ShardedBatchRunner::_solveChunk(const std::vector<long>& recordIndices, const std::vector<std::string>& lines, std::string& text, ShardCheckpoint& checkpoint) {
+    GridVector grids;
+    grids.reserve(lines.size());
+    GridVector laneGrids;
+    std::vector<int> lanePositions;
+    std::vector<int> scalarPositions;
+    // lines that aren't a puzzle of a supported size keep their place with a default grid that is never solved
+    std::vector<bool> invalid(lines.size(), false);
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (Grid::compactStringSize(lines[i]) == 0) {
+            grids.push_back(Grid());
+            invalid[i] = true;
+            continue;
+        }
+        grids.push_back(Grid::fromCompactString(lines[i]));
+        if (_options.useLanes && LaneSolver::supportsSize(grids.back().getSize())) {
+            lanePositions.push_back((int)i);
+            laneGrids.push_back(grids.back());
+        } else {
+            scalarPositions.push_back((int)i);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    SolveStatusVector statuses(grids.size(), SolveStatus::NoSolution);
+    if (!laneGrids.empty()) {
+        const SolveStatusVector laneStatuses = LaneSolver::solveAll(laneGrids, _pool, checkpoint.laneStatistics);
+        for (size_t lane = 0; lane < lanePositions.size(); lane++) {
+            grids[lanePositions[lane]] = laneGrids[lane];
+            statuses[lanePositions[lane]] = laneStatuses[lane];
+        }
+    }
+    _pool.parallelFor((int)scalarPositions.size(), [&](const int, const int itemIndex) {
+        const int position = scalarPositions[itemIndex];
+        Solver solver(grids[position]);
+        solver.setVerbose(false);
+        statuses[position] = solver.solve().status;
+    });
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    checkpoint.solveSeconds += elapsed.count();
+
+    for (size_t i = 0; i < grids.size(); i++) {
+        text += std::to_string(recordIndices[i]);
+        text += "\t";
+        if (invalid[i]) {
+            text += lines[i];
+            text += "\tinvalid\n";
+        } else {
+            _formatter(grids[i], statuses[i], text);
+        }
+        checkpoint.puzzleCount += 1;
+        checkpoint.solvedCount += statuses[i] == SolveStatus::Solved;
+    }
+}
+
+bool ShardedBatchRunner::run(std::istream& input, const std::string& outputPath, ShardCheckpoint& checkpoint) {
+    const std::string checkpointFile = checkpointPath(outputPath);
+    checkpoint = ShardCheckpoint();
+    checkpoint.shard = _shard;
+    const bool resuming = fileExists(checkpointFile);
+    if (resuming) {
+        if (!checkpoint.read(checkpointFile, _lastError)) {
+            return false;
+        }
+        if (checkpoint.shard.index != _shard.index || checkpoint.shard.count != _shard.count || checkpoint.shard.mode != _shard.mode) {
+            _lastError = checkpointFile + " belongs to shard " + std::to_string(checkpoint.shard.index) + "/" + std::to_string(checkpoint.shard.count) + " by " + checkpoint.shard.modeName();
+            return false;
+        }
+    }
+
+    // the input is checked before the output is touched
+    uint64_t hash = kHashOffset;
+    long recordIndex = 0;
+    std::string line;
+    while (recordIndex < checkpoint.nextRecord && getline(input, line)) {
+        if (!line.empty()) {
+            hash = hashRecord(hash, line);
+            recordIndex += 1;
+        }
+    }
+    bool inputChanged = recordIndex < checkpoint.nextRecord || (resuming && hash != checkpoint.inputHash);
+    if (checkpoint.complete) {
+        while (!inputChanged && getline(input, line)) {
+            inputChanged = !line.empty();
+        }
+    }
+    if (inputChanged) {
+        _lastError = "the input changed since " + checkpointFile + " was written";
+        return false;
+    }
+    if (checkpoint.complete) {
+        return true;
+    }
+
+    if (resuming) {
+        struct stat status;
+        if (stat(outputPath.c_str(), &status) != 0 || status.st_size < checkpoint.outputBytes) {
+            _lastError = outputPath + " is shorter than its checkpoint says";
+            return false;
+        }
+        // drops whatever was written after the last checkpoint
+        if (truncate(outputPath.c_str(), checkpoint.outputBytes) != 0) {
+            _lastError = "unable to truncate " + outputPath;
+            return false;
+        }
+    }
+    std::unique_ptr<FILE, int (*)(FILE*)> output(fopen(outputPath.c_str(), resuming ? "ab" : "wb"), fclose);
+    if (output == nullptr) {
+        _lastError = "unable to open " + outputPath;
+        return false;
+    }
+
+    const std::string temporaryFile = checkpointFile + ".tmp";
+    std::vector<long> recordIndices;
+    std::vector<std::string> lines;
+    std::string text;
+    const auto finishChunk = [&](const bool complete) {
+        text.clear();
+        _solveChunk(recordIndices, lines, text, checkpoint);
+        recordIndices.clear();
+        lines.clear();
+        // the output has to be on disk before a checkpoint can point past it
+        if (fwrite(text.data(), 1, text.size(), output.get()) != text.size() || fflush(output.get()) != 0 || fsync(fileno(output.get())) != 0) {
+            _lastError = "unable to write " + outputPath;
+            return false;
+        }
+        checkpoint.outputBytes += text.size();
+        checkpoint.nextRecord = recordIndex;
+        checkpoint.inputHash = hash;
+        checkpoint.complete = complete;
+        if (!checkpoint.write(temporaryFile) || rename(temporaryFile.c_str(), checkpointFile.c_str()) != 0) {
+            _lastError = "unable to write " + checkpointFile;
+            return false;
+        }
+        return true;
+    };
+
+    while (getline(input, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        hash = hashRecord(hash, line);
+        if (_shard.contains(recordIndex, line)) {
+            recordIndices.push_back(recordIndex);
+            lines.push_back(line);
+        }
+        recordIndex += 1;
+        if ((int)lines.size() >= _options.chunkSize && !finishChunk(false)) {
+            return false;
+        }
+    }
+    return finishChunk(true);
+}
+
+#pragma mark - Merge
+
+namespace {
+    struct ShardReader {
+        std::ifstream file;
+        std::string line;
+        long recordIndex = -1;
+        size_t answerStart = 0;
+
+        // false at the end of the file; recordIndex is -1 for a malformed line
+        bool next() {
+            if (!getline(file, line)) {
+                return false;
+            }
+            const size_t tab = line.find('\t');
+            char* end = nullptr;
+            recordIndex = strtol(line.c_str(), &end, 10);
+            if (tab == std::string::npos || end != line.c_str() + tab || recordIndex < 0) {
+                recordIndex = -1;
+            }
+            answerStart = tab + 1;
+            return true;
+        }
+    };
+}
+
+bool ShardMerger::merge(const std::vector<std::string>& outputPaths, std::ostream& output, ShardCheckpoint& totals, std::string& error) {
+    if (outputPaths.empty()) {
+        error = "no shard outputs";
+        return false;
+    }
+    std::vector<ShardCheckpoint> checkpoints(outputPaths.size());
+    for (size_t shard = 0; shard < outputPaths.size(); shard++) {
+        const std::string checkpointFile = ShardedBatchRunner::checkpointPath(outputPaths[shard]);
+        if (!checkpoints[shard].read(checkpointFile, error)) {
+            return false;
+        }
+        if (!checkpoints[shard].complete) {
+            error = outputPaths[shard] + " is not complete";
+            return false;
+        }
+    }
+
+    const ShardCheckpoint& first = checkpoints.front();
+    std::vector<bool> seen(first.shard.count, false);
+    totals = ShardCheckpoint();
+    totals.shard = first.shard;
+    totals.nextRecord = first.nextRecord;
+    totals.inputHash = first.inputHash;
+    totals.complete = true;
+    for (size_t shard = 0; shard < checkpoints.size(); shard++) {
+        const ShardCheckpoint& checkpoint = checkpoints[shard];
+        if (checkpoint.shard.count != first.shard.count || checkpoint.shard.mode != first.shard.mode) {
+            error = outputPaths[shard] + " was split differently from " + outputPaths.front();
+            return false;
+        }
+        if (checkpoint.inputHash != first.inputHash || checkpoint.nextRecord != first.nextRecord) {
+            error = outputPaths[shard] + " was run on a different input from " + outputPaths.front();
+            return false;
+        }
+        if (seen[checkpoint.shard.index]) {
+            error = "shard " + std::to_string(checkpoint.shard.index) + " is given twice";
+            return false;
+        }
+        seen[checkpoint.shard.index] = true;
+        totals.addStatistics(checkpoint);
+    }
+    if ((int)outputPaths.size() != first.shard.count) {
+        error = std::to_string(first.shard.count - (int)outputPaths.size()) + " of " + std::to_string(first.shard.count) + " shards are missing";
+        return false;
+    }
+
+    std::vector<ShardReader> readers(outputPaths.size());
+    // (record index, shard) of every reader that still has a line, smallest index first
+    typedef std::pair<long, int> Head;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    for (size_t shard = 0; shard < outputPaths.size(); shard++) {
+        readers[shard].file.open(outputPaths[shard]);
+        if (!readers[shard].file.is_open()) {
+            error = "unable to open " + outputPaths[shard];
+            return false;
+        }
+        if (readers[shard].next()) {
+            heads.push(Head(readers[shard].recordIndex, (int)shard));
+        }
+    }
+
+    long expected = 0;
+    while (!heads.empty()) {
+        const int shard = heads.top().second;
+        heads.pop();
+        ShardReader& reader = readers[shard];
+        if (reader.recordIndex != expected) {
+            error = outputPaths[shard] + ": expected record " + std::to_string(expected) + ", found " + (reader.recordIndex < 0 ? "a malformed line" : "record " + std::to_string(reader.recordIndex));
+            return false;
+        }
+        output.write(reader.line.data() + reader.answerStart, reader.line.size() - reader.answerStart);
+        output.put('\n');
+        expected += 1;
+        if (reader.next()) {
+            heads.push(Head(reader.recordIndex, shard));
+        }
+    }
+    if (expected != totals.nextRecord) {
+        error = "the shards hold " + std::to_string(expected) + " of " + std::to_string(totals.nextRecord) + " records";
+        return false;
+    }
+    return output.good();
+}
@@ -0,0 +1,109 @@
+//
+//  ShardedBatch.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef ShardedBatch_hpp
+#define ShardedBatch_hpp
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "LaneSolver.hpp"
+#include "SolvePipeline.hpp"
+#include "ThreadPool.hpp"
+
+enum class ShardMode {
+    RecordIndex,    // record i goes to shard i % count
+    Hash            // by a hash of the puzzle, so a shard's share doesn't depend on where a puzzle sits in the file
+};
+
+// shard index of count; records are the non-empty lines of the input, numbered from 0
+struct ShardSpec {
+    int index = 0;
+    int count = 1;
+    ShardMode mode = ShardMode::RecordIndex;
+
+    // "i/n"
+    static bool parse(const std::string& text, ShardSpec& spec);
+    bool contains(const long recordIndex, const std::string& line) const;
+    std::string modeName() const;
+};
+
+/**
+ Progress of one shard, rewritten after every chunk: the shard's output up to outputBytes holds the answers for
+ every record of the shard before nextRecord. inputHash covers the input's records before nextRecord, so a resume
+ notices a changed input, and once the shard is complete it covers the whole input, so the merge notices shards
+ that ran over different files.
+ */
+struct ShardCheckpoint {
+    ShardSpec shard;
+    long nextRecord = 0;
+    long outputBytes = 0;
+    uint64_t inputHash = 0;
+    bool complete = false;
+
+    long puzzleCount = 0;
+    long solvedCount = 0;
+    double solveSeconds = 0;
+    LaneStatistics laneStatistics;
+
+    bool write(const std::string& filename) const;
+    bool read(const std::string& filename, std::string& error);
+    // sums the counters; the shard and progress fields are left alone
+    void addStatistics(const ShardCheckpoint& other);
+};
+
+struct ShardOptions {
+    bool useLanes = true;               // 9x9 puzzles go through LaneSolver, the others through Solver
+    int chunkSize = 4096;               // shard records solved between checkpoints
+};
+
+/**
+ Batch runner for one shard of a corpus, so that a corpus can be spread over processes or hosts that share a
+ filesystem: every shard reads the whole input, solves its own records and writes the formatter's line for each
+ (which has to be a single line), prefixed with its record index, to its own output file, with a checkpoint next to
+ it (outputPath + ".checkpoint").
+
+ Output is appended and flushed to disk a chunk at a time, and only then is the checkpoint replaced (written to a
+ temporary file and renamed over the old one), so after a crash the checkpoint never claims more than the output
+ holds. Running the same shard again resumes: the output is cut back to the checkpoint's length and the input is
+ skipped up to its record. The answer for each puzzle depends on the puzzle alone, so the shard layout, chunking
+ and resumes can't change what the merge produces.
+ */
+class ShardedBatchRunner {
+    ThreadPool& _pool;
+    ShardSpec _shard;
+    ShardOptions _options;
+    ResultFormatter _formatter;
+    std::string _lastError;
+
+    void _solveChunk(const std::vector<long>& recordIndices, const std::vector<std::string>& lines, std::string& text, ShardCheckpoint& checkpoint);
+
+public:
+    ShardedBatchRunner(ThreadPool& pool, const ShardSpec shard, const ShardOptions options, const ResultFormatter formatter);
+
+    // runs or resumes the shard; on success the checkpoint is complete and holds the shard's statistics
+    bool run(std::istream& input, const std::string& outputPath, ShardCheckpoint& checkpoint);
+
+    static std::string checkpointPath(const std::string& outputPath);
+    const std::string& getLastError() const;
+};
+
+/**
+ Puts the outputs of a complete set of shards back into input order. Each output is sorted by record index, so the
+ merge streams them side by side and fails on a gap, a duplicate, a missing or unfinished shard, or shards that
+ read different inputs.
+ */
+class ShardMerger {
+public:
+    // writes the answers without their record indices; totals gets the summed statistics
+    static bool merge(const std::vector<std::string>& outputPaths, std::ostream& output, ShardCheckpoint& totals, std::string& error);
+};
+
+#endif /* ShardedBatch_hpp */
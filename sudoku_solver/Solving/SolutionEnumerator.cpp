@@ -0,0 +1,481 @@
+//
+//  SolutionEnumerator.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "SolutionEnumerator.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+static const char kMagic[4] = {'S', 'D', 'K', 'S'};
+static const uint32_t kVersion = 1;
+static const int kHeaderFieldCount = 5;
+static const std::string kCheckpointHeader = "sudoku_enumeration_checkpoint 1";
+// nodes a worker explores between looks at the checkpoint flag
+static const long kNodesPerStep = 1024;
+
+#pragma mark - Codec
+
+static void appendUInt32(std::string& output, const uint32_t value) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        output += (char)((value >> shift) & 0xff);
+    }
+}
+
+static uint32_t readUInt32(const unsigned char* bytes) {
+    return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+SolutionCodec::SolutionCodec() : _size(0), _bitsPerValue(1), _recordBytes(0) {}
+
+SolutionCodec::SolutionCodec(const Grid& puzzle) : _size(puzzle.getSize()), _puzzle(puzzle.compactPrint()) {
+    _layOut();
+}
+
+void SolutionCodec::_layOut() {
+    _freeCells.clear();
+    for (int cellIndex = 0; cellIndex < (int)_puzzle.size(); cellIndex++) {
+        if (_puzzle[cellIndex] == '-') {
+            _freeCells.push_back(cellIndex);
+        }
+    }
+    _bitsPerValue = 1;
+    while ((1 << _bitsPerValue) < _size) {
+        _bitsPerValue += 1;
+    }
+    _recordBytes = std::max(1, ((int)_freeCells.size() * _bitsPerValue + 7) / 8);
+}
+
+std::string SolutionCodec::header() const {
+    std::string result(kMagic, sizeof(kMagic));
+    appendUInt32(result, kVersion);
+    appendUInt32(result, _size);
+    appendUInt32(result, (uint32_t)_freeCells.size());
+    appendUInt32(result, _bitsPerValue);
+    appendUInt32(result, _recordBytes);
+    result += _puzzle;
+    return result;
+}
+
+bool SolutionCodec::readHeader(std::istream& input, std::string& error) {
+    unsigned char fields[sizeof(kMagic) + 4 * kHeaderFieldCount];
+    if (!input.read((char*)fields, sizeof(fields)) || memcmp(fields, kMagic, sizeof(kMagic)) != 0) {
+        error = "not a solution file";
+        return false;
+    }
+    const uint32_t version = readUInt32(fields + 4);
+    const uint32_t size = readUInt32(fields + 8);
+    if (version != kVersion || size < 1 || size > 64) {
+        error = "unsupported solution file version or grid size";
+        return false;
+    }
+    _size = size;
+    _puzzle.assign(size * size, '-');
+    if (!input.read(&_puzzle[0], _puzzle.size())) {
+        error = "truncated solution file header";
+        return false;
+    }
+    _layOut();
+    if (readUInt32(fields + 12) != _freeCells.size() || readUInt32(fields + 16) != (uint32_t)_bitsPerValue || readUInt32(fields + 20) != (uint32_t)_recordBytes) {
+        error = "inconsistent solution file header";
+        return false;
+    }
+    return true;
+}
+
+void SolutionCodec::encode(const IntVector& values, std::string& output) const {
+    const size_t start = output.size();
+    output.append(_recordBytes, '\0');
+    char* bytes = &output[start];
+    uint64_t pending = 0;
+    int pendingBits = 0;
+    for (auto cellIndex = _freeCells.begin(); cellIndex != _freeCells.end(); ++cellIndex) {
+        pending |= (uint64_t)(values[*cellIndex] - 1) << pendingBits;
+        pendingBits += _bitsPerValue;
+        while (pendingBits >= 8) {
+            *bytes++ = (char)(pending & 0xff);
+            pending >>= 8;
+            pendingBits -= 8;
+        }
+    }
+    if (pendingBits > 0) {
+        *bytes = (char)(pending & 0xff);
+    }
+}
+
+std::string SolutionCodec::decode(const char* record) const {
+    std::string result = _puzzle;
+    const unsigned char* bytes = (const unsigned char*)record;
+    const uint64_t valueMask = (1ULL << _bitsPerValue) - 1;
+    uint64_t pending = 0;
+    int pendingBits = 0;
+    for (auto cellIndex = _freeCells.begin(); cellIndex != _freeCells.end(); ++cellIndex) {
+        while (pendingBits < _bitsPerValue) {
+            pending |= (uint64_t)*bytes++ << pendingBits;
+            pendingBits += 8;
+        }
+        result[*cellIndex] = Grid::printCharacterOfValue((int)(pending & valueMask) + 1);
+        pending >>= _bitsPerValue;
+        pendingBits -= _bitsPerValue;
+    }
+    return result;
+}
+
+int SolutionCodec::getSize() const {
+    return _size;
+}
+
+const std::string& SolutionCodec::getPuzzle() const {
+    return _puzzle;
+}
+
+size_t SolutionCodec::getHeaderBytes() const {
+    return sizeof(kMagic) + 4 * kHeaderFieldCount + _puzzle.size();
+}
+
+int SolutionCodec::getRecordBytes() const {
+    return _recordBytes;
+}
+
+#pragma mark - Enumeration
+
+SolutionEnumerator::SolutionEnumerator(ThreadPool& pool, const Grid& grid, const EnumerationOptions options) : _pool(pool), _grid(grid), _options(options), _codec(grid), _nextTask(0), _runningCount(0), _pausedCount(0), _checkpointRequested(false), _failed(false), _output(nullptr), _outputBytes(0) {
+    _options.tasksPerThread = std::max(1, _options.tasksPerThread);
+    _options.checkpointSeconds = std::max(0.001, _options.checkpointSeconds);
+}
+
+std::string SolutionEnumerator::checkpointPath(const std::string& outputPath) {
+    return outputPath + ".checkpoint";
+}
+
+const EnumerationStatistics& SolutionEnumerator::getStatistics() const {
+    return _statistics;
+}
+
+const std::string& SolutionEnumerator::getLastError() const {
+    return _lastError;
+}
+
+void SolutionEnumerator::_fail(const std::string& error) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_failed) {
+        _lastError = error;
+    }
+    _failed = true;
+}
+
+// expands the frontier a level at a time, keeping the subtrees in enumeration order
+void SolutionEnumerator::_splitIntoTasks() {
+    BitmaskSolver solver(_grid);
+    const size_t target = (size_t)_pool.getThreadCount() * _options.tasksPerThread;
+    std::vector<BranchVector> frontier(1);
+    while (frontier.size() < target) {
+        std::vector<BranchVector> next;
+        bool expanded = false;
+        BranchVector branches;
+        for (auto path = frontier.begin(); path != frontier.end(); ++path) {
+            if (!solver.branchesAt(*path, branches)) {
+                next.push_back(*path);
+                continue;
+            }
+            expanded = true;
+            for (auto branch = branches.begin(); branch != branches.end(); ++branch) {
+                next.push_back(*path);
+                next.back().push_back(*branch);
+            }
+        }
+        frontier.swap(next);
+        if (!expanded) {
+            break;
+        }
+    }
+    _tasks.clear();
+    for (auto path = frontier.begin(); path != frontier.end(); ++path) {
+        Task task;
+        task.path = *path;
+        task.rootDepth = (int)path->size();
+        _tasks.push_back(task);
+    }
+}
+
+bool SolutionEnumerator::_writeBuffer(std::string& buffer) {
+    if (buffer.empty()) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(_outputMutex);
+    if (fwrite(buffer.data(), 1, buffer.size(), _output) != buffer.size()) {
+        return false;
+    }
+    _outputBytes += buffer.size();
+    buffer.clear();
+    return true;
+}
+
+void SolutionEnumerator::_workerLoop(WorkerState& worker) {
+    BitmaskSolver solver(_grid);
+    while (true) {
+        Task* task;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_failed || _nextTask >= _taskOrder.size()) {
+                break;
+            }
+            task = &_tasks[_taskOrder[_nextTask++]];
+        }
+        if (!solver.startEnumeration(task->path, task->rootDepth, task->nodeFinished)) {
+            _fail("a checkpointed path doesn't fit the puzzle");
+            break;
+        }
+        const long startNodeCount = task->nodeCount;
+        while (!_failed) {
+            const EnumerationStep step = solver.stepEnumeration(kNodesPerStep);
+            if (step == EnumerationStep::Solution) {
+                _codec.encode(solver.getValues(), worker.buffer);
+                task->solutionCount += 1;
+                if (worker.buffer.size() >= _options.writeBufferSize && !_writeBuffer(worker.buffer)) {
+                    _fail("unable to write the solutions");
+                }
+            } else if (step == EnumerationStep::Exhausted) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                task->done = true;
+                task->nodeCount = startNodeCount + solver.getNodeCount();
+                break;
+            }
+            if (_checkpointRequested) {
+                std::unique_lock<std::mutex> lock(_mutex);
+                solver.getEnumerationPosition(task->path, task->nodeFinished);
+                task->nodeCount = startNodeCount + solver.getNodeCount();
+                _pausedCount += 1;
+                _changed.notify_all();
+                _changed.wait(lock, [&] { return !_checkpointRequested; });
+                _pausedCount -= 1;
+            }
+        }
+    }
+    if (!_failed && !_writeBuffer(worker.buffer)) {
+        _fail("unable to write the solutions");
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    _runningCount -= 1;
+    _changed.notify_all();
+}
+
+#pragma mark - Checkpoints
+
+// the output has to be on disk before a checkpoint can point past it
+bool SolutionEnumerator::_writeCheckpoint(const std::string& checkpointFile, const bool complete) {
+    if (fflush(_output) != 0 || fsync(fileno(_output)) != 0) {
+        return false;
+    }
+    const std::string temporaryFile = checkpointFile + ".tmp";
+    {
+        std::ofstream file(temporaryFile);
+        if (!file.is_open()) {
+            return false;
+        }
+        file << kCheckpointHeader << "\n";
+        file << "puzzle " << _codec.getPuzzle() << "\n";
+        file << "output_bytes " << _outputBytes << "\n";
+        file << "checkpoints " << _statistics.checkpointCount << "\n";
+        file << "complete " << (complete ? 1 : 0) << "\n";
+        // task root_depth done node_finished solutions nodes decision_count (cell value)...
+        for (auto task = _tasks.begin(); task != _tasks.end(); ++task) {
+            file << "task " << task->rootDepth << " " << (task->done ? 1 : 0) << " " << (task->nodeFinished ? 1 : 0);
+            file << " " << task->solutionCount << " " << task->nodeCount << " " << task->path.size();
+            for (auto decision = task->path.begin(); decision != task->path.end(); ++decision) {
+                file << " " << decision->cellIndex << " " << decision->value;
+            }
+            file << "\n";
+        }
+        file.flush();
+        if (!file.good()) {
+            return false;
+        }
+    }
+    return rename(temporaryFile.c_str(), checkpointFile.c_str()) == 0;
+}
+
+bool SolutionEnumerator::_readCheckpoint(const std::string& checkpointFile, bool& complete) {
+    std::ifstream file(checkpointFile);
+    if (!file.is_open()) {
+        _lastError = "unable to open " + checkpointFile;
+        return false;
+    }
+    std::string line;
+    if (!getline(file, line) || line != kCheckpointHeader) {
+        _lastError = checkpointFile + " is not an enumeration checkpoint";
+        return false;
+    }
+    _tasks.clear();
+    complete = false;
+    int lineNumber = 1;
+    while (getline(file, line)) {
+        lineNumber += 1;
+        if (line.empty()) {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string name;
+        fields >> name;
+        bool valid = true;
+        if (name == "puzzle") {
+            std::string puzzle;
+            fields >> puzzle;
+            if (!fields.fail() && puzzle != _codec.getPuzzle()) {
+                _lastError = checkpointFile + " belongs to a different puzzle";
+                return false;
+            }
+        } else if (name == "output_bytes") {
+            fields >> _outputBytes;
+        } else if (name == "checkpoints") {
+            fields >> _statistics.checkpointCount;
+        } else if (name == "complete") {
+            int value;
+            fields >> value;
+            complete = value != 0;
+        } else if (name == "task") {
+            Task task;
+            int done;
+            int nodeFinished;
+            size_t decisionCount;
+            fields >> task.rootDepth >> done >> nodeFinished >> task.solutionCount >> task.nodeCount >> decisionCount;
+            for (size_t decision = 0; decision < decisionCount && !fields.fail(); decision++) {
+                Branch branch;
+                fields >> branch.cellIndex >> branch.value;
+                task.path.push_back(branch);
+            }
+            task.done = done != 0;
+            task.nodeFinished = nodeFinished != 0;
+            valid = task.rootDepth <= (int)task.path.size();
+            _tasks.push_back(task);
+        }
+        if (!valid || fields.fail()) {
+            _lastError = checkpointFile + ":" + std::to_string(lineNumber) + ": invalid record";
+            return false;
+        }
+    }
+    if (_tasks.empty() || _outputBytes < (long)_codec.getHeaderBytes()) {
+        _lastError = checkpointFile + " is incomplete";
+        return false;
+    }
+    return true;
+}
+
+#pragma mark - Run
+
+bool SolutionEnumerator::run(const std::string& outputPath) {
+    const std::string checkpointFile = checkpointPath(outputPath);
+    _statistics = EnumerationStatistics();
+    _lastError.clear();
+    _failed = false;
+
+    struct stat status;
+    if (stat(checkpointFile.c_str(), &status) == 0) {
+        bool complete = false;
+        if (!_readCheckpoint(checkpointFile, complete)) {
+            return false;
+        }
+        _statistics.resumed = true;
+        _statistics.alreadyComplete = complete;
+        if (!complete) {
+            // the solutions written after the checkpoint are written again from the checkpointed paths
+            std::ifstream existing(outputPath, std::ios::binary);
+            std::string header(_codec.getHeaderBytes(), '\0');
+            if (!existing.read(&header[0], header.size()) || header != _codec.header()) {
+                _lastError = outputPath + " doesn't hold this puzzle's solutions";
+                return false;
+            }
+            existing.close();
+            if (stat(outputPath.c_str(), &status) != 0 || status.st_size < _outputBytes || truncate(outputPath.c_str(), _outputBytes) != 0) {
+                _lastError = outputPath + " is shorter than its checkpoint says";
+                return false;
+            }
+            _output = fopen(outputPath.c_str(), "ab");
+        }
+    } else {
+        _output = fopen(outputPath.c_str(), "wb");
+        if (_output != nullptr) {
+            std::string header = _codec.header();
+            _outputBytes = 0;
+            _splitIntoTasks();
+            // from here on a killed run resumes with the same subtrees
+            if (!_writeBuffer(header) || !_writeCheckpoint(checkpointFile, false)) {
+                _lastError = "unable to write " + checkpointFile;
+                fclose(_output);
+                _output = nullptr;
+                return false;
+            }
+        }
+    }
+
+    if (!_statistics.alreadyComplete) {
+        if (_output == nullptr) {
+            _lastError = "unable to open " + outputPath;
+            return false;
+        }
+        _taskOrder.clear();
+        for (int taskIndex = 0; taskIndex < (int)_tasks.size(); taskIndex++) {
+            if (!_tasks[taskIndex].done) {
+                _taskOrder.push_back(taskIndex);
+            }
+        }
+        _workers.assign(_pool.getThreadCount(), WorkerState());
+        _nextTask = 0;
+        _runningCount = _pool.getThreadCount();
+        _pausedCount = 0;
+        _checkpointRequested = false;
+
+        std::thread workers([&]() {
+            _pool.runOnEachWorker([&](const int workerIndex) {
+                _workerLoop(_workers[workerIndex]);
+            });
+        });
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (_runningCount > 0) {
+                _changed.wait_for(lock, std::chrono::duration<double>(_options.checkpointSeconds), [&] { return _runningCount == 0; });
+                if (_runningCount == 0 || _failed) {
+                    continue;
+                }
+                _checkpointRequested = true;
+                _changed.wait(lock, [&] { return _pausedCount == _runningCount; });
+                bool written = true;
+                for (auto worker = _workers.begin(); worker != _workers.end(); ++worker) {
+                    written = written && _writeBuffer(worker->buffer);
+                }
+                _statistics.checkpointCount += 1;
+                if (!written || !_writeCheckpoint(checkpointFile, false)) {
+                    // the last good checkpoint stays, and a resume starts over from it
+                    _lastError = "unable to write the solutions or " + checkpointFile;
+                    _failed = true;
+                }
+                _checkpointRequested = false;
+                _changed.notify_all();
+            }
+        }
+        workers.join();
+
+        if (!_failed && !_writeCheckpoint(checkpointFile, true)) {
+            _lastError = "unable to write " + checkpointFile;
+            _failed = true;
+        }
+        fclose(_output);
+        _output = nullptr;
+    }
+
+    for (auto task = _tasks.begin(); task != _tasks.end(); ++task) {
+        _statistics.nodeCount += task->nodeCount;
+    }
+    _statistics.taskCount = (int)_tasks.size();
+    _statistics.solutionCount = (_outputBytes - (long)_codec.getHeaderBytes()) / _codec.getRecordBytes();
+    return !_failed;
+}
@@ -0,0 +1,145 @@
+//
+//  SolutionEnumerator.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef SolutionEnumerator_hpp
+#define SolutionEnumerator_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <istream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "BitmaskSolver.hpp"
+#include "Grid.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ Binary layout of an enumeration's output: a header, then one fixed-size record per solution.
+
+ The header is "SDKS", then version, grid size, free cell count, bits per value and record bytes as little-endian
+ 32-bit numbers, then the puzzle as a compactPrint line. A record holds only the cells that are empty in the
+ puzzle, in cell order, each as value - 1 in bitsPerValue bits, packed from the lowest bit of the first byte up;
+ a 9x9 grid with 60 empty cells takes 30 bytes per solution.
+ */
+class SolutionCodec {
+    int _size;
+    std::string _puzzle;
+    IntVector _freeCells;
+    int _bitsPerValue;
+    int _recordBytes;
+
+    void _layOut();
+
+public:
+    SolutionCodec();
+    SolutionCodec(const Grid& puzzle);
+
+    std::string header() const;
+    bool readHeader(std::istream& input, std::string& error);
+
+    // appends the record for a full assignment of cell values
+    void encode(const IntVector& values, std::string& output) const;
+    // the solution a record holds, as a compactPrint line
+    std::string decode(const char* record) const;
+
+    int getSize() const;
+    const std::string& getPuzzle() const;
+    size_t getHeaderBytes() const;
+    int getRecordBytes() const;
+};
+
+struct EnumerationOptions {
+    // the search tree is split into about this many subtrees per pool thread
+    int tasksPerThread = 16;
+    double checkpointSeconds = 60;
+    // per worker; a full buffer goes to the output file in one write
+    size_t writeBufferSize = 1 << 18;
+};
+
+struct EnumerationStatistics {
+    long solutionCount = 0;
+    long nodeCount = 0;
+    int taskCount = 0;
+    long checkpointCount = 0;
+    bool resumed = false;
+    bool alreadyComplete = false;
+};
+
+/**
+ Enumerates every solution of a grid into a binary file (see SolutionCodec), for puzzles with far too many
+ solutions to count in one sitting.
+
+ The search tree is cut into subtrees first: the root's branches are expanded level by level (in BitmaskSolver's
+ enumeration order) until there are tasksPerThread subtrees per thread. The pool's workers then take subtrees one at
+ a time and walk them with BitmaskSolver's resumable enumeration, encoding solutions into a buffer of their own.
+
+ Every checkpointSeconds the workers stop between enumeration steps, their buffers are written out and synced, and
+ a checkpoint next to the output (outputPath + ".checkpoint") is replaced: the output's length and, for every
+ subtree, whether it is done or the decision path to where its worker stopped. Running again on the same puzzle
+ cuts the output back to that length and resumes every subtree from its path, so nothing is lost or written twice.
+ With one thread the solutions come out in enumeration order; with more, subtrees interleave.
+ */
+class SolutionEnumerator {
+    struct Task {
+        BranchVector path;          // the subtree's root, then where its last worker stopped
+        int rootDepth = 0;
+        bool nodeFinished = false;  // the node at the end of path has been explored
+        bool done = false;
+        long solutionCount = 0;
+        long nodeCount = 0;
+    };
+    struct WorkerState {
+        std::string buffer;
+    };
+
+    ThreadPool& _pool;
+    Grid _grid;
+    EnumerationOptions _options;
+    SolutionCodec _codec;
+
+    std::vector<Task> _tasks;
+    std::vector<int> _taskOrder;    // the tasks that aren't done, in the order they are handed out
+    std::vector<WorkerState> _workers;
+    EnumerationStatistics _statistics;
+    std::string _lastError;
+
+    // protect the fields below, and the tasks while the workers run
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    size_t _nextTask;
+    int _runningCount;
+    int _pausedCount;
+    std::atomic<bool> _checkpointRequested;
+    std::atomic<bool> _failed;
+
+    std::mutex _outputMutex;
+    FILE* _output;
+    long _outputBytes;
+
+    void _splitIntoTasks();
+    void _workerLoop(WorkerState& worker);
+    bool _writeBuffer(std::string& buffer);
+    bool _writeCheckpoint(const std::string& checkpointFile, const bool complete);
+    bool _readCheckpoint(const std::string& checkpointFile, bool& complete);
+    void _fail(const std::string& error);
+
+public:
+    SolutionEnumerator(ThreadPool& pool, const Grid& grid, const EnumerationOptions options);
+
+    // runs or resumes the enumeration; false on an I/O error or a checkpoint that doesn't fit
+    bool run(const std::string& outputPath);
+
+    const EnumerationStatistics& getStatistics() const;
+    const std::string& getLastError() const;
+
+    static std::string checkpointPath(const std::string& outputPath);
+};
+
+#endif /* SolutionEnumerator_hpp */
@@ -0,0 +1,142 @@
+//
+//  SolveMonitor.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "SolveMonitor.hpp"
+
+#include <algorithm>
+
+static const long kClockCheckInterval = 4;
+
+#pragma mark - Cancellation token
+
+CancellationToken::CancellationToken() : _cancelled(false) {}
+
+void CancellationToken::cancel() {
+    _cancelled.store(true, std::memory_order_relaxed);
+}
+
+void CancellationToken::reset() {
+    _cancelled.store(false, std::memory_order_relaxed);
+}
+
+bool CancellationToken::isCancelled() const {
+    return _cancelled.load(std::memory_order_relaxed);
+}
+
+#pragma mark - Limits
+
+void SolveLimits::setTimeout(const double seconds) {
+    deadline = SolveClock::now() + std::chrono::duration_cast<SolveClock::duration>(std::chrono::duration<double>(seconds));
+}
+
+#pragma mark - Monitor
+
+SolveMonitor::SolveMonitor(const SolveLimits& limits) : _limits(limits) {
+    _startTime = SolveClock::now();
+    _nodeCount = 0;
+    _checkCount = 0;
+    _nextProgressNodeCount = limits.progressInterval > 0 ? limits.progressInterval : 0;
+    _currentDepth = 0;
+    _stopped = false;
+    _stopStatus = SolveStatus::NoSolution;
+}
+
+void SolveMonitor::_stop(const SolveStatus status) {
+    _stopped = true;
+    _stopStatus = status;
+}
+
+void SolveMonitor::_reportProgress() {
+    const double elapsed = getElapsedSeconds();
+    SolveProgress progress;
+    progress.nodeCount = _nodeCount;
+    progress.nodesPerSecond = elapsed > 0 ? _nodeCount / elapsed : 0;
+    progress.depth = _currentDepth;
+    progress.elapsedSeconds = elapsed;
+    _limits.progressCallback(progress);
+}
+
+bool SolveMonitor::countNode(const int depth) {
+    _nodeCount += 1;
+    _currentDepth = depth;
+    if (_limits.maxNodes > 0 && _nodeCount > _limits.maxNodes) {
+        _stop(SolveStatus::BudgetExhausted);
+        return false;
+    }
+    if (_limits.progressCallback && _nextProgressNodeCount > 0 && _nodeCount >= _nextProgressNodeCount) {
+        _nextProgressNodeCount += _limits.progressInterval;
+        _reportProgress();
+    }
+    return !shouldStop();
+}
+
+bool SolveMonitor::shouldStop() {
+    if (_stopped) {
+        return true;
+    }
+    if (_limits.cancellationToken != nullptr && _limits.cancellationToken->isCancelled()) {
+        _stop(SolveStatus::Cancelled);
+        return true;
+    }
+    _checkCount += 1;
+    if (_checkCount % kClockCheckInterval == 0 && _limits.deadline != SolveClock::time_point::max()) {
+        if (SolveClock::now() >= _limits.deadline) {
+            _stop(SolveStatus::BudgetExhausted);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SolveMonitor::setMemoryUsage(const MemoryCategory category, const size_t bytes) {
+    const int index = (int)category;
+    _memoryStatistics.liveBytes[index] = bytes;
+    _memoryStatistics.peakBytes[index] = std::max(_memoryStatistics.peakBytes[index], bytes);
+    size_t total = 0;
+    for (int i = 0; i < kMemoryCategoryCount; i++) {
+        total += _memoryStatistics.liveBytes[i];
+    }
+    _memoryStatistics.peakTotalBytes = std::max(_memoryStatistics.peakTotalBytes, total);
+    if (_limits.maxMemoryBytes > 0 && total > _limits.maxMemoryBytes && !_stopped) {
+        _stop(SolveStatus::MemoryExhausted);
+    }
+    return !_stopped;
+}
+
+bool SolveMonitor::resumeAfterMemoryStop() {
+    if (!_stopped || _stopStatus != SolveStatus::MemoryExhausted) {
+        return false;
+    }
+    _stopped = false;
+    _stopStatus = SolveStatus::NoSolution;
+    return true;
+}
+
+bool SolveMonitor::isStopped() const {
+    return _stopped;
+}
+
+SolveStatus SolveMonitor::getStopStatus() const {
+    return _stopStatus;
+}
+
+long SolveMonitor::getNodeCount() const {
+    return _nodeCount;
+}
+
+int SolveMonitor::getCurrentDepth() const {
+    return _currentDepth;
+}
+
+double SolveMonitor::getElapsedSeconds() const {
+    std::chrono::duration<double> elapsed = SolveClock::now() - _startTime;
+    return elapsed.count();
+}
+
+const MemoryStatistics& SolveMonitor::getMemoryStatistics() const {
+    return _memoryStatistics;
+}
@@ -0,0 +1,116 @@
+//
+//  SolveMonitor.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef SolveMonitor_hpp
+#define SolveMonitor_hpp
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+
+typedef std::chrono::steady_clock SolveClock;
+
+class CancellationToken {
+    std::atomic<bool> _cancelled;
+public:
+    CancellationToken();
+    void cancel();
+    void reset();
+    bool isCancelled() const;
+};
+
+struct SolveProgress {
+    long nodeCount;
+    double nodesPerSecond;
+    int depth;
+    double elapsedSeconds;
+};
+
+typedef std::function<void(const SolveProgress&)> ProgressCallback;
+
+struct SolveLimits {
+    SolveClock::time_point deadline = SolveClock::time_point::max();
+    // 0 means no limit
+    long maxNodes = 0;
+    // not owned; may be shared by several solves
+    const CancellationToken* cancellationToken = nullptr;
+    ProgressCallback progressCallback;
+    // the callback runs once every progressInterval DFS nodes
+    long progressInterval = 4096;
+    // cap on the memory the solve accounts for (see MemoryStatistics); 0 means no limit
+    size_t maxMemoryBytes = 0;
+
+    void setTimeout(const double seconds);
+};
+
+enum class SolveStatus {
+    Solved,
+    NoSolution,
+    BudgetExhausted,    // deadline passed or node budget used up
+    Cancelled,
+    MemoryExhausted     // over SolveLimits::maxMemoryBytes, with no smaller strategy left to try
+};
+
+enum class MemoryCategory {
+    SearchState,        // DFS grids along the path, the backjumping trail and nogoods, the SAT clause database
+    PropagationScratch, // the thread's ScratchArena
+    TopologyTables      // index tables, hash keys and bitmask topology shared by the grids of a size
+};
+
+static const int kMemoryCategoryCount = 3;
+
+// bytes held by a solve, as its parts report them (capacities, with an estimate for hash set nodes), not measured
+struct MemoryStatistics {
+    size_t liveBytes[kMemoryCategoryCount] = {};
+    size_t peakBytes[kMemoryCategoryCount] = {};
+    size_t peakTotalBytes = 0;
+};
+
+/**
+ Enforces SolveLimits for one solve. DFS calls countNode once per expanded state; propagation loops call
+ shouldStop once per pass. Both only read an atomic flag on most calls and look at the clock every
+ kClockCheckInterval calls, so they are cheap enough for the hot paths.
+
+ Once a limit is hit the monitor stays stopped and every later check returns immediately. The one exception is the
+ memory cap: the engines report what they hold through setMemoryUsage whenever it grows, and a solve stopped on the
+ cap may release that memory and go on with a smaller strategy (see Solver).
+ */
+class SolveMonitor {
+    SolveLimits _limits;
+    SolveClock::time_point _startTime;
+    long _nodeCount;
+    long _checkCount;
+    long _nextProgressNodeCount;
+    int _currentDepth;
+    bool _stopped;
+    SolveStatus _stopStatus;
+    MemoryStatistics _memoryStatistics;
+
+    void _stop(const SolveStatus status);
+    void _reportProgress();
+
+public:
+    SolveMonitor(const SolveLimits& limits);
+
+    // returns false once the solve has to stop
+    bool countNode(const int depth);
+    bool shouldStop();
+    // replaces what the category holds; returns false once the total is over the cap
+    bool setMemoryUsage(const MemoryCategory category, const size_t bytes);
+    // undoes a stop on the memory cap, once the caller has released what hit it; false for other stops
+    bool resumeAfterMemoryStop();
+
+    bool isStopped() const;
+    SolveStatus getStopStatus() const;
+    long getNodeCount() const;
+    int getCurrentDepth() const;
+    double getElapsedSeconds() const;
+    const MemoryStatistics& getMemoryStatistics() const;
+};
+
+#endif /* SolveMonitor_hpp */
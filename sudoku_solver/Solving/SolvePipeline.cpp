@@ -0,0 +1,162 @@
+//
+//  SolvePipeline.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "SolvePipeline.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "BoundedQueue.hpp"
+#include "Solver.hpp"
+
+namespace {
+    struct Chunk {
+        long sequence = 0;
+        std::vector<std::string> lines;
+    };
+
+    struct ChunkResult {
+        long sequence = 0;
+        std::string text;
+    };
+}
+
+SolvePipeline::SolvePipeline(ThreadPool& pool, const PipelineOptions options, const ResultFormatter formatter) : _pool(pool), _options(options), _formatter(formatter) {
+    _options.chunkSize = std::max(1, _options.chunkSize);
+    _options.window = std::max(1, _options.window);
+}
+
+void SolvePipeline::_solveChunk(const std::vector<std::string>& lines, std::string& text, LaneStatistics& laneStatistics) const {
+    GridVector grids;
+    grids.reserve(lines.size());
+    // per line, its grid or -1 when the line isn't a puzzle of a supported size
+    IntVector gridIndices;
+    gridIndices.reserve(lines.size());
+    bool useLanes = _options.useLanes;
+    for (auto line = lines.begin(); line != lines.end(); ++line) {
+        if (Grid::compactStringSize(*line) == 0) {
+            gridIndices.push_back(-1);
+            continue;
+        }
+        gridIndices.push_back((int)grids.size());
+        grids.push_back(Grid::fromCompactString(*line));
+        useLanes = useLanes && LaneSolver::supportsSize(grids.back().getSize());
+    }
+
+    SolveStatusVector statuses(grids.size(), SolveStatus::NoSolution);
+    if (useLanes) {
+        for (size_t first = 0; first < grids.size(); first += LaneSolver::kLaneCount) {
+            const int count = (int)std::min(grids.size() - first, (size_t)LaneSolver::kLaneCount);
+            LaneSolver::solveBatch(&grids[first], count, &statuses[first], laneStatistics);
+        }
+    } else {
+        for (size_t i = 0; i < grids.size(); i++) {
+            Solver solver(grids[i]);
+            solver.setVerbose(false);
+            statuses[i] = solver.solve().status;
+        }
+    }
+
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (gridIndices[i] < 0) {
+            text += lines[i];
+            text += "\tinvalid\n";
+        } else {
+            _formatter(grids[gridIndices[i]], statuses[gridIndices[i]], text);
+        }
+    }
+}
+
+PipelineStatistics SolvePipeline::run(std::istream& input, std::ostream& output) {
+    PipelineStatistics statistics;
+    const int window = _options.window;
+    BoundedQueue<Chunk> chunks(window);
+    BoundedQueue<ChunkResult> results(window);
+    // chunks before this one have been written; the reader stays less than a window ahead of it
+    std::atomic<long> writtenCount(0);
+
+    std::thread reader([&]() {
+        Chunk chunk;
+        std::string line;
+        while (getline(input, line)) {
+            if (line.empty()) {
+                continue;
+            }
+            chunk.lines.push_back(line);
+            statistics.puzzleCount += 1;
+            if ((int)chunk.lines.size() < _options.chunkSize) {
+                continue;
+            }
+            for (int attempt = 0; chunk.sequence - writtenCount.load(std::memory_order_acquire) >= window; attempt++) {
+                statistics.readerWaitCount += attempt == 0;
+                std::this_thread::sleep_for(std::chrono::microseconds(attempt < 16 ? 10 : 200));
+            }
+            const long sequence = chunk.sequence;
+            chunks.push(std::move(chunk));
+            chunk = Chunk();
+            chunk.sequence = sequence + 1;
+        }
+        if (!chunk.lines.empty()) {
+            while (chunk.sequence - writtenCount.load(std::memory_order_acquire) >= window) {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+            chunks.push(std::move(chunk));
+            chunk.sequence += 1;
+        }
+        statistics.chunkCount = chunk.sequence;
+        chunks.close();
+    });
+
+    std::thread writer([&]() {
+        std::vector<ChunkResult> pending(window);
+        std::vector<char> isPending(window, 0);
+        std::string buffer;
+        buffer.reserve(_options.writeBufferSize + 4096);
+        long nextSequence = 0;
+        ChunkResult result;
+        while (results.pop(result)) {
+            const int slot = (int)(result.sequence % window);
+            pending[slot] = std::move(result);
+            isPending[slot] = 1;
+            for (int next = (int)(nextSequence % window); isPending[next]; next = (int)(nextSequence % window)) {
+                buffer += pending[next].text;
+                pending[next].text.clear();
+                isPending[next] = 0;
+                nextSequence += 1;
+                writtenCount.store(nextSequence, std::memory_order_release);
+                if (buffer.size() >= _options.writeBufferSize) {
+                    output.write(buffer.data(), buffer.size());
+                    buffer.clear();
+                }
+            }
+        }
+        output.write(buffer.data(), buffer.size());
+        output.flush();
+    });
+
+    std::vector<LaneStatistics> workerStatistics(_pool.getThreadCount());
+    _pool.runOnEachWorker([&](const int workerIndex) {
+        Chunk chunk;
+        while (chunks.pop(chunk)) {
+            ChunkResult result;
+            result.sequence = chunk.sequence;
+            _solveChunk(chunk.lines, result.text, workerStatistics[workerIndex]);
+            results.push(std::move(result));
+        }
+    });
+    reader.join();
+    results.close();
+    writer.join();
+
+    for (auto worker = workerStatistics.begin(); worker != workerStatistics.end(); ++worker) {
+        statistics.laneStatistics.add(*worker);
+    }
+    return statistics;
+}
@@ -0,0 +1,62 @@
+//
+//  SolvePipeline.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef SolvePipeline_hpp
+#define SolvePipeline_hpp
+
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+
+#include "Grid.hpp"
+#include "LaneSolver.hpp"
+#include "SolveMonitor.hpp"
+#include "ThreadPool.hpp"
+
+// appends the output line(s) for one solved (or not) puzzle; input lines that aren't a compact grid of a supported
+// size skip it and come out as the line, a tab and "invalid"
+typedef std::function<void(const Grid& grid, const SolveStatus status, std::string& output)> ResultFormatter;
+
+struct PipelineOptions {
+    bool useLanes = true;               // 9x9 chunks go through LaneSolver first
+    int chunkSize = LaneSolver::kLaneCount;
+    int window = 64;                    // chunks between the reader and the writer (parsed, solving or reordering)
+    size_t writeBufferSize = 1 << 20;
+};
+
+struct PipelineStatistics {
+    long puzzleCount = 0;
+    long chunkCount = 0;
+    long readerWaitCount = 0;           // times the reader had to wait for the writer (backpressure)
+    LaneStatistics laneStatistics;
+};
+
+/**
+ Streams puzzles (one per line) from an input stream to an output stream in three stages, so memory use depends on
+ the window and not on the size of the input:
+
+ - the reader (its own thread) parses nothing; it groups lines into chunks numbered in order and pushes them on a
+   bounded queue, waiting whenever the writer is a full window behind;
+ - the pool's workers pop chunks, solve them and push the formatted text on a second bounded queue;
+ - the writer (its own thread) puts chunks back in order in a ring of window slots and writes them out in buffers
+   of writeBufferSize bytes.
+ */
+class SolvePipeline {
+    ThreadPool& _pool;
+    PipelineOptions _options;
+    ResultFormatter _formatter;
+
+    void _solveChunk(const std::vector<std::string>& lines, std::string& text, LaneStatistics& laneStatistics) const;
+
+public:
+    SolvePipeline(ThreadPool& pool, const PipelineOptions options, const ResultFormatter formatter);
+
+    PipelineStatistics run(std::istream& input, std::ostream& output);
+};
+
+#endif /* SolvePipeline_hpp */
@@ -6,30 +6,271 @@
 
 #include "Solver.hpp"
 
+#include "BitmaskSolver.hpp"
 #include "ConstraintSolver.hpp"
 #include "DepthFirstSearchSolver.hpp"
+#include "SatGridSolver.hpp"
 
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
-Solver::Solver(Grid& g) : _grid(g) {}
+// how often a portfolio solve looks at the caller's cancellation token while its members run
+static const int kPortfolioPollMilliseconds = 10;
+
+Solver::Solver(Grid& g) : _grid(g), _engine(SolveEngine::Automatic), _costModel(nullptr), _verbose(true) {}
+
+Solver::Solver(Grid& g, const SolveLimits limits) : _grid(g), _limits(limits), _engine(SolveEngine::Automatic), _costModel(nullptr), _verbose(true) {}
+
+void Solver::setSearchOptions(const SearchOptions options) {
+    _searchOptions = options;
+}
+
+void Solver::setEngine(const SolveEngine engine) {
+    _engine = engine;
+}
+
+void Solver::setPortfolio(const PortfolioMemberVector members) {
+    _portfolio = members;
+}
+
+PortfolioMemberVector Solver::defaultPortfolio(const SearchOptions base) {
+    PortfolioMemberVector members;
+
+    PortfolioMember search;
+    search.name = "dfs";
+    search.searchOptions = base;
+    members.push_back(search);
+
+    // the probe pool can only serve one search at a time, so only the first member keeps it
+    SearchOptions withoutPool = base;
+    withoutPool.lookaheadPool = nullptr;
+
+    PortfolioMember restarts;
+    restarts.name = "dfs-luby";
+    restarts.searchOptions = withoutPool;
+    restarts.searchOptions.randomize = true;
+    restarts.searchOptions.seed = base.seed + 1;
+    restarts.searchOptions.restartSchedule = RestartSchedule::Luby;
+    restarts.searchOptions.branching = BranchingStrategy::MinimumRemainingValues;
+    members.push_back(restarts);
+
+    PortfolioMember backjump;
+    backjump.name = "backjump";
+    backjump.searchOptions = withoutPool;
+    backjump.searchOptions.conflictDirectedBackjumping = true;
+    members.push_back(backjump);
+
+    PortfolioMember sat;
+    sat.name = "sat";
+    sat.engine = SolveEngine::Sat;
+    sat.searchOptions = withoutPool;
+    members.push_back(sat);
+
+    return members;
+}
+
+void Solver::setCostModel(const EngineCostModel* model) {
+    _costModel = model;
+}
+
+void Solver::setVerbose(const bool verbose) {
+    _verbose = verbose;
+}
+
+void Solver::_report(const std::string& message) const {
+    if (_verbose) {
+        std::cout << message << std::endl << std::endl;
+    }
+}
+
+static SolveResult finishResult(SolveResult result, const SolveMonitor& monitor) {
+    result.monitoredNodeCount = monitor.getNodeCount();
+    result.elapsedSeconds = monitor.getElapsedSeconds();
+    result.memoryStatistics = monitor.getMemoryStatistics();
+    return result;
+}
+
+// only a DFS that stopped on the memory cap; resumes the monitor when it can
+bool Solver::_canFallBackOnMemory(SolveMonitor& monitor, const SearchOptions& searchOptions) const {
+    if (!monitor.isStopped() || monitor.getStopStatus() != SolveStatus::MemoryExhausted) {
+        return false;
+    }
+    if (searchOptions.conflictDirectedBackjumping || !BitmaskSolver::supportsSize(_grid.getSize())) {
+        return false;
+    }
+    return monitor.resumeAfterMemoryStop();
+}
+
+SolveResult Solver::solve() {
+    SolveResult result;
+    SolveMonitor monitor(_limits);
+    monitor.setMemoryUsage(MemoryCategory::TopologyTables, _grid.getSharedTableBytes());
 
-void Solver::solve() {
     if (_grid.isSolved()) {
-        return;
+        result.status = SolveStatus::Solved;
+        return finishResult(result, monitor);
     }
 
-    ConstraintSolver(_grid).propagateContraints();
+    if (_engine == SolveEngine::Portfolio) {
+        result = _solveWithPortfolio();
+        result.elapsedSeconds = monitor.getElapsedSeconds();
+        return result;
+    }
+
+    bool useSat = _engine == SolveEngine::Sat;
+    SearchOptions searchOptions = _searchOptions;
+    std::string strategyName;
+    if (_engine == SolveEngine::Automatic) {
+        const EngineCostModel& model = _costModel != nullptr ? *_costModel : EngineCostModel::builtIn();
+        const SolveStrategy& strategy = model.choose(PuzzleFeatures::extract(_grid));
+        useSat = strategy.useSat;
+        searchOptions = strategy.searchOptions(_searchOptions);
+        strategyName = strategy.name;
+    }
+
+    if (useSat) {
+        result = _solveWithSat(monitor);
+        result.strategy = strategyName;
+        return finishResult(result, monitor);
+    }
+
+    result.strategy = strategyName;
+    ConstraintSolver(_grid, &monitor, searchOptions.techniques).propagateContraints();
+    monitor.setMemoryUsage(MemoryCategory::PropagationScratch, ScratchArena::forCurrentThread().getCapacity());
 
     if (_grid.isSolved()) {
-        std::cout << "*** Solved without DFS *** " << std::endl << std::endl;
+        _report("*** Solved without DFS ***");
+        result.status = SolveStatus::Solved;
+    } else if (monitor.isStopped()) {
+        _report("*** Stopped during propagation ***");
+        result.status = monitor.getStopStatus();
     } else {
-        Grid dfsResult = DepthFirstSearchSolver(_grid).search();
+        DepthFirstSearchSolver searchSolver(_grid, &monitor, searchOptions);
+        Grid dfsResult = searchSolver.search();
+        result.usedSearch = true;
+        result.searchStatistics = searchSolver.getStatistics();
+        if (!dfsResult.isSolved() && _canFallBackOnMemory(monitor, searchOptions)) {
+            _report("*** DFS went over the memory cap, continuing with backjumping ***");
+            SearchOptions backjumpOptions = searchOptions;
+            backjumpOptions.conflictDirectedBackjumping = true;
+            DepthFirstSearchSolver backjumpSolver(_grid, &monitor, backjumpOptions);
+            dfsResult = backjumpSolver.search();
+            result.searchStatistics = backjumpSolver.getStatistics();
+            result.usedMemoryFallback = true;
+        }
         if (dfsResult.isSolved()) {
-            std::cout << "*** Solved with DFS ***" << std::endl << std::endl;
+            _report("*** Solved with DFS ***");
             _grid = dfsResult;
+            result.status = SolveStatus::Solved;
+        } else if (monitor.isStopped()) {
+            _report("*** Stopped during DFS ***");
+            result.status = monitor.getStopStatus();
         } else {
-            std::cout << "*** Could NOT solve! ***" << std::endl << std::endl;
+            _report("*** Could NOT solve! ***");
+            result.status = SolveStatus::NoSolution;
         }
     }
+    return finishResult(result, monitor);
+}
+
+SolveResult Solver::_solveWithSat(SolveMonitor& monitor) {
+    SolveResult result;
+    SatGridSolver satSolver(_grid, &monitor);
+    const SatResult satResult = satSolver.solve();
+    result.usedSat = true;
+    result.satStatistics = satSolver.getStatistics();
+    switch (satResult) {
+        case SatResult::Satisfiable:
+            _report("*** Solved with SAT ***");
+            result.status = SolveStatus::Solved;
+            break;
+        case SatResult::Unsatisfiable:
+            _report("*** Could NOT solve! ***");
+            result.status = SolveStatus::NoSolution;
+            break;
+        case SatResult::Stopped:
+            _report("*** Stopped during SAT ***");
+            result.status = monitor.getStopStatus();
+            break;
+    }
+    return result;
 }
 
+SolveResult Solver::_solveWithPortfolio() {
+    const PortfolioMemberVector members = _portfolio.empty() ? defaultPortfolio(_searchOptions) : _portfolio;
+    CancellationToken raceToken;
+    SolveLimits memberLimits = _limits;
+    memberLimits.cancellationToken = &raceToken;
+    // callbacks from several threads at once would interleave
+    memberLimits.progressCallback = nullptr;
+    memberLimits.maxMemoryBytes = _limits.maxMemoryBytes / members.size();
+
+    std::mutex mutex;
+    std::condition_variable memberFinished;
+    int finishedCount = 0;
+    int winnerIndex = -1;
+    bool budgetExhausted = false;
+    bool memoryExhausted = false;
+    SolveResult winnerResult;
+    Grid winnerGrid;
+
+    std::vector<std::thread> threads;
+    for (int index = 0; index < (int)members.size(); index++) {
+        threads.push_back(std::thread([&, index]() {
+            const PortfolioMember& member = members[index];
+            Grid grid = _grid;
+            Solver solver(grid, memberLimits);
+            solver.setEngine(member.engine == SolveEngine::Portfolio ? SolveEngine::Automatic : member.engine);
+            solver.setSearchOptions(member.searchOptions);
+            solver.setCostModel(_costModel);
+            solver.setVerbose(false);
+            const SolveResult memberResult = solver.solve();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            const bool proved = memberResult.status == SolveStatus::Solved || memberResult.status == SolveStatus::NoSolution;
+            if (proved && winnerIndex < 0) {
+                winnerIndex = index;
+                winnerResult = memberResult;
+                winnerGrid = grid;
+                raceToken.cancel();
+            }
+            budgetExhausted |= memberResult.status == SolveStatus::BudgetExhausted;
+            memoryExhausted |= memberResult.status == SolveStatus::MemoryExhausted;
+            finishedCount += 1;
+            memberFinished.notify_all();
+        }));
+    }
+    {
+        // the members only see the race token, so the caller's is forwarded from here
+        std::unique_lock<std::mutex> lock(mutex);
+        while (finishedCount < (int)members.size()) {
+            memberFinished.wait_for(lock, std::chrono::milliseconds(kPortfolioPollMilliseconds));
+            if (_limits.cancellationToken != nullptr && _limits.cancellationToken->isCancelled()) {
+                raceToken.cancel();
+            }
+        }
+    }
+    for (auto thread = threads.begin(); thread != threads.end(); ++thread) {
+        thread->join();
+    }
+
+    if (winnerIndex < 0) {
+        _report("*** Stopped during portfolio ***");
+        SolveResult result;
+        const bool callerCancelled = _limits.cancellationToken != nullptr && _limits.cancellationToken->isCancelled();
+        if (callerCancelled) {
+            result.status = SolveStatus::Cancelled;
+        } else if (budgetExhausted) {
+            result.status = SolveStatus::BudgetExhausted;
+        } else {
+            result.status = memoryExhausted ? SolveStatus::MemoryExhausted : SolveStatus::Cancelled;
+        }
+        return result;
+    }
+    _grid = winnerGrid;
+    winnerResult.portfolioWinner = members[winnerIndex].name;
+    _report("*** Answered by portfolio member " + winnerResult.portfolioWinner + " ***");
+    return winnerResult;
+}
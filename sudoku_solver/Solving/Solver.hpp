@@ -7,13 +7,94 @@
 #ifndef Solver_hpp
 #define Solver_hpp
 
+#include <string>
+#include <vector>
+
+#include "DepthFirstSearchSolver.hpp"
+#include "EngineCostModel.hpp"
 #include "Grid.hpp"
+#include "SatSolver.hpp"
+#include "SolveMonitor.hpp"
+
+enum class SolveEngine {
+    Automatic,  // picks a strategy from the puzzle's features (see EngineCostModel)
+    Search,     // propagation, then DFS
+    Sat,
+    Portfolio   // races several engine configurations on their own threads (see setPortfolio)
+};
+
+struct PortfolioMember {
+    std::string name;
+    SolveEngine engine = SolveEngine::Search;
+    SearchOptions searchOptions;
+};
+
+typedef std::vector<PortfolioMember> PortfolioMemberVector;
+
+struct SolveResult {
+    SolveStatus status = SolveStatus::NoSolution;
+    bool usedSearch = false;
+    bool usedSat = false;
+    // partial when the solve was stopped early
+    SearchStatistics searchStatistics;
+    SatStatistics satStatistics;
+    long monitoredNodeCount = 0;
+    double elapsedSeconds = 0;
+    // the member that answered first; empty outside portfolio solves
+    std::string portfolioWinner;
+    // the strategy the Automatic engine picked; empty for the other engines
+    std::string strategy;
+    // the winner's alone for portfolio solves
+    MemoryStatistics memoryStatistics;
+    // DFS went over SolveLimits::maxMemoryBytes and backjumping took over; searchStatistics are then its own
+    bool usedMemoryFallback = false;
+};
+
+/**
+ Solves one grid in place with the chosen engine.
+
+ The Automatic engine extracts the puzzle's PuzzleFeatures and lets the cost model pick a strategy, which narrows
+ the caller's search options (techniques switched off stay off) or hands the grid to SAT.
+
+ The Portfolio engine copies the grid to one thread per member and solves all copies at once. The first member to
+ prove a result (solved or no solution) wins: its grid is copied back and the others are cancelled through a
+ CancellationToken that only the members share, which their monitors check on every node and propagation pass.
+ The caller's own token is forwarded to it, and every member gets the caller's deadline and node budget and an equal
+ share of the memory cap.
 
+ With a memory cap, a DFS that goes over it releases its grids and the solve continues with backjumping (grids up
+ to 64x64), which keeps a trail instead of a grid per level. SAT and backjumping itself have nothing smaller to
+ fall back to and end the solve as MemoryExhausted.
+ */
 class Solver {
     Grid& _grid;
+    SolveLimits _limits;
+    SearchOptions _searchOptions;
+    SolveEngine _engine;
+    PortfolioMemberVector _portfolio;
+    const EngineCostModel* _costModel;
+    bool _verbose;
+
+    void _report(const std::string& message) const;
+
+    SolveResult _solveWithSat(SolveMonitor& monitor);
+    bool _canFallBackOnMemory(SolveMonitor& monitor, const SearchOptions& searchOptions) const;
+    SolveResult _solveWithPortfolio();
+
 public:
     Solver(Grid&);
-    void solve();
+    Solver(Grid&, const SolveLimits limits);
+    void setSearchOptions(const SearchOptions options);
+    void setEngine(const SolveEngine engine);
+    // members for the Portfolio engine; defaultPortfolio when empty. Members must not share a lookaheadPool
+    void setPortfolio(const PortfolioMemberVector members);
+    // plain DFS, randomized DFS with Luby restarts, backjumping and SAT, all starting from the given options
+    static PortfolioMemberVector defaultPortfolio(const SearchOptions base);
+    // not owned; the Automatic engine uses EngineCostModel::builtIn when null
+    void setCostModel(const EngineCostModel* model);
+    // prints how the grid was solved (on by default); batch callers turn it off
+    void setVerbose(const bool verbose);
+    SolveResult solve();
 };
 
 #endif /* Solver_hpp */
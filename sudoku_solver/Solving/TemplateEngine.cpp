@@ -0,0 +1,193 @@
+//
+//  TemplateEngine.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "TemplateEngine.hpp"
+
+#include <memory>
+#include <mutex>
+
+static const int kSize = 9;
+static const int kCellCount = 81;
+
+static inline bool hasCell(const uint64_t low, const uint64_t high, const int cellIndex) {
+    return cellIndex < 64 ? (low >> cellIndex) & 1 : (high >> (cellIndex - 64)) & 1;
+}
+
+static inline void addCell(uint64_t& low, uint64_t& high, const int cellIndex) {
+    if (cellIndex < 64) {
+        low |= ((uint64_t)1) << cellIndex;
+    } else {
+        high |= ((uint64_t)1) << (cellIndex - 64);
+    }
+}
+
+TemplateEngine::TemplateEngine() {
+    _survivors.resize(kSize);
+}
+
+bool TemplateEngine::supportsSize(const int size) {
+    return size == kSize;
+}
+
+int TemplateEngine::templateCount() {
+    return (int)_table().low.size();
+}
+
+#pragma mark - Table
+
+// one row at a time: a column not used yet, in a subgrid of the current band not used yet
+static void addTemplates(const int row, const int usedColumns, const int usedSubgrids, const uint64_t low, const uint64_t high, std::vector<uint64_t>& lows, std::vector<uint64_t>& highs) {
+    if (row == kSize) {
+        lows.push_back(low);
+        highs.push_back(high);
+        return;
+    }
+    const int bandSubgrids = row % 3 == 0 ? 0 : usedSubgrids;
+    for (int column = 0; column < kSize; column++) {
+        const int subgrid = column / 3;
+        if ((usedColumns >> column) & 1 || (bandSubgrids >> subgrid) & 1) {
+            continue;
+        }
+        uint64_t nextLow = low;
+        uint64_t nextHigh = high;
+        addCell(nextLow, nextHigh, row * kSize + column);
+        addTemplates(row + 1, usedColumns | (1 << column), bandSubgrids | (1 << subgrid), nextLow, nextHigh, lows, highs);
+    }
+}
+
+const TemplateEngine::TemplateTable& TemplateEngine::_table() {
+    static std::unique_ptr<TemplateTable> table;
+    static std::once_flag flag;
+    std::call_once(flag, []() {
+        table.reset(new TemplateTable());
+        table->low.reserve(46656);
+        table->high.reserve(46656);
+        addTemplates(0, 0, 0, 0, 0, table->low, table->high);
+    });
+    return *table;
+}
+
+#pragma mark - Filtering
+
+void TemplateEngine::_filterDigit(const uint64_t requiredLow, const uint64_t requiredHigh, const uint64_t allowedLow, const uint64_t allowedHigh, IntVector& survivors) {
+    const TemplateTable& table = _table();
+    const int count = (int)table.low.size();
+    const uint64_t* low = table.low.data();
+    const uint64_t* high = table.high.data();
+    const uint64_t forbiddenLow = ~allowedLow;
+    const uint64_t forbiddenHigh = ~allowedHigh;
+
+    // no branches in this loop so it vectorizes
+    _keep.resize(count);
+    uint8_t* keep = _keep.data();
+    for (int index = 0; index < count; index++) {
+        const uint64_t missing = (~low[index] & requiredLow) | (~high[index] & requiredHigh);
+        const uint64_t outside = (low[index] & forbiddenLow) | (high[index] & forbiddenHigh);
+        keep[index] = (missing | outside) == 0;
+    }
+
+    survivors.clear();
+    for (int index = 0; index < count; index++) {
+        if (keep[index]) {
+            survivors.push_back(index);
+        }
+    }
+}
+
+bool TemplateEngine::_filterPair(IntVector& survivors, const IntVector& others) {
+    if (survivors.empty() || (long)survivors.size() * (long)others.size() > kMaxPairWork) {
+        return false;
+    }
+    const TemplateTable& table = _table();
+    const size_t initialCount = survivors.size();
+    size_t keptCount = 0;
+    for (size_t i = 0; i < survivors.size(); i++) {
+        const uint64_t low = table.low[survivors[i]];
+        const uint64_t high = table.high[survivors[i]];
+        bool compatible = false;
+        for (size_t j = 0; j < others.size() && !compatible; j++) {
+            compatible = ((low & table.low[others[j]]) | (high & table.high[others[j]])) == 0;
+        }
+        if (compatible) {
+            survivors[keptCount++] = survivors[i];
+        }
+    }
+    survivors.resize(keptCount);
+    return keptCount < initialCount;
+}
+
+bool TemplateEngine::findEliminations(const Grid& grid, EliminationVector& eliminations) {
+    if (grid.getSize() != kSize) {
+        return false;
+    }
+
+    uint64_t requiredLow[kSize] = {0}, requiredHigh[kSize] = {0};
+    uint64_t allowedLow[kSize] = {0}, allowedHigh[kSize] = {0};
+    CandidateMaskVector candidates(kCellCount, 0);
+    for (int cellIndex = 0; cellIndex < kCellCount; cellIndex++) {
+        const Cell& cell = grid.cellAtIndex(cellIndex);
+        const int value = cell.getValue();
+        if (value >= 1 && value <= kSize) {
+            addCell(requiredLow[value - 1], requiredHigh[value - 1], cellIndex);
+            addCell(allowedLow[value - 1], allowedHigh[value - 1], cellIndex);
+            continue;
+        }
+        const IntSet& cellCandidates = cell.getCandidates();
+        for (auto candidate = cellCandidates.begin(); candidate != cellCandidates.end(); ++candidate) {
+            if (*candidate >= 1 && *candidate <= kSize) {
+                candidates[cellIndex] |= bitForValue(*candidate);
+                addCell(allowedLow[*candidate - 1], allowedHigh[*candidate - 1], cellIndex);
+            }
+        }
+    }
+
+    for (int digit = 0; digit < kSize; digit++) {
+        _filterDigit(requiredLow[digit], requiredHigh[digit], allowedLow[digit], allowedHigh[digit], _survivors[digit]);
+    }
+    bool anyRemoved = true;
+    while (anyRemoved) {
+        anyRemoved = false;
+        for (int digit = 0; digit < kSize; digit++) {
+            for (int other = 0; other < kSize; other++) {
+                if (other != digit && _filterPair(_survivors[digit], _survivors[other])) {
+                    anyRemoved = true;
+                }
+            }
+        }
+    }
+
+    const TemplateTable& table = _table();
+    uint64_t unionLow[kSize], unionHigh[kSize], intersectionLow[kSize], intersectionHigh[kSize];
+    for (int digit = 0; digit < kSize; digit++) {
+        unionLow[digit] = unionHigh[digit] = 0;
+        intersectionLow[digit] = intersectionHigh[digit] = _survivors[digit].empty() ? 0 : ~(uint64_t)0;
+        for (auto index = _survivors[digit].begin(); index != _survivors[digit].end(); ++index) {
+            unionLow[digit] |= table.low[*index];
+            unionHigh[digit] |= table.high[*index];
+            intersectionLow[digit] &= table.low[*index];
+            intersectionHigh[digit] &= table.high[*index];
+        }
+    }
+
+    const size_t initialCount = eliminations.size();
+    for (int cellIndex = 0; cellIndex < kCellCount; cellIndex++) {
+        CandidateMask removed = 0;
+        for (CandidateMask rest = candidates[cellIndex]; rest != 0; rest &= rest - 1) {
+            const CandidateMask bit = rest & (~rest + 1);
+            const int digit = valueForBit(bit) - 1;
+            if (!hasCell(unionLow[digit], unionHigh[digit], cellIndex)) {
+                removed |= bit;
+            } else if (hasCell(intersectionLow[digit], intersectionHigh[digit], cellIndex)) {
+                removed |= candidates[cellIndex] & ~bit;
+            }
+        }
+        if (removed) {
+            eliminations.push_back(Elimination{cellIndex, removed});
+        }
+    }
+    return eliminations.size() > initialCount;
+}
@@ -0,0 +1,56 @@
+//
+//  TemplateEngine.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef TemplateEngine_hpp
+#define TemplateEngine_hpp
+
+#include <cstdint>
+#include <vector>
+
+#include "BitmaskTechniques.hpp"
+#include "Grid.hpp"
+
+/**
+ Pattern overlay method for 9x9 grids. A template is one complete placement of a single digit (one cell per row,
+ column and subgrid); there are 46,656 of them, kept as 81-bit cell sets split over two parallel word arrays and
+ built once on first use.
+
+ For each digit, the templates that cover every cell holding it and stay inside the cells where it is still a
+ candidate survive. The union of a digit's survivors is its real candidate set and their intersection is where it
+ must go. Survivors are then checked against each other digit's survivors: a template that overlaps every template
+ of another digit can't be part of a solution. Both steps repeat until nothing more goes.
+
+ The single digit filter is a branch-free pass over the word arrays, which the compiler vectorizes; the pair step
+ is quadratic in the survivor counts and is skipped for pairs above kMaxPairWork.
+ */
+class TemplateEngine {
+    static const int kMaxPairWork = 1 << 22;
+
+    struct TemplateTable {
+        std::vector<uint64_t> low;      // cells 0 to 63
+        std::vector<uint64_t> high;     // cells 64 to 80
+    };
+
+    static const TemplateTable& _table();
+
+    std::vector<IntVector> _survivors;  // by value - 1: indices into the table
+    std::vector<uint8_t> _keep;
+
+    void _filterDigit(const uint64_t requiredLow, const uint64_t requiredHigh, const uint64_t allowedLow, const uint64_t allowedHigh, IntVector& survivors);
+    bool _filterPair(IntVector& survivors, const IntVector& others);
+
+public:
+    TemplateEngine();
+
+    static bool supportsSize(const int size);
+    static int templateCount();
+
+    // a digit left without templates loses all its candidates, so a grid with no solution ends up with an empty cell
+    bool findEliminations(const Grid& grid, EliminationVector& eliminations);
+};
+
+#endif /* TemplateEngine_hpp */
@@ -0,0 +1,48 @@
+//
+//  TranspositionTable.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "TranspositionTable.hpp"
+
+TranspositionTable::TranspositionTable(const int log2EntryCount) {
+    const size_t entryCount = ((size_t)1) << log2EntryCount;
+    _entries.reset(new Entry[entryCount]);
+    _mask = entryCount - 1;
+    clear();
+}
+
+bool TranspositionTable::lookup(const uint64_t hash, long& solutionCount) const {
+    const Entry& entry = _entries[hash & _mask];
+    const uint64_t data = entry.data.load(std::memory_order_relaxed);
+    const uint64_t check = entry.check.load(std::memory_order_relaxed);
+    if (data == 0 || (check ^ data) != hash) {
+        return false;
+    }
+    solutionCount = (long)(data - 1);
+    return true;
+}
+
+void TranspositionTable::store(const uint64_t hash, const long solutionCount) {
+    Entry& entry = _entries[hash & _mask];
+    const uint64_t data = (uint64_t)solutionCount + 1;
+    entry.check.store(hash ^ data, std::memory_order_relaxed);
+    entry.data.store(data, std::memory_order_relaxed);
+}
+
+void TranspositionTable::clear() {
+    for (size_t i = 0; i <= _mask; i++) {
+        _entries[i].check.store(0, std::memory_order_relaxed);
+        _entries[i].data.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t TranspositionTable::getEntryCount() const {
+    return _mask + 1;
+}
+
+size_t TranspositionTable::getMemoryFootprint() const {
+    return getEntryCount() * sizeof(Entry);
+}
@@ -0,0 +1,45 @@
+//
+//  TranspositionTable.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef TranspositionTable_hpp
+#define TranspositionTable_hpp
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ Fixed-size cache from search state hashes (Grid::getHash) to the number of solutions below that state; 0 marks a
+ dead state. Safe to share between threads without locks.
+
+ Each slot holds the hash XORed with the data next to the data itself. A read that races with a write of the same
+ slot sees a mismatching pair and is treated as a miss, so torn entries are never returned. New entries always
+ replace old ones.
+ */
+class TranspositionTable {
+    struct Entry {
+        std::atomic<uint64_t> check;
+        std::atomic<uint64_t> data;     // solution count + 1, 0 when empty
+    };
+
+    std::unique_ptr<Entry[]> _entries;
+    size_t _mask;
+
+public:
+    // 2^log2EntryCount slots of 16 bytes
+    TranspositionTable(const int log2EntryCount);
+
+    bool lookup(const uint64_t hash, long& solutionCount) const;
+    void store(const uint64_t hash, const long solutionCount);
+    void clear();
+
+    size_t getEntryCount() const;
+    size_t getMemoryFootprint() const;
+};
+
+#endif /* TranspositionTable_hpp */
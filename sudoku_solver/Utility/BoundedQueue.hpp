@@ -0,0 +1,136 @@
+//
+//  BoundedQueue.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef BoundedQueue_hpp
+#define BoundedQueue_hpp
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+
+/**
+ Fixed capacity multi-producer multi-consumer queue (the sequence numbered ring of D. Vyukov): every slot carries
+ a sequence number that tells producers and consumers whether it is free for the current lap, so tryPush and tryPop
+ only need one compare-and-swap on the head or tail and never take a lock.
+
+ push and pop wait (spinning briefly, then yielding and sleeping) while the queue is full or empty, which is what
+ gives a pipeline its backpressure. Once close has been called and the queue has drained, pop returns false; close
+ must only be called after the last push.
+ */
+template <typename T>
+class BoundedQueue {
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> _slots;
+    size_t _mask;
+    alignas(64) std::atomic<size_t> _head;
+    alignas(64) std::atomic<size_t> _tail;
+    std::atomic<bool> _closed;
+
+    static void _backOff(const int attempt) {
+        if (attempt < 64) {
+            return;
+        }
+        if (attempt < 256) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+public:
+    // capacity is rounded up to a power of two
+    BoundedQueue(const size_t capacity) : _head(0), _tail(0), _closed(false) {
+        size_t slotCount = 2;
+        while (slotCount < capacity) {
+            slotCount *= 2;
+        }
+        _slots.reset(new Slot[slotCount]);
+        _mask = slotCount - 1;
+        for (size_t index = 0; index < slotCount; index++) {
+            _slots[index].sequence.store(index, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    size_t capacity() const {
+        return _mask + 1;
+    }
+
+    bool tryPush(T& value) {
+        size_t position = _head.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = _slots[position & _mask];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const long difference = (long)sequence - (long)position;
+            if (difference == 0) {
+                if (_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;   // full
+            } else {
+                position = _head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T& value) {
+        size_t position = _tail.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = _slots[position & _mask];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const long difference = (long)sequence - (long)(position + 1);
+            if (difference == 0) {
+                if (_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    value = std::move(slot.value);
+                    slot.sequence.store(position + _mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;   // empty
+            } else {
+                position = _tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void push(T value) {
+        for (int attempt = 0; !tryPush(value); attempt++) {
+            _backOff(attempt);
+        }
+    }
+
+    bool pop(T& value) {
+        for (int attempt = 0; ; attempt++) {
+            if (tryPop(value)) {
+                return true;
+            }
+            // everything pushed before close is visible once closed reads true
+            if (_closed.load(std::memory_order_acquire)) {
+                return tryPop(value);
+            }
+            _backOff(attempt);
+        }
+    }
+
+    void close() {
+        _closed.store(true, std::memory_order_release);
+    }
+};
+
+#endif /* BoundedQueue_hpp */
@@ -0,0 +1,79 @@
+//
+//  ScratchArena.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "ScratchArena.hpp"
+
+#include <algorithm>
+
+ScratchArena::ScratchArena() : _blockIndex(0), _offset(0), _bytesInUse(0), _highWater(0), _blockAllocationCount(0) {}
+
+void ScratchArena::_addBlock(const size_t minimumSize) {
+    Block block;
+    block.size = std::max(kDefaultBlockSize, minimumSize);
+    block.memory.reset(new char[block.size]);
+    _blocks.push_back(std::move(block));
+    _blockAllocationCount += 1;
+}
+
+void* ScratchArena::allocate(const size_t bytes, const size_t alignment) {
+    while (true) {
+        if (_blockIndex < _blocks.size()) {
+            Block& block = _blocks[_blockIndex];
+            const size_t start = (_offset + alignment - 1) & ~(alignment - 1);
+            if (start + bytes <= block.size) {
+                _bytesInUse += start + bytes - _offset;
+                _offset = start + bytes;
+                _highWater = std::max(_highWater, _bytesInUse);
+                return block.memory.get() + start;
+            }
+            // the rest of this block stays unused until the arena is rewound past it
+            _bytesInUse += block.size - _offset;
+            _blockIndex += 1;
+            _offset = 0;
+            continue;
+        }
+        _addBlock(bytes + alignment);
+    }
+}
+
+ScratchArena::Marker ScratchArena::mark() const {
+    return Marker{_blockIndex, _offset, _bytesInUse};
+}
+
+void ScratchArena::rewind(const Marker& marker) {
+    _blockIndex = marker.blockIndex;
+    _offset = marker.offset;
+    _bytesInUse = marker.bytesInUse;
+    // back at the start after spilling over: one block that holds everything from now on
+    if (_bytesInUse == 0 && _blocks.size() > 1) {
+        _blocks.clear();
+        _addBlock(_highWater);
+        _blockIndex = 0;
+        _offset = 0;
+    }
+}
+
+size_t ScratchArena::getCapacity() const {
+    size_t capacity = 0;
+    for (auto block = _blocks.begin(); block != _blocks.end(); ++block) {
+        capacity += block->size;
+    }
+    return capacity;
+}
+
+size_t ScratchArena::getHighWater() const {
+    return _highWater;
+}
+
+long ScratchArena::getBlockAllocationCount() const {
+    return _blockAllocationCount;
+}
+
+ScratchArena& ScratchArena::forCurrentThread() {
+    static thread_local ScratchArena arena;
+    return arena;
+}
@@ -0,0 +1,118 @@
+//
+//  ScratchArena.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef ScratchArena_hpp
+#define ScratchArena_hpp
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+/**
+ Bump allocator for the temporaries of one solve: allocating is a pointer increment and freeing does nothing, the
+ memory comes back when a ScratchScope ends and rewinds the arena to where it started.
+
+ Memory is taken from the heap in blocks that are kept for reuse. When a solve needed more than one block, the
+ next rewind to the start replaces them with a single block of the high-water size, so a worker that solves
+ puzzle after puzzle stops touching the heap once it has seen its largest one.
+
+ Not thread safe: every thread uses its own arena (forCurrentThread), which also keeps parallel solves from
+ contending for the heap allocator.
+ */
+class ScratchArena {
+    struct Block {
+        std::unique_ptr<char[]> memory;
+        size_t size;
+    };
+
+    std::vector<Block> _blocks;
+    size_t _blockIndex;
+    size_t _offset;
+    size_t _bytesInUse;
+    size_t _highWater;
+    long _blockAllocationCount;
+
+    void _addBlock(const size_t minimumSize);
+
+public:
+    struct Marker {
+        size_t blockIndex;
+        size_t offset;
+        size_t bytesInUse;
+    };
+
+    static const size_t kDefaultBlockSize = 64 * 1024;
+
+    ScratchArena();
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    void* allocate(const size_t bytes, const size_t alignment);
+
+    Marker mark() const;
+    void rewind(const Marker& marker);
+
+    size_t getCapacity() const;
+    size_t getHighWater() const;
+    // heap blocks taken so far; stays put once the arena has reached its steady state
+    long getBlockAllocationCount() const;
+
+    static ScratchArena& forCurrentThread();
+};
+
+// rewinds the arena when it goes out of scope; declare it before the containers it should reclaim
+class ScratchScope {
+    ScratchArena& _arena;
+    const ScratchArena::Marker _marker;
+
+public:
+    ScratchScope(ScratchArena& arena) : _arena(arena), _marker(arena.mark()) {}
+    ScratchScope() : ScratchScope(ScratchArena::forCurrentThread()) {}
+    ~ScratchScope() {
+        _arena.rewind(_marker);
+    }
+
+    ScratchScope(const ScratchScope&) = delete;
+    ScratchScope& operator=(const ScratchScope&) = delete;
+};
+
+// standard allocator on top of an arena, the calling thread's unless given one; deallocate is a no-op
+template <typename T>
+class ArenaAllocator {
+    template <typename U> friend class ArenaAllocator;
+    ScratchArena* _arena;
+
+public:
+    typedef T value_type;
+
+    ArenaAllocator() : _arena(&ScratchArena::forCurrentThread()) {}
+    ArenaAllocator(ScratchArena& arena) : _arena(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : _arena(other._arena) {}
+
+    T* allocate(const size_t count) {
+        return static_cast<T*>(_arena->allocate(count * sizeof(T), alignof(T)));
+    }
+    void deallocate(T*, const size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const {
+        return _arena == other._arena;
+    }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const {
+        return _arena != other._arena;
+    }
+};
+
+// scratch versions of the model's containers; same hashing, so they iterate in the same order as their heap twins
+typedef std::unordered_set<int, std::hash<int>, std::equal_to<int>, ArenaAllocator<int>> ScratchIntSet;
+typedef std::vector<int, ArenaAllocator<int>> ScratchIntVector;
+
+#endif /* ScratchArena_hpp */
@@ -0,0 +1,92 @@
+//
+//  ThreadPool.cpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#include "ThreadPool.hpp"
+
+#include <atomic>
+
+ThreadPool::ThreadPool(const int threadCount) : _generation(0), _busyWorkers(0), _stopping(false) {
+    const int count = threadCount > 0 ? threadCount : defaultThreadCount();
+    for (int workerIndex = 0; workerIndex < count; workerIndex++) {
+        _threads.push_back(std::thread(&ThreadPool::_workerLoop, this, workerIndex));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _jobAvailable.notify_all();
+    for (auto thread = _threads.begin(); thread != _threads.end(); ++thread) {
+        thread->join();
+    }
+}
+
+int ThreadPool::getThreadCount() const {
+    return (int)_threads.size();
+}
+
+int ThreadPool::defaultThreadCount() {
+    const int hardwareCount = (int)std::thread::hardware_concurrency();
+    return hardwareCount > 0 ? hardwareCount : 1;
+}
+
+void ThreadPool::_workerLoop(const int workerIndex) {
+    unsigned long seenGeneration = 0;
+    while (true) {
+        WorkerJob job;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _jobAvailable.wait(lock, [&] { return _stopping || _generation != seenGeneration; });
+            if (_stopping) {
+                return;
+            }
+            seenGeneration = _generation;
+            job = _job;
+        }
+
+        job(workerIndex);
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _busyWorkers -= 1;
+        }
+        _jobFinished.notify_all();
+    }
+}
+
+#pragma mark - Running jobs
+
+void ThreadPool::runOnEachWorker(const WorkerJob& job) {
+    // only one batch can be in flight at a time; concurrent callers queue up here
+    std::lock_guard<std::mutex> runLock(_runMutex);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _job = job;
+    _busyWorkers = (int)_threads.size();
+    _generation += 1;
+    _jobAvailable.notify_all();
+    _jobFinished.wait(lock, [&] { return _busyWorkers == 0; });
+    _job = WorkerJob();
+}
+
+void ThreadPool::parallelFor(const int count, const ItemJob& job) {
+    if (count <= 0) {
+        return;
+    }
+    std::atomic<int> nextItemIndex(0);
+    runOnEachWorker([&](const int workerIndex) {
+        while (true) {
+            const int itemIndex = nextItemIndex.fetch_add(1);
+            if (itemIndex >= count) {
+                break;
+            }
+            job(workerIndex, itemIndex);
+        }
+    });
+}
@@ -0,0 +1,58 @@
+//
+//  ThreadPool.hpp
+//  sudoku_solver
+//
+//  Copyright © 2019 Kevin Broom. All rights reserved.
+//
+
+#ifndef ThreadPool_hpp
+#define ThreadPool_hpp
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::function<void(const int workerIndex)> WorkerJob;
+typedef std::function<void(const int workerIndex, const int itemIndex)> ItemJob;
+
+/**
+ Fixed set of worker threads that are started once and reused for every batch.
+
+ Jobs are handed out one batch at a time: runOnEachWorker runs the job once on every worker and
+ parallelFor splits [0, count) across the workers. Both block until the whole batch has finished.
+ The worker index passed to a job is stable, so callers can keep per-worker state (RNG, scratch grids)
+ in a vector indexed by it.
+ */
+class ThreadPool {
+    std::vector<std::thread> _threads;
+
+    std::mutex _runMutex;
+    std::mutex _mutex;
+    std::condition_variable _jobAvailable;
+    std::condition_variable _jobFinished;
+
+    WorkerJob _job;
+    unsigned long _generation;
+    int _busyWorkers;
+    bool _stopping;
+
+    void _workerLoop(const int workerIndex);
+
+public:
+    ThreadPool(const int threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int getThreadCount() const;
+
+    void runOnEachWorker(const WorkerJob& job);
+    void parallelFor(const int count, const ItemJob& job);
+
+    static int defaultThreadCount();
+};
+
+#endif /* ThreadPool_hpp */
@@ -4,21 +4,236 @@
 //  Copyright © 2019 Kevin Broom. All rights reserved.
 //
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <vector>
 
+#include "ConstraintSolver.hpp"
+#include "DaemonClient.hpp"
+#include "DifficultyGrader.hpp"
 #include "Grid.hpp"
+#include "LaneSolver.hpp"
+#include "PuzzleGenerator.hpp"
+#include "SharedMemoryServer.hpp"
+#include "ShardedBatch.hpp"
+#include "SolutionEnumerator.hpp"
+#include "SolveDaemon.hpp"
+#include "SolvePipeline.hpp"
 #include "Solver.hpp"
+#include "ThreadPool.hpp"
 
-int main(int argc, const char * argv[]) {
-    Grid grid = Grid("hard2.txt");
+static std::string statusName(const SolveStatus status) {
+    switch (status) {
+        case SolveStatus::Solved:
+            return "solved";
+        case SolveStatus::NoSolution:
+            return "no solution";
+        case SolveStatus::BudgetExhausted:
+            return "budget exhausted";
+        case SolveStatus::Cancelled:
+            return "cancelled";
+        case SolveStatus::MemoryExhausted:
+            return "memory exhausted";
+    }
+    return "";
+}
+
+static std::string megabytes(const size_t bytes) {
+    std::ostringstream text;
+    text.setf(std::ios::fixed);
+    text.precision(1);
+    text << bytes / (1024.0 * 1024.0) << " MB";
+    return text.str();
+}
+
+/**
+ [file] [--timeout seconds] [--max-nodes n] [--max-memory MB] [--progress] [--seed n] [--restarts none|luby|geometric]
+        [--restart-growth factor] [--branching mrv|degree|unit] [--values natural|lcv]
+        [--engine auto|dfs|sat|portfolio] [--backjump] [--nogoods size] [--tt log2-entries] [--lookahead]
+        [--probe-threads n] [--assume-unique] [--without technique,...] [--portfolio member,...] [--model file]
+
+ Solves one grid file (hard2.txt by default) and prints it before and after. --assume-unique also enables the
+ techniques that rely on a unique solution; --without switches techniques off by their grade names. --portfolio
+ races the named members of Solver::defaultPortfolio (dfs, dfs-luby, backjump, sat), which are built from the
+ other search options, and prints which one answered first. The automatic engine picks its strategy with
+ EngineCostModel::builtIn, or with the model --model reads (written by "sudoku_bench calibrate"). --max-memory caps
+ the memory the solve accounts for; the peak is printed with the statistics either way. --restart-growth sets the
+ geometric schedule's factor, which has to be above 1. --assume-unique, --without, --seed, --restarts,
+ --restart-growth, --branching, --values, --backjump, --nogoods, --tt, --lookahead and --probe-threads only apply to
+ the dfs engine (and the portfolio members built from it), so without --engine or --portfolio they select dfs; with
+ --engine sat they are ignored, with a warning.
+ */
+static int runSolve(const int argc, const char * argv[]) {
+    std::string filename = "hard2.txt";
+    SolveLimits limits;
+    SearchOptions searchOptions;
+    SolveEngine engine = SolveEngine::Automatic;
+    bool engineChosen = false;
+    bool searchOptionGiven = false;
+    std::unique_ptr<TranspositionTable> table;
+    std::unique_ptr<ThreadPool> probePool;
+    std::vector<std::string> portfolioNames;
+    std::unique_ptr<EngineCostModel> costModel;
+    for (int i = 0; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (argument == "--tt" && i + 1 < argc) {
+            searchOptionGiven = true;
+            table.reset(new TranspositionTable(atoi(argv[++i])));
+            searchOptions.transpositionTable = table.get();
+        } else if (argument == "--assume-unique") {
+            searchOptionGiven = true;
+            searchOptions.techniques |= techniqueBit(Technique::UniqueRectangle) | techniqueBit(Technique::BugPlusOne);
+        } else if (argument == "--without" && i + 1 < argc) {
+            searchOptionGiven = true;
+            std::stringstream names(argv[++i]);
+            std::string name;
+            while (getline(names, name, ',')) {
+                Technique technique;
+                if (!DifficultyGrader::techniqueFromName(name, technique)) {
+                    std::cerr << "unknown technique: " << name << std::endl;
+                    return 1;
+                }
+                searchOptions.techniques &= ~techniqueBit(technique);
+            }
+        } else if (argument == "--lookahead") {
+            searchOptionGiven = true;
+            searchOptions.lookahead = true;
+        } else if (argument == "--probe-threads" && i + 1 < argc) {
+            searchOptionGiven = true;
+            searchOptions.lookahead = true;
+            probePool.reset(new ThreadPool(atoi(argv[++i])));
+            searchOptions.lookaheadPool = probePool.get();
+        } else if (argument == "--engine" && i + 1 < argc) {
+            engineChosen = true;
+            const std::string name = argv[++i];
+            if (name == "dfs") {
+                engine = SolveEngine::Search;
+            } else if (name == "sat") {
+                engine = SolveEngine::Sat;
+            } else if (name == "portfolio") {
+                engine = SolveEngine::Portfolio;
+            } else {
+                engine = SolveEngine::Automatic;
+            }
+        } else if (argument == "--seed" && i + 1 < argc) {
+            searchOptionGiven = true;
+            searchOptions.randomize = true;
+            searchOptions.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (argument == "--restarts" && i + 1 < argc) {
+            searchOptionGiven = true;
+            const std::string schedule = argv[++i];
+            if (!DepthFirstSearchSolver::restartScheduleFromName(schedule, searchOptions.restartSchedule)) {
+                std::cerr << "unknown restart schedule: " << schedule << " (expected none, luby or geometric)" << std::endl;
+                return 1;
+            }
+            searchOptions.randomize = searchOptions.restartSchedule != RestartSchedule::None;
+        } else if (argument == "--restart-growth" && i + 1 < argc) {
+            searchOptionGiven = true;
+            searchOptions.restartGrowthFactor = atof(argv[++i]);
+        } else if (argument == "--branching" && i + 1 < argc) {
+            searchOptionGiven = true;
+            const std::string branching = argv[++i];
+            if (branching == "mrv") {
+                searchOptions.branching = BranchingStrategy::MinimumRemainingValues;
+            } else if (branching == "degree") {
+                searchOptions.branching = BranchingStrategy::DegreeTieBreak;
+            } else {
+                searchOptions.branching = BranchingStrategy::CellOrUnit;
+            }
+        } else if (argument == "--values" && i + 1 < argc) {
+            searchOptionGiven = true;
+            const std::string ordering = argv[++i];
+            searchOptions.valueOrdering = ordering == "natural" ? ValueOrdering::Natural : ValueOrdering::LeastConstraining;
+        } else if (argument == "--portfolio" && i + 1 < argc) {
+            engine = SolveEngine::Portfolio;
+            engineChosen = true;
+            std::stringstream names(argv[++i]);
+            std::string name;
+            while (getline(names, name, ',')) {
+                portfolioNames.push_back(name);
+            }
+        } else if (argument == "--model" && i + 1 < argc) {
+            std::string error;
+            costModel.reset(new EngineCostModel());
+            if (!EngineCostModel::read(argv[++i], *costModel, error)) {
+                std::cerr << error << std::endl;
+                return 1;
+            }
+        } else if (argument == "--backjump") {
+            searchOptionGiven = true;
+            searchOptions.conflictDirectedBackjumping = true;
+        } else if (argument == "--nogoods" && i + 1 < argc) {
+            searchOptionGiven = true;
+            searchOptions.conflictDirectedBackjumping = true;
+            searchOptions.maxNogoodSize = atoi(argv[++i]);
+        } else if (argument == "--timeout" && i + 1 < argc) {
+            limits.setTimeout(atof(argv[++i]));
+        } else if (argument == "--max-nodes" && i + 1 < argc) {
+            limits.maxNodes = atol(argv[++i]);
+        } else if (argument == "--max-memory" && i + 1 < argc) {
+            limits.maxMemoryBytes = (size_t)(atof(argv[++i]) * 1024 * 1024);
+        } else if (argument == "--progress") {
+            limits.progressCallback = [](const SolveProgress& progress) {
+                std::cerr << "nodes: " << progress.nodeCount << " (" << (long)progress.nodesPerSecond << "/s), depth: " << progress.depth << std::endl;
+            };
+        } else {
+            filename = argument;
+        }
+    }
+
+    std::string restartError;
+    if (!DepthFirstSearchSolver::checkRestartOptions(searchOptions, restartError)) {
+        std::cerr << restartError << std::endl;
+        return 1;
+    }
+
+    // the automatic engine may pick SAT, which would quietly ignore them
+    if (searchOptionGiven && !engineChosen) {
+        engine = SolveEngine::Search;
+    } else if (searchOptionGiven && engine == SolveEngine::Sat) {
+        std::cerr << "the sat engine ignores the technique and search options" << std::endl;
+    }
+
+    Grid grid = Grid(filename);
 
     std::cout << "INITIAL GRID" << std::endl << std::endl;
     std::cout << grid.prettyPrint(true) << std::endl;
 
     auto start = std::chrono::high_resolution_clock::now();
 
-    Solver(grid).solve();
+    // members are built from the final search options, so they come after the loop
+    PortfolioMemberVector portfolio;
+    const PortfolioMemberVector defaultPortfolio = Solver::defaultPortfolio(searchOptions);
+    for (auto name = portfolioNames.begin(); name != portfolioNames.end(); ++name) {
+        auto member = std::find_if(defaultPortfolio.begin(), defaultPortfolio.end(), [&](const PortfolioMember& candidate) {
+            return candidate.name == *name;
+        });
+        if (member == defaultPortfolio.end()) {
+            std::cerr << "unknown portfolio member: " << *name << std::endl;
+            return 1;
+        }
+        portfolio.push_back(*member);
+    }
+
+    Solver solver(grid, limits);
+    solver.setSearchOptions(searchOptions);
+    solver.setEngine(engine);
+    solver.setPortfolio(portfolio);
+    solver.setCostModel(costModel.get());
+    SolveResult result = solver.solve();
 
     auto finish = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> elapsed = finish - start;
@@ -26,7 +241,1105 @@ int main(int argc, const char * argv[]) {
     std::cout << "FINAL GRID" << std::endl << std::endl;
     std::cout << grid.prettyPrint(true) << std::endl;
 
+    std::cout << "Status: " << statusName(result.status) << std::endl;
+    if (!result.strategy.empty()) {
+        std::cout << "Strategy: " << result.strategy << std::endl;
+    }
+    if (!result.portfolioWinner.empty()) {
+        std::cout << "Portfolio winner: " << result.portfolioWinner << std::endl;
+    }
+    if (result.usedSearch) {
+        std::cout << "DFS nodes: " << result.searchStatistics.nodeCount << ", branches: " << result.searchStatistics.branchCount;
+        std::cout << ", max depth: " << result.searchStatistics.maxDepth << ", restarts: " << result.searchStatistics.restartCount << std::endl;
+        if (table) {
+            std::cout << "Transposition hits: " << result.searchStatistics.transpositionHitCount << std::endl;
+        }
+        if (searchOptions.lookahead) {
+            std::cout << "Probes: " << result.searchStatistics.probeCount << ", failed literals: " << result.searchStatistics.failedLiteralCount;
+            std::cout << ", forced eliminations: " << result.searchStatistics.forcedCount << std::endl;
+        }
+        if (searchOptions.conflictDirectedBackjumping) {
+            std::cout << "Backjumps: " << result.searchStatistics.backjumpCount << ", nogoods: " << result.searchStatistics.nogoodCount;
+            std::cout << " (" << result.searchStatistics.nogoodPruneCount << " prunes)" << std::endl;
+        }
+    }
+    if (result.usedSat) {
+        const SatStatistics& statistics = result.satStatistics;
+        std::cout << "SAT variables: " << statistics.variableCount << ", clauses: " << statistics.clauseCount;
+        std::cout << ", decisions: " << statistics.decisionCount << ", conflicts: " << statistics.conflictCount;
+        std::cout << ", learned: " << statistics.learnedClauseCount << ", restarts: " << statistics.restartCount << std::endl;
+    }
+    const MemoryStatistics& memory = result.memoryStatistics;
+    std::cout << "Peak memory: " << megabytes(memory.peakTotalBytes) << " (search state " << megabytes(memory.peakBytes[(int)MemoryCategory::SearchState]);
+    std::cout << ", propagation scratch " << megabytes(memory.peakBytes[(int)MemoryCategory::PropagationScratch]);
+    std::cout << ", topology tables " << megabytes(memory.peakBytes[(int)MemoryCategory::TopologyTables]) << ")";
+    if (limits.maxMemoryBytes > 0) {
+        std::cout << ", cap " << megabytes(limits.maxMemoryBytes);
+    }
+    std::cout << std::endl;
+    if (result.usedMemoryFallback) {
+        std::cout << "DFS went over the memory cap; backjumping finished the solve" << std::endl;
+    }
     std::cout << "Elapsed time: " << elapsed.count() << " s" <<std::endl;
 
+    return result.status == SolveStatus::Solved ? 0 : 2;
+}
+
+/**
+ count [file] [--limit n] [--tt log2-entries] [--timeout seconds]
+
+ Counts the solutions of one grid file (hard2.txt by default) up to limit (1000 by default) with propagation and DFS.
+ */
+static int runCount(const int argc, const char * argv[]) {
+    std::string filename = "hard2.txt";
+    long limit = 1000;
+    SolveLimits limits;
+    SearchOptions searchOptions;
+    std::unique_ptr<TranspositionTable> table;
+    for (int i = 0; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (argument == "--limit" && i + 1 < argc) {
+            limit = atol(argv[++i]);
+        } else if (argument == "--tt" && i + 1 < argc) {
+            table.reset(new TranspositionTable(atoi(argv[++i])));
+            searchOptions.transpositionTable = table.get();
+        } else if (argument == "--timeout" && i + 1 < argc) {
+            limits.setTimeout(atof(argv[++i]));
+        } else {
+            filename = argument;
+        }
+    }
+
+    Grid grid = Grid(filename);
+    SolveMonitor monitor(limits);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    ConstraintSolver(grid, &monitor).propagateContraints();
+    DepthFirstSearchSolver searchSolver(grid, &monitor, searchOptions);
+    const long count = searchSolver.countSolutions(limit);
+    auto finish = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = finish - start;
+
+    if (count < 0) {
+        std::cout << "Status: " << statusName(monitor.getStopStatus()) << std::endl;
+    } else {
+        std::cout << "Solutions: " << count << (count == limit ? " (limit reached)" : "") << std::endl;
+    }
+    const SearchStatistics& statistics = searchSolver.getStatistics();
+    std::cout << "DFS nodes: " << statistics.nodeCount << ", branches: " << statistics.branchCount;
+    std::cout << ", transposition hits: " << statistics.transpositionHitCount << std::endl;
+    std::cout << "Elapsed time: " << elapsed.count() << " s" << std::endl;
+
+    return count < 0 ? 2 : 0;
+}
+
+/**
+ enumerate [file] --output path [--threads n] [--checkpoint-seconds s] [--tasks-per-thread n]
+
+ Writes every solution of one grid file (hard2.txt by default) to path in SolutionEnumerator's binary format,
+ checkpointing as it goes; running the same command again after an interruption resumes where the checkpoint left off.
+ */
+static int runEnumerate(const int argc, const char * argv[]) {
+    std::string filename = "hard2.txt";
+    std::string outputPath = "";
+    int threadCount = 0;
+    EnumerationOptions options;
+    for (int i = 0; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (argument == "--output" && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (argument == "--threads" && i + 1 < argc) {
+            threadCount = atoi(argv[++i]);
+        } else if (argument == "--checkpoint-seconds" && i + 1 < argc) {
+            options.checkpointSeconds = atof(argv[++i]);
+        } else if (argument == "--tasks-per-thread" && i + 1 < argc) {
+            options.tasksPerThread = atoi(argv[++i]);
+        } else {
+            filename = argument;
+        }
+    }
+    if (outputPath.empty()) {
+        std::cerr << "enumerate needs an --output path" << std::endl;
+        return 1;
+    }
+
+    Grid grid = Grid(filename);
+    ThreadPool pool(threadCount);
+    SolutionEnumerator enumerator(pool, grid, options);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    const bool succeeded = enumerator.run(outputPath);
+    auto finish = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = finish - start;
+
+    if (!succeeded) {
+        std::cerr << enumerator.getLastError() << std::endl;
+        return 1;
+    }
+    const EnumerationStatistics& statistics = enumerator.getStatistics();
+    if (statistics.alreadyComplete) {
+        std::cout << "Already complete" << std::endl;
+    } else if (statistics.resumed) {
+        std::cout << "Resumed from " << SolutionEnumerator::checkpointPath(outputPath) << std::endl;
+    }
+    std::cout << "Solutions: " << statistics.solutionCount << std::endl;
+    std::cout << "Nodes: " << statistics.nodeCount << ", subtrees: " << statistics.taskCount;
+    std::cout << ", checkpoints: " << statistics.checkpointCount << std::endl;
+    std::cout << "Elapsed time: " << elapsed.count() << " s" << std::endl;
     return 0;
 }
+
+/**
+ enumerate-print file [--limit n]
+
+ Prints the solutions in an enumerate output file, one compactPrint line each.
+ */
+static int runEnumeratePrint(const int argc, const char * argv[]) {
+    std::string filename = "";
+    long limit = -1;
+    for (int i = 0; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (argument == "--limit" && i + 1 < argc) {
+            limit = atol(argv[++i]);
+        } else {
+            filename = argument;
+        }
+    }
+
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "unable to open " << filename << std::endl;
+        return 1;
+    }
+    SolutionCodec codec;
+    std::string error;
+    if (!codec.readHeader(file, error)) {
+        std::cerr << filename << ": " << error << std::endl;
+        return 1;
+    }
+    std::ios::sync_with_stdio(false);
+    std::string record(codec.getRecordBytes(), '\0');
+    for (long count = 0; count != limit && file.read(&record[0], record.size()); count++) {
+        std::cout << codec.decode(record.data()) << "\n";
+    }
+    std::cout.flush();
+    return 0;
+}
+
+/**
+ generate [--count n] [--size n] [--clues n] [--symmetry none|rotational|quarter|horizontal|vertical|diagonal]
+          [--attempts n] [--check-nodes n] [--threads n] [--seed n]
+
+ Writes one puzzle per line to stdout and the throughput to stderr.
+ */
+static int runGenerate(const int argc, const char * argv[]) {
+    GeneratorOptions options;
+    int count = 1;
+    int threadCount = 0;
+    for (int i = 0; i + 1 < argc; i += 2) {
+        const std::string flag = argv[i];
+        const std::string value = argv[i + 1];
+        if (flag == "--count") {
+            count = atoi(value.c_str());
+        } else if (flag == "--size") {
+            options.size = atoi(value.c_str());
+        } else if (flag == "--clues") {
+            options.targetClueCount = atoi(value.c_str());
+        } else if (flag == "--attempts") {
+            options.maxAttempts = atoi(value.c_str());
+        } else if (flag == "--check-nodes") {
+            options.checkNodeLimit = atol(value.c_str());
+        } else if (flag == "--threads") {
+            threadCount = atoi(value.c_str());
+        } else if (flag == "--seed") {
+            options.seed = strtoull(value.c_str(), nullptr, 10);
+        } else if (flag == "--symmetry") {
+            if (!PuzzleGenerator::symmetryTypeFromName(value, options.symmetry)) {
+                std::cerr << "unknown symmetry: " << value << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "unknown option: " << flag << std::endl;
+            return 1;
+        }
+    }
+    if (!BitmaskSolver::supportsSize(options.size)) {
+        std::cerr << "unsupported size: " << options.size << std::endl;
+        return 1;
+    }
+
+    ThreadPool pool(threadCount);
+    PuzzleGenerator generator(options);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    GeneratedPuzzleVector puzzles = generator.generate(count, pool);
+    auto finish = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = finish - start;
+
+    for (auto puzzle = puzzles.begin(); puzzle != puzzles.end(); ++puzzle) {
+        std::cout << puzzle->puzzleGrid().compactPrint() << "\n";
+    }
+    std::cout.flush();
+
+    std::cerr << "Generated " << count << " puzzles on " << pool.getThreadCount() << " threads in " << elapsed.count() << " s";
+    std::cerr << " (" << count / elapsed.count() << " puzzles/s)" << std::endl;
+
+    return 0;
+}
+
+/**
+ grade [file] [--threads n]
+
+ Reads one puzzle per line (generate's output format) from the file or stdin and writes, per puzzle:
+ puzzle, difficulty, hardest technique, step counts per technique, and DFS depth/branches when logic stalled. A line
+ that isn't a puzzle of a supported size is echoed with invalid in place of the difficulty.
+ */
+static int runGrade(const int argc, const char * argv[]) {
+    std::string filename = "";
+    int threadCount = 0;
+    for (int i = 0; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (argument == "--threads" && i + 1 < argc) {
+            threadCount = atoi(argv[++i]);
+        } else {
+            filename = argument;
+        }
+    }
+
+    std::ifstream file;
+    if (!filename.empty()) {
+        file.open(filename);
+        if (!file.is_open()) {
+            std::cerr << "unable to open file " << filename << std::endl;
+            return 1;
+        }
+    }
+    std::istream& input = filename.empty() ? std::cin : file;
+
+    GridVector grids;
+    // per input line, its grid or -1 when the line isn't a puzzle of a supported size
+    std::vector<std::string> lines;
+    IntVector gridIndices;
+    std::string line;
+    while (getline(input, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        lines.push_back(line);
+        if (Grid::compactStringSize(line) == 0) {
+            gridIndices.push_back(-1);
+        } else {
+            gridIndices.push_back((int)grids.size());
+            grids.push_back(Grid::fromCompactString(line));
+        }
+    }
+
+    ThreadPool pool(threadCount);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    GradeReportVector reports = DifficultyGrader::gradeAll(grids, pool);
+    auto finish = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = finish - start;
+
+    for (size_t lineIndex = 0; lineIndex < lines.size(); lineIndex++) {
+        if (gridIndices[lineIndex] < 0) {
+            std::cout << lines[lineIndex] << "\tinvalid\n";
+            continue;
+        }
+        const GradeReport& report = reports[gridIndices[lineIndex]];
+        std::cout << lines[lineIndex] << "\t" << DifficultyGrader::difficultyName(report.difficulty);
+        std::cout << "\t" << DifficultyGrader::techniqueName(report.hardestStep.technique);
+        if (report.hardestStep.technique == Technique::Chains) {
+            std::cout << report.hardestStep.chainSize;
+        }
+        std::cout << "\tsteps=";
+        for (int technique = 0; technique < kTechniqueCount; technique++) {
+            std::cout << (technique > 0 ? "/" : "") << report.stepCounts[technique];
+        }
+        if (!report.solvedWithLogic) {
+            std::cout << "\tdfs-depth=" << report.searchStatistics.maxDepth;
+            std::cout << "\tdfs-branches=" << report.searchStatistics.branchCount;
+        }
+        std::cout << "\n";
+    }
+    std::cout.flush();
+
+    std::cerr << "Graded " << reports.size() << " puzzles on " << pool.getThreadCount() << " threads in " << elapsed.count() << " s";
+    std::cerr << " (" << reports.size() / elapsed.count() << " puzzles/s)" << std::endl;
+
+    return 0;
+}
+
+static void appendResultLine(const Grid& grid, const SolveStatus status, std::string& output) {
+    output += grid.compactPrint();
+    output += "\t";
+    output += statusName(status);
+    output += "\n";
+}
+
+// for an input line that isn't a compact grid of a supported size, in the line's place
+static void appendInvalidLine(const std::string& line, std::string& output) {
+    output += line;
+    output += "\tinvalid\n";
+}
+
+static void printShardStatistics(const std::string& label, const ShardCheckpoint& checkpoint) {
+    std::cerr << label << ": solved " << checkpoint.solvedCount << " of " << checkpoint.puzzleCount << " puzzles in " << checkpoint.solveSeconds << " s of solving";
+    if (checkpoint.solveSeconds > 0) {
+        std::cerr << " (" << checkpoint.puzzleCount / checkpoint.solveSeconds << " puzzles/s)";
+    }
+    std::cerr << std::endl;
+    const LaneStatistics& laneStatistics = checkpoint.laneStatistics;
+    if (laneStatistics.batchCount == 0) {
+        return;
+    }
+    std::cerr << "Lane batches: " << laneStatistics.batchCount << ", solved in lanes: " << laneStatistics.laneSolvedCount;
+    std::cerr << ", contradictions: " << laneStatistics.laneContradictionCount << ", scalar: " << laneStatistics.scalarCount << std::endl;
+}
+
+/**
+ batch [file] [--threads n] [--engine lanes|scalar] [--shard i/n] [--shard-by index|hash] [--output path] [--checkpoint-every puzzles]
+
+ Solves one puzzle per line (generate's output format) from the file or stdin and writes each solution with its
+ status; a line that isn't a puzzle of a supported size is echoed with the status invalid. lanes (the default for
+ 9x9) propagates kLaneCount puzzles at a time and only hands stalled ones to the scalar solver; scalar runs Solver on
+ every puzzle.
+
+ With --output, only shard i of n is solved (records i, i + n, ... or, by hash, the puzzles whose hash falls on i)
+ and its answers go to the output file with a checkpoint next to it; running the same command again resumes an
+ interrupted shard. merge-shards puts the shards' outputs back together.
+ */
+static int runBatch(const int argc, const char * argv[]) {
+    std::string filename = "";
+    int threadCount = 0;
+    bool useLanes = true;
+    ShardSpec shard;
+    std::string outputPath = "";
+    ShardOptions shardOptions;
+    for (int i = 0; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (argument == "--threads" && i + 1 < argc) {
+            threadCount = atoi(argv[++i]);
+        } else if (argument == "--engine" && i + 1 < argc) {
+            useLanes = std::string(argv[++i]) != "scalar";
+        } else if (argument == "--shard" && i + 1 < argc) {
+            if (!ShardSpec::parse(argv[++i], shard)) {
+                std::cerr << "invalid shard " << argv[i] << ", expected index/count" << std::endl;
+                return 1;
+            }
+        } else if (argument == "--shard-by" && i + 1 < argc) {
+            shard.mode = std::string(argv[++i]) == "hash" ? ShardMode::Hash : ShardMode::RecordIndex;
+        } else if (argument == "--output" && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (argument == "--checkpoint-every" && i + 1 < argc) {
+            shardOptions.chunkSize = atoi(argv[++i]);
+        } else {
+            filename = argument;
+        }
+    }
+    if (shard.count > 1 && outputPath.empty()) {
+        std::cerr << "a shard needs an --output file" << std::endl;
+        return 1;
+    }
+
+    std::ifstream file;
+    if (!filename.empty()) {
+        file.open(filename);
+        if (!file.is_open()) {
+            std::cerr << "unable to open file " << filename << std::endl;
+            return 1;
+        }
+    }
+    std::istream& input = filename.empty() ? std::cin : file;
+
+    if (!outputPath.empty()) {
+        ThreadPool pool(threadCount);
+        shardOptions.useLanes = useLanes;
+        ShardedBatchRunner runner(pool, shard, shardOptions, appendResultLine);
+        ShardCheckpoint checkpoint;
+        if (!runner.run(input, outputPath, checkpoint)) {
+            std::cerr << runner.getLastError() << std::endl;
+            return 1;
+        }
+        printShardStatistics("Shard " + std::to_string(shard.index) + "/" + std::to_string(shard.count), checkpoint);
+        return 0;
+    }
+
+    GridVector grids;
+    // per input line, its grid or -1 when the line isn't a puzzle of a supported size
+    std::vector<std::string> lines;
+    IntVector gridIndices;
+    std::string line;
+    while (getline(input, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        lines.push_back(line);
+        if (Grid::compactStringSize(line) == 0) {
+            gridIndices.push_back(-1);
+        } else {
+            gridIndices.push_back((int)grids.size());
+            grids.push_back(Grid::fromCompactString(line));
+        }
+    }
+    for (auto grid = grids.begin(); grid != grids.end() && useLanes; ++grid) {
+        useLanes = LaneSolver::supportsSize(grid->getSize());
+    }
+
+    ThreadPool pool(threadCount);
+    LaneStatistics statistics;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    SolveStatusVector statuses;
+    if (useLanes) {
+        statuses = LaneSolver::solveAll(grids, pool, statistics);
+    } else {
+        statuses.resize(grids.size());
+        pool.parallelFor((int)grids.size(), [&](const int, const int itemIndex) {
+            Solver solver(grids[itemIndex]);
+            solver.setVerbose(false);
+            statuses[itemIndex] = solver.solve().status;
+        });
+    }
+    auto finish = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = finish - start;
+
+    std::string output;
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (gridIndices[i] < 0) {
+            appendInvalidLine(lines[i], output);
+        } else {
+            appendResultLine(grids[gridIndices[i]], statuses[gridIndices[i]], output);
+        }
+    }
+    std::cout << output;
+    std::cout.flush();
+
+    std::cerr << "Solved " << grids.size() << " puzzles on " << pool.getThreadCount() << " threads in " << elapsed.count() << " s";
+    std::cerr << " (" << grids.size() / elapsed.count() << " puzzles/s)" << std::endl;
+    if (lines.size() > grids.size()) {
+        std::cerr << "Invalid lines: " << lines.size() - grids.size() << std::endl;
+    }
+    if (useLanes) {
+        std::cerr << "Lane batches: " << statistics.batchCount << ", solved in lanes: " << statistics.laneSolvedCount;
+        std::cerr << ", contradictions: " << statistics.laneContradictionCount << ", scalar: " << statistics.scalarCount << std::endl;
+    }
+
+    return 0;
+}
+
+/**
+ stream [file] [--threads n] [--engine lanes|scalar] [--chunk puzzles] [--window chunks]
+
+ Same output as batch, but puzzles are read, solved and written as they stream through (stdin to stdout without a
+ file), so memory use stays bounded however long the input is.
+ */
+static int runStream(const int argc, const char * argv[]) {
+    std::string filename = "";
+    int threadCount = 0;
+    PipelineOptions options;
+    for (int i = 0; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (argument == "--threads" && i + 1 < argc) {
+            threadCount = atoi(argv[++i]);
+        } else if (argument == "--engine" && i + 1 < argc) {
+            options.useLanes = std::string(argv[++i]) != "scalar";
+        } else if (argument == "--chunk" && i + 1 < argc) {
+            options.chunkSize = atoi(argv[++i]);
+        } else if (argument == "--window" && i + 1 < argc) {
+            options.window = atoi(argv[++i]);
+        } else {
+            filename = argument;
+        }
+    }
+
+    std::ifstream file;
+    if (!filename.empty()) {
+        file.open(filename);
+        if (!file.is_open()) {
+            std::cerr << "unable to open file " << filename << std::endl;
+            return 1;
+        }
+    }
+    std::ios::sync_with_stdio(false);
+    std::istream& input = filename.empty() ? std::cin : file;
+
+    ThreadPool pool(threadCount);
+    SolvePipeline pipeline(pool, options, appendResultLine);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    PipelineStatistics statistics = pipeline.run(input, std::cout);
+    auto finish = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = finish - start;
+
+    std::cerr << "Streamed " << statistics.puzzleCount << " puzzles in " << statistics.chunkCount << " chunks on " << pool.getThreadCount();
+    std::cerr << " threads in " << elapsed.count() << " s (" << statistics.puzzleCount / elapsed.count() << " puzzles/s)";
+    std::cerr << ", reader waits: " << statistics.readerWaitCount << std::endl;
+    if (options.useLanes) {
+        const LaneStatistics& laneStatistics = statistics.laneStatistics;
+        std::cerr << "Lane batches: " << laneStatistics.batchCount << ", solved in lanes: " << laneStatistics.laneSolvedCount;
+        std::cerr << ", contradictions: " << laneStatistics.laneContradictionCount << ", scalar: " << laneStatistics.scalarCount << std::endl;
+    }
+
+    return 0;
+}
+
+/**
+ merge-shards output... [--merged file]
+
+ Combines the outputs of every shard of a sharded batch back into input order (batch's output format, to the file
+ or stdout) and adds up the shards' statistics.
+ */
+static int runMergeShards(const int argc, const char * argv[]) {
+    std::vector<std::string> outputPaths;
+    std::string mergedPath = "";
+    for (int i = 0; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (argument == "--merged" && i + 1 < argc) {
+            mergedPath = argv[++i];
+        } else {
+            outputPaths.push_back(argument);
+        }
+    }
+
+    std::ofstream mergedFile;
+    if (!mergedPath.empty()) {
+        mergedFile.open(mergedPath);
+        if (!mergedFile.is_open()) {
+            std::cerr << "unable to open " << mergedPath << std::endl;
+            return 1;
+        }
+    }
+    std::ios::sync_with_stdio(false);
+    ShardCheckpoint totals;
+    std::string error;
+    if (!ShardMerger::merge(outputPaths, mergedPath.empty() ? std::cout : mergedFile, totals, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    printShardStatistics("Merged " + std::to_string(totals.shard.count) + " shards", totals);
+    return 0;
+}
+
+// for commands that start copies of this program
+static std::string programPath = "";
+extern char** environ;
+
+/**
+ shards file --count n --output prefix [--shard-by index|hash] [--threads n] [--checkpoint-every puzzles]
+
+ Runs a sharded batch as n local processes (batch file --shard i/n --output prefix.i) and merges their outputs into
+ prefix, the way it would be spread over hosts. Shards that were interrupted resume when the command is run again.
+ */
+static int runShards(const int argc, const char * argv[]) {
+    std::string filename = "";
+    int shardCount = 2;
+    std::string prefix = "";
+    std::vector<std::string> passedOn;
+    for (int i = 0; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (argument == "--count" && i + 1 < argc) {
+            shardCount = std::max(1, atoi(argv[++i]));
+        } else if (argument == "--output" && i + 1 < argc) {
+            prefix = argv[++i];
+        } else if ((argument == "--shard-by" || argument == "--threads" || argument == "--checkpoint-every" || argument == "--engine") && i + 1 < argc) {
+            passedOn.push_back(argument);
+            passedOn.push_back(argv[++i]);
+        } else {
+            filename = argument;
+        }
+    }
+    if (filename.empty() || prefix.empty()) {
+        std::cerr << "shards needs an input file and an --output prefix" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> outputPaths;
+    std::vector<pid_t> children;
+    for (int shard = 0; shard < shardCount; shard++) {
+        outputPaths.push_back(prefix + "." + std::to_string(shard));
+        std::vector<std::string> arguments = {programPath, "batch", filename, "--shard", std::to_string(shard) + "/" + std::to_string(shardCount), "--output", outputPaths.back()};
+        arguments.insert(arguments.end(), passedOn.begin(), passedOn.end());
+        std::vector<char*> childArgv;
+        for (auto argument = arguments.begin(); argument != arguments.end(); ++argument) {
+            childArgv.push_back(&(*argument)[0]);
+        }
+        childArgv.push_back(nullptr);
+        pid_t child;
+        if (posix_spawnp(&child, programPath.c_str(), nullptr, nullptr, childArgv.data(), environ) != 0) {
+            std::cerr << "unable to start " << programPath << std::endl;
+            return 1;
+        }
+        children.push_back(child);
+    }
+    bool failed = false;
+    for (int shard = 0; shard < shardCount; shard++) {
+        int status = 0;
+        waitpid(children[shard], &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::cerr << "shard " << shard << " failed" << std::endl;
+            failed = true;
+        }
+    }
+    if (failed) {
+        return 1;
+    }
+
+    std::ofstream mergedFile(prefix);
+    ShardCheckpoint totals;
+    std::string error;
+    if (!mergedFile.is_open() || !ShardMerger::merge(outputPaths, mergedFile, totals, error)) {
+        std::cerr << (error.empty() ? "unable to open " + prefix : error) << std::endl;
+        return 1;
+    }
+    printShardStatistics("Merged " + std::to_string(shardCount) + " shards into " + prefix, totals);
+    return 0;
+}
+
+static const std::string kDefaultSocketPath = "/tmp/sudoku_solver.sock";
+
+/**
+ serve [--socket path] [--threads n] [--batch n] [--delay microseconds] [--request-timeout seconds]
+       [--request-max-nodes n]
+
+ Runs the solving daemon on a Unix domain socket until a client asks it to shut down. Each request gets
+ --request-timeout seconds (10 by default, 0 for none) and at most --request-max-nodes DFS nodes before it is
+ answered as budget exhausted.
+ */
+static int runServe(const int argc, const char * argv[]) {
+    std::string socketPath = kDefaultSocketPath;
+    int threadCount = 0;
+    DaemonOptions options;
+    for (int i = 0; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (argument == "--socket" && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (argument == "--threads" && i + 1 < argc) {
+            threadCount = atoi(argv[++i]);
+        } else if (argument == "--batch" && i + 1 < argc) {
+            options.maxBatchSize = atoi(argv[++i]);
+        } else if (argument == "--delay" && i + 1 < argc) {
+            options.batchDelayMicroseconds = atoi(argv[++i]);
+        } else if (argument == "--request-timeout" && i + 1 < argc) {
+            options.requestTimeoutSeconds = atof(argv[++i]);
+        } else if (argument == "--request-max-nodes" && i + 1 < argc) {
+            options.requestMaxNodes = atol(argv[++i]);
+        } else {
+            std::cerr << "unknown option: " << argument << std::endl;
+            return 1;
+        }
+    }
+    // a client that hangs up mid-answer must not take the daemon down
+    signal(SIGPIPE, SIG_IGN);
+
+    ThreadPool pool(threadCount);
+    SolveDaemon daemon(socketPath, pool, options);
+    std::cerr << "Listening on " << socketPath << " with " << pool.getThreadCount() << " threads" << std::endl;
+    return daemon.run() ? 0 : 1;
+}
+
+/**
+ loadtest file [--socket path] [--connections n] [--requests n] [--shutdown]
+
+ Sends the file's puzzles (one per line, reused round robin) to a running daemon over n concurrent connections and
+ reports throughput and latency percentiles, then the daemon's own statistics.
+ */
+static int runLoadTest(const int argc, const char * argv[]) {
+    std::string filename = "";
+    std::string socketPath = kDefaultSocketPath;
+    int connectionCount = 8;
+    long requestCount = 1000;
+    bool shutdownAfterwards = false;
+    for (int i = 0; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (argument == "--socket" && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (argument == "--connections" && i + 1 < argc) {
+            connectionCount = std::max(1, atoi(argv[++i]));
+        } else if (argument == "--requests" && i + 1 < argc) {
+            requestCount = atol(argv[++i]);
+        } else if (argument == "--shutdown") {
+            shutdownAfterwards = true;
+        } else {
+            filename = argument;
+        }
+    }
+
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "unable to open file " << filename << std::endl;
+        return 1;
+    }
+    std::vector<std::string> puzzles;
+    std::string line;
+    while (getline(file, line)) {
+        if (!line.empty()) {
+            puzzles.push_back(line);
+        }
+    }
+    if (puzzles.empty()) {
+        std::cerr << "no puzzles in " << filename << std::endl;
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<std::vector<double>> latencies(connectionCount);
+    std::vector<long> solvedCounts(connectionCount, 0);
+    std::vector<std::string> errors(connectionCount);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int connection = 0; connection < connectionCount; connection++) {
+        threads.push_back(std::thread([&, connection]() {
+            DaemonClient client;
+            if (!client.connectTo(socketPath)) {
+                errors[connection] = client.getLastError();
+                return;
+            }
+            for (long request = connection; request < requestCount; request += connectionCount) {
+                SolveStatus status;
+                std::string solution;
+                auto sent = std::chrono::steady_clock::now();
+                if (!client.solve(puzzles[request % puzzles.size()], status, solution)) {
+                    errors[connection] = client.getLastError();
+                    return;
+                }
+                std::chrono::duration<double> latency = std::chrono::steady_clock::now() - sent;
+                latencies[connection].push_back(latency.count());
+                solvedCounts[connection] += status == SolveStatus::Solved;
+            }
+        }));
+    }
+    for (auto thread = threads.begin(); thread != threads.end(); ++thread) {
+        thread->join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::vector<double> allLatencies;
+    long solvedCount = 0;
+    for (int connection = 0; connection < connectionCount; connection++) {
+        if (!errors[connection].empty()) {
+            std::cerr << "connection " << connection << ": " << errors[connection] << std::endl;
+        }
+        allLatencies.insert(allLatencies.end(), latencies[connection].begin(), latencies[connection].end());
+        solvedCount += solvedCounts[connection];
+    }
+    if (allLatencies.empty()) {
+        return 1;
+    }
+    std::sort(allLatencies.begin(), allLatencies.end());
+    const auto percentile = [&](const double fraction) {
+        return allLatencies[std::min(allLatencies.size() - 1, (size_t)(fraction * allLatencies.size()))] * 1000;
+    };
+    std::cout << "Requests: " << allLatencies.size() << " on " << connectionCount << " connections, solved: " << solvedCount << std::endl;
+    std::cout << "Throughput: " << allLatencies.size() / elapsed.count() << " requests/s" << std::endl;
+    std::cout << "Latency ms: p50 " << percentile(0.5) << ", p90 " << percentile(0.9) << ", p99 " << percentile(0.99);
+    std::cout << ", max " << allLatencies.back() * 1000 << std::endl;
+
+    DaemonClient client;
+    std::string statistics;
+    if (client.connectTo(socketPath) && client.requestStatistics(statistics)) {
+        std::cout << "Daemon statistics:" << std::endl << statistics;
+    }
+    if (shutdownAfterwards) {
+        client.requestShutdown();
+    }
+    return 0;
+}
+
+static const std::string kDefaultSharedMemoryName = "/sudoku_solver";
+
+// for the signal handler, so an interrupted shm-serve still unlinks its segment
+static SharedMemoryQueue* servedQueue = nullptr;
+
+static void closeServedQueue(int) {
+    if (servedQueue != nullptr) {
+        servedQueue->close();
+    }
+}
+
+static void printSharedMemoryStatistics(const SharedMemoryServerStatistics& statistics) {
+    std::cout << "Server statistics:" << std::endl;
+    std::cout << "requests " << statistics.requestCount << std::endl;
+    std::cout << "invalid_requests " << statistics.invalidRequestCount << std::endl;
+    std::cout << "solved " << statistics.solvedCount << std::endl;
+    std::cout << "lane_batches " << statistics.laneStatistics.batchCount << std::endl;
+    std::cout << "lane_solved " << statistics.laneStatistics.laneSolvedCount << std::endl;
+    std::cout << "lane_contradictions " << statistics.laneStatistics.laneContradictionCount << std::endl;
+    std::cout << "scalar " << statistics.laneStatistics.scalarCount << std::endl;
+}
+
+/**
+ shm-serve [--name name] [--threads n] [--slots n] [--max-size n] [--spin n]
+
+ Creates a shared memory queue and solves whatever co-located producers submit to it until one of them closes it
+ (shm-loadtest --shutdown) or the process is interrupted. --max-size (9 by default) goes up to 64.
+ */
+static int runSharedMemoryServe(const int argc, const char * argv[]) {
+    std::string name = kDefaultSharedMemoryName;
+    int threadCount = 0;
+    int spinCount = 2000;
+    SharedMemoryOptions options;
+    for (int i = 0; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (argument == "--name" && i + 1 < argc) {
+            name = argv[++i];
+        } else if (argument == "--threads" && i + 1 < argc) {
+            threadCount = atoi(argv[++i]);
+        } else if (argument == "--slots" && i + 1 < argc) {
+            options.slotCount = std::max(1, atoi(argv[++i]));
+        } else if (argument == "--max-size" && i + 1 < argc) {
+            options.maxGridSize = std::max(1, atoi(argv[++i]));
+            if (options.maxGridSize > 64) {
+                std::cerr << "--max-size " << options.maxGridSize << " is over the largest grid size, 64" << std::endl;
+                return 1;
+            }
+        } else if (argument == "--spin" && i + 1 < argc) {
+            spinCount = atoi(argv[++i]);
+        } else {
+            std::cerr << "unknown option: " << argument << std::endl;
+            return 1;
+        }
+    }
+
+    SharedMemoryQueue queue;
+    if (!queue.create(name, options)) {
+        std::cerr << queue.getLastError() << std::endl;
+        return 1;
+    }
+    servedQueue = &queue;
+    signal(SIGINT, closeServedQueue);
+    signal(SIGTERM, closeServedQueue);
+
+    ThreadPool pool(threadCount);
+    SharedMemoryServer server(queue, pool, spinCount);
+    std::cerr << "Serving " << name << " (" << queue.getSlotCount() << " slots) with " << pool.getThreadCount() << " threads" << std::endl;
+    server.run();
+    servedQueue = nullptr;
+    printSharedMemoryStatistics(server.getStatistics());
+    return 0;
+}
+
+/**
+ shm-loadtest file [--name name] [--producers n] [--requests n] [--spin n] [--local threads] [--shutdown]
+
+ Submits the file's puzzles (one per line, reused round robin) to a shared memory queue from n producer threads
+ while a collector thread takes the completions, checks the solutions against their puzzles and frees the slots,
+ then reports throughput and latency percentiles. With --local the queue and its server live in this process, so
+ the whole round trip can be tried without a second process; otherwise it attaches to a running shm-serve.
+ */
+static int runSharedMemoryLoadTest(const int argc, const char * argv[]) {
+    std::string filename = "";
+    std::string name = kDefaultSharedMemoryName;
+    int producerCount = 4;
+    long requestCount = 100000;
+    int spinCount = 2000;
+    int localThreadCount = -1;
+    bool shutdownAfterwards = false;
+    for (int i = 0; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (argument == "--name" && i + 1 < argc) {
+            name = argv[++i];
+        } else if (argument == "--producers" && i + 1 < argc) {
+            producerCount = std::max(1, atoi(argv[++i]));
+        } else if (argument == "--requests" && i + 1 < argc) {
+            requestCount = std::max(1L, atol(argv[++i]));
+        } else if (argument == "--spin" && i + 1 < argc) {
+            spinCount = atoi(argv[++i]);
+        } else if (argument == "--local" && i + 1 < argc) {
+            localThreadCount = std::max(0, atoi(argv[++i]));
+        } else if (argument == "--shutdown") {
+            shutdownAfterwards = true;
+        } else {
+            filename = argument;
+        }
+    }
+
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "unable to open file " << filename << std::endl;
+        return 1;
+    }
+    std::vector<std::string> lines;
+    std::string line;
+    while (getline(file, line)) {
+        if (!line.empty()) {
+            lines.push_back(line);
+        }
+    }
+
+    SharedMemoryQueue queue;
+    std::unique_ptr<ThreadPool> localPool;
+    std::unique_ptr<SharedMemoryServer> localServer;
+    std::thread serverThread;
+    if (localThreadCount >= 0) {
+        SharedMemoryOptions options;
+        for (auto puzzle = lines.begin(); puzzle != lines.end(); ++puzzle) {
+            options.maxGridSize = std::max(options.maxGridSize, Grid::compactStringSize(*puzzle));
+        }
+        if (!queue.create(name, options)) {
+            std::cerr << queue.getLastError() << std::endl;
+            return 1;
+        }
+        localPool.reset(new ThreadPool(localThreadCount));
+        localServer.reset(new SharedMemoryServer(queue, *localPool, spinCount));
+        serverThread = std::thread([&]() { localServer->run(); });
+    } else if (!queue.attach(name)) {
+        std::cerr << queue.getLastError() << std::endl;
+        return 1;
+    }
+
+    // in compactPrint's alphabet, so a solution can be checked against its givens character by character
+    std::vector<std::string> puzzles;
+    std::map<int, Grid> checkGrids;
+    for (auto puzzle = lines.begin(); puzzle != lines.end(); ++puzzle) {
+        const int size = Grid::compactStringSize(*puzzle);
+        if (size > 0 && size <= queue.getMaxGridSize()) {
+            auto found = checkGrids.find(size);
+            if (found == checkGrids.end()) {
+                found = checkGrids.insert(std::make_pair(size, Grid(size))).first;
+            }
+            found->second.loadCompactString(*puzzle);
+            puzzles.push_back(found->second.compactPrint());
+        }
+    }
+    if (puzzles.empty()) {
+        std::cerr << "no puzzles in " << filename << " fit the queue's records" << std::endl;
+        requestCount = 0;
+    }
+
+    // indexed by tag; written before the submit and read after the matching completion
+    std::vector<std::chrono::steady_clock::time_point> sentAt(requestCount);
+    std::vector<double> latencies;
+    latencies.reserve(requestCount);
+    long solvedCount = 0;
+    long wrongCount = 0;
+    bool collectorGaveUp = false;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread collector([&]() {
+        for (long received = 0; received < requestCount; received++) {
+            uint32_t slot;
+            if (!queue.takeCompleted(slot, -1, spinCount)) {
+                collectorGaveUp = true;
+                return;
+            }
+            const SlotRecord& record = queue.recordOfSlot(slot);
+            latencies.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - sentAt[record.tag]).count());
+            if ((SolveStatus)record.status == SolveStatus::Solved) {
+                solvedCount += 1;
+                const std::string& puzzle = puzzles[record.tag % puzzles.size()];
+                const char* cells = queue.cellsOfSlot(slot);
+                Grid& checkGrid = checkGrids.at(record.size);
+                bool keepsGivens = true;
+                for (size_t cellIndex = 0; cellIndex < puzzle.size(); cellIndex++) {
+                    keepsGivens &= puzzle[cellIndex] == '-' || puzzle[cellIndex] == cells[cellIndex];
+                }
+                if (!keepsGivens || !checkGrid.loadCompactCharacters(cells, (int)puzzle.size()) || !checkGrid.isSolved()) {
+                    wrongCount += 1;
+                }
+            }
+            queue.release(slot);
+        }
+    });
+
+    std::vector<std::thread> producers;
+    std::atomic<bool> producerGaveUp(false);
+    for (int producer = 0; producer < producerCount; producer++) {
+        producers.push_back(std::thread([&, producer]() {
+            for (long request = producer; request < requestCount; request += producerCount) {
+                uint32_t slot;
+                if (!queue.acquireFreeSlot(slot, -1, spinCount)) {
+                    producerGaveUp = true;
+                    return;
+                }
+                const std::string& puzzle = puzzles[request % puzzles.size()];
+                SlotRecord& record = queue.recordOfSlot(slot);
+                record.tag = request;
+                record.size = Grid::compactStringSize(puzzle);
+                memcpy(queue.cellsOfSlot(slot), puzzle.data(), puzzle.size());
+                sentAt[request] = std::chrono::steady_clock::now();
+                queue.submit(slot);
+            }
+        }));
+    }
+    for (auto producer = producers.begin(); producer != producers.end(); ++producer) {
+        producer->join();
+    }
+    if (producerGaveUp) {
+        // the collector would wait for requests that were never sent
+        queue.close();
+    }
+    collector.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if (shutdownAfterwards || localServer != nullptr) {
+        queue.close();
+    }
+    if (localServer != nullptr) {
+        serverThread.join();
+    }
+    if (producerGaveUp || collectorGaveUp) {
+        std::cerr << "the queue was closed before every request was answered" << std::endl;
+    }
+    if (latencies.empty()) {
+        return 1;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&](const double fraction) {
+        return latencies[std::min(latencies.size() - 1, (size_t)(fraction * latencies.size()))] * 1000;
+    };
+    std::cout << "Requests: " << latencies.size() << " from " << producerCount << " producers, solved: " << solvedCount;
+    std::cout << ", wrong: " << wrongCount << std::endl;
+    std::cout << "Throughput: " << latencies.size() / elapsed.count() << " requests/s" << std::endl;
+    std::cout << "Latency ms: p50 " << percentile(0.5) << ", p90 " << percentile(0.9) << ", p99 " << percentile(0.99);
+    std::cout << ", max " << latencies.back() * 1000 << std::endl;
+    if (localServer != nullptr) {
+        printSharedMemoryStatistics(localServer->getStatistics());
+    }
+    return wrongCount == 0 && !producerGaveUp && !collectorGaveUp ? 0 : 1;
+}
+
+int main(int argc, const char * argv[]) {
+    programPath = argv[0];
+    if (argc > 1 && std::string(argv[1]) == "generate") {
+        return runGenerate(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::string(argv[1]) == "count") {
+        return runCount(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::string(argv[1]) == "enumerate") {
+        return runEnumerate(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::string(argv[1]) == "enumerate-print") {
+        return runEnumeratePrint(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::string(argv[1]) == "grade") {
+        return runGrade(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::string(argv[1]) == "batch") {
+        return runBatch(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::string(argv[1]) == "stream") {
+        return runStream(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::string(argv[1]) == "merge-shards") {
+        return runMergeShards(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::string(argv[1]) == "shards") {
+        return runShards(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::string(argv[1]) == "serve") {
+        return runServe(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::string(argv[1]) == "loadtest") {
+        return runLoadTest(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::string(argv[1]) == "shm-serve") {
+        return runSharedMemoryServe(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::string(argv[1]) == "shm-loadtest") {
+        return runSharedMemoryLoadTest(argc - 2, argv + 2);
+    }
+    return runSolve(argc - 1, argv + 1);
+}